@@ -344,6 +344,11 @@ def get_var_attrs(cli, var_token, partial_word):
             var_desc = 'configuration filename'
             var_candidates = complete_filename(partial_word)
 
+        elif var_token == 'SNAPSHOT_FILE':
+            var_type = 'filename'
+            var_desc = 'snapshot filename on the BESS host'
+            var_candidates = complete_filename(partial_word)
+
         elif var_token == 'PLUGIN_FILE':
             var_type = 'filename'
             var_desc = 'plugin filename (*.so)'
@@ -757,6 +762,38 @@ def daemon_reset(cli):
         warn(cli, 'The entire pipeline will be cleared.', _do_reset)
 
 
+@cmd('daemon save SNAPSHOT_FILE', 'Save the pipeline to a snapshot file')
+def daemon_save(cli, path):
+    resp = cli.bess.save_snapshot(os.path.abspath(path))
+    cli.fout.write('Saved %d modules (%d bytes) in %.3f seconds\n' %
+                   (resp.num_modules, resp.bytes, resp.elapsed))
+
+
+@cmd('daemon restore SNAPSHOT_FILE',
+     'Rebuild the pipeline from a snapshot file')
+def daemon_restore(cli, path):
+    resp = cli.bess.restore_snapshot(os.path.abspath(path))
+    cli.fout.write('Restored %d modules in %.3f seconds\n' %
+                   (resp.num_modules, resp.elapsed))
+
+
+@cmd('daemon restart SNAPSHOT_FILE [BESSD_OPTS...]',
+     'Restart BESS daemon, rebuilding the pipeline from a snapshot file')
+def daemon_restart(cli, path, opts):
+    path = os.path.abspath(path)
+
+    # Paused until the daemon is killed, so that the snapshot is up to date.
+    cli.bess.pause_all()
+    try:
+        resp = cli.bess.save_snapshot(path)
+    except:
+        cli.bess.resume_all()
+        raise
+    cli.fout.write('Saved %d modules (%d bytes) in %.3f seconds\n' %
+                   (resp.num_modules, resp.bytes, resp.elapsed))
+    _do_start(cli, (opts or []) + ['--restore=%s' % path])
+
+
 def _do_stop(cli):
     cli.bess.pause_all()
     cli.bess.kill()
@@ -1497,19 +1534,28 @@ def _show_module(cli, module_name):
 
     if len(info.metadata) > 0:
         cli.fout.write('    Per-packet metadata fields:\n')
+        lines = set()
         for field in info.metadata:
             cli.fout.write('%16s %-6s%2d bytes ' %
                            (field.name + ':', field.mode, field.size))
 
             if field.offset >= 0:
-                cli.fout.write('at offset %d\n' % field.offset)
+                cli.fout.write('at offset %d (cache line %d)\n' %
+                               (field.offset, field.cache_line))
+                lines.add(field.cache_line)
             elif field.offset == -1:
                 cli.fout.write('(no downstream reader)\n')
             elif field.offset == -2:
                 cli.fout.write('(no upstream writer)\n')
+            elif field.offset == -3:
+                cli.fout.write('(out of metadata space)\n')
             else:
                 cli.fout.write('\n')
 
+        if len(lines) > 1:
+            cli.fout.write('    Metadata fields span %d cache lines\n' %
+                           len(lines))
+
     if len(info.igates) > 0:
         cli.fout.write('    Input gates:\n')
         for gate in info.igates:
@@ -2113,6 +2159,40 @@ def show_system_packets(cli, socket):
         cli.fout.write('\tring_bytes: {}\n'.format(dump.ring_bytes))
 
 
+@cmd('show trace', 'Show per-module latency of sampled packets, and clear it')
+def show_trace(cli):
+    resp = cli.bess.dump_trace()
+
+    # Group records by packet, then measure the time between consecutive hops
+    packets = collections.defaultdict(list)
+    for r in resp.records:
+        packets[(r.stamp, r.pkt_index)].append(r)
+
+    hops = collections.defaultdict(list)
+    for records in packets.values():
+        records.sort(key=lambda r: r.tsc)
+        for prev, cur in zip(records, records[1:]):
+            usec = (cur.tsc - prev.tsc) * 1e6 / resp.tsc_hz
+            hops[(prev.module, cur.module)].append(usec)
+
+    cli.fout.write('%d packets sampled, %d records dropped\n' %
+                   (len(packets), resp.dropped))
+    if not hops:
+        return
+
+    def percentile(values, p):
+        return values[min(len(values) - 1, int(len(values) * p / 100.0))]
+
+    cli.fout.write('%-40s %10s %10s %10s %10s\n' %
+                   ('hop', 'count', 'p50(us)', 'p99(us)', 'max(us)'))
+    for (src, dst), values in sorted(hops.items()):
+        values.sort()
+        cli.fout.write('%-40s %10d %10.3f %10.3f %10.3f\n' %
+                       ('%s -> %s' % (src, dst), len(values),
+                        percentile(values, 50), percentile(values, 99),
+                        values[-1]))
+
+
 @cmd('http [HOST] [PORT_NUMBER]', 'Run an HTTP server')
 def http(cli, host, port):
     host = host or 'localhost'
@@ -28,6 +28,7 @@
 # POSSIBILITY OF SUCH DAMAGE.
 
 from test_utils import *
+from pybess import protobuf_to_dict as pb_conv
 
 
 class BessIPLookupTest(BessModuleTestCase):
@@ -52,6 +53,24 @@ class BessIPLookupTest(BessModuleTestCase):
         self.assertSamePackets(pkt_outs[0][0], pkts[0])
         self.assertSamePackets(pkt_outs[1][0], pkts[1])
 
+    def test_runtime_config(self):
+        ipl = IPLookup(ipv6=True)
+        ipl.add(prefix='::', prefix_len=0, gate=2)
+        ipl.add(prefix='22.22.22.0', prefix_len=24, gate=0)
+        ipl.add(prefix='2001:db8::', prefix_len=32, gate=1)
+        ipl.add(prefix='2001:db8:1::', prefix_len=48, gate=3)
+
+        config = ipl.get_runtime_config()
+        routes = [(r.prefix, r.prefix_len, r.gate) for r in config.rules]
+        self.assertEquals(routes, [('::', 0, 2),
+                                   ('22.22.22.0', 24, 0),
+                                   ('2001:db8::', 32, 1),
+                                   ('2001:db8:1::', 48, 3)])
+
+        ipl2 = IPLookup(ipv6=True)
+        ipl2.set_runtime_config(**pb_conv.protobuf_to_dict(config))
+        self.assertEquals(ipl2.get_runtime_config(), config)
+
     def test_prefix(self):
         ipl = IPLookup()
         with self.assertRaises(bess.Error):
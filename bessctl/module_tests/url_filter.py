@@ -125,6 +125,26 @@ class BessUrlFilterTest(BessModuleTestCase):
         #    '\nmut state:', cur_config, 'expecting:', expect_config)
         assert arg == iconf and cur_config == expect_config
 
+    def test_urlfilter_selfconfig_domains(self):
+        uf = UrlFilter(domains=['*.Example.com'])
+        uf.add(blacklist=[{'host': 'www.blacklisted.com', 'path': '/'}])
+        # Domains are reported normalized, in both the initial argument and
+        # the runtime config.
+        expect_arg = {'domains': ['example.com']}
+        expect_config = {
+            'blacklist': [{'host': 'www.blacklisted.com', 'path': '/'}],
+            'domains': ['example.com'],
+        }
+        arg = pb_conv.protobuf_to_dict(uf.get_initial_arg())
+        cur_config = pb_conv.protobuf_to_dict(uf.get_runtime_config())
+        assert arg == expect_arg and cur_config == expect_config
+
+        # A bad config is rejected without touching the current one.
+        with self.assertRaises(bess.Error):
+            uf.set_runtime_config(blacklist=[], domains=['example.org', '.'])
+        cur_config = pb_conv.protobuf_to_dict(uf.get_runtime_config())
+        assert cur_config == expect_config
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessUrlFilterTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
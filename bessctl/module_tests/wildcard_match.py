@@ -101,6 +101,29 @@ class BessWildcardMatchTest(BessModuleTestCase):
         self.assertEquals(len(pkt_outs[3]), 1)
         self.assertSamePackets(pkt_outs[3][0], pkt_nomatch)
 
+    def test_wildcardmatch_priority_tie(self):
+        # Among matches of equal priority, the rule whose mask was added last
+        # wins, even if an older mask also holds higher-priority rules.
+        wm = WildcardMatch(fields=[{'offset': 26, 'num_bytes': 4},
+                                   {'offset': 30, 'num_bytes': 4}])
+        src_only = vstring([0xff, 0xff, 0xff, 0xff], [0, 0, 0, 0])
+        dst_only = vstring([0, 0, 0, 0], [0xff, 0xff, 0xff, 0xff])
+        sip = '65.43.21.0'
+        dip = '12.34.56.78'
+        any_ip = {'value_bin': socket.inet_aton('0.0.0.0')}
+        wm.add(gate=0, priority=5, masks=src_only,
+               values=[{'value_bin': socket.inet_aton('1.1.1.1')}, any_ip])
+        wm.add(gate=1, priority=1, masks=src_only,
+               values=[{'value_bin': socket.inet_aton(sip)}, any_ip])
+        wm.add(gate=2, priority=1, masks=dst_only,
+               values=[any_ip, {'value_bin': socket.inet_aton(dip)}])
+        wm.set_default_gate(gate=3)
+
+        pkt = get_tcp_packet(sip=sip, dip=dip)
+        pkt_outs = self.run_module(wm, 0, [pkt], range(4))
+        self.assertEquals(len(pkt_outs[2]), 1)
+        self.assertSamePackets(pkt_outs[2][0], pkt)
+
     def test_wildcardmatch_with_metadata(self):
         # One wildcard match field
         mask = vstring([0xff, 0xff])
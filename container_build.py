@@ -111,7 +111,7 @@ def shell_quote(cmd):
 
 
 def docker_env_args():
-    env_vars = ['V', 'CXX', 'DEBUG', 'SANITIZE']
+    env_vars = ['V', 'CXX', 'DEBUG', 'SANITIZE', 'METADATA_SIZE']
     return ' '.join(['-e %s' % var for var in env_vars])
 
 
@@ -31,6 +31,15 @@
 
 #include "bessctl.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
 #include <thread>
 
 #include <gflags/gflags.h>
@@ -50,10 +59,12 @@
 #include "gate_hooks/track.h"
 #include "message.h"
 #include "metadata.h"
+#include "metrics.h"
 #include "module.h"
 #include "module_graph.h"
 #include "opts.h"
 #include "packet_pool.h"
+#include "packet_trace.h"
 #include "port.h"
 #include "resume_hook.h"
 #include "scheduler.h"
@@ -90,6 +101,45 @@ static inline Status return_with_errno(T* response, int code) {
   return Status::OK;
 }
 
+// gRPC handlers that change the daemon (the pipeline, workers, ports, ...)
+// take this lock exclusively; read-only ones, module commands and gate hook
+// commands take it shared, and thus run concurrently. Module and gate hook
+// commands are further serialized per module (see Module::RunCommand()).
+// The exclusive lock is recursive, since handlers may call each other.
+class ControlMutex {
+ public:
+  void lock() {
+    if (exclusive_depth_++ == 0) {
+      mutex_.lock();
+    }
+  }
+
+  void unlock() {
+    if (--exclusive_depth_ == 0) {
+      mutex_.unlock();
+    }
+  }
+
+  // No-ops if the exclusive lock is held by this thread.
+  void lock_shared() {
+    if (exclusive_depth_ == 0) {
+      mutex_.lock_shared();
+    }
+  }
+
+  void unlock_shared() {
+    if (exclusive_depth_ == 0) {
+      mutex_.unlock_shared();
+    }
+  }
+
+ private:
+  std::shared_mutex mutex_;
+  static thread_local int exclusive_depth_;
+};
+
+thread_local int ControlMutex::exclusive_depth_ = 0;
+
 static inline bess::Gate* module_gate(const Module* m, bool is_igate,
                                       gate_idx_t gate_idx) {
   if (is_igate) {
@@ -305,6 +355,7 @@ static int collect_metadata(Module* m, GetModuleInfoResponse* response) {
     }
 
     attr->set_offset(m->attr_offset(i));
+    attr->set_cache_line(bess::metadata::CacheLineOf(m->attr_offset(i)));
     i++;
   }
 
@@ -433,15 +484,209 @@ static void collect_tc(const bess::TrafficClass* c, int wid,
   }
 }
 
+// Appends "c" and its subtree to "snapshot", parents before children, in a
+// form that AddTc() and UpdateTcParent() accept.
+static void snapshot_tc(const bess::TrafficClass* c, int wid,
+                        PipelineSnapshot* snapshot) {
+  ListTcsResponse_TrafficClassStatus status;
+  collect_tc(c, wid, &status);
+
+  bess::pb::TrafficClass* class_ = snapshot->add_tcs();
+  *class_ = status.class_();
+  class_->set_blocked(false);
+  if (c->parent()) {
+    class_->set_parent(status.parent());
+    class_->set_wid(Worker::kAnyWorker);
+  }
+
+  switch (c->policy()) {
+    case bess::POLICY_LEAF:
+      // Leaves are looked up by module and task ID instead.
+      class_->clear_name();
+      return;
+    case bess::POLICY_WEIGHTED_FAIR: {
+      const auto* wrr = static_cast<const bess::WeightedFairTrafficClass*>(c);
+      class_->set_resource(bess::ResourceName.at(wrr->resource()));
+      for (const auto& child_data : wrr->children()) {
+        int idx = snapshot->tcs_size();
+        snapshot_tc(child_data.first, wid, snapshot);
+        snapshot->mutable_tcs(idx)->set_share(child_data.second);
+      }
+      return;
+    }
+    case bess::POLICY_PRIORITY: {
+      const auto* prio = static_cast<const bess::PriorityTrafficClass*>(c);
+      for (const auto& child_data : prio->children()) {
+        int idx = snapshot->tcs_size();
+        snapshot_tc(child_data.c_, wid, snapshot);
+        snapshot->mutable_tcs(idx)->set_priority(child_data.priority_);
+      }
+      return;
+    }
+    case bess::POLICY_RATE_LIMIT: {
+      const auto* rl = static_cast<const bess::RateLimitTrafficClass*>(c);
+      class_->set_resource(bess::ResourceName.at(rl->resource()));
+      break;
+    }
+    default:
+      break;
+  }
+
+  for (const auto* child : c->Children()) {
+    snapshot_tc(child, wid, snapshot);
+  }
+}
+
+// Counters of the objects selected by a SubscribeStatsRequest, keyed by name.
+// See StatsUpdate for the meaning of each column.
+struct StatsSnapshot {
+  double timestamp;
+  std::map<std::string, std::array<uint64_t, 6>> ports;
+  std::map<std::string, std::array<uint64_t, 6>> modules;
+  std::map<std::string, std::array<uint64_t, 4>> tcs;
+};
+
+// Calls f() on every object in "all" whose name is listed in "names", or on
+// all of them if "names" contains "*". Returns a listed name that does not
+// exist, or nullptr.
+template <typename M, typename F>
+static const std::string* for_each_selected(
+    const google::protobuf::RepeatedPtrField<std::string>& names, const M& all,
+    F f) {
+  if (std::find(names.begin(), names.end(), "*") != names.end()) {
+    for (const auto& pair : all) {
+      f(pair.first, pair.second);
+    }
+    return nullptr;
+  }
+
+  const std::string* missing = nullptr;
+  for (const auto& name : names) {
+    const auto& it = all.find(name);
+    if (it == all.end()) {
+      missing = &name;
+      continue;
+    }
+    f(it->first, it->second);
+  }
+  return missing;
+}
+
+static std::array<uint64_t, 6> collect_module_counters(Module* m) {
+  std::array<uint64_t, 6> counters = {};
+  for (const auto& g : m->igates()) {
+    Track* t = g ? reinterpret_cast<Track*>(g->FindHookByClass(Track::kName))
+                 : nullptr;
+    if (t) {
+      counters[0] += t->cnt();
+      counters[1] += t->pkts();
+      counters[2] += t->bytes();
+    }
+  }
+  for (const auto& g : m->ogates()) {
+    Track* t = g ? reinterpret_cast<Track*>(g->FindHookByClass(Track::kName))
+                 : nullptr;
+    if (t) {
+      counters[3] += t->cnt();
+      counters[4] += t->pkts();
+      counters[5] += t->bytes();
+    }
+  }
+  return counters;
+}
+
+// Returns how much the counters of "name" have grown since "prev". Objects
+// that are new, or whose counters went backwards (e.g., destroyed and created
+// again), report their current values.
+template <size_t N>
+static std::array<uint64_t, N> counter_delta(
+    const std::map<std::string, std::array<uint64_t, N>>& prev,
+    const std::string& name, const std::array<uint64_t, N>& cur) {
+  const auto& it = prev.find(name);
+  if (it == prev.end()) {
+    return cur;
+  }
+
+  std::array<uint64_t, N> delta;
+  for (size_t i = 0; i < N; i++) {
+    delta[i] = cur[i] >= it->second[i] ? cur[i] - it->second[i] : cur[i];
+  }
+  return delta;
+}
+
+static void fill_stats_update(const StatsSnapshot& prev,
+                              const StatsSnapshot& cur, StatsUpdate* update) {
+  update->set_timestamp(cur.timestamp);
+  update->set_interval(prev.timestamp > 0 ? cur.timestamp - prev.timestamp
+                                          : 0);
+
+  for (const auto& pair : cur.ports) {
+    const auto d = counter_delta(prev.ports, pair.first, pair.second);
+    StatsUpdate::PortStats* port = update->add_ports();
+    port->set_name(pair.first);
+    port->set_inc_packets(d[0]);
+    port->set_inc_dropped(d[1]);
+    port->set_inc_bytes(d[2]);
+    port->set_out_packets(d[3]);
+    port->set_out_dropped(d[4]);
+    port->set_out_bytes(d[5]);
+  }
+
+  for (const auto& pair : cur.modules) {
+    const auto d = counter_delta(prev.modules, pair.first, pair.second);
+    StatsUpdate::ModuleStats* module = update->add_modules();
+    module->set_name(pair.first);
+    module->set_in_batches(d[0]);
+    module->set_in_packets(d[1]);
+    module->set_in_bytes(d[2]);
+    module->set_out_batches(d[3]);
+    module->set_out_packets(d[4]);
+    module->set_out_bytes(d[5]);
+  }
+
+  for (const auto& pair : cur.tcs) {
+    const auto d = counter_delta(prev.tcs, pair.first, pair.second);
+    StatsUpdate::TcStats* tc = update->add_tcs();
+    tc->set_name(pair.first);
+    tc->set_count(d[0]);
+    tc->set_cycles(d[1]);
+    tc->set_packets(d[2]);
+    tc->set_bits(d[3]);
+  }
+}
+
+// Adds the hardware event counters of all leaves in the subtree of "c" to
+// "sum".
+static void sum_tc_perf(const bess::TrafficClass* c,
+                        bess::utils::perf_arr_t sum) {
+  if (c->policy() == bess::POLICY_LEAF) {
+    for (int i = 0; i < bess::utils::NUM_PERF_EVENTS; i++) {
+      sum[i] += c->stats().perf[i];
+    }
+    return;
+  }
+
+  for (const bess::TrafficClass* child : c->Children()) {
+    sum_tc_perf(child, sum);
+  }
+}
+
 class BESSControlImpl final : public BESSControl::Service {
  public:
   void set_shutdown_func(const std::function<void()>& func) {
     shutdown_func_ = func;
   }
 
+  // Renders the page served by the metrics endpoint (see metrics.h).
+  std::string RenderMetrics() {
+    std::shared_lock<ControlMutex> lock(mutex_);
+    std::lock_guard<std::mutex> stats_lock(port_stats_mutex_);
+    return bess::RenderMetrics();
+  }
+
   Status GetVersion(ServerContext*, const EmptyRequest*,
                     VersionResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     response->set_version(google::VersionString());
     return Status::OK;
@@ -449,7 +694,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ResetAll(ServerContext* context, const EmptyRequest* request,
                   EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     Status status;
     WorkerPauser wp;
@@ -481,7 +726,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status PauseAll(ServerContext*, const EmptyRequest*,
                   EmptyResponse*) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     pause_all_workers();
     LOG(INFO) << "*** All workers have been paused ***";
@@ -490,7 +735,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status PauseWorker(ServerContext*, const PauseWorkerRequest* req,
                      EmptyResponse*) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     int wid = req->wid();
     // TODO: It should be made harder to wreak havoc on the rest of the daemon
@@ -505,7 +750,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ResumeAll(ServerContext*, const EmptyRequest*,
                    EmptyResponse*) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     if (!is_any_worker_running()) {
       attach_orphans();
@@ -520,7 +765,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ResumeWorker(ServerContext*, const ResumeWorkerRequest* req,
                       EmptyResponse*) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     int wid = req->wid();
     LOG(INFO) << "*** Resuming worker " << wid << " ***";
@@ -530,7 +775,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ResetWorkers(ServerContext*, const EmptyRequest*,
                       EmptyResponse*) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
     destroy_all_workers();
@@ -540,7 +785,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListWorkers(ServerContext*, const EmptyRequest*,
                      ListWorkersResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
       if (!is_worker_active(wid))
@@ -557,7 +802,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status AddWorker(ServerContext*, const AddWorkerRequest* request,
                    EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     uint64_t wid = request->wid();
     if (wid >= Worker::kMaxWorkers) {
@@ -583,7 +828,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status DestroyWorker(ServerContext*, const DestroyWorkerRequest* request,
                        EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     uint64_t wid = request->wid();
     if (wid >= Worker::kMaxWorkers) {
@@ -613,7 +858,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ResetTcs(ServerContext*, const EmptyRequest*,
                   EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
 
@@ -626,7 +871,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListTcs(ServerContext*, const ListTcsRequest* request,
                  ListTcsResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     int wid_filter = request->wid();
     if (wid_filter >= Worker::kMaxWorkers) {
@@ -678,7 +923,7 @@ class BESSControlImpl final : public BESSControl::Service {
   Status CheckSchedulingConstraints(
       ServerContext*, const EmptyRequest*,
       CheckSchedulingConstraintsResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     // Start by attaching orphans -- this is essential to make sure we visit
     // every TC.
@@ -737,7 +982,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status AddTc(ServerContext*, const AddTcRequest* request,
                EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
 
@@ -809,7 +1054,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status UpdateTcParams(ServerContext*, const UpdateTcParamsRequest* request,
                         EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
 
@@ -853,7 +1098,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status UpdateTcParent(ServerContext*, const UpdateTcParentRequest* request,
                         EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
 
@@ -888,7 +1133,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GetTcStats(ServerContext*, const GetTcStatsRequest* request,
                     GetTcStatsResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     const char* tc_name = request->name().c_str();
 
@@ -912,12 +1157,23 @@ class BESSControlImpl final : public BESSControl::Service {
     response->set_packets(c->stats().usage[bess::RESOURCE_PACKET]);
     response->set_bits(c->stats().usage[bess::RESOURCE_BIT]);
 
+    if (FLAGS_perf_counters) {
+      bess::utils::perf_arr_t perf = {};
+      sum_tc_perf(c, perf);
+      response->set_perf_counters(true);
+      response->set_hw_cycles(perf[bess::utils::PERF_EVENT_CYCLES]);
+      response->set_instructions(perf[bess::utils::PERF_EVENT_INSTRUCTIONS]);
+      response->set_llc_misses(perf[bess::utils::PERF_EVENT_LLC_MISSES]);
+      response->set_branch_misses(perf[bess::utils::PERF_EVENT_BRANCH_MISSES]);
+      response->set_dtlb_misses(perf[bess::utils::PERF_EVENT_DTLB_MISSES]);
+    }
+
     return Status::OK;
   }
 
   Status ListDrivers(ServerContext*, const EmptyRequest*,
                      ListDriversResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     for (const auto& pair : PortBuilder::all_port_builders()) {
       const PortBuilder& builder = pair.second;
@@ -929,7 +1185,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GetDriverInfo(ServerContext*, const GetDriverInfoRequest* request,
                        GetDriverInfoResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     if (request->driver_name().length() == 0) {
       return return_with_error(response, EINVAL,
@@ -958,7 +1214,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ResetPorts(ServerContext*, const EmptyRequest*,
                     EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
 
@@ -980,7 +1236,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListPorts(ServerContext*, const EmptyRequest*,
                    ListPortsResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     for (const auto& pair : PortBuilder::all_ports()) {
       const ::Port* p = pair.second;
@@ -1001,7 +1257,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status CreatePort(ServerContext*, const CreatePortRequest* request,
                     CreatePortResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     const char* driver_name;
     ::Port* port = nullptr;
@@ -1038,7 +1294,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status SetPortConf(ServerContext*, const SetPortConfRequest* request,
                      CommandResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     if (!request->name().length()) {
       return return_with_error(response, EINVAL, "Port name is not given");
@@ -1070,7 +1326,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GetPortConf(ServerContext*, const GetPortConfRequest* request,
                      GetPortConfResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     if (!request->name().length()) {
       return return_with_error(response, EINVAL, "Port name is not given");
@@ -1095,7 +1351,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status DestroyPort(ServerContext*, const DestroyPortRequest* request,
                      EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     const char* port_name;
     int ret;
@@ -1120,7 +1376,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GetPortStats(ServerContext*, const GetPortStatsRequest* request,
                       GetPortStatsResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     const auto& it = PortBuilder::all_ports().find(request->name());
     if (it == PortBuilder::all_ports().end()) {
@@ -1128,7 +1384,12 @@ class BESSControlImpl final : public BESSControl::Service {
                                request->name().c_str());
     }
 
-    ::Port::PortStats stats = it->second->GetPortStats();
+    ::Port::PortStats stats;
+    {
+      // Collecting stats updates the port's counters.
+      std::lock_guard<std::mutex> stats_lock(port_stats_mutex_);
+      stats = it->second->GetPortStats();
+    }
 
     response->mutable_inc()->set_packets(stats.inc.packets);
     response->mutable_inc()->set_dropped(stats.inc.dropped);
@@ -1157,7 +1418,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GetLinkStatus(ServerContext*, const GetLinkStatusRequest* request,
                        GetLinkStatusResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     const auto& it = PortBuilder::all_ports().find(request->name());
     if (it == PortBuilder::all_ports().end()) {
@@ -1175,9 +1436,170 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status SubscribeStats(ServerContext* context,
+                        const SubscribeStatsRequest* request,
+                        grpc::ServerWriter<StatsUpdate>* writer) override {
+    const uint64_t kMinIntervalMs = 10;
+    const uint64_t interval_ms =
+        request->interval_ms() ? request->interval_ms() : 1000;
+
+    if (interval_ms < kMinIntervalMs) {
+      StatsUpdate update;
+      return_with_error(&update, EINVAL, "'interval_ms' must be at least %d",
+                        static_cast<int>(kMinIntervalMs));
+      writer->Write(update);
+      return Status::OK;
+    }
+
+    const auto interval = std::chrono::milliseconds(interval_ms);
+    auto next = std::chrono::steady_clock::now();
+    StatsSnapshot prev = {};
+
+    while (true) {
+      StatsSnapshot cur = {};
+      StatsUpdate update;
+
+      if (!CollectStats(*request, &cur, &update)) {
+        writer->Write(update);
+        return Status::OK;
+      }
+
+      fill_stats_update(prev, cur, &update);
+      if (!writer->Write(update)) {
+        return Status::OK;  // The client has gone away.
+      }
+      prev = std::move(cur);
+
+      // Updates follow a fixed schedule, so that intervals do not drift. If we
+      // fell behind (e.g., a slow client), skip the missed ticks.
+      next += interval;
+      while (true) {
+        if (context->IsCancelled() || shutting_down_) {
+          return Status::OK;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next + interval) {
+          next = now;
+        }
+        if (now >= next) {
+          break;
+        }
+        std::this_thread::sleep_for(
+            std::min<std::chrono::steady_clock::duration>(
+                next - now, std::chrono::milliseconds(100)));
+      }
+    }
+  }
+
+  Status DumpTrace(ServerContext*, const EmptyRequest*,
+                   DumpTraceResponse* response) override {
+    if (!bess::trace::enabled()) {
+      return return_with_error(response, ENOTSUP,
+                               "Tracing is disabled (see --trace_sample)");
+    }
+
+    std::lock_guard<std::mutex> lock(trace_mutex_);
+
+    response->set_tsc_hz(tsc_hz);
+    std::map<uint32_t, std::string> names;
+    uint64_t dropped = bess::trace::Drain(
+        [&](int wid, const bess::trace::Record& r) {
+          auto it = names.find(r.module_id);
+          if (it == names.end()) {
+            it = names.emplace(r.module_id,
+                               bess::trace::ModuleName(r.module_id)).first;
+          }
+          DumpTraceResponse::Record* record = response->add_records();
+          record->set_stamp(r.stamp);
+          record->set_pkt_index(r.pkt_index);
+          record->set_module(it->second);
+          record->set_tsc(r.tsc);
+          record->set_wid(wid);
+        });
+    response->set_dropped(dropped);
+
+    return Status::OK;
+  }
+
+  Status SaveSnapshot(ServerContext*, const SnapshotRequest* request,
+                      SnapshotResponse* response) override {
+    // Exclusive, so that no command changes a module while it is saved.
+    // Workers keep running.
+    std::lock_guard<ControlMutex> lock(mutex_);
+
+    double start = get_epoch_time();
+    if (!request->path().length()) {
+      return return_with_error(response, EINVAL, "Missing 'path' field");
+    }
+
+    PipelineSnapshot snapshot;
+    if (!BuildSnapshot(&snapshot, response)) {
+      return Status::OK;
+    }
+
+    // Write to a temporary file first, so that an existing snapshot is only
+    // replaced by a complete one.
+    const std::string tmp_path = request->path() + ".tmp";
+    {
+      std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+      if (!file || !snapshot.SerializeToOstream(&file) || !file.flush()) {
+        int err = errno ? errno : EIO;
+        std::remove(tmp_path.c_str());
+        return return_with_error(response, err, "Cannot write %s",
+                                 tmp_path.c_str());
+      }
+    }
+    if (std::rename(tmp_path.c_str(), request->path().c_str())) {
+      int err = errno;
+      std::remove(tmp_path.c_str());
+      return return_with_error(response, err, "Cannot rename %s to %s",
+                               tmp_path.c_str(), request->path().c_str());
+    }
+
+    response->set_bytes(snapshot.ByteSizeLong());
+    response->set_num_modules(snapshot.modules_size());
+    response->set_elapsed(get_epoch_time() - start);
+    LOG(INFO) << "Saved a snapshot of " << snapshot.modules_size()
+              << " modules to " << request->path();
+    return Status::OK;
+  }
+
+  Status RestoreSnapshot(ServerContext*, const SnapshotRequest* request,
+                         SnapshotResponse* response) override {
+    double start = get_epoch_time();
+    if (!request->path().length()) {
+      return return_with_error(response, EINVAL, "Missing 'path' field");
+    }
+
+    PipelineSnapshot snapshot;
+    {
+      std::ifstream file(request->path(), std::ios::binary);
+      if (!file) {
+        return return_with_error(response, errno, "Cannot open %s",
+                                 request->path().c_str());
+      }
+      if (!snapshot.ParseFromIstream(&file)) {
+        return return_with_error(response, EINVAL, "%s is not a snapshot",
+                                 request->path().c_str());
+      }
+    }
+
+    if (!ReplaySnapshot(snapshot, response)) {
+      return Status::OK;
+    }
+
+    response->set_bytes(snapshot.ByteSizeLong());
+    response->set_num_modules(snapshot.modules_size());
+    response->set_elapsed(get_epoch_time() - start);
+    LOG(INFO) << "Restored a snapshot of " << snapshot.modules_size()
+              << " modules from " << request->path() << " in "
+              << response->elapsed() << "s";
+    return Status::OK;
+  }
+
   Status ResetModules(ServerContext*, const EmptyRequest*,
                       EmptyResponse*) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
 
@@ -1189,7 +1611,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListModules(ServerContext*, const EmptyRequest*,
                      ListModulesResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     for (const auto& pair : ModuleGraph::GetAllModules()) {
       const Module* m = pair.second;
@@ -1197,6 +1619,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
       module->set_name(m->name());
       module->set_mclass(m->module_builder()->class_name());
+      std::lock_guard<std::mutex> module_lock(m->command_mutex());
       module->set_desc(m->GetDesc());
     }
     return Status::OK;
@@ -1204,7 +1627,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status CreateModule(ServerContext*, const CreateModuleRequest* request,
                       CreateModuleResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     VLOG(1) << "CreateModuleRequest from client:" << std::endl
             << request->DebugString();
@@ -1250,7 +1673,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status DestroyModule(ServerContext*, const DestroyModuleRequest* request,
                        EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
     const char* m_name;
@@ -1280,7 +1703,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GetModuleInfo(ServerContext*, const GetModuleInfoRequest* request,
                        GetModuleInfoResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     const char* m_name;
     Module* m;
@@ -1299,7 +1722,10 @@ class BESSControlImpl final : public BESSControl::Service {
 
     response->set_name(m->name());
     response->set_mclass(m->module_builder()->class_name());
-    response->set_desc(m->GetDesc());
+    {
+      std::lock_guard<std::mutex> module_lock(m->command_mutex());
+      response->set_desc(m->GetDesc());
+    }
 
     collect_igates(m, response);
     collect_ogates(m, response);
@@ -1311,7 +1737,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ConnectModules(ServerContext*, const ConnectModulesRequest* request,
                         EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     VLOG(1) << "ConnectModulesRequest from client:" << std::endl
             << request->DebugString();
@@ -1371,7 +1797,7 @@ class BESSControlImpl final : public BESSControl::Service {
   Status DisconnectModules(ServerContext*,
                            const DisconnectModulesRequest* request,
                            EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
     const char* m_name;
@@ -1402,7 +1828,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status DumpMempool(ServerContext*, const DumpMempoolRequest* request,
                      DumpMempoolResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     int socket_filter = request->socket();
     socket_filter =
@@ -1440,7 +1866,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListGateHookClass(ServerContext*, const EmptyRequest*,
                            ListGateHookClassResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     for (const auto& pair : bess::GateHookBuilder::all_gate_hook_builders()) {
       const auto& builder = pair.second;
@@ -1452,7 +1878,7 @@ class BESSControlImpl final : public BESSControl::Service {
   Status GetGateHookClassInfo(ServerContext*,
                               const GetGateHookClassInfoRequest* request,
                               GetGateHookClassInfoResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     VLOG(1) << "GetGateHookClassInfo from client:" << std::endl
             << request->DebugString();
@@ -1481,7 +1907,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListGateHooks(ServerContext*, const EmptyRequest*,
                        ListGateHooksResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     for (const auto& pair : ModuleGraph::GetAllModules()) {
       const Module* m = pair.second;
@@ -1518,7 +1944,7 @@ class BESSControlImpl final : public BESSControl::Service {
   Status ConfigureGateHook(ServerContext*,
                            const ConfigureGateHookRequest* request,
                            ConfigureGateHookResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
     bool use_gate = true;
@@ -1582,7 +2008,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GateHookCommand(ServerContext*, const GateHookCommandRequest* request,
                          CommandResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     // No need to look up the hook builder: the gate either
     // has a hook instance with the right name, or doesn't.
@@ -1620,7 +2046,7 @@ class BESSControlImpl final : public BESSControl::Service {
   Status ConfigureResumeHook(ServerContext*,
                              const ConfigureResumeHookRequest* request,
                              CommandResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     auto& hooks = bess::global_resume_hooks;
     auto hook_it = hooks.end();
@@ -1663,26 +2089,33 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status KillBess(ServerContext*, const EmptyRequest*,
                   EmptyResponse*) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
     LOG(WARNING) << "Halt requested by a client\n";
 
-    CHECK(shutdown_func_ != nullptr);
-    std::thread shutdown_helper([this]() {
-      // Deadlock occurs when closing a gRPC server while processing a RPC.
-      // Instead, we defer calling gRPC::Server::Shutdown() to a temporary
-      // thread.
-      shutdown_func_();
-    });
-    shutdown_helper.detach();
-
+    Shutdown();
     return Status::OK;
   }
 
+  // Rebuilds the pipeline from the snapshot file at "path", as
+  // RestoreSnapshot() does.
+  void RestoreAtStartup(const std::string& path) {
+    SnapshotRequest request;
+    SnapshotResponse response;
+
+    request.set_path(path);
+    RestoreSnapshot(nullptr, &request, &response);
+    if (response.error().code()) {
+      LOG(ERROR) << "Cannot restore the pipeline from " << path << ": "
+                 << response.error().errmsg()
+                 << "; starting with an empty pipeline";
+    }
+  }
+
   Status ImportPlugin(ServerContext*, const ImportPluginRequest* request,
                       EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
     VLOG(1) << "Loading plugin: " << request->path();
@@ -1695,7 +2128,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status UnloadPlugin(ServerContext*, const UnloadPluginRequest* request,
                       EmptyResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::lock_guard<ControlMutex> lock(mutex_);
 
     WorkerPauser wp;
 
@@ -1709,7 +2142,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListPlugins(ServerContext*, const EmptyRequest*,
                      ListPluginsResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     auto list = bess::bessd::ListPlugins();
     for (auto& path : list) {
@@ -1720,7 +2153,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ListMclass(ServerContext*, const EmptyRequest*,
                     ListMclassResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     for (const auto& pair : ModuleBuilder::all_module_builders()) {
       const ModuleBuilder& builder = pair.second;
@@ -1731,7 +2164,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status GetMclassInfo(ServerContext*, const GetMclassInfoRequest* request,
                        GetMclassInfoResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     VLOG(1) << "GetMclassInfo from client:" << std::endl
             << request->DebugString();
@@ -1759,7 +2192,7 @@ class BESSControlImpl final : public BESSControl::Service {
 
   Status ModuleCommand(ServerContext*, const CommandRequest* request,
                        CommandResponse* response) override {
-    std::lock_guard<std::recursive_mutex> lock(mutex_);
+    std::shared_lock<ControlMutex> lock(mutex_);
 
     if (!request->name().length()) {
       return return_with_error(response, EINVAL,
@@ -1780,6 +2213,282 @@ class BESSControlImpl final : public BESSControl::Service {
   }
 
  private:
+  // Makes the gRPC server, and then bessd, terminate once the current RPC
+  // returns.
+  void Shutdown() {
+    CHECK(shutdown_func_ != nullptr);
+    // Let SubscribeStats() streams end, or the server would wait for them.
+    shutting_down_ = true;
+    std::thread shutdown_helper([this]() {
+      // Deadlock occurs when closing a gRPC server while processing a RPC.
+      // Instead, we defer calling gRPC::Server::Shutdown() to a temporary
+      // thread.
+      shutdown_func_();
+    });
+    shutdown_helper.detach();
+  }
+
+  // Fills "snapshot" with the current pipeline; see PipelineSnapshot. Must be
+  // called with "mutex_" held. Returns false, with the error set in
+  // "response", if a module fails to report its configuration.
+  bool BuildSnapshot(PipelineSnapshot* snapshot, SnapshotResponse* response) {
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      if (!is_worker_active(wid)) {
+        continue;
+      }
+      AddWorkerRequest* worker = snapshot->add_workers();
+      worker->set_wid(wid);
+      worker->set_core(workers[wid]->core());
+      if (dynamic_cast<ExperimentalScheduler*>(workers[wid]->scheduler())) {
+        worker->set_scheduler("experimental");
+      }
+    }
+
+    for (const auto& pair : PortBuilder::all_ports()) {
+      const ::Port* p = pair.second;
+      CreatePortRequest* port = snapshot->add_ports();
+      port->set_name(p->name());
+      port->set_driver(p->port_builder()->class_name());
+      port->set_num_inc_q(p->num_rx_queues());
+      port->set_num_out_q(p->num_tx_queues());
+      port->set_size_inc_q(p->rx_queue_size());
+      port->set_size_out_q(p->tx_queue_size());
+      *port->mutable_arg() = p->driver_arg();
+    }
+
+    google::protobuf::Any empty_arg;
+    empty_arg.PackFrom(bess::pb::EmptyArg());
+
+    for (const auto& pair : ModuleGraph::GetAllModules()) {
+      Module* m = pair.second;
+
+      CommandResponse ret = m->RunCommand("get_initial_arg", empty_arg);
+      if (ret.error().code()) {
+        return_with_error(response, ret.error().code(), "%s: %s",
+                          m->name().c_str(), ret.error().errmsg().c_str());
+        return false;
+      }
+      CreateModuleRequest* module = snapshot->add_modules();
+      module->set_name(m->name());
+      module->set_mclass(m->module_builder()->class_name());
+      *module->mutable_arg() = ret.data();
+
+      for (const auto& g : m->ogates()) {
+        if (!g) {
+          continue;
+        }
+        ConnectModulesRequest* conn = snapshot->add_connections();
+        conn->set_m1(m->name());
+        conn->set_m2(g->igate()->module()->name());
+        conn->set_ogate(g->gate_idx());
+        conn->set_igate(g->igate()->gate_idx());
+        conn->set_skip_default_hooks(!g->FindHookByClass(Track::kName));
+      }
+
+      const auto& cmds = m->module_builder()->cmds();
+      auto has_cmd = [&cmds](const char* name) {
+        return std::find_if(cmds.begin(), cmds.end(), [name](const auto& c) {
+                 return c.first == name;
+               }) != cmds.end();
+      };
+      if (has_cmd("get_runtime_config") && has_cmd("set_runtime_config")) {
+        ret = m->RunCommand("get_runtime_config", empty_arg);
+        if (ret.error().code()) {
+          return_with_error(response, ret.error().code(), "%s: %s",
+                            m->name().c_str(), ret.error().errmsg().c_str());
+          return false;
+        }
+        CommandRequest* config = snapshot->add_runtime_configs();
+        config->set_name(m->name());
+        config->set_cmd("set_runtime_config");
+        *config->mutable_arg() = ret.data();
+      }
+    }
+
+    for (const auto& tc_pair : TrafficClassBuilder::all_tcs()) {
+      const bess::TrafficClass* c = tc_pair.second;
+      if (!c->parent()) {
+        snapshot_tc(c, c->WorkerId(), snapshot);
+      }
+    }
+
+    return true;
+  }
+
+  // Rebuilds the pipeline from "snapshot" into an empty BESS, then resumes
+  // workers. The control lock is held and workers stay paused throughout, so
+  // no other client sees a partial pipeline. Returns false, with the error set
+  // in "response", on the first step that fails; BESS is then rolled back to
+  // its previous (empty) state and the workers that were running resume.
+  bool ReplaySnapshot(const PipelineSnapshot& snapshot,
+                      SnapshotResponse* response) {
+    std::lock_guard<ControlMutex> lock(mutex_);
+
+    if (!PortBuilder::all_ports().empty() ||
+        !ModuleGraph::GetAllModules().empty() ||
+        !TrafficClassBuilder::all_tcs().empty()) {
+      return_with_error(response, EBUSY,
+                        "Ports, modules or TCs exist; reset BESS first");
+      return false;
+    }
+
+    std::vector<int> paused;
+    bool existed[Worker::kMaxWorkers];
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      existed[wid] = is_worker_active(wid);
+      if (is_worker_running(wid)) {
+        pause_worker(wid);
+        paused.push_back(wid);
+      }
+    }
+
+    // The snapshot is replayed through the same handlers a client would call,
+    // only without the RPC round trips. They take the (recursive) control
+    // lock again, and find no worker to pause.
+    EmptyRequest empty;
+    auto failed = [&](const std::string& what, const pb_error_t& error) {
+      return_with_error(response, error.code(), "%s: %s", what.c_str(),
+                        error.errmsg().c_str());
+
+      EmptyResponse resp;
+      ResetModules(nullptr, &empty, &resp);
+      ResetPorts(nullptr, &empty, &resp);
+      ResetTcs(nullptr, &empty, &resp);
+      for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+        if (!existed[wid] && is_worker_active(wid)) {
+          destroy_worker(wid);
+        }
+      }
+      for (int wid : paused) {
+        resume_worker(wid);
+      }
+      LOG(ERROR) << "Snapshot replay failed at " << what
+                 << "; rolled back to an empty pipeline";
+      return false;
+    };
+
+    for (const auto& req : snapshot.workers()) {
+      EmptyResponse resp;
+      AddWorker(nullptr, &req, &resp);
+      // Worker 0 may have been launched already, e.g., by a previous AddTc().
+      if (resp.error().code() && resp.error().code() != EEXIST) {
+        return failed("worker " + std::to_string(req.wid()), resp.error());
+      }
+    }
+
+    for (const auto& req : snapshot.ports()) {
+      CreatePortResponse resp;
+      CreatePort(nullptr, &req, &resp);
+      if (resp.error().code()) {
+        return failed(req.name(), resp.error());
+      }
+    }
+
+    for (const auto& req : snapshot.modules()) {
+      CreateModuleResponse resp;
+      CreateModule(nullptr, &req, &resp);
+      if (resp.error().code()) {
+        return failed(req.name(), resp.error());
+      }
+    }
+
+    for (const auto& req : snapshot.connections()) {
+      EmptyResponse resp;
+      ConnectModules(nullptr, &req, &resp);
+      if (resp.error().code()) {
+        return failed(req.m1(), resp.error());
+      }
+    }
+
+    for (const auto& class_ : snapshot.tcs()) {
+      EmptyResponse resp;
+      if (class_.policy() == bess::TrafficPolicyName[bess::POLICY_LEAF]) {
+        UpdateTcParentRequest req;
+        *req.mutable_class_() = class_;
+        UpdateTcParent(nullptr, &req, &resp);
+      } else {
+        AddTcRequest req;
+        *req.mutable_class_() = class_;
+        AddTc(nullptr, &req, &resp);
+      }
+      if (resp.error().code()) {
+        return failed(class_.name().length() ? class_.name()
+                                              : class_.leaf_module_name(),
+                      resp.error());
+      }
+    }
+
+    // Tables are loaded in bulk by set_runtime_config, which sizes them for
+    // all their entries up front where the module supports it.
+    for (const auto& req : snapshot.runtime_configs()) {
+      CommandResponse resp;
+      ModuleCommand(nullptr, &req, &resp);
+      if (resp.error().code()) {
+        return failed(req.name(), resp.error());
+      }
+    }
+
+    EmptyResponse resp;
+    ResumeAll(nullptr, &empty, &resp);
+    return true;
+  }
+
+  // Reads the counters selected by "request" into "snapshot". Workers keep
+  // running; all counters are per-worker or written by a single worker, so
+  // each value read is consistent on its own. Returns false, with the error
+  // set in "update", if a listed object does not exist.
+  bool CollectStats(const SubscribeStatsRequest& request,
+                    StatsSnapshot* snapshot, StatsUpdate* update) {
+    std::shared_lock<ControlMutex> lock(mutex_);
+    const std::string* missing;
+
+    missing = for_each_selected(
+        request.ports(), PortBuilder::all_ports(),
+        [&](const std::string& name, ::Port* p) {
+          ::Port::PortStats stats;
+          {
+            std::lock_guard<std::mutex> stats_lock(port_stats_mutex_);
+            stats = p->GetPortStats();
+          }
+          snapshot->ports[name] = {stats.inc.packets, stats.inc.dropped,
+                                   stats.inc.bytes,   stats.out.packets,
+                                   stats.out.dropped, stats.out.bytes};
+        });
+    if (missing) {
+      return_with_error(update, ENOENT, "No port '%s' found",
+                        missing->c_str());
+      return false;
+    }
+
+    missing = for_each_selected(request.modules(),
+                                ModuleGraph::GetAllModules(),
+                                [&](const std::string& name, Module* m) {
+                                  snapshot->modules[name] =
+                                      collect_module_counters(m);
+                                });
+    if (missing) {
+      return_with_error(update, ENOENT, "No module '%s' found",
+                        missing->c_str());
+      return false;
+    }
+
+    missing = for_each_selected(
+        request.tcs(), TrafficClassBuilder::all_tcs(),
+        [&](const std::string& name, bess::TrafficClass* c) {
+          const auto& usage = c->stats().usage;
+          snapshot->tcs[name] = {
+              usage[bess::RESOURCE_COUNT], usage[bess::RESOURCE_CYCLE],
+              usage[bess::RESOURCE_PACKET], usage[bess::RESOURCE_BIT]};
+        });
+    if (missing) {
+      return_with_error(update, ENOENT, "No TC '%s' found", missing->c_str());
+      return false;
+    }
+
+    snapshot->timestamp = get_epoch_time();
+    return true;
+  }
+
   Status AttachTc(bess::TrafficClass* c_, const bess::pb::TrafficClass& class_,
                   EmptyResponse* response) {
     std::unique_ptr<bess::TrafficClass> c(c_);
@@ -1918,9 +2627,17 @@ class BESSControlImpl final : public BESSControl::Service {
   // function to call to close this gRPC service.
   std::function<void()> shutdown_func_;
 
-  // gRPC service handlers are not thread-safe; we serialize them with a lock.
-  // A recursive mutex is required since handlers may call each other.
-  std::recursive_mutex mutex_;
+  // Serializes handlers that change the daemon against all others.
+  ControlMutex mutex_;
+
+  // Serializes GetPortStats(), which may run concurrently otherwise.
+  std::mutex port_stats_mutex_;
+
+  // Serializes DumpTrace(), since trace rings have a single consumer.
+  std::mutex trace_mutex_;
+
+  // Set once KillBess() has been called.
+  std::atomic<bool> shutting_down_ = {false};
 };
 
 void ApiServer::Listen(const std::string& addr) {
@@ -1941,7 +2658,13 @@ void ApiServer::Run() {
 
   BESSControlImpl service;
   builder_->RegisterService(&service);
-  builder_->SetSyncServerOption(grpc::ServerBuilder::MAX_POLLERS, 1);
+  builder_->SetSyncServerOption(grpc::ServerBuilder::MAX_POLLERS,
+                                FLAGS_grpc_threads);
+
+  // Before serving requests, so that clients find the pipeline complete.
+  if (!FLAGS_restore.empty()) {
+    service.RestoreAtStartup(FLAGS_restore);
+  }
 
   std::unique_ptr<grpc::Server> server = builder_->BuildAndStart();
   if (server == nullptr) {
@@ -1949,6 +2672,19 @@ void ApiServer::Run() {
     return;
   }
 
+  bess::MetricsServer metrics(
+      [&service]() { return service.RenderMetrics(); });
+  if (!FLAGS_metrics_url.empty()) {
+    int ret = metrics.Start(FLAGS_metrics_url);
+    if (ret < 0) {
+      LOG(ERROR) << "Cannot serve metrics on " << FLAGS_metrics_url << ": "
+                 << strerror(-ret);
+    } else {
+      LOG(INFO) << "Serving metrics on http://" << FLAGS_metrics_url
+                << "/metrics";
+    }
+  }
+
   service.set_shutdown_func([&server]() { server->Shutdown(); });
   server->Wait();
 }
@@ -0,0 +1,260 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcap_file.h"
+
+#include <sys/time.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+
+#include "../utils/copy.h"
+#include "../utils/pcap.h"
+#include "../utils/time.h"
+
+CommandResponse PCAPFilePort::Init(const bess::pb::PCAPFilePortArg &arg) {
+  if (num_queues[PACKET_DIR_INC] > 1 || num_queues[PACKET_DIR_OUT] > 1) {
+    return CommandFailure(EINVAL, "Cannot have more than 1 queue per RX/TX");
+  }
+
+  if (arg.rx_file().empty() && arg.tx_file().empty()) {
+    return CommandFailure(EINVAL, "At least one of 'rx_file' and 'tx_file' "
+                                  "must be specified");
+  }
+
+  if (arg.speed() < 0 || (arg.timestamp_pacing() && !(arg.speed() > 0))) {
+    return CommandFailure(EINVAL, "'speed' must be positive");
+  }
+
+  if (!arg.rx_file().empty()) {
+    int ret = reader_.Open(arg.rx_file());
+    if (ret < 0) {
+      return CommandFailure(-ret, "Failed to open '%s'",
+                            arg.rx_file().c_str());
+    }
+    if (reader_.size() == 0) {
+      reader_.Close();
+      return CommandFailure(EINVAL, "'%s' has no packets",
+                            arg.rx_file().c_str());
+    }
+  }
+
+  if (!arg.tx_file().empty()) {
+    size_t buffer_size = arg.tx_buffer_bytes()
+                             ?: bess::utils::PcapFileWriter::kDefaultBufferSize;
+    int ret = writer_.Open(arg.tx_file(), buffer_size);
+    if (ret < 0) {
+      reader_.Close();
+      return CommandFailure(-ret, "Failed to create '%s'",
+                            arg.tx_file().c_str());
+    }
+    writer_.StartPeriodicFlush(arg.tx_flush_interval_ms() ?: 1000);
+  }
+
+  loop_ = arg.loop();
+  pos_ = 0;
+  loop_offset_ns_ = 0;
+  if (reader_.size() > 1) {
+    // Leave an average inter-packet gap between the last record of one pass
+    // and the first record of the next.
+    loop_ns_ = reader_.duration_ns() +
+               reader_.duration_ns() / (reader_.size() - 1);
+  } else {
+    loop_ns_ = 0;
+  }
+
+  cycles_per_pkt_ = 0;
+  ns_per_cycle_ = 0;
+  if (arg.rate_pps()) {
+    cycles_per_pkt_ = static_cast<double>(tsc_hz) / arg.rate_pps();
+  } else if (arg.timestamp_pacing()) {
+    ns_per_cycle_ = 1e9 / tsc_hz * arg.speed();
+  }
+
+  start_tsc_ = 0;
+  sent_since_start_ = 0;
+
+  return CommandSuccess();
+}
+
+void PCAPFilePort::DeInit() {
+  reader_.Close();
+  writer_.Close();
+}
+
+int PCAPFilePort::NumDue(int cnt) {
+  size_t n_records = reader_.size();
+
+  if (!loop_) {
+    cnt = std::min<size_t>(cnt, n_records - pos_);
+    if (cnt == 0) {
+      return 0;
+    }
+  }
+
+  if (cycles_per_pkt_ == 0 && ns_per_cycle_ == 0) {
+    return cnt;
+  }
+
+  uint64_t now = rdtsc();
+  if (!start_tsc_) {
+    start_tsc_ = now;
+  }
+
+  if (cycles_per_pkt_ > 0) {
+    // The first packet is due immediately.
+    uint64_t target = (now - start_tsc_) / cycles_per_pkt_ + 1;
+    if (target <= sent_since_start_) {
+      return 0;
+    }
+    return std::min<uint64_t>(cnt, target - sent_since_start_);
+  }
+
+  uint64_t elapsed_ns = (now - start_tsc_) * ns_per_cycle_;
+  size_t i = pos_;
+  uint64_t offset_ns = loop_offset_ns_;
+  int n = 0;
+  while (n < cnt) {
+    if (i >= n_records) {
+      i = 0;
+      offset_ns += loop_ns_;
+    }
+    if (reader_.record(i).ts_ns + offset_ns > elapsed_ns) {
+      break;
+    }
+    i++;
+    n++;
+  }
+
+  return n;
+}
+
+bool PCAPFilePort::FillPacket(bess::Packet *pkt, const uint8_t *data,
+                              uint32_t len) {
+  uint32_t total_len = len;
+  uint32_t copy_len = std::min<uint32_t>(len, pkt->tailroom());
+  bess::utils::CopyInlined(pkt->append(copy_len), data, copy_len);
+  data += copy_len;
+  len -= copy_len;
+
+  bess::Packet *m = pkt;
+  int nb_segs = 1;
+  while (len > 0) {
+    bess::Packet *seg = current_worker.packet_pool()->Alloc();
+    if (!seg) {
+      return false;
+    }
+    m->set_next(seg);
+    m = seg;
+    nb_segs++;
+
+    copy_len = std::min<uint32_t>(len, m->tailroom());
+    bess::utils::Copy(m->append(copy_len), data, copy_len);
+    data += copy_len;
+    len -= copy_len;
+  }
+
+  pkt->set_nb_segs(nb_segs);
+  pkt->set_total_len(total_len);
+  return true;
+}
+
+int PCAPFilePort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  DCHECK_EQ(qid, 0);
+
+  if (!reader_.is_open()) {
+    return 0;
+  }
+
+  int n = NumDue(cnt);
+  if (n == 0) {
+    return 0;
+  }
+
+  if (!current_worker.packet_pool()->AllocBulk(pkts, n)) {
+    return 0;
+  }
+
+  int recv_cnt = 0;
+  for (int i = 0; i < n; i++) {
+    if (pos_ >= reader_.size()) {
+      pos_ = 0;
+      loop_offset_ns_ += loop_ns_;
+    }
+
+    const bess::utils::PcapFileReader::Record &rec = reader_.record(pos_++);
+    if (likely(FillPacket(pkts[i], rec.data, rec.caplen))) {
+      pkts[recv_cnt++] = pkts[i];
+    } else {
+      bess::Packet::Free(pkts[i]);
+    }
+  }
+
+  sent_since_start_ += n;
+  return recv_cnt;
+}
+
+int PCAPFilePort::SendPackets(queue_t, bess::Packet **pkts, int cnt) {
+  if (writer_.is_open()) {
+    // The periodic flush only takes the lock to swap buffers, never across
+    // write(). Records that find both buffers full are dropped.
+    std::lock_guard<std::mutex> lock(writer_.mutex());
+
+    // One timestamp per batch is precise enough, and much cheaper.
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *pkt = pkts[i];
+      uint32_t caplen = std::min<uint32_t>(pkt->total_len(), PCAP_SNAPLEN);
+
+      uint8_t *dst =
+          writer_.AppendRecord(caplen, pkt->total_len(), tv.tv_sec, tv.tv_usec);
+      if (!dst) {
+        port_stats_.out.dropped++;
+        continue;
+      }
+
+      for (bess::Packet *seg = pkt; seg && caplen > 0; seg = seg->next()) {
+        uint32_t len = std::min<uint32_t>(caplen, seg->head_len());
+        bess::utils::CopyInlined(dst, seg->head_data(), len);
+        dst += len;
+        caplen -= len;
+      }
+    }
+  }
+
+  bess::Packet::Free(pkts, cnt);
+  return cnt;
+}
+
+ADD_DRIVER(PCAPFilePort, "pcap_file_port",
+           "replays/captures packets from/to a pcap file at high rate")
@@ -0,0 +1,104 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_DRIVERS_PCAP_FILE_H_
+#define BESS_DRIVERS_PCAP_FILE_H_
+
+#include "../port.h"
+
+#include "../utils/pcap_file.h"
+
+/*!
+ * Port that replays packets from a capture file and/or writes transmitted
+ * packets to one. Unlike PCAPPort, it never goes through libpcap: the RX file
+ * is mapped into memory and indexed up front, so each RecvPackets() call only
+ * copies records into a bulk-allocated batch, and TX records are buffered and
+ * written out in large chunks.
+ *
+ * Useful to feed realistic traffic (e.g., GTP-U captures) into a pipeline for
+ * benchmarking without a hardware traffic generator.
+ */
+class PCAPFilePort final : public Port {
+ public:
+  PCAPFilePort()
+      : Port(),
+        reader_(),
+        writer_(),
+        loop_(),
+        pos_(),
+        loop_ns_(),
+        loop_offset_ns_(),
+        cycles_per_pkt_(),
+        ns_per_cycle_(),
+        start_tsc_(),
+        sent_since_start_() {}
+
+  /*!
+   * Initialize the port, ie, map rx_file and create tx_file.
+   * See PCAPFilePortArg for parameters.
+   */
+  CommandResponse Init(const bess::pb::PCAPFilePortArg &arg);
+
+  void DeInit() override;
+
+  // Multi-queue is not supported. qid must be 0.
+  int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+  int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+
+ private:
+  // Returns how many records (up to cnt) are due for replay now.
+  int NumDue(int cnt);
+
+  // Copies a record into pkt, chaining more segments if needed.
+  // Returns false if segments could not be allocated.
+  bool FillPacket(bess::Packet *pkt, const uint8_t *data, uint32_t len);
+
+  bess::utils::PcapFileReader reader_;
+  bess::utils::PcapFileWriter writer_;
+
+  bool loop_;
+
+  // Index of the next record to replay.
+  size_t pos_;
+
+  // Virtual duration of one pass over the file, and the accumulated offset of
+  // the current pass, used to keep timestamp pacing continuous across loops.
+  uint64_t loop_ns_;
+  uint64_t loop_offset_ns_;
+
+  // Pacing parameters. At most one of them is non-zero.
+  double cycles_per_pkt_;  // constant-rate pacing
+  double ns_per_cycle_;    // timestamp pacing (scaled by speed)
+
+  uint64_t start_tsc_;          // 0 until the first RecvPackets() call
+  uint64_t sent_since_start_;   // for constant-rate pacing
+};
+
+#endif  // BESS_DRIVERS_PCAP_FILE_H_
@@ -54,6 +54,18 @@ static const rte_eth_conf default_eth_conf(const rte_eth_dev_info &dev_info,
   return ret;
 }
 
+// An RSS key of repeated 0x6d5a makes the Toeplitz hash symmetric: swapping
+// source and destination (addresses and ports) yields the same hash.
+// (Woo and Park, "Scalable TCP Session Monitoring with Symmetric Receive-side
+// Scaling", 2012)
+static uint8_t symmetric_rss_key[] = {
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+    0x6d, 0x5a, 0x6d, 0x5a,
+};
+
 void PMDPort::InitDriver() {
   dpdk_port_t num_dpdk_ports = rte_eth_dev_count_avail();
 
@@ -205,6 +217,7 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
   rte_eth_dev_info dev_info;
   rte_eth_conf eth_conf;
   rte_eth_rxconf eth_rxconf;
+  rte_eth_txconf eth_txconf;
 
   int num_txq = num_queues[PACKET_DIR_OUT];
   int num_rxq = num_queues[PACKET_DIR_INC];
@@ -246,11 +259,59 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
     eth_conf.lpbk_mode = 1;
   }
 
+  if (arg.symmetric_rss()) {
+    uint8_t key_len = dev_info.hash_key_size ?: 40;
+    if (key_len > sizeof(symmetric_rss_key)) {
+      return CommandFailure(ENOTSUP, "RSS key size %u is not supported",
+                            key_len);
+    }
+    eth_conf.rx_adv_conf.rss_conf.rss_key = symmetric_rss_key;
+    eth_conf.rx_adv_conf.rss_conf.rss_key_len = key_len;
+  }
+
+  if (arg.rx_scatter()) {
+    if (!(dev_info.rx_offload_capa & DEV_RX_OFFLOAD_SCATTER)) {
+      return CommandFailure(ENOTSUP, "Device does not support RX scatter");
+    }
+    eth_conf.rxmode.offloads |= DEV_RX_OFFLOAD_SCATTER;
+    if (dev_info.tx_offload_capa & DEV_TX_OFFLOAD_MULTI_SEGS) {
+      eth_conf.txmode.offloads |= DEV_TX_OFFLOAD_MULTI_SEGS;
+    }
+  }
+
+  uint32_t mtu = arg.mtu() ?: conf_.mtu;
+  if (arg.mtu() && (mtu < RTE_ETHER_MIN_MTU || mtu > dev_info.max_mtu)) {
+    return CommandFailure(EINVAL, "mtu should be >= %d and <= %d",
+                          RTE_ETHER_MIN_MTU, dev_info.max_mtu);
+  }
+  if (mtu > SNBUF_DATA && !arg.rx_scatter()) {
+    return CommandFailure(EINVAL, "mtu larger than %d requires rx_scatter",
+                          SNBUF_DATA);
+  }
+
+  uint32_t max_frame_len = mtu + RTE_ETHER_HDR_LEN + RTE_ETHER_CRC_LEN;
+  if (max_frame_len > RTE_ETHER_MAX_LEN) {
+    if (!(dev_info.rx_offload_capa & DEV_RX_OFFLOAD_JUMBO_FRAME)) {
+      return CommandFailure(ENOTSUP, "Device does not support jumbo frames");
+    }
+    eth_conf.rxmode.offloads |= DEV_RX_OFFLOAD_JUMBO_FRAME;
+    eth_conf.rxmode.max_rx_pkt_len = max_frame_len;
+  }
+
   ret = rte_eth_dev_configure(ret_port_id, num_rxq, num_txq, &eth_conf);
   if (ret != 0) {
     return CommandFailure(-ret, "rte_eth_dev_configure() failed");
   }
 
+  if (arg.mtu()) {
+    ret = rte_eth_dev_set_mtu(ret_port_id, mtu);
+    if (ret != 0) {
+      return CommandFailure(-ret, "rte_eth_dev_set_mtu() failed");
+    }
+  }
+  conf_.mtu = mtu;
+  rx_scatter_ = arg.rx_scatter();
+
   int sid = rte_eth_dev_socket_id(ret_port_id);
   if (sid < 0 || sid > RTE_MAX_NUMA_NODES) {
     sid = 0;  // if socket_id is invalid, set to 0
@@ -258,6 +319,7 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
 
   eth_rxconf = dev_info.default_rxconf;
   eth_rxconf.rx_drop_en = 1;
+  eth_rxconf.offloads = eth_conf.rxmode.offloads;
 
   if (dev_info.rx_desc_lim.nb_min > 0 &&
       queue_size[PACKET_DIR_INC] < dev_info.rx_desc_lim.nb_min) {
@@ -300,9 +362,12 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
                  << queue_size[PACKET_DIR_OUT];
   }
 
+  eth_txconf = dev_info.default_txconf;
+  eth_txconf.offloads = eth_conf.txmode.offloads;
+
   for (int i = 0; i < num_txq; i++) {
     ret = rte_eth_tx_queue_setup(ret_port_id, i, queue_size[PACKET_DIR_OUT],
-                                 sid, nullptr);
+                                 sid, &eth_txconf);
     if (ret != 0) {
       return CommandFailure(-ret, "rte_eth_tx_queue_setup() failed");
     }
@@ -347,9 +412,11 @@ CommandResponse PMDPort::UpdateConf(const Conf &conf) {
   rte_eth_dev_stop(dpdk_port_id_);  // need to restart before return
 
   if (conf_.mtu != conf.mtu && conf.mtu != 0) {
-    if (conf.mtu > SNBUF_DATA || conf.mtu < RTE_ETHER_MIN_MTU) {
-      resp = CommandFailure(EINVAL, "mtu should be >= %d and <= %d",
-                            RTE_ETHER_MIN_MTU, SNBUF_DATA);
+    // Without RX scatter, a frame must fit in a single packet buffer.
+    uint32_t max_mtu = rx_scatter_ ? UINT16_MAX : SNBUF_DATA;
+    if (conf.mtu > max_mtu || conf.mtu < RTE_ETHER_MIN_MTU) {
+      resp = CommandFailure(EINVAL, "mtu should be >= %d and <= %u",
+                            RTE_ETHER_MIN_MTU, max_mtu);
       goto restart;
     }
 
@@ -53,6 +53,7 @@ class PMDPort final : public Port {
       : Port(),
         dpdk_port_id_(DPDK_PORT_UNKNOWN),
         hot_plugged_(false),
+        rx_scatter_(false),
         node_placement_(UNCONSTRAINED_SOCKET) {}
 
   void InitDriver() override;
@@ -67,6 +68,8 @@ class PMDPort final : public Port {
    * * string pci : The PCI address of the port to bind to.
    * * string vdev : If a virtual device, the virtual device address (e.g.
    * tun/tap)
+   * * bool rx_scatter : Receive/send frames as chained segments if needed.
+   * * uint32 mtu : MTU of the port, up to 9000-byte jumbo frames.
    *
    * EXPECTS:
    * * Must specify exactly one of port_id or PCI or vdev.
@@ -149,6 +152,11 @@ class PMDPort final : public Port {
    */
   bool hot_plugged_;
 
+  /*!
+   * True if frames may be received as multiple chained segments.
+   */
+  bool rx_scatter_;
+
   /*!
    * The NUMA node to which device is attached
    */
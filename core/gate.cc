@@ -186,6 +186,7 @@ CommandResponse GateHookBuilder::RunCommand(
     GateHook *hook, const std::string &user_cmd,
     const google::protobuf::Any &arg) const {
   Module *mod = hook->gate()->module();
+  std::lock_guard<std::mutex> lock(mod->command_mutex());
   for (auto &cmd : cmds_) {
     if (user_cmd == cmd.cmd) {
       if (cmd.mt_safe != GateHookCommand::THREAD_SAFE &&
@@ -34,16 +34,19 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <functional>
 #include <limits>
 
 #include <glog/logging.h>
 
 #include "../message.h"
 #include "../utils/common.h"
+#include "../utils/copy.h"
 #include "../utils/pcapng.h"
 #include "../utils/time.h"
 
 using namespace bess::utils::pcapng;
+using bess::utils::CaptureRing;
 
 namespace {
 
@@ -86,10 +89,16 @@ void BytesToHexDump(const void *src, size_t len, char *dst) {
 
 const std::string Pcapng::kName = "PcapNg";
 
+const GateHookCommands Pcapng::cmds = {
+    {"get_stats", "EmptyArg", GATE_HOOK_CMD_FUNC(&Pcapng::CommandGetStats),
+     GateHookCommand::THREAD_SAFE}};
+
 Pcapng::Pcapng()
     : bess::GateHook(Pcapng::kName, "pcapng", Pcapng::kPriority),
       opener_(),
+      writer_(&opener_, Worker::kMaxWorkers),
       attrs_(),
+      attrs_size_(),
       attr_template_() {}
 
 // Send the initialization data on the FIFO, once it's open.
@@ -110,7 +119,7 @@ bool PcapngOpener::InitFifo(int fd) {
       .tot_len = sizeof(idb) + sizeof(uint32_t),
       .link_type = InterfaceDescriptionBlock::kEthernet,
       .reserved = 0,
-      .snap_len = 1518,
+      .snap_len = snaplen_ ? snaplen_ : 1518,
   };
 
   uint32_t idb_tot_len = idb.tot_len;
@@ -145,7 +154,9 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
 
     attrs_.emplace_back(Attr{.md_offset = m->attr_offset(i),
                              .size = it.size,
+                             .meta_offset = attrs_size_,
                              .tmpl_offset = tmpl_offset});
+    attrs_size_ += it.size;
     i++;
   }
 
@@ -159,7 +170,16 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
 
   attr_template_ = std::vector<char>(tmpl.begin(), tmpl.end());
 
-  int ret = opener_.Init(arg.fifo(), arg.reconnect());
+  using namespace std::placeholders;
+  int ret = writer_.Init(arg.buffer_size(), arg.snaplen(), arg.sample(),
+                         std::bind(&Pcapng::FormatRecord, this, _1, _2, _3));
+  if (ret < 0) {
+    return CommandFailure(-ret, "invalid buffer_size %" PRIu64,
+                          arg.buffer_size());
+  }
+
+  opener_.set_snaplen(arg.snaplen());
+  ret = opener_.Init(arg.fifo(), arg.reconnect());
   if (ret < 0) {
     return CommandFailure(-errno, "inappropriate reinitialization");
   }
@@ -168,6 +188,18 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
     return CommandFailure(-errno, "Failed to open FIFO");
   }
 
+  // Hooks are attached with workers paused, so the rings of the existing
+  // workers are set up here, off the datapath.
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (is_worker_active(wid)) {
+      writer_.AddProducer(wid);
+    }
+  }
+
+  if (!writer_.Start()) {
+    return CommandFailure(errno, "Failed to start the writer thread");
+  }
+
   return CommandSuccess();
 }
 
@@ -179,74 +211,95 @@ void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
     return;
   }
 
-  struct timeval tv;
-
-  gettimeofday(&tv, nullptr);
-
-  uint64_t ts = tv.tv_sec * 1000000 + tv.tv_usec;
-  uint16_t comment_size = static_cast<uint16_t>(attr_template_.size());
+  int wid = current_worker.wid();
+  uint64_t tsc = rdtsc();
 
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *pkt = batch->pkts()[i];
+    CaptureRing::Record *rec = writer_.Reserve(
+        wid, attrs_size_, pkt->head_len(), pkt->total_len(), tsc);
+    if (!rec) {
+      continue;
+    }
 
-    Option opt_comment = {
-        .code = Option::kComment,
-        .len = comment_size,
-    };
-
+    // Values of attributes without a valid offset are left out; the writer
+    // knows to skip them too.
     for (const Attr &attr : attrs_) {
       const char *attr_data = ptr_attr_with_offset<char>(attr.md_offset, pkt);
       if (attr_data != nullptr) {
-        BytesToHexDump(attr_data, attr.size, &attr_template_[attr.tmpl_offset]);
-      } else {
-        auto string_it = attr_template_.begin() + attr.tmpl_offset;
-        std::fill(string_it, string_it + attr.size * 2, 'X');
+        bess::utils::Copy(rec->meta() + attr.meta_offset, attr_data,
+                          attr.size);
       }
     }
+    bess::utils::Copy(rec->data(), pkt->head_data(), rec->caplen);
+  }
 
-    Option opt_end = {
-        .code = Option::kEndOfOpts,
-        .len = 0,
-    };
-
-    EnhancedPacketBlock epb = {
-        .type = EnhancedPacketBlock::kType,
-        .tot_len = static_cast<uint32_t>(
-            sizeof(epb) + sizeof(uint32_t) +
-            RoundUp<uint32_t>(pkt->head_len(), 4) + sizeof(opt_comment) +
-            RoundUp<uint32_t>(comment_size, 4) + sizeof(opt_end)),
-        .interface_id = 0,
-        .timestamp_high = static_cast<uint32_t>(ts >> 32),
-        .timestamp_low = static_cast<uint32_t>(ts),
-        .captured_len = static_cast<uint32_t>(pkt->head_len()),
-        .orig_len = static_cast<uint32_t>(pkt->total_len()),
-    };
-
-    uint32_t padding = 0;
-
-    uint32_t epb_tot_len = epb.tot_len;
-
-    struct iovec vec[8] = {
-        {&epb, sizeof(epb)},
-        {pkt->head_data(), static_cast<size_t>(pkt->head_len())},
-        {&padding, static_cast<size_t>(PadSize(pkt->head_len(), 4))},
-
-        {&opt_comment, sizeof(opt_comment)},
-        {attr_template_.data(), comment_size},
-        {&padding, static_cast<size_t>(PadSize<uint32_t>(comment_size, 4))},
-        {&opt_end, sizeof(opt_end)},
-
-        {&epb_tot_len, sizeof(epb_tot_len)}};
-
-    int ret = writev(fd, vec, 8);
-    if (ret < 0) {
-      if (errno == EPIPE) {
-        DLOG(WARNING) << "Broken pipe: stopping pcapng";
-        opener_.MarkDead(fd, gen);
-      }
-      return;
+  writer_.Commit(wid);
+}
+
+void Pcapng::FormatRecord(const CaptureRing::Record &rec, uint64_t ts_ns,
+                          std::string *out) {
+  uint64_t ts = ts_ns / 1000;
+  uint16_t comment_size = static_cast<uint16_t>(attr_template_.size());
+
+  Option opt_comment = {
+      .code = Option::kComment,
+      .len = comment_size,
+  };
+
+  for (const Attr &attr : attrs_) {
+    if (bess::metadata::IsValidOffset(attr.md_offset)) {
+      BytesToHexDump(rec.meta() + attr.meta_offset, attr.size,
+                     &attr_template_[attr.tmpl_offset]);
+    } else {
+      auto string_it = attr_template_.begin() + attr.tmpl_offset;
+      std::fill(string_it, string_it + attr.size * 2, 'X');
     }
   }
+
+  Option opt_end = {
+      .code = Option::kEndOfOpts,
+      .len = 0,
+  };
+
+  EnhancedPacketBlock epb = {
+      .type = EnhancedPacketBlock::kType,
+      .tot_len = static_cast<uint32_t>(
+          sizeof(epb) + sizeof(uint32_t) + RoundUp<uint32_t>(rec.caplen, 4) +
+          sizeof(opt_comment) + RoundUp<uint32_t>(comment_size, 4) +
+          sizeof(opt_end)),
+      .interface_id = 0,
+      .timestamp_high = static_cast<uint32_t>(ts >> 32),
+      .timestamp_low = static_cast<uint32_t>(ts),
+      .captured_len = rec.caplen,
+      .orig_len = rec.orig_len,
+  };
+
+  static const char padding[4] = {};
+
+  out->append(reinterpret_cast<const char *>(&epb), sizeof(epb));
+  out->append(rec.data(), rec.caplen);
+  out->append(padding, PadSize<uint32_t>(rec.caplen, 4));
+
+  out->append(reinterpret_cast<const char *>(&opt_comment),
+              sizeof(opt_comment));
+  out->append(attr_template_.data(), comment_size);
+  out->append(padding, PadSize<uint32_t>(comment_size, 4));
+  out->append(reinterpret_cast<const char *>(&opt_end), sizeof(opt_end));
+
+  out->append(reinterpret_cast<const char *>(&epb.tot_len),
+              sizeof(epb.tot_len));
+}
+
+CommandResponse Pcapng::CommandGetStats(const bess::pb::EmptyArg &) {
+  bess::utils::CaptureWriter::Stats stats = writer_.GetStats();
+  bess::pb::CaptureCommandGetStatsResponse r;
+  r.set_seen(stats.seen);
+  r.set_captured(stats.captured);
+  r.set_dropped(stats.dropped);
+  r.set_discarded(stats.discarded);
+  r.set_written_bytes(stats.written_bytes);
+  return CommandSuccess(r);
 }
 
 ADD_GATE_HOOK(Pcapng, "pcapng", "metadata-dump-able packet dump")
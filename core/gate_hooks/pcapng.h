@@ -34,26 +34,38 @@
 #include "../message.h"
 #include "../module.h"
 
+#include "../utils/capture_writer.h"
 #include "../utils/fifo_opener.h"
 
 class PcapngOpener final : public bess::utils::FifoOpener {
  public:
-  PcapngOpener() : FifoOpener() {}
+  PcapngOpener() : FifoOpener(), snaplen_() {}
   bool InitFifo(int fd) override;
+
+  void set_snaplen(uint32_t snaplen) { snaplen_ = snaplen; }
+
+ private:
+  uint32_t snaplen_;
 };
 
 // Pcapng dumps copies of the packets seen by a gate (data + metadata) in
-// pcapng format.  Useful for debugging.
+// pcapng format.  Useful for debugging.  Workers only copy packets and raw
+// metadata into per-worker rings; a background thread formats them and writes
+// them to the FIFO.
 class Pcapng final : public bess::GateHook {
  public:
   Pcapng();
 
   virtual ~Pcapng(){};
 
+  static const GateHookCommands cmds;
+
   CommandResponse Init(const bess::Gate *, const bess::pb::PcapngArg &);
 
   void ProcessBatch(const bess::PacketBatch *batch);
 
+  CommandResponse CommandGetStats(const bess::pb::EmptyArg &);
+
   static constexpr uint16_t kPriority = 2;
   static const std::string kName;
 
@@ -63,6 +75,8 @@ class Pcapng final : public bess::GateHook {
     int md_offset;
     // Size in bytes of the attribute.
     size_t size;
+    // Offset of the attribute value in a captured record's metadata.
+    size_t meta_offset;
     // Offset where this attribute hex dump should go inside `attr_template_`.
     size_t tmpl_offset;
   };
@@ -70,12 +84,21 @@ class Pcapng final : public bess::GateHook {
   // The opener instance for the FIFO for the captured packets.
   PcapngOpener opener_;
 
+  // The background writer, which uses opener_.
+  bess::utils::CaptureWriter writer_;
+
   // List of attributes to dump.
   std::vector<Attr> attrs_;
+  // Total size of the attributes, copied with each packet.
+  size_t attrs_size_;
   // Preallocated string with attribute names and values.  For each packet,
-  // we will change in place the values and send the string out, without
-  // doing any memory allocation.
+  // the writer thread changes in place the values and sends the string out,
+  // without doing any memory allocation.
   std::vector<char> attr_template_;
+
+  // Runs on the writer thread.
+  void FormatRecord(const bess::utils::CaptureRing::Record &rec,
+                    uint64_t ts_ns, std::string *out);
 };
 
 #endif  // BESS_GATE_HOOKS_PCAPNG_
@@ -31,34 +31,66 @@
 #include "tcpdump.h"
 
 #include <fcntl.h>
-#include <sys/uio.h>
 #include <unistd.h>
 
 #include <glog/logging.h>
 
 #include "../message.h"
 #include "../utils/common.h"
+#include "../utils/copy.h"
 #include "../utils/pcap.h"
 #include "../utils/time.h"
 
+using bess::utils::CaptureRing;
+
 const std::string Tcpdump::kName = "TcpDump";
 
+const GateHookCommands Tcpdump::cmds = {
+    {"get_stats", "EmptyArg", GATE_HOOK_CMD_FUNC(&Tcpdump::CommandGetStats),
+     GateHookCommand::THREAD_SAFE}};
+
+Tcpdump::Tcpdump()
+    : bess::GateHook(Tcpdump::kName, "tcpdump", Tcpdump::kPriority),
+      opener_(),
+      writer_(&opener_, Worker::kMaxWorkers) {}
+
 bool TcpdumpOpener::InitFifo(int fd) {
-  static const struct pcap_hdr hdr = {
+  const struct pcap_hdr hdr = {
       .magic_number = PCAP_MAGIC_NUMBER,
       .version_major = PCAP_VERSION_MAJOR,
       .version_minor = PCAP_VERSION_MINOR,
       .thiszone = PCAP_THISZONE,
       .sigfigs = PCAP_SIGFIGS,
-      .snaplen = PCAP_SNAPLEN,
+      .snaplen = snaplen_ ? snaplen_ : PCAP_SNAPLEN,
       .network = PCAP_NETWORK,
   };
   return write(fd, &hdr, sizeof(hdr)) == sizeof(hdr);
 }
 
+// Runs on the writer thread.
+static void FormatPcapRecord(const CaptureRing::Record &rec, uint64_t ts_ns,
+                             std::string *out) {
+  struct pcap_rec_hdr hdr = {
+      .ts_sec = static_cast<uint32_t>(ts_ns / 1000000000),
+      .ts_usec = static_cast<uint32_t>(ts_ns % 1000000000 / 1000),
+      .incl_len = rec.caplen,
+      .orig_len = rec.orig_len,
+  };
+  out->append(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+  out->append(rec.data(), rec.caplen);
+}
+
 CommandResponse Tcpdump::Init(const bess::Gate *,
                               const bess::pb::TcpdumpArg &arg) {
-  int ret = opener_.Init(arg.fifo(), arg.reconnect());
+  int ret = writer_.Init(arg.buffer_size(), arg.snaplen(), arg.sample(),
+                         FormatPcapRecord);
+  if (ret < 0) {
+    return CommandFailure(-ret, "invalid buffer_size %" PRIu64,
+                          arg.buffer_size());
+  }
+
+  opener_.set_snaplen(arg.snaplen());
+  ret = opener_.Init(arg.fifo(), arg.reconnect());
   if (ret < 0) {
     return CommandFailure(-errno, "inappropriate reinitialization");
   }
@@ -67,6 +99,18 @@ CommandResponse Tcpdump::Init(const bess::Gate *,
     return CommandFailure(-errno, "Failed to open FIFO");
   }
 
+  // Hooks are attached with workers paused, so the rings of the existing
+  // workers are set up here, off the datapath.
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (is_worker_active(wid)) {
+      writer_.AddProducer(wid);
+    }
+  }
+
+  if (!writer_.Start()) {
+    return CommandFailure(errno, "Failed to start the writer thread");
+  }
+
   return CommandSuccess();
 }
 
@@ -78,30 +122,30 @@ void Tcpdump::ProcessBatch(const bess::PacketBatch *batch) {
     return;
   }
 
-  struct timeval tv;
-  gettimeofday(&tv, nullptr);
+  int wid = current_worker.wid();
+  uint64_t tsc = rdtsc();
 
   for (int i = 0; i < batch->cnt(); i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    struct pcap_rec_hdr rec = {
-        .ts_sec = (uint32_t)tv.tv_sec,
-        .ts_usec = (uint32_t)tv.tv_usec,
-        .incl_len = (uint32_t)pkt->head_len(),
-        .orig_len = (uint32_t)pkt->total_len(),
-    };
-
-    struct iovec vec[2] = {{&rec, sizeof(rec)},
-                           {pkt->head_data(), (size_t)pkt->head_len()}};
-
-    int ret = writev(fd, vec, 2);
-    if (ret < 0) {
-      if (errno == EPIPE) {
-        DLOG(WARNING) << "Broken pipe: stopping tcpdump";
-        opener_.MarkDead(fd, gen);
-      }
-      return;
+    CaptureRing::Record *rec = writer_.Reserve(
+        wid, 0, pkt->head_len(), pkt->total_len(), tsc);
+    if (rec) {
+      bess::utils::Copy(rec->data(), pkt->head_data(), rec->caplen);
     }
   }
+
+  writer_.Commit(wid);
+}
+
+CommandResponse Tcpdump::CommandGetStats(const bess::pb::EmptyArg &) {
+  bess::utils::CaptureWriter::Stats stats = writer_.GetStats();
+  bess::pb::CaptureCommandGetStatsResponse r;
+  r.set_seen(stats.seen);
+  r.set_captured(stats.captured);
+  r.set_dropped(stats.dropped);
+  r.set_discarded(stats.discarded);
+  r.set_written_bytes(stats.written_bytes);
+  return CommandSuccess(r);
 }
 
 ADD_GATE_HOOK(Tcpdump, "tcpdump", "dump traffic on a network")
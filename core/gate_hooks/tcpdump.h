@@ -34,32 +34,43 @@
 #include "../message.h"
 #include "../module.h"
 
+#include "../utils/capture_writer.h"
 #include "../utils/fifo_opener.h"
 
 class TcpdumpOpener final : public bess::utils::FifoOpener {
  public:
-  TcpdumpOpener() : FifoOpener() {}
+  TcpdumpOpener() : FifoOpener(), snaplen_() {}
   bool InitFifo(int fd) override;
+
+  void set_snaplen(uint32_t snaplen) { snaplen_ = snaplen; }
+
+ private:
+  uint32_t snaplen_;
 };
 
 // Tcpdump dumps copies of the packets seen by a gate. Useful for debugging.
+// Workers only copy packets into per-worker rings; a background thread writes
+// them to the FIFO.
 class Tcpdump final : public bess::GateHook {
  public:
-  Tcpdump()
-      : bess::GateHook(Tcpdump::kName, "tcpdump", Tcpdump::kPriority),
-        opener_() {}
+  Tcpdump();
 
   virtual ~Tcpdump() {}
 
+  static const GateHookCommands cmds;
+
   CommandResponse Init(const bess::Gate *, const bess::pb::TcpdumpArg &);
 
   void ProcessBatch(const bess::PacketBatch *batch);
 
+  CommandResponse CommandGetStats(const bess::pb::EmptyArg &);
+
   static constexpr uint16_t kPriority = 1;
   static const std::string kName;
 
  private:
   TcpdumpOpener opener_;
+  bess::utils::CaptureWriter writer_;  // uses opener_, so declared after it
 };
 
 #endif  // BESS_GATE_HOOKS_TCPDUMP_
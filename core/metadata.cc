@@ -64,13 +64,8 @@ static mt_offset_t ComputeNextOffset(mt_offset_t curr_offset, int8_t size) {
 }
 
 // Generate warnings for modules that read metadata that never gets set.
-static void CheckOrphanReaders() {
-  for (const auto &it : ModuleGraph::GetAllModules()) {
-    const Module *m = it.second;
-    if (!m) {
-      break;
-    }
-
+static void CheckOrphanReaders(const std::vector<Module *> &modules) {
+  for (const Module *m : modules) {
     size_t i = 0;
     for (const auto &attr : m->all_attrs()) {
       if (m->attr_offset(i) == kMetadataOffsetNoRead) {
@@ -83,6 +78,25 @@ static void CheckOrphanReaders() {
   }
 }
 
+// Report modules whose attributes ended up in more than one cache line, as
+// they touch several lines of every packet they process.
+static void CheckCacheLineSpread(const std::vector<Module *> &modules) {
+  for (const Module *m : modules) {
+    std::set<int> lines;
+    for (size_t i = 0; i < m->all_attrs().size(); i++) {
+      int line = CacheLineOf(m->attr_offset(i));
+      if (line >= 0) {
+        lines.insert(line);
+      }
+    }
+
+    if (lines.size() > 1) {
+      VLOG(1) << "Metadata attrs of module " << m->name() << " span "
+              << lines.size() << " cache lines";
+    }
+  }
+}
+
 static inline attr_id_t get_attr_id(const struct Attribute *attr) {
   return attr->name;
 }
@@ -105,7 +119,14 @@ class ScopeComponentComp {
   bool reverse_;
 };
 
-static bool DegreeComp(const ScopeComponent &a, const ScopeComponent &b) {
+// Components are placed in this order, each at the lowest offset that does not
+// collide with an already placed component. Putting the most frequently
+// accessed attributes first packs them into the first metadata cache line;
+// ties fall back to the degree to keep the packing tight.
+static bool PackingComp(const ScopeComponent &a, const ScopeComponent &b) {
+  if (a.accesses() != b.accesses()) {
+    return a.accesses() > b.accesses();
+  }
   return a.degree() > b.degree();
 }
 
@@ -122,13 +143,59 @@ bool ScopeComponent::DisjointFrom(const ScopeComponent &rhs) {
 
 // Pipeline ----------------------------------------------------------------
 
-int Pipeline::PrepareMetadataComputation() {
-  for (const auto &it : ModuleGraph::GetAllModules()) {
-    Module *m = it.second;
-    if (!m) {
-      break;
+std::vector<Module *> Pipeline::CollectDirtyComponents() {
+  std::set<const Module *> visited;
+  std::vector<Module *> modules;
+  std::vector<Module *> stack;
+
+  // Scope components only extend along gates, so modules outside the weakly
+  // connected components of the dirty modules can keep their offsets.
+  for (const Module *dirty : dirty_modules_) {
+    if (!visited.insert(dirty).second) {
+      continue;
+    }
+    stack.push_back(const_cast<Module *>(dirty));
+
+    while (!stack.empty()) {
+      Module *m = stack.back();
+      stack.pop_back();
+      modules.push_back(m);
+
+      for (const IGate *g : m->igates()) {
+        if (g == nullptr) {
+          continue;
+        }
+        for (const auto &og : g->ogates_upstream()) {
+          if (visited.insert(og->module()).second) {
+            stack.push_back(og->module());
+          }
+        }
+      }
+
+      for (const auto &og : m->ogates()) {
+        if (og == nullptr) {
+          continue;
+        }
+        Module *next = og->igate()->module();
+        if (visited.insert(next).second) {
+          stack.push_back(next);
+        }
+      }
     }
+  }
+
+  dirty_modules_.clear();
 
+  // Keep the traversal order identical to a full pass over the module graph.
+  std::sort(modules.begin(), modules.end(),
+            [](const Module *a, const Module *b) {
+              return a->name() < b->name();
+            });
+  return modules;
+}
+
+int Pipeline::PrepareMetadataComputation(const std::vector<Module *> &modules) {
+  for (Module *m : modules) {
     if (!module_components_.count(m)) {
       module_components_.emplace(m, new scope_id_t[kMetadataTotalSize]);
     }
@@ -372,6 +439,8 @@ void Pipeline::AssignOffsets() {
       }
     }
 
+    // h yields the colliding candidates by increasing offset, so sweep past
+    // each one that overlaps [offset, offset + size) until a gap is found.
     while (!h.empty()) {
       comp2 = h.top();
       h.pop();
@@ -382,10 +451,17 @@ void Pipeline::AssignOffsets() {
         continue;
       }
 
-      if (offset + comp1->size() > comp2->offset()) {
-        offset =
-            ComputeNextOffset(comp2->offset() + comp2->size(), comp1->size());
-      } else {
+      if (comp2->offset() + comp2->size() <= offset) {
+        continue;
+      }
+
+      if (offset + comp1->size() <= comp2->offset()) {
+        break;
+      }
+
+      offset =
+          ComputeNextOffset(comp2->offset() + comp2->size(), comp1->size());
+      if (offset == kMetadataOffsetNoSpace) {
         break;
       }
     }
@@ -397,7 +473,7 @@ void Pipeline::AssignOffsets() {
   FillOffsetArrays();
 }
 
-void Pipeline::LogAllScopes() const {
+void Pipeline::LogAllScopes(const std::vector<Module *> &modules) const {
   for (size_t i = 0; i < scope_components_.size(); i++) {
     VLOG(1) << "scope component for " << scope_components_[i].size()
             << "-byte attr " << scope_components_[i].attr_id() << " at offset "
@@ -410,12 +486,7 @@ void Pipeline::LogAllScopes() const {
     VLOG(1) << "}";
   }
 
-  for (const auto &it : ModuleGraph::GetAllModules()) {
-    const Module *m = it.second;
-    if (!m) {
-      break;
-    }
-
+  for (const Module *m : modules) {
     const scope_id_t *scope_arr = module_components_.find(m)->second;
 
     LOG(INFO) << "Module " << m->name()
@@ -428,6 +499,19 @@ void Pipeline::LogAllScopes() const {
   }
 }
 
+void Pipeline::CountScopeAccesses() {
+  for (auto &c : scope_components_) {
+    for (Module *m : c.modules()) {
+      for (const auto &attr : m->all_attrs()) {
+        if (get_attr_id(&attr) == c.attr_id()) {
+          c.incr_accesses();
+          break;
+        }
+      }
+    }
+  }
+}
+
 void Pipeline::ComputeScopeDegrees() {
   for (size_t i = 0; i < scope_components_.size(); i++) {
     for (size_t j = i + 1; j < scope_components_.size(); j++) {
@@ -443,19 +527,23 @@ void Pipeline::ComputeScopeDegrees() {
 int Pipeline::ComputeMetadataOffsets() {
   int ret;
 
-  ret = PrepareMetadataComputation();
+  if (dirty_modules_.empty()) {
+    return 0;
+  }
+
+  std::vector<Module *> modules = CollectDirtyComponents();
+
+  VLOG(1) << "Recomputing metadata offsets for " << modules.size() << " of "
+          << ModuleGraph::GetAllModules().size() << " modules";
+
+  ret = PrepareMetadataComputation(modules);
 
   if (ret) {
     CleanupMetadataComputation();
     return ret;
   }
 
-  for (const auto &it : ModuleGraph::GetAllModules()) {
-    Module *m = it.second;
-    if (!m) {
-      break;
-    }
-
+  for (Module *m : modules) {
     size_t i = 0;
     for (const auto &attr : m->all_attrs()) {
       if (attr.mode == Attribute::AccessMode::kRead ||
@@ -472,14 +560,16 @@ int Pipeline::ComputeMetadataOffsets() {
   }
 
   ComputeScopeDegrees();
-  std::sort(scope_components_.begin(), scope_components_.end(), DegreeComp);
+  CountScopeAccesses();
+  std::sort(scope_components_.begin(), scope_components_.end(), PackingComp);
   AssignOffsets();
 
   if (VLOG_IS_ON(1)) {
-    LogAllScopes();
+    LogAllScopes(modules);
   }
 
-  CheckOrphanReaders();
+  CheckOrphanReaders(modules);
+  CheckCacheLineSpread(modules);
 
   CleanupMetadataComputation();
   return 0;
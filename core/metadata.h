@@ -60,8 +60,15 @@ static const size_t kMetadataTotalSize = SNBUF_METADATA;
 static_assert(kMetadataTotalSize <= SIZE_MAX,
               "Total metadata size check failed");
 
+// Attributes are packed so that each one lies within a single cache line of
+// the metadata area. Offsets are aligned to the attribute size rounded up to a
+// power of two, which guarantees this as long as attributes fit in a line.
+static const size_t kMetadataCacheLineSize = 64;
+static_assert(kMetadataAttrMaxSize <= kMetadataCacheLineSize,
+              "Metadata attributes must fit in a cache line");
+
 // Normal offset values are 0 or a positive value.
-typedef int8_t mt_offset_t;
+typedef int16_t mt_offset_t;
 typedef int16_t scope_id_t;
 
 // No downstream module reads the attribute, so the module can skip writing.
@@ -77,6 +84,11 @@ static inline int IsValidOffset(mt_offset_t offset) {
   return (offset >= 0);
 }
 
+// Returns the index of the metadata cache line holding the offset, or -1.
+static inline int CacheLineOf(mt_offset_t offset) {
+  return IsValidOffset(offset) ? offset / kMetadataCacheLineSize : -1;
+}
+
 struct Attribute {
   Attribute() : name(), size(), mode(), scope_id() {}
 
@@ -98,7 +110,8 @@ class ScopeComponent {
         assigned_(),
         invalid_(),
         modules_(),
-        degree_() {}
+        degree_(),
+        accesses_() {}
 
   ~ScopeComponent() {}
 
@@ -127,6 +140,11 @@ class ScopeComponent {
   int degree() const { return degree_; }
   void incr_degree() { degree_++; }
 
+  // Number of modules in the component that read, write, or update the
+  // attribute, i.e., how many times it is touched along the packet path.
+  int accesses() const { return accesses_; }
+  void incr_accesses() { accesses_++; }
+
   bool DisjointFrom(const ScopeComponent &rhs);
 
  private:
@@ -141,6 +159,7 @@ class ScopeComponent {
   bool invalid_;
   std::set<Module *> modules_;
   int degree_;
+  int accesses_;
 };
 
 class Pipeline {
@@ -149,11 +168,22 @@ class Pipeline {
       : scope_components_(),
         module_scopes_(),
         module_components_(),
-        registered_attrs_() {}
+        registered_attrs_(),
+        dirty_modules_() {}
 
-  // Main entry point for calculating metadata offsets.
+  // Main entry point for calculating metadata offsets. Only the connected
+  // components of the module graph that contain a module marked with
+  // MarkDirty() since the last call are recomputed; offsets already assigned
+  // in the rest of the graph are kept as they are.
   int ComputeMetadataOffsets();
 
+  // Records that the attributes or the gate connections of a module have
+  // changed, so its connected component needs a new offset assignment.
+  void MarkDirty(const Module *m) { dirty_modules_.insert(m); }
+
+  // Drops all references to a module that is about to be destroyed.
+  void ForgetModule(const Module *m) { dirty_modules_.erase(m); }
+
   // Registers attr and returns 0 if no attribute named @attr_name with size
   // other than @size has already been registered for this pipeline.
   // Returns -EINVAL on error.
@@ -163,14 +193,18 @@ class Pipeline {
  private:
   friend class MetadataTest;
 
+  // Collects the modules that are weakly connected to any dirty module, sorted
+  // by name, and clears the dirty set.
+  std::vector<Module *> CollectDirtyComponents();
+
   // Allocate and initiliaze scope component storage.
   // Returns 0 on sucess, -errno on failure.
-  int PrepareMetadataComputation();
+  int PrepareMetadataComputation(const std::vector<Module *> &modules);
 
   void CleanupMetadataComputation();
 
   // Debugging tool.
-  void LogAllScopes() const;
+  void LogAllScopes(const std::vector<Module *> &modules) const;
 
   // Add a module to the current scope component.
   void AddModuleToComponent(Module *m, const struct Attribute *attr);
@@ -196,6 +230,7 @@ class Pipeline {
   void FillOffsetArrays();
   void AssignOffsets();
   void ComputeScopeDegrees();
+  void CountScopeAccesses();
 
   std::vector<ScopeComponent> scope_components_;
 
@@ -210,6 +245,9 @@ class Pipeline {
   // attribute is deregistered once it reaches back to 0.
   // Those modules should agree on the same size(=size_t).
   std::map<std::string, std::tuple<size_t, int> > registered_attrs_;
+
+  // Modules whose connected component changed since the last computation.
+  std::set<const Module *> dirty_modules_;
 };
 
 extern bess::metadata::Pipeline default_pipeline;
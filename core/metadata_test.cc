@@ -351,5 +351,91 @@ TEST_F(MetadataTest, ScopeComponentDegreeOrder) {
               (m4->attr_offset(1) + 6 <= m3->attr_offset(4)));
 }
 
+// Changing one connected component of the graph must leave the offsets of
+// the others untouched, and an unchanged graph must not be recomputed at all.
+TEST_F(MetadataTest, IncrementalRecompute) {
+  Module *m2 = create_foo();
+  Module *m3 = create_foo();
+  ASSERT_NE(nullptr, m2);
+  ASSERT_NE(nullptr, m3);
+
+  ASSERT_EQ(0, m0->AddMetadataAttr("a", 4, Attribute::AccessMode::kWrite));
+  ASSERT_EQ(0, m1->AddMetadataAttr("a", 4, Attribute::AccessMode::kRead));
+  ModuleGraph::ConnectModules(m0, 0, m1, 0);
+
+  ASSERT_EQ(0, m2->AddMetadataAttr("b", 4, Attribute::AccessMode::kWrite));
+  ASSERT_EQ(0, m3->AddMetadataAttr("b", 4, Attribute::AccessMode::kRead));
+  ModuleGraph::ConnectModules(m2, 0, m3, 0);
+
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+  ASSERT_GE(m0->attr_offset(0), 0);
+  ASSERT_EQ(m0->attr_offset(0), m1->attr_offset(0));
+  ASSERT_GE(m2->attr_offset(0), 0);
+
+  // Nothing changed: the next computation is a no-op.
+  const mt_offset_t marker = kMetadataTotalSize - 1;
+  m0->set_attr_offset(0, marker);
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+  ASSERT_EQ(marker, m0->attr_offset(0));
+
+  // A new reader hanging off m3 only touches the m2/m3 component.
+  Module *m4 = create_foo();
+  ASSERT_NE(nullptr, m4);
+  ASSERT_EQ(0, m4->AddMetadataAttr("b", 4, Attribute::AccessMode::kRead));
+  ModuleGraph::ConnectModules(m3, 0, m4, 0);
+
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+  ASSERT_EQ(marker, m0->attr_offset(0));
+  ASSERT_GE(m4->attr_offset(0), 0);
+  ASSERT_EQ(m2->attr_offset(0), m4->attr_offset(0));
+
+  // Disconnecting the first pipe recomputes it.
+  ModuleGraph::DisconnectModule(m0, 0);
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+  ASSERT_EQ(kMetadataOffsetNoWrite, m0->attr_offset(0));
+  ASSERT_EQ(kMetadataOffsetNoRead, m1->attr_offset(0));
+
+  // Destroying a module marks its former neighbours.
+  ModuleGraph::DestroyModule(m3);
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+  ASSERT_EQ(kMetadataOffsetNoWrite, m2->attr_offset(0));
+  ASSERT_EQ(kMetadataOffsetNoRead, m4->attr_offset(0));
+}
+
+// The attribute touched by the most modules must land in the first cache line
+// even when larger, less frequently accessed attributes compete for it.
+TEST_F(MetadataTest, FrequentAttrInFirstCacheLine) {
+  Module *m2 = create_foo();
+  ASSERT_NE(nullptr, m2);
+
+  ASSERT_EQ(0, m0->AddMetadataAttr("c0", 32, Attribute::AccessMode::kWrite));
+  ASSERT_EQ(1, m0->AddMetadataAttr("c1", 32, Attribute::AccessMode::kWrite));
+  ASSERT_EQ(2, m0->AddMetadataAttr("h", 4, Attribute::AccessMode::kWrite));
+  ASSERT_EQ(0, m1->AddMetadataAttr("h", 4, Attribute::AccessMode::kUpdate));
+  ASSERT_EQ(0, m2->AddMetadataAttr("c0", 32, Attribute::AccessMode::kRead));
+  ASSERT_EQ(1, m2->AddMetadataAttr("c1", 32, Attribute::AccessMode::kRead));
+  ASSERT_EQ(2, m2->AddMetadataAttr("h", 4, Attribute::AccessMode::kRead));
+  ModuleGraph::ConnectModules(m0, 0, m1, 0);
+  ModuleGraph::ConnectModules(m1, 0, m2, 0);
+
+  ASSERT_EQ(0, default_pipeline.ComputeMetadataOffsets());
+
+  ASSERT_EQ(0, CacheLineOf(m0->attr_offset(2)));
+  ASSERT_EQ(m0->attr_offset(2), m1->attr_offset(0));
+  ASSERT_EQ(m0->attr_offset(2), m2->attr_offset(2));
+
+  // The cold attributes still get valid, non-overlapping offsets.
+  bool dummy_meta[kMetadataTotalSize] = {};
+  for (size_t i = 0; i < m0->all_attrs().size(); i++) {
+    mt_offset_t offset = m0->attr_offset(i);
+    ASSERT_LE(0, offset);
+    ASSERT_EQ(offset, m2->attr_offset(i));
+    for (size_t j = 0; j < m0->all_attrs()[i].size; j++) {
+      ASSERT_FALSE(dummy_meta[offset + j]);
+      dummy_meta[offset + j] = true;
+    }
+  }
+}
+
 }  // namespace metadata
 }  // namespace bess
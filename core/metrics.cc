@@ -0,0 +1,313 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "metrics.h"
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include <glog/logging.h>
+#include <rte_config.h>
+#include <rte_mempool.h>
+
+#include "gate_hooks/track.h"
+#include "module.h"
+#include "module_graph.h"
+#include "packet_pool.h"
+#include "port.h"
+#include "scheduler.h"
+#include "utils/format.h"
+#include "utils/openmetrics.h"
+#include "utils/time.h"
+#include "worker.h"
+
+namespace bess {
+
+using utils::OpenMetricsWriter;
+
+namespace {
+
+const char *const kDirNames[PACKET_DIRS] = {"inc", "out"};
+
+void CollectPortMetrics(OpenMetricsWriter *w) {
+  for (const auto &pair : PortBuilder::all_ports()) {
+    ::Port *p = pair.second;
+    ::Port::PortStats stats = p->GetPortStats();
+    const ::QueueStats *totals[PACKET_DIRS] = {&stats.inc, &stats.out};
+
+    for (int dir = 0; dir < PACKET_DIRS; dir++) {
+      OpenMetricsWriter::Labels labels = {{"port", pair.first},
+                                          {"dir", kDirNames[dir]}};
+      w->Counter("bess_port_packets", "Packets sent/received by a port",
+                 labels, totals[dir]->packets);
+      w->Counter("bess_port_dropped", "Packets dropped by a port", labels,
+                 totals[dir]->dropped);
+      w->Counter("bess_port_bytes", "Bytes sent/received by a port", labels,
+                 totals[dir]->bytes);
+
+      for (queue_t qid = 0; qid < p->num_queues[dir]; qid++) {
+        const ::QueueStats &q = p->queue_stats[dir][qid];
+        OpenMetricsWriter::Labels qlabels = labels;
+        qlabels.emplace_back("queue", std::to_string(qid));
+        w->Counter("bess_port_queue_packets",
+                   "Packets sent/received by BESS on a port queue", qlabels,
+                   q.packets);
+        w->Counter("bess_port_queue_dropped",
+                   "Packets dropped by BESS on a port queue", qlabels,
+                   q.dropped);
+        w->Counter("bess_port_queue_bytes",
+                   "Bytes sent/received by BESS on a port queue", qlabels,
+                   q.bytes);
+      }
+    }
+  }
+}
+
+template <typename G>
+void CollectGateMetrics(OpenMetricsWriter *w, const Module *m,
+                        const std::vector<G *> &gates, const char *dir) {
+  for (G *g : gates) {
+    if (!g) {
+      continue;
+    }
+    Track *t = reinterpret_cast<Track *>(g->FindHookByClass(Track::kName));
+    if (!t) {
+      continue;
+    }
+
+    OpenMetricsWriter::Labels labels = {
+        {"module", m->name()},
+        {"dir", dir},
+        {"gate", std::to_string(g->gate_idx())}};
+    w->Counter("bess_gate_batches", "Batches seen by a tracked gate", labels,
+               t->cnt());
+    w->Counter("bess_gate_packets", "Packets seen by a tracked gate", labels,
+               t->pkts());
+    w->Counter("bess_gate_bytes", "Bytes seen by a tracked gate", labels,
+               t->bytes());
+  }
+}
+
+void CollectWorkerMetrics(OpenMetricsWriter *w) {
+  w->Gauge("bess_tsc_hz", "TSC frequency, to convert cycles to seconds", {},
+           tsc_hz);
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (!is_worker_active(wid)) {
+      continue;
+    }
+    const sched_stats &stats = workers[wid]->scheduler()->stats();
+    OpenMetricsWriter::Labels labels = {{"worker", std::to_string(wid)}};
+    w->Counter("bess_worker_idle_rounds",
+               "Scheduling rounds in which a worker had nothing to run",
+               labels, stats.cnt_idle);
+    w->Counter("bess_worker_idle_cycles", "CPU cycles a worker spent idle",
+               labels, stats.cycles_idle);
+  }
+}
+
+void CollectMempoolMetrics(OpenMetricsWriter *w) {
+  for (int socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+    PacketPool *pool = PacketPool::GetDefaultPool(socket);
+    if (!pool || !pool->pool()) {
+      continue;
+    }
+    rte_mempool *mempool = pool->pool();
+    OpenMetricsWriter::Labels labels = {{"socket", std::to_string(socket)}};
+    w->Gauge("bess_mempool_buffers", "Packet buffers in a pool", labels,
+             mempool->size);
+    w->Gauge("bess_mempool_available_buffers", "Free packet buffers in a pool",
+             labels, rte_mempool_avail_count(mempool));
+    w->Gauge("bess_mempool_in_use_buffers", "Packet buffers in use", labels,
+             rte_mempool_in_use_count(mempool));
+  }
+}
+
+}  // namespace
+
+std::string RenderMetrics() {
+  OpenMetricsWriter w;
+
+  CollectPortMetrics(&w);
+
+  for (const auto &pair : ModuleGraph::GetAllModules()) {
+    const Module *m = pair.second;
+    CollectGateMetrics(&w, m, m->igates(), "in");
+    CollectGateMetrics(&w, m, m->ogates(), "out");
+  }
+
+  CollectWorkerMetrics(&w);
+  CollectMempoolMetrics(&w);
+
+  for (const auto &pair : ModuleGraph::GetAllModules()) {
+    const Module *m = pair.second;
+    std::lock_guard<std::mutex> lock(m->command_mutex());
+    m->CollectMetrics(&w);
+  }
+
+  return w.Render();
+}
+
+int MetricsServer::Start(const std::string &addr) {
+  size_t colon = addr.rfind(':');
+  if (colon == std::string::npos) {
+    return -EINVAL;
+  }
+  std::string host = addr.substr(0, colon);
+  std::string port = addr.substr(colon + 1);
+  if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);  // IPv6 literal
+  }
+
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  addrinfo *res;
+  if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints,
+                  &res) != 0) {
+    return -EINVAL;
+  }
+
+  int ret = -EADDRNOTAVAIL;
+  for (addrinfo *ai = res; ai; ai = ai->ai_next) {
+    int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                    ai->ai_protocol);
+    if (fd < 0) {
+      ret = -errno;
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, 16) < 0) {
+      ret = -errno;
+      close(fd);
+      continue;
+    }
+    fd_ = fd;
+    ret = 0;
+    break;
+  }
+  freeaddrinfo(res);
+
+  if (ret == 0) {
+    stop_ = false;
+    thread_ = std::thread(&MetricsServer::Run, this);
+  }
+  return ret;
+}
+
+void MetricsServer::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  stop_ = true;
+  thread_.join();
+  close(fd_);
+  fd_ = -1;
+}
+
+void MetricsServer::Run() {
+  while (!stop_) {
+    pollfd pfd = {fd_, POLLIN, 0};
+    // Wake up now and then to check for Stop().
+    if (poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+
+    int fd = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+
+    // Do not let a stuck client block the server.
+    timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    Serve(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::Serve(int fd) {
+  // We only need the request line, but read the whole header before
+  // responding, so that closing the socket does not reset the connection.
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < 8192) {
+    ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+    if (ret <= 0) {
+      return;
+    }
+    request.append(buf, ret);
+  }
+
+  std::string status;
+  std::string content_type = "text/plain; charset=utf-8";
+  std::string body;
+
+  std::string line = request.substr(0, request.find("\r\n"));
+  if (line.compare(0, 4, "GET ") != 0) {
+    status = "405 Method Not Allowed";
+  } else if (line.compare(4, 9, "/metrics ") != 0 &&
+             line.compare(4, 9, "/metrics?") != 0) {
+    status = "404 Not Found";
+  } else {
+    status = "200 OK";
+    content_type =
+        "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    body = render_();
+  }
+
+  std::string response = utils::Format(
+      "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+      "Connection: close\r\n\r\n",
+      status.c_str(), content_type.c_str(), body.size());
+  response += body;
+
+  size_t sent = 0;
+  while (sent < response.size()) {
+    ssize_t ret = send(fd, response.data() + sent, response.size() - sent,
+                       MSG_NOSIGNAL);
+    if (ret <= 0) {
+      return;
+    }
+    sent += ret;
+  }
+}
+
+}  // namespace bess
@@ -0,0 +1,79 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#ifndef BESS_METRICS_H_
+#define BESS_METRICS_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace bess {
+
+// Renders the metrics of the daemon in the OpenMetrics text format: port and
+// queue counters, gates with a "track" hook, worker idle time, packet pools,
+// and whatever modules add with Module::CollectMetrics(). Counters are read
+// while workers keep running. The caller must keep the pipeline from changing
+// and serialize calls to Port::GetPortStats() (see bessctl.cc).
+std::string RenderMetrics();
+
+// A minimal HTTP server for Prometheus scrapes. It serves the page returned by
+// `render` at /metrics, one request at a time, on its own thread.
+class MetricsServer {
+ public:
+  explicit MetricsServer(const std::function<std::string()> &render)
+      : render_(render), fd_(-1), stop_(false) {}
+
+  ~MetricsServer() { Stop(); }
+
+  // This class is neither copyable nor movable.
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+
+  // Starts listening on `addr` ("host:port"). Returns 0 or -errno.
+  int Start(const std::string &addr);
+
+  void Stop();
+
+ private:
+  void Run();
+
+  // Reads one request from `fd` and responds to it.
+  void Serve(int fd);
+
+  std::function<std::string()> render_;
+  int fd_;
+  std::atomic<bool> stop_;
+  std::thread thread_;
+};
+
+}  // namespace bess
+
+#endif  // BESS_METRICS_H_
@@ -245,6 +245,35 @@ CheckConstraintResult Module::CheckModuleConstraints() const {
   return valid;
 }
 
+bool Module::UpdateActiveSockets() {
+  placement_constraint sockets = 0;
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (active_workers_[wid] && workers[wid]) {
+      sockets |= 1ull << workers[wid]->socket();
+    }
+  }
+
+  if (sockets == active_sockets_) {
+    return false;
+  }
+
+  int old_socket = socket();
+  active_sockets_ = sockets;
+
+  if (socket() >= 0 && socket() != old_socket) {
+    VLOG(1) << "Module " << name_ << " now runs on socket " << socket();
+    OnSocketChange();
+  } else if (socket() < 0 && sockets != 0) {
+    LOG(WARNING) << "Module " << name_
+                 << " is shared by workers on multiple sockets (mask 0x"
+                 << std::hex << sockets << std::dec
+                 << "); its state will be accessed across sockets";
+  }
+
+  return true;
+}
+
 int Module::AddMetadataAttr(const std::string &name, size_t size,
                             bess::metadata::Attribute::AccessMode mode) {
   int ret;
@@ -276,6 +305,7 @@ int Module::AddMetadataAttr(const std::string &name, size_t size,
   attr.scope_id = -1;
 
   attrs_.push_back(attr);
+  pipeline_->MarkDirty(this);
 
   return attrs_.size() - 1;
 }
@@ -362,6 +392,10 @@ void Module::Destroy() {
 
   DestroyAllTasks();
   DeregisterAllAttributes();
+
+  if (pipeline_) {
+    pipeline_->ForgetModule(this);
+  }
 }
 
 void Module::DisconnectModulesUpstream(gate_idx_t igate_idx) {
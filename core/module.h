@@ -34,6 +34,7 @@
 #include <array>
 #include <atomic>
 #include <map>
+#include <mutex>
 #include <numeric>
 #include <string>
 #include <unordered_map>
@@ -47,6 +48,7 @@
 #include "message.h"
 #include "metadata.h"
 #include "packet_pool.h"
+#include "utils/openmetrics.h"
 #include "worker.h"
 
 using bess::gate_idx_t;
@@ -189,6 +191,7 @@ class alignas(64) Module {
         module_builder_(),
         initial_arg_(),
         pipeline_(),
+        command_mutex_(),
         attrs_(),
         attr_offsets_(),
         tasks_(),
@@ -202,9 +205,12 @@ class alignas(64) Module {
         children_overload_(0),
         overload_(false),
         node_constraints_(UNCONSTRAINED_SOCKET),
+        active_sockets_(0),
         min_allowed_workers_(1),
         max_allowed_workers_(1),
-        propagate_workers_(true) {}
+        propagate_workers_(true),
+        trace_attr_id_(-1),
+        trace_module_id_() {}
   virtual ~Module() {}
 
   CommandResponse Init(const bess::pb::EmptyArg &arg);
@@ -233,6 +239,11 @@ class alignas(64) Module {
 
   virtual std::string GetDesc() const { return ""; }
 
+  // Adds module-specific metrics (e.g., histograms) to the page served by the
+  // metrics endpoint, labeled with the module name. Called with the command
+  // lock held, while workers are running.
+  virtual void CollectMetrics(bess::utils::OpenMetricsWriter *) const {}
+
   static const gate_idx_t kNumIGates = 1;
   static const gate_idx_t kNumOGates = 1;
 
@@ -294,11 +305,19 @@ class alignas(64) Module {
   int AddMetadataAttr(const std::string &name, size_t size,
                       bess::metadata::Attribute::AccessMode mode);
 
+  // Commands on a module (and on hooks of its gates) are serialized by the
+  // module's own lock, so that the control plane can run commands on
+  // different modules concurrently.
   CommandResponse RunCommand(const std::string &cmd,
                              const google::protobuf::Any &arg) {
+    std::lock_guard<std::mutex> lock(command_mutex_);
     return module_builder_->RunCommand(this, cmd, arg);
   }
 
+  // Held while running a command, or while anything else in the control
+  // plane reads state that commands may change (e.g., GetDesc()).
+  std::mutex &command_mutex() const { return command_mutex_; }
+
   const ModuleBuilder *module_builder() const { return module_builder_; }
 
   bess::metadata::Pipeline *pipeline() const { return pipeline_; }
@@ -328,6 +347,17 @@ class alignas(64) Module {
     return attr_offsets_;
   }
 
+  // The metadata attribute with the packet trace stamp, or -1 if packets are
+  // not traced (see packet_trace.h).
+  int trace_attr_id() const { return trace_attr_id_; }
+
+  uint32_t trace_module_id() const { return trace_module_id_; }
+
+  void set_trace(int attr_id, uint32_t module_id) {
+    trace_attr_id_ = attr_id;
+    trace_module_id_ = module_id;
+  }
+
   const std::vector<bess::IGate *> &igates() const { return igates_; }
 
   const std::vector<bess::OGate *> &ogates() const { return ogates_; }
@@ -381,6 +411,24 @@ class alignas(64) Module {
 
   virtual CheckConstraintResult CheckModuleConstraints() const;
 
+  // Bitmask of the NUMA nodes hosting the workers attached to this module, as
+  // of the last resume.
+  placement_constraint active_sockets() const { return active_sockets_; }
+
+  // The NUMA node all attached workers run on, or -1 if no worker is attached
+  // yet or the module is shared by workers on several nodes.
+  int socket() const {
+    if (active_sockets_ == 0 || (active_sockets_ & (active_sockets_ - 1))) {
+      return -1;
+    }
+    return __builtin_ctzll(active_sockets_);
+  }
+
+  // Recomputes `active_sockets()` from the set of active workers, calling
+  // OnSocketChange() if `socket()` moved to a new node. Must be called with
+  // all workers paused. Returns true if `active_sockets()` changed.
+  bool UpdateActiveSockets();
+
   // For testing.
   int children_overload() const { return children_overload_; };
 
@@ -445,6 +493,8 @@ class alignas(64) Module {
 
   bess::metadata::Pipeline *pipeline_;
 
+  mutable std::mutex command_mutex_;
+
   std::vector<bess::metadata::Attribute> attrs_;
   bess::metadata::mt_offset_t attr_offsets_[bess::metadata::kMaxAttrsPerModule];
 
@@ -484,11 +534,24 @@ class alignas(64) Module {
   // to greater than 1 iff the module is thread safe.
   int max_allowed_workers_;
 
+  // Called with all workers paused when `socket()` becomes a (different) valid
+  // node. Modules owning sizable lookup state override this to re-home it onto
+  // `socket()`, so that the datapath does not read it across the interconnect.
+  virtual void OnSocketChange() {}
+
+  // NUMA nodes of the workers attached to this module. See active_sockets().
+  placement_constraint active_sockets_;
+
   // Should workers be propagated. Set this to false for cases, e.g., `Queue`
   // where upstream and downstream modules are called by different workers.
   // Note, one should override the `AddActiveWorker` method in more complex
   // cases.
   bool propagate_workers_;
+
+ private:
+  int trace_attr_id_;
+  uint32_t trace_module_id_;
+
   DISALLOW_COPY_AND_ASSIGN(Module);
 };
 
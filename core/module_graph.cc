@@ -35,6 +35,7 @@
 #include "gate.h"
 #include "gate_hooks/track.h"
 #include "module.h"
+#include "packet_trace.h"
 #include "scheduler.h"
 #include "utils/extended_priority_queue.h"
 
@@ -273,6 +274,8 @@ Module *ModuleGraph::CreateModule(const ModuleBuilder &builder,
     return nullptr;
   }
 
+  bess::trace::AttachModule(m);
+
   if (m->is_task()) {
     if (!tasks_.insert(m->name()).second) {
       *perr = pb_errno(ENOMEM);
@@ -293,9 +296,32 @@ Module *ModuleGraph::CreateModule(const ModuleBuilder &builder,
   return m;
 }
 
+// Marks `m` for new metadata offsets in its own pipeline, as
+// Module::AddMetadataAttr() does.
+static void MarkDirty(const Module *m) {
+  if (m->pipeline()) {
+    m->pipeline()->MarkDirty(m);
+  }
+}
+
 void ModuleGraph::DestroyModule(Module *m, bool erase) {
   changes_made_ = true;
 
+  // Neighbours lose their gates to m, so their components need new offsets.
+  for (const bess::IGate *g : m->igates()) {
+    if (g == nullptr) {
+      continue;
+    }
+    for (const auto &og : g->ogates_upstream()) {
+      MarkDirty(og->module());
+    }
+  }
+  for (const auto &og : m->ogates()) {
+    if (og != nullptr) {
+      MarkDirty(og->igate()->module());
+    }
+  }
+
   m->Destroy();
 
   if (erase) {
@@ -339,6 +365,9 @@ int ModuleGraph::ConnectModules(Module *module, gate_idx_t ogate_idx,
   if (ret != 0)
     return ret;
 
+  MarkDirty(module);
+  MarkDirty(m_next);
+
   if (!skip_default_hooks) {
     // Gate tracking is enabled by default
     module->ogates()[ogate_idx]->AddTrackHook();
@@ -354,6 +383,14 @@ int ModuleGraph::DisconnectModule(Module *module, gate_idx_t ogate_idx) {
 
   changes_made_ = true;
 
+  bess::OGate *ogate = module->ogates().size() > ogate_idx
+                           ? module->ogates()[ogate_idx]
+                           : nullptr;
+  if (ogate != nullptr) {
+    MarkDirty(module);
+    MarkDirty(ogate->igate()->module());
+  }
+
   module->DisconnectGate(ogate_idx);
 
   return 0;
@@ -29,6 +29,8 @@
 
 #include "acl.h"
 
+#include <x86intrin.h>
+
 #include "../utils/ether.h"
 #include "../utils/ip.h"
 #include "../utils/udp.h"
@@ -39,6 +41,133 @@ const Commands ACL::cmds = {
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&ACL::CommandClear),
      Command::THREAD_UNSAFE}};
 
+void ACL::RuleTable::Build(const std::vector<ACLRule> &rules) {
+  size_ = rules.size();
+
+  size_t padded = (size_ + kPadding - 1) / kPadding * kPadding;
+
+  // (x & 0) never equals 1, so padding entries never match
+  src_addr_.assign(padded, 1);
+  src_mask_.assign(padded, 0);
+  dst_addr_.assign(padded, 1);
+  dst_mask_.assign(padded, 0);
+  ports_.assign(padded, 1);
+  ports_mask_.assign(padded, 0);
+
+  for (size_t i = 0; i < size_; i++) {
+    const ACLRule &rule = rules[i];
+    uint16_t sport = rule.src_port.value();
+    uint16_t dport = rule.dst_port.value();
+
+    src_mask_[i] = rule.src_ip.mask.value();
+    src_addr_[i] = rule.src_ip.addr.value() & src_mask_[i];
+    dst_mask_[i] = rule.dst_ip.mask.value();
+    dst_addr_[i] = rule.dst_ip.addr.value() & dst_mask_[i];
+    ports_[i] = (static_cast<uint32_t>(sport) << 16) | dport;
+    ports_mask_[i] = (sport ? 0xffff0000 : 0) | (dport ? 0x0000ffff : 0);
+  }
+}
+
+int ACL::RuleTable::Match(uint32_t sip, uint32_t dip, uint32_t ports) const {
+  // Padding entries never match, so there is no need to check for i < size_
+#if __AVX512F__
+  const __m512i s = _mm512_set1_epi32(sip);
+  const __m512i d = _mm512_set1_epi32(dip);
+  const __m512i p = _mm512_set1_epi32(ports);
+
+  for (size_t i = 0; i < src_addr_.size(); i += 16) {
+    __mmask16 m = _mm512_cmpeq_epi32_mask(
+        _mm512_and_si512(s, _mm512_loadu_si512(&src_mask_[i])),
+        _mm512_loadu_si512(&src_addr_[i]));
+    m = _mm512_mask_cmpeq_epi32_mask(
+        m, _mm512_and_si512(d, _mm512_loadu_si512(&dst_mask_[i])),
+        _mm512_loadu_si512(&dst_addr_[i]));
+    m = _mm512_mask_cmpeq_epi32_mask(
+        m, _mm512_and_si512(p, _mm512_loadu_si512(&ports_mask_[i])),
+        _mm512_loadu_si512(&ports_[i]));
+    if (m) {
+      return i + __builtin_ctz(m);
+    }
+  }
+#elif __AVX2__
+  const __m256i s = _mm256_set1_epi32(sip);
+  const __m256i d = _mm256_set1_epi32(dip);
+  const __m256i p = _mm256_set1_epi32(ports);
+
+  for (size_t i = 0; i < src_addr_.size(); i += 8) {
+    __m256i m = _mm256_cmpeq_epi32(
+        _mm256_and_si256(
+            s, _mm256_loadu_si256(
+                   reinterpret_cast<const __m256i *>(&src_mask_[i]))),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&src_addr_[i])));
+    m = _mm256_and_si256(
+        m, _mm256_cmpeq_epi32(
+               _mm256_and_si256(
+                   d, _mm256_loadu_si256(
+                          reinterpret_cast<const __m256i *>(&dst_mask_[i]))),
+               _mm256_loadu_si256(
+                   reinterpret_cast<const __m256i *>(&dst_addr_[i]))));
+    m = _mm256_and_si256(
+        m, _mm256_cmpeq_epi32(
+               _mm256_and_si256(
+                   p, _mm256_loadu_si256(
+                          reinterpret_cast<const __m256i *>(&ports_mask_[i]))),
+               _mm256_loadu_si256(
+                   reinterpret_cast<const __m256i *>(&ports_[i]))));
+    int bits = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+    if (bits) {
+      return i + __builtin_ctz(bits);
+    }
+  }
+#else
+  for (size_t i = 0; i < size_; i++) {
+    if ((sip & src_mask_[i]) == src_addr_[i] &&
+        (dip & dst_mask_[i]) == dst_addr_[i] &&
+        (ports & ports_mask_[i]) == ports_[i]) {
+      return i;
+    }
+  }
+#endif
+  return -1;
+}
+
+void ACL::Compile() {
+  use_tree_ = rules_.size() > kMaxLinearRules;
+
+  if (!use_tree_) {
+    table_.Build(rules_);
+    tree_.Build({});
+    return;
+  }
+
+  std::vector<HyperSplit::Rule> rules;
+  rules.reserve(rules_.size());
+  for (size_t i = 0; i < rules_.size(); i++) {
+    const ACLRule &rule = rules_[i];
+    HyperSplit::Rule r;
+
+    r.ranges[HyperSplit::kSrcIp] = HyperSplit::PrefixRange(
+        rule.src_ip.addr.value(), rule.src_ip.prefix_length());
+    r.ranges[HyperSplit::kDstIp] = HyperSplit::PrefixRange(
+        rule.dst_ip.addr.value(), rule.dst_ip.prefix_length());
+    for (auto field : {HyperSplit::kSrcPort, HyperSplit::kDstPort}) {
+      uint16_t port = (field == HyperSplit::kSrcPort) ? rule.src_port.value()
+                                                      : rule.dst_port.value();
+      r.ranges[field] = port ? HyperSplit::Range{port, port}
+                             : HyperSplit::FullRange(field);
+    }
+    r.ranges[HyperSplit::kProto] = HyperSplit::FullRange(HyperSplit::kProto);
+
+    // Earlier rules take precedence
+    r.priority = -static_cast<int>(i);
+    r.id = i;
+    rules.push_back(r);
+  }
+
+  tree_.Build(rules);
+  table_.Build({});
+}
+
 CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
   for (const auto &rule : arg.rules()) {
     ACLRule new_rule = {
@@ -49,6 +178,7 @@ CommandResponse ACL::Init(const bess::pb::ACLArg &arg) {
         .drop = rule.drop()};
     rules_.push_back(new_rule);
   }
+  Compile();
   return CommandSuccess();
 }
 
@@ -59,6 +189,7 @@ CommandResponse ACL::CommandAdd(const bess::pb::ACLArg &arg) {
 
 CommandResponse ACL::CommandClear(const bess::pb::EmptyArg &) {
   rules_.clear();
+  Compile();
   return CommandSuccess();
 }
 
@@ -69,28 +200,74 @@ void ACL::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   gate_idx_t incoming_gate = ctx->current_igate;
 
+  HyperSplit::Key keys[bess::PacketBatch::kMaxBurst];
+  const HyperSplit::Rule *matches[bess::PacketBatch::kMaxBurst];
+  int key_idx[bess::PacketBatch::kMaxBurst];  // packet index -> key, or -1
+  int n_keys = 0;
+
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
+    key_idx[i] = -1;
+
+    // Non-IPv4 packets cannot match any rule, thus are dropped
     Ethernet *eth = pkt->head_data<Ethernet *>();
+    if (pkt->head_len() < sizeof(*eth) + sizeof(Ipv4) ||
+        eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
+      continue;
+    }
+
     Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
     size_t ip_bytes = ip->header_length << 2;
-    Udp *udp =
-        reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
-
-    bool emitted = false;
-    for (const auto &rule : rules_) {
-      if (rule.Match(ip->src, ip->dst, udp->src_port, udp->dst_port)) {
-        if (!rule.drop) {
-          emitted = true;
-          EmitPacket(ctx, pkt, incoming_gate);
-        }
-        break;  // Stop matching other rules
+    HyperSplit::Key *key = &keys[n_keys];
+
+    key->fields[HyperSplit::kSrcIp] = ip->src.value();
+    key->fields[HyperSplit::kDstIp] = ip->dst.value();
+    key->fields[HyperSplit::kSrcPort] = 0;
+    key->fields[HyperSplit::kDstPort] = 0;
+    key->fields[HyperSplit::kProto] = ip->protocol;
+
+    // Packets without a TCP/UDP header (other protocols, non-first fragments)
+    // have port 0: they only match rules with wildcard ports.
+    bool first_frag = (ip->fragment_offset & be16_t(0x1fff)) == be16_t(0);
+    if ((ip->protocol == Ipv4::Proto::kTcp ||
+         ip->protocol == Ipv4::Proto::kUdp) &&
+        first_frag &&
+        pkt->head_len() >= sizeof(*eth) + ip_bytes + sizeof(Udp)) {
+      Udp *udp =
+          reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+      key->fields[HyperSplit::kSrcPort] = udp->src_port.value();
+      key->fields[HyperSplit::kDstPort] = udp->dst_port.value();
+    }
+
+    key_idx[i] = n_keys++;
+  }
+
+  if (use_tree_) {
+    tree_.MatchBatch(keys, n_keys, matches);
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    int rule_idx = -1;
+
+    if (key_idx[i] >= 0) {
+      const HyperSplit::Key &key = keys[key_idx[i]];
+      if (use_tree_) {
+        const HyperSplit::Rule *match = matches[key_idx[i]];
+        rule_idx = match ? match->id : -1;
+      } else {
+        rule_idx = table_.Match(key.fields[HyperSplit::kSrcIp],
+                                key.fields[HyperSplit::kDstIp],
+                                (key.fields[HyperSplit::kSrcPort] << 16) |
+                                    key.fields[HyperSplit::kDstPort]);
       }
     }
 
-    if (!emitted) {
+    if (rule_idx >= 0 && !rules_[rule_idx].drop) {
+      EmitPacket(ctx, pkt, incoming_gate);
+    } else {
       DropPacket(ctx, pkt);
     }
   }
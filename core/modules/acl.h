@@ -34,10 +34,12 @@
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/hyper_split.h"
 #include "../utils/ip.h"
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
+using bess::utils::HyperSplit;
 using bess::utils::Ipv4Prefix;
 
 class ACL final : public Module {
@@ -56,6 +58,36 @@ class ACL final : public Module {
     bool drop;
   };
 
+  // Rules compiled into a structure-of-arrays table, so that a packet is
+  // compared against 8 (AVX2) or 16 (AVX-512) rules per instruction. Both
+  // ports are packed into a single 32-bit lane. All values are in host order.
+  class RuleTable {
+   public:
+    // Rule arrays are padded to a multiple of this with never-matching rules
+    static const size_t kPadding = 16;
+
+    void Build(const std::vector<ACLRule> &rules);
+
+    // Returns the index of the first matching rule, or -1 if none matches.
+    int Match(uint32_t sip, uint32_t dip, uint32_t ports) const;
+
+    size_t size() const { return size_; }
+
+   private:
+    size_t size_ = 0;  // Number of rules, excluding padding
+
+    std::vector<uint32_t> src_addr_;
+    std::vector<uint32_t> src_mask_;
+    std::vector<uint32_t> dst_addr_;
+    std::vector<uint32_t> dst_mask_;
+    std::vector<uint32_t> ports_;
+    std::vector<uint32_t> ports_mask_;
+  };
+
+  // Beyond this many rules, a linear (even if vectorized) scan is slower than
+  // a HyperSplit decision tree lookup.
+  static const size_t kMaxLinearRules = 256;
+
   static const Commands cmds;
 
   ACL() : Module() { max_allowed_workers_ = Worker::kMaxWorkers; }
@@ -68,7 +100,14 @@ class ACL final : public Module {
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
 
  private:
+  // Recompiles rules_ into table_ or tree_, depending on the number of rules.
+  void Compile();
+
   std::vector<ACLRule> rules_;
+
+  bool use_tree_ = false;
+  RuleTable table_;
+  HyperSplit tree_;
 };
 
 #endif  // BESS_MODULES_ACL_H_
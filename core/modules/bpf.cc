@@ -33,6 +33,7 @@
 
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -56,22 +57,29 @@ const Commands BPF::cmds = {
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&BPF::CommandClear),
      Command::THREAD_UNSAFE},
     {"get_initial_arg", "EmptyArg", MODULE_CMD_FUNC(&BPF::GetInitialArg),
+     Command::THREAD_SAFE},
+    {"get_stats", "EmptyArg", MODULE_CMD_FUNC(&BPF::CommandGetStats),
      Command::THREAD_SAFE}};
 
 CommandResponse BPF::Init(const bess::pb::BPFArg &arg) {
   return CommandAdd(arg);
 }
 
-void BPF::DeInit() {
-  for (auto &filter : filters_) {
+void BPF::FreeFilter(bess::utils::Filter *filter) {
 #ifdef __x86_64
-    munmap(reinterpret_cast<void *>(filter.func), filter.mmap_size);
+  munmap(reinterpret_cast<void *>(filter->func), filter->mmap_size);
 #else
-    pcap_freecode(&filter.il_code);
+  pcap_freecode(&filter->il_code);
 #endif
+}
+
+void BPF::DeInit() {
+  for (auto &filter : filters_) {
+    FreeFilter(&filter);
   }
 
   filters_.clear();
+  Merge();
 }
 
 CommandResponse BPF::GetInitialArg(const bess::pb::EmptyArg &) {
@@ -86,9 +94,18 @@ CommandResponse BPF::GetInitialArg(const bess::pb::EmptyArg &) {
 }
 
 CommandResponse BPF::CommandAdd(const bess::pb::BPFArg &arg) {
+  std::vector<bess::utils::Filter> added;
+
+  auto fail = [&added](int err, const char *msg) {
+    for (auto &filter : added) {
+      FreeFilter(&filter);
+    }
+    return CommandFailure(err, "%s", msg);
+  };
+
   for (const auto &f : arg.filters()) {
     if (f.gate() < 0 || f.gate() >= MAX_GATES) {
-      return CommandFailure(EINVAL, "Invalid gate");
+      return fail(EINVAL, "Invalid gate");
     }
 
     bess::utils::Filter filter;
@@ -101,29 +118,34 @@ CommandResponse BPF::CommandAdd(const bess::pb::BPFArg &arg) {
                             &il, filter.exp.c_str(),
                             1,  // optimize (IL only)
                             PCAP_NETMASK_UNKNOWN) == -1) {
-      return CommandFailure(EINVAL, "BPF compilation error");
+      return fail(EINVAL, "BPF compilation error");
     }
 
+    filter.insns.assign(il.bf_insns, il.bf_insns + il.bf_len);
+
 #ifdef __x86_64
     filter.func =
         bess::utils::bpf_jit_compile(il.bf_insns, il.bf_len, &filter.mmap_size);
     pcap_freecode(&il);
     if (!filter.func) {
-      return CommandFailure(ENOMEM, "BPF JIT compilation error");
+      return fail(ENOMEM, "BPF JIT compilation error");
     }
 #else
     filter.il_code = il;
 #endif
 
-    filters_.push_back(filter);
+    added.push_back(filter);
   }
 
-  std::sort(filters_.begin(), filters_.end(),
-            [](const bess::utils::Filter &a, const bess::utils::Filter &b) {
-              // descending order of priority number
-              return b.priority < a.priority;
-            });
+  filters_.insert(filters_.end(), added.begin(), added.end());
+  std::stable_sort(
+      filters_.begin(), filters_.end(),
+      [](const bess::utils::Filter &a, const bess::utils::Filter &b) {
+        // descending order of priority number
+        return b.priority < a.priority;
+      });
 
+  Merge();
   return CommandSuccess();
 }
 
@@ -132,16 +154,20 @@ CommandResponse BPF::CommandDelete(const bess::pb::BPFArg &arg) {
     if (f.gate() < 0 || f.gate() >= MAX_GATES) {
       return CommandFailure(EINVAL, "Invalid gate");
     }
+  }
 
+  for (const auto &f : arg.filters()) {
     for (auto i = filters_.begin(); i != filters_.end(); ++i) {
       if (f.priority() == i->priority && f.gate() == i->gate &&
           f.filter() == i->exp) {
+        FreeFilter(&*i);
         filters_.erase(i);
         break;
       }
     }
   }
 
+  Merge();
   return CommandSuccess();
 }
 
@@ -150,6 +176,77 @@ CommandResponse BPF::CommandClear(const bess::pb::EmptyArg &) {
   return CommandSuccess();
 }
 
+CommandResponse BPF::CommandGetStats(const bess::pb::EmptyArg &) {
+  bess::pb::BPFCommandGetStatsResponse r;
+
+  for (size_t i = 0; i < filters_.size(); i++) {
+    uint64_t hits = 0;
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      hits += hits_[wid][i];
+    }
+
+    auto *f_pb = r.add_filters();
+    f_pb->set_priority(filters_[i].priority);
+    f_pb->set_filter(filters_[i].exp);
+    f_pb->set_gate(filters_[i].gate);
+    f_pb->set_hits(hits);
+  }
+
+  uint64_t unmatched = 0;
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    unmatched += hits_[wid][filters_.size()];
+  }
+  r.set_unmatched(unmatched);
+
+  return CommandSuccess(r);
+}
+
+void BPF::Merge() {
+  if (has_merged_) {
+    FreeFilter(&merged_);
+    has_merged_ = false;
+  }
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    hits_[wid].assign(filters_.size() + 1, 0);
+  }
+
+  if (filters_.empty()) {
+    return;
+  }
+
+  std::vector<const std::vector<struct bpf_insn> *> progs;
+  for (const auto &filter : filters_) {
+    progs.push_back(&filter.insns);
+  }
+
+  if (!bess::utils::bpf_merge_programs(progs, &merged_.insns)) {
+    LOG(WARNING) << name() << ": cannot merge filters, evaluating them "
+                 << "one by one";
+    return;
+  }
+
+#ifdef __x86_64
+  merged_.func = bess::utils::bpf_jit_compile(
+      merged_.insns.data(), merged_.insns.size(), &merged_.mmap_size);
+  if (!merged_.func) {
+    LOG(WARNING) << name() << ": BPF JIT compilation of merged filters failed";
+    return;
+  }
+#else
+  merged_.il_code.bf_len = merged_.insns.size();
+  merged_.il_code.bf_insns = static_cast<struct bpf_insn *>(
+      malloc(sizeof(struct bpf_insn) * merged_.insns.size()));
+  if (!merged_.il_code.bf_insns) {
+    return;
+  }
+  std::copy(merged_.insns.begin(), merged_.insns.end(),
+            merged_.il_code.bf_insns);
+#endif
+
+  has_merged_ = true;
+}
+
 inline bool BPF::Match(const bess::utils::Filter &filter, u_char *pkt,
                        u_int wirelen, u_int buflen) {
 #ifdef __x86_64
@@ -161,50 +258,62 @@ inline bool BPF::Match(const bess::utils::Filter &filter, u_char *pkt,
   return ret != 0;
 }
 
-void BPF::ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch) {
-  const bess::utils::Filter &filter = filters_[0];
-
-  int cnt = batch->cnt();
-
-  for (int i = 0; i < cnt; i++) {
-    bess::Packet *pkt = batch->pkts()[i];
-
-    if (Match(filter, pkt->head_data<u_char *>(), pkt->total_len(),
+size_t BPF::MatchEach(bess::Packet *pkt) const {
+  // high priority filters are checked first
+  for (size_t i = 0; i < filters_.size(); i++) {
+    if (Match(filters_[i], pkt->head_data<u_char *>(), pkt->total_len(),
               pkt->head_len())) {
-      EmitPacket(ctx, pkt, filter.gate);
-    } else {
-      EmitPacket(ctx, pkt);
+      return i;
     }
   }
+  return filters_.size();
 }
 
 void BPF::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
-  int n_filters = filters_.size();
+  size_t n_filters = filters_.size();
 
   if (n_filters == 0) {
     RunNextModule(ctx, batch);
     return;
-  } else if (n_filters == 1) {
-    ProcessBatch1Filter(ctx, batch);
-    return;
   }
 
-  // slow version for general cases
   int cnt = batch->cnt();
+  size_t idx[bess::PacketBatch::kMaxBurst];
+
+  if (has_merged_) {
+    // One call per packet, returning the index of the matched filter + 1.
+    // Evaluating the whole batch first keeps the program hot in i-cache.
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *pkt = batch->pkts()[i];
+#ifdef __x86_64
+      u_int ret = merged_.func(pkt->head_data<u_char *>(), pkt->total_len(),
+                               pkt->head_len());
+#else
+      u_int ret = bpf_filter(merged_.il_code.bf_insns,
+                             pkt->head_data<u_char *>(), pkt->total_len(),
+                             pkt->head_len());
+#endif
+      // 0 means that some filter aborted (e.g., on a truncated packet),
+      // so the following filters must be evaluated separately.
+      idx[i] = ret ? ret - 1 : MatchEach(pkt);
+    }
+  } else {
+    for (int i = 0; i < cnt; i++) {
+      idx[i] = MatchEach(batch->pkts()[i]);
+    }
+  }
+
+  uint64_t *hits = hits_[ctx->wid].data();
 
   for (int i = 0; i < cnt; i++) {
-    gate_idx_t gate = 0;  // default gate for unmatched pkts
     bess::Packet *pkt = batch->pkts()[i];
 
-    // high priority filters are checked first
-    for (const bess::utils::Filter &filter : filters_) {
-      if (Match(filter, pkt->head_data<uint8_t *>(), pkt->total_len(),
-                pkt->head_len())) {
-        gate = filter.gate;
-        break;
-      }
+    hits[idx[i]]++;
+    if (idx[i] < n_filters) {
+      EmitPacket(ctx, pkt, filters_[idx[i]].gate);
+    } else {
+      EmitPacket(ctx, pkt);  // unmatched packets are sent to gate 0
     }
-    EmitPacket(ctx, pkt, gate);
   }
 }
 
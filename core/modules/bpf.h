@@ -56,13 +56,30 @@ class BPF final : public Module {
   CommandResponse CommandAdd(const bess::pb::BPFArg &arg);
   CommandResponse CommandDelete(const bess::pb::BPFArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandGetStats(const bess::pb::EmptyArg &arg);
 
  private:
   static bool Match(const bess::utils::Filter &, u_char *, u_int, u_int);
 
-  void ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch);
+  static void FreeFilter(bess::utils::Filter *filter);
+
+  // Rebuilds merged_ from filters_ and resets the hit counters.
+  void Merge();
+
+  // Returns the index of the first filter that matches pkt, or
+  // filters_.size() if none does.
+  size_t MatchEach(bess::Packet *pkt) const;
 
   std::vector<bess::utils::Filter> filters_;
+
+  // All filters in one program, which returns the index of the first
+  // matching filter plus one. Used if has_merged_ is true.
+  bess::utils::Filter merged_;
+  bool has_merged_ = false;
+
+  // Per-worker hit counters, indexed by filter. The last one counts
+  // unmatched packets.
+  std::vector<uint64_t> hits_[Worker::kMaxWorkers];
 };
 
 #endif  // BESS_MODULES_BPF_H_
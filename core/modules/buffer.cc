@@ -30,6 +30,7 @@
 
 #include "buffer.h"
 #include "../utils/format.h"
+#include "../utils/numa.h"
 #include <cstdlib>
 #include "../core/packet.h"
 
@@ -45,6 +46,15 @@ const Commands Buffer::cmds = {
 void Buffer::DeInit() {
   bess::PacketBatch *buf = &buf_;
   bess::Packet::Free(buf);
+
+  if (queue_) {
+    bess::Packet *pkt;
+    while (llring_sc_dequeue(queue_, (void **)&pkt) == 0) {
+      bess::Packet::Free(pkt);
+    }
+    bess::utils::FreePages(queue_, llring_bytes_with_slots(size_));
+    queue_ = nullptr;
+  }
 }
 
 void Buffer::ProcessBatch(Context *, bess::PacketBatch *batch) {
@@ -201,15 +211,15 @@ int Buffer::Resize(int slots) {
 
   int bytes = llring_bytes_with_slots(slots);
 
-  new_queue =
-      reinterpret_cast<llring *>(std::aligned_alloc(alignof(llring), bytes));
+  // In pages of its own, for OnSocketChange().
+  new_queue = reinterpret_cast<llring *>(bess::utils::AllocPages(bytes));
   if (!new_queue) {
     return -ENOMEM;
   }
 
   int ret = llring_init(new_queue, slots, 0, 1);
   if (ret) {
-    std::free(new_queue);
+    bess::utils::FreePages(new_queue, bytes);
     return -EINVAL;
   }
 
@@ -224,7 +234,7 @@ int Buffer::Resize(int slots) {
       }
     }
 
-    std::free(old_queue);
+    bess::utils::FreePages(old_queue, llring_bytes_with_slots(size_));
   }
 
   queue_ = new_queue;
@@ -233,6 +243,18 @@ int Buffer::Resize(int slots) {
   return 0;
 }
 
+void Buffer::OnSocketChange() {
+  if (!queue_) {
+    return;
+  }
+  int ret = bess::utils::MovePagesToNode(
+      queue_, llring_bytes_with_slots(size_), socket());
+  if (ret) {
+    LOG(WARNING) << name() << ": failed to move ring to socket " << socket()
+                 << ": " << strerror(-ret);
+  }
+}
+
 int Buffer::SendPfcpReport() {
   int result;
   const char pfcpmsg[40]={
@@ -73,6 +73,7 @@ class Buffer final : public Module {
   
 
  private:
+  void OnSocketChange() override;
 
   // Packets Buffer Vars 
   bess::PacketBatch buf_; //private buffer batch
@@ -0,0 +1,243 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "conntrack.h"
+
+#include "../utils/ether.h"
+#include "../utils/format.h"
+#include "../utils/ip.h"
+#include "../utils/numa.h"
+#include "../utils/time.h"
+
+using bess::utils::be16_t;
+using bess::utils::ConnTracker;
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::ToIpv4Address;
+
+const Commands Conntrack::cmds = {
+    {"get_summary", "EmptyArg", MODULE_CMD_FUNC(&Conntrack::CommandGetSummary),
+     Command::THREAD_SAFE},
+    {"dump", "ConntrackCommandDumpArg",
+     MODULE_CMD_FUNC(&Conntrack::CommandDump), Command::THREAD_UNSAFE},
+    {"clear", "ConntrackCommandClearArg",
+     MODULE_CMD_FUNC(&Conntrack::CommandClear), Command::THREAD_UNSAFE},
+};
+
+CommandResponse Conntrack::Init(const bess::pb::ConntrackArg &arg) {
+  if (arg.max_flows() > ConnTracker::kMaxFlows) {
+    return CommandFailure(EINVAL, "max_flows must be at most %zu",
+                          ConnTracker::kMaxFlows);
+  }
+  if (arg.max_flows()) {
+    config_.max_flows = arg.max_flows();
+  }
+  config_.tcp_loose = !arg.tcp_strict();
+
+  for (const auto &it : arg.timeouts()) {
+    int state = 0;
+    while (state < ConnTracker::kNumStates &&
+           it.first != ConnTracker::StateName(
+                           static_cast<ConnTracker::State>(state))) {
+      state++;
+    }
+    if (state == ConnTracker::kNumStates) {
+      return CommandFailure(EINVAL, "unknown state '%s' in timeouts",
+                            it.first.c_str());
+    }
+    if (it.second == 0 || it.second > 30 * 86400) {
+      return CommandFailure(EINVAL, "timeout for %s must be 1s-30d",
+                            it.first.c_str());
+    }
+    config_.timeout_ns[state] = it.second * 1000000000ull;
+  }
+
+  using AccessMode = bess::metadata::Attribute::AccessMode;
+  dir_attr_id_ = AddMetadataAttr("ct_dir", 1, AccessMode::kWrite);
+  state_attr_id_ = AddMetadataAttr("ct_state", 1, AccessMode::kWrite);
+  if (dir_attr_id_ < 0 || state_attr_id_ < 0) {
+    return CommandFailure(EINVAL, "invalid metadata declaration");
+  }
+
+  return CommandSuccess();
+}
+
+void Conntrack::DeInit() {
+  for (PerWorker &w : workers_) {
+    w.tracker.reset();
+  }
+}
+
+void Conntrack::AddActiveWorker(int wid, const Task *task) {
+  Module::AddActiveWorker(wid, task);
+
+  // Workers are paused here, so the table can be set up before its worker
+  // first reaches this module.
+  PerWorker &w = workers_[wid];
+  if (!w.tracker) {
+    bess::utils::ScopedNodePreference numa(workers[wid]->socket());
+    w.tracker.reset(new ConnTracker());
+    w.tracker->Init(config_, tsc_to_ns(rdtsc()));
+  }
+}
+
+void Conntrack::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  PerWorker &w = workers_[ctx->wid];
+  ConnTracker *tracker = w.tracker.get();
+  int cnt = batch->cnt();
+
+  if (!tracker) {
+    w.untracked += cnt;
+    RunChooseModule(ctx, kUntrackedGate, batch);
+    return;
+  }
+
+  tracker->Expire(ctx->current_ns);
+
+  ConnTracker::Packet pkts[bess::PacketBatch::kMaxBurst];
+  ConnTracker::Result results[bess::PacketBatch::kMaxBurst];
+  int idx[bess::PacketBatch::kMaxBurst];
+  int n = 0;
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    int len = pkt->head_len() - static_cast<int>(sizeof(*eth));
+
+    if (len < 0 || eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
+      continue;
+    }
+    if (ConnTracker::ParseIpv4(reinterpret_cast<Ipv4 *>(eth + 1), len,
+                               &pkts[n])) {
+      idx[n++] = i;
+    }
+  }
+
+  tracker->Track(pkts, n, ctx->current_ns, results);
+
+  gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
+  for (int i = 0; i < cnt; i++) {
+    out_gates[i] = kUntrackedGate;
+  }
+
+  for (int j = 0; j < n; j++) {
+    if (!results[j].flow) {
+      continue;
+    }
+    bess::Packet *pkt = batch->pkts()[idx[j]];
+    set_attr<uint8_t>(this, dir_attr_id_, pkt, results[j].dir);
+    set_attr<uint8_t>(this, state_attr_id_, pkt, results[j].flow->state);
+    out_gates[idx[j]] = kTrackedGate;
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    w.untracked += (out_gates[i] == kUntrackedGate);
+    EmitPacket(ctx, batch->pkts()[i], out_gates[i]);
+  }
+}
+
+std::string Conntrack::GetDesc() const {
+  size_t flows = 0;
+  for (const PerWorker &w : workers_) {
+    if (w.tracker) {
+      flows += w.tracker->count();
+    }
+  }
+  return bess::utils::Format("%zu flows", flows);
+}
+
+CommandResponse Conntrack::CommandGetSummary(const bess::pb::EmptyArg &) {
+  bess::pb::ConntrackCommandGetSummaryResponse r;
+
+  // Counters are read while workers update them; each one is consistent on
+  // its own, which is all a summary needs.
+  for (const PerWorker &w : workers_) {
+    r.set_untracked(r.untracked() + w.untracked);
+    if (!w.tracker) {
+      continue;
+    }
+    const ConnTracker::Stats &stats = w.tracker->stats();
+    r.set_flows(r.flows() + w.tracker->count());
+    r.set_created(r.created() + stats.created);
+    r.set_expired(r.expired() + stats.expired);
+    r.set_invalid(r.invalid() + stats.invalid);
+    r.set_table_full(r.table_full() + stats.table_full);
+  }
+
+  return CommandSuccess(r);
+}
+
+CommandResponse Conntrack::CommandDump(
+    const bess::pb::ConntrackCommandDumpArg &arg) {
+  bess::pb::ConntrackCommandDumpResponse r;
+  uint64_t max_flows = arg.max_flows() ?: UINT64_MAX;
+  uint64_t now = tsc_to_ns(rdtsc());
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    ConnTracker *tracker = workers_[wid].tracker.get();
+    if (!tracker) {
+      continue;
+    }
+
+    tracker->ForEach([&](const ConnTracker::Flow &flow) {
+      if (static_cast<uint64_t>(r.flows_size()) >= max_flows) {
+        return;
+      }
+      bess::utils::FlowTuple t = flow.tuple(ConnTracker::kOriginal);
+      auto *f = r.add_flows();
+      f->set_wid(wid);
+      f->set_src_ip(ToIpv4Address(t.src_addr));
+      f->set_dst_ip(ToIpv4Address(t.dst_addr));
+      f->set_src_port(t.src_port.value());
+      f->set_dst_port(t.dst_port.value());
+      f->set_proto(t.proto);
+      f->set_state(ConnTracker::StateName(flow.state));
+      f->set_packets_orig(flow.packets[ConnTracker::kOriginal]);
+      f->set_packets_reply(flow.packets[ConnTracker::kReply]);
+      f->set_bytes_orig(flow.bytes[ConnTracker::kOriginal]);
+      f->set_bytes_reply(flow.bytes[ConnTracker::kReply]);
+      f->set_expires_in_ns(flow.deadline > now ? flow.deadline - now : 0);
+    });
+  }
+
+  return CommandSuccess(r);
+}
+
+CommandResponse Conntrack::CommandClear(
+    const bess::pb::ConntrackCommandClearArg &) {
+  for (PerWorker &w : workers_) {
+    if (w.tracker) {
+      w.tracker->Clear();
+    }
+    w.untracked = 0;
+  }
+  return CommandSuccess();
+}
+
+ADD_MODULE(Conntrack, "conntrack", "tracks bidirectional IPv4 connections")
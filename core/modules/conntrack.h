@@ -0,0 +1,83 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_CONNTRACK_H_
+#define BESS_MODULES_CONNTRACK_H_
+
+#include <memory>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/conn_tracker.h"
+
+// Conntrack tracks IPv4 connections with one ConnTracker per worker. Tables
+// are created when a worker is attached, on that worker's NUMA node, and are
+// only ever touched by their worker (or by commands, with workers paused).
+class Conntrack final : public Module {
+ public:
+  static const gate_idx_t kNumOGates = 2;
+
+  static const Commands cmds;
+
+  Conntrack() : Module(), config_(), dir_attr_id_(), state_attr_id_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::ConntrackArg &arg);
+
+  void DeInit() override;
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+  void AddActiveWorker(int wid, const Task *task) override;
+
+  CommandResponse CommandGetSummary(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandDump(const bess::pb::ConntrackCommandDumpArg &arg);
+  CommandResponse CommandClear(const bess::pb::ConntrackCommandClearArg &arg);
+
+ private:
+  static const gate_idx_t kTrackedGate = 0;
+  static const gate_idx_t kUntrackedGate = 1;
+
+  struct alignas(64) PerWorker {
+    std::unique_ptr<bess::utils::ConnTracker> tracker;
+    uint64_t untracked;
+  };
+
+  bess::utils::ConnTracker::Config config_;
+  PerWorker workers_[Worker::kMaxWorkers];
+
+  int dir_attr_id_;
+  int state_attr_id_;
+};
+
+#endif  // BESS_MODULES_CONNTRACK_H_
@@ -0,0 +1,267 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <cstring>
+
+#include "../utils/format.h"
+
+using bess::metadata::Attribute;
+using bess::utils::EbpfContext;
+using bess::utils::EbpfInsn;
+
+const Commands EBPF::cmds = {
+    {"load", "EBPFCommandLoadArg", MODULE_CMD_FUNC(&EBPF::CommandLoad),
+     Command::THREAD_UNSAFE},
+    {"map_lookup", "EBPFCommandMapLookupArg",
+     MODULE_CMD_FUNC(&EBPF::CommandMapLookup), Command::THREAD_SAFE},
+    {"map_update", "EBPFCommandMapUpdateArg",
+     MODULE_CMD_FUNC(&EBPF::CommandMapUpdate), Command::THREAD_SAFE},
+    {"map_delete", "EBPFCommandMapDeleteArg",
+     MODULE_CMD_FUNC(&EBPF::CommandMapDelete), Command::THREAD_SAFE},
+    {"map_dump", "EBPFCommandMapDumpArg",
+     MODULE_CMD_FUNC(&EBPF::CommandMapDump), Command::THREAD_SAFE}};
+
+CommandResponse EBPF::Init(const bess::pb::EBPFArg &arg) {
+  if (arg.attrs_size() > bess::utils::ebpf::kMaxAttrs) {
+    return CommandFailure(EINVAL, "at most %d attributes are supported",
+                          bess::utils::ebpf::kMaxAttrs);
+  }
+
+  for (int i = 0; i < arg.attrs_size(); i++) {
+    const auto &attr = arg.attrs(i);
+    if (attr.size() < 1 || attr.size() > sizeof(uint64_t)) {
+      return CommandFailure(EINVAL, "attribute '%s': size must be 1-8",
+                            attr.name().c_str());
+    }
+
+    int attr_id = AddMetadataAttr(attr.name(), attr.size(),
+                                  attr.writable()
+                                      ? Attribute::AccessMode::kUpdate
+                                      : Attribute::AccessMode::kRead);
+    if (attr_id < 0) {
+      return CommandFailure(-attr_id, "add_metadata_attr() failed");
+    }
+
+    attr_ids_.push_back(attr_id);
+    attr_sizes_.push_back(attr.size());
+    if (attr.writable()) {
+      writable_attrs_ |= 1u << i;
+    }
+  }
+
+  for (const auto &m : arg.maps()) {
+    EbpfMap::Type type;
+    if (m.type() == "array") {
+      type = EbpfMap::kArray;
+    } else if (m.type() == "hash") {
+      type = EbpfMap::kHash;
+    } else {
+      return CommandFailure(EINVAL, "map '%s': unknown type '%s'",
+                            m.name().c_str(), m.type().c_str());
+    }
+
+    if (maps_by_name_.count(m.name())) {
+      return CommandFailure(EEXIST, "duplicate map '%s'", m.name().c_str());
+    }
+
+    std::string err;
+    EbpfMap *map = EbpfMap::Create(type, m.key_size(), m.value_size(),
+                                   m.max_entries(), &err);
+    if (!map) {
+      return CommandFailure(EINVAL, "map '%s': %s", m.name().c_str(),
+                            err.c_str());
+    }
+
+    maps_.emplace_back(map);
+    maps_by_name_[m.name()] = map;
+  }
+
+  return LoadProgram(arg.code(), arg.interpret());
+}
+
+CommandResponse EBPF::LoadProgram(const std::string &code, bool interpret) {
+  if (code.size() % sizeof(EbpfInsn) != 0) {
+    return CommandFailure(EINVAL, "code must be a multiple of %zu bytes",
+                          sizeof(EbpfInsn));
+  }
+
+  std::vector<EbpfInsn> insns(code.size() / sizeof(EbpfInsn));
+  memcpy(insns.data(), code.data(), code.size());
+
+  EbpfProgram::Config config;
+  config.num_attrs = attr_ids_.size();
+  config.writable_attrs = writable_attrs_;
+  for (const auto &map : maps_) {
+    config.maps.push_back(map.get());
+  }
+
+  std::unique_ptr<EbpfProgram> prog(new EbpfProgram());
+  std::string err;
+  if (!prog->Load(insns, config, !interpret, &err)) {
+    return CommandFailure(EINVAL, "cannot load program: %s", err.c_str());
+  }
+
+  prog_ = std::move(prog);
+  return CommandSuccess();
+}
+
+std::string EBPF::GetDesc() const {
+  if (!prog_) {
+    return "";
+  }
+  return bess::utils::Format("%zu insns%s, %zu maps", prog_->num_insns(),
+                             prog_->jitted() ? " (JIT)" : "", maps_.size());
+}
+
+EbpfMap *EBPF::FindMap(const std::string &name) const {
+  auto it = maps_by_name_.find(name);
+  return (it != maps_by_name_.end()) ? it->second : nullptr;
+}
+
+CommandResponse EBPF::CommandLoad(const bess::pb::EBPFCommandLoadArg &arg) {
+  return LoadProgram(arg.code(), arg.interpret());
+}
+
+CommandResponse EBPF::CommandMapLookup(
+    const bess::pb::EBPFCommandMapLookupArg &arg) {
+  EbpfMap *map = FindMap(arg.map());
+  if (!map) {
+    return CommandFailure(ENOENT, "no map '%s'", arg.map().c_str());
+  }
+  if (arg.key().size() != map->key_size()) {
+    return CommandFailure(EINVAL, "key must be %u bytes", map->key_size());
+  }
+
+  const void *value = map->Lookup(arg.key().data());
+  if (!value) {
+    return CommandFailure(ENOENT, "key not found");
+  }
+
+  bess::pb::EBPFCommandMapLookupResponse r;
+  r.set_value(value, map->value_size());
+  return CommandSuccess(r);
+}
+
+CommandResponse EBPF::CommandMapUpdate(
+    const bess::pb::EBPFCommandMapUpdateArg &arg) {
+  EbpfMap *map = FindMap(arg.map());
+  if (!map) {
+    return CommandFailure(ENOENT, "no map '%s'", arg.map().c_str());
+  }
+  if (arg.key().size() != map->key_size()) {
+    return CommandFailure(EINVAL, "key must be %u bytes", map->key_size());
+  }
+  if (arg.value().size() != map->value_size()) {
+    return CommandFailure(EINVAL, "value must be %u bytes",
+                          map->value_size());
+  }
+
+  int ret = map->Update(arg.key().data(), arg.value().data(), arg.flags());
+  if (ret < 0) {
+    return CommandFailure(-ret, "map update failed");
+  }
+  return CommandSuccess();
+}
+
+CommandResponse EBPF::CommandMapDelete(
+    const bess::pb::EBPFCommandMapDeleteArg &arg) {
+  EbpfMap *map = FindMap(arg.map());
+  if (!map) {
+    return CommandFailure(ENOENT, "no map '%s'", arg.map().c_str());
+  }
+  if (arg.key().size() != map->key_size()) {
+    return CommandFailure(EINVAL, "key must be %u bytes", map->key_size());
+  }
+
+  int ret = map->Delete(arg.key().data());
+  if (ret < 0) {
+    return CommandFailure(-ret, "map delete failed");
+  }
+  return CommandSuccess();
+}
+
+CommandResponse EBPF::CommandMapDump(
+    const bess::pb::EBPFCommandMapDumpArg &arg) {
+  EbpfMap *map = FindMap(arg.map());
+  if (!map) {
+    return CommandFailure(ENOENT, "no map '%s'", arg.map().c_str());
+  }
+
+  bess::pb::EBPFCommandMapDumpResponse r;
+  map->ForEach([&r, map](const void *key, const void *value) {
+    auto *entry = r.add_entries();
+    entry->set_key(key, map->key_size());
+    entry->set_value(value, map->value_size());
+  });
+  return CommandSuccess(r);
+}
+
+void EBPF::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  const EbpfProgram *prog = prog_.get();
+  size_t num_attrs = attr_ids_.size();
+  EbpfContext prog_ctx;
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    prog_ctx.pkt_len = pkt->total_len();
+    prog_ctx.data_len = pkt->head_len();
+    prog_ctx.data = pkt->head_data<const uint8_t *>();
+
+    for (size_t j = 0; j < num_attrs; j++) {
+      const uint8_t *p =
+          ptr_attr_with_offset<uint8_t>(attr_offset(attr_ids_[j]), pkt);
+      prog_ctx.attrs[j] = 0;
+      if (p) {
+        memcpy(&prog_ctx.attrs[j], p, attr_sizes_[j]);
+      }
+    }
+
+    uint64_t ret = prog->Run(&prog_ctx);
+
+    for (size_t j = 0; j < num_attrs; j++) {
+      if (writable_attrs_ & (1u << j)) {
+        uint8_t *p =
+            ptr_attr_with_offset<uint8_t>(attr_offset(attr_ids_[j]), pkt);
+        if (p) {
+          memcpy(p, &prog_ctx.attrs[j], attr_sizes_[j]);
+        }
+      }
+    }
+
+    // Anything that is not a valid gate index drops the packet
+    EmitPacket(ctx, pkt, (ret < MAX_GATES) ? ret : DROP_GATE);
+  }
+}
+
+ADD_MODULE(EBPF, "ebpf", "runs an eBPF program to classify packets")
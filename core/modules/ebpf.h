@@ -0,0 +1,92 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_EBPF_H_
+#define BESS_MODULES_EBPF_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/ebpf.h"
+
+using bess::utils::EbpfMap;
+using bess::utils::EbpfProgram;
+
+// EBPF runs a verified eBPF program on every packet and sends the packet out
+// the gate the program returns. Programs see the packet through LD_ABS/LD_IND
+// and a context holding the packet length and the configured metadata
+// attributes, and can keep state in maps that the control plane can also
+// read and write.
+class EBPF final : public Module {
+ public:
+  static const gate_idx_t kNumOGates = MAX_GATES;
+
+  static const Commands cmds;
+
+  EBPF() : Module(), writable_attrs_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::EBPFArg &arg);
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+  CommandResponse CommandLoad(const bess::pb::EBPFCommandLoadArg &arg);
+  CommandResponse CommandMapLookup(
+      const bess::pb::EBPFCommandMapLookupArg &arg);
+  CommandResponse CommandMapUpdate(
+      const bess::pb::EBPFCommandMapUpdateArg &arg);
+  CommandResponse CommandMapDelete(
+      const bess::pb::EBPFCommandMapDeleteArg &arg);
+  CommandResponse CommandMapDump(const bess::pb::EBPFCommandMapDumpArg &arg);
+
+ private:
+  CommandResponse LoadProgram(const std::string &code, bool interpret);
+
+  // Returns the map with the given name, or nullptr
+  EbpfMap *FindMap(const std::string &name) const;
+
+  std::unique_ptr<EbpfProgram> prog_;
+
+  std::vector<std::unique_ptr<EbpfMap>> maps_;  // in the order of EBPFArg
+  std::map<std::string, EbpfMap *> maps_by_name_;
+
+  std::vector<int> attr_ids_;    // for EbpfContext::attrs
+  std::vector<size_t> attr_sizes_;
+  uint32_t writable_attrs_;     // bitmask over attr_ids_
+};
+
+#endif  // BESS_MODULES_EBPF_H_
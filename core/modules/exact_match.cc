@@ -30,6 +30,7 @@
 
 #include "exact_match.h"
 
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -252,6 +253,7 @@ CommandResponse ExactMatch::SetRuntimeConfig(
     const bess::pb::ExactMatchConfig &arg) {
   default_gate_ = arg.default_gate();
   table_.ClearRules();
+  table_.Reserve(arg.rules_size());
 
   for (auto i = 0; i < arg.rules_size(); i++) {
     Error ret = AddRule(arg.rules(i));
@@ -345,6 +347,14 @@ std::string ExactMatch::GetDesc() const {
                              table_.Size());
 }
 
+void ExactMatch::OnSocketChange() {
+  int ret = table_.MoveToSocket(socket());
+  if (ret) {
+    LOG(WARNING) << name() << ": failed to move rule table to socket "
+                 << socket() << ": " << strerror(-ret);
+  }
+}
+
 void ExactMatch::RuleFieldsFromPb(
     const RepeatedPtrField<bess::pb::FieldData> &fields,
     bess::utils::ExactMatchRuleFields *rule, Type type) {
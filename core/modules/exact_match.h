@@ -101,6 +101,8 @@ class ExactMatch final : public Module {
       const bess::pb::ExactMatchCommandSetDefaultGateArg &arg);
 
  private:
+  void OnSocketChange() override;
+
   CommandResponse AddFieldOne(const bess::pb::Field &field,
                               const bess::pb::FieldData &mask, int idx, Type t);
   void RuleFieldsFromPb(const RepeatedPtrField<bess::pb::FieldData> &fields,
@@ -9,6 +9,7 @@
 #include <rte_jhash.h>
 
 #include "../core/utils/common.h"
+#include "../core/utils/numa.h"
 
 /*----------------------------------------------------------------------------------*/
 const Commands FlowMeasure::cmds = {
@@ -80,6 +81,7 @@ CommandResponse FlowMeasure::Init(const bess::pb::FlowMeasureArg &arg) {
   std::vector<SessionStats> tmp_b(hash_params.entries);
   table_data_a_.swap(tmp_a);
   table_data_b_.swap(tmp_b);
+  table_socket_ = hash_params.socket_id;
   VLOG(1) << name() << ": Tables created successfully.";
 
   return CommandSuccess();
@@ -275,6 +277,128 @@ CommandResponse FlowMeasure::CommandFlipFlag(
   return CommandSuccess(resp);
 }
 
+// Exports the latency and jitter of all sessions in both buffers, merged into
+// one histogram each. They shrink when the controller reads and clears a
+// buffer, which Prometheus handles as a counter reset.
+void FlowMeasure::CollectMetrics(bess::utils::OpenMetricsWriter *w) const {
+  const size_t num_buckets = SessionStats::kNumBuckets + 1;
+  std::vector<uint64_t> latency(num_buckets);
+  std::vector<uint64_t> jitter(num_buckets);
+  uint64_t sessions = 0;
+
+  const std::pair<rte_hash *, const std::vector<SessionStats> *> tables[] = {
+      {table_a_, &table_data_a_}, {table_b_, &table_data_b_}};
+  for (const auto &table : tables) {
+    if (!table.first) {
+      continue;
+    }
+    const void *key = nullptr;
+    void *data = nullptr;
+    uint32_t next = 0;
+    int32_t ret;
+    while (ret = rte_hash_iterate(table.first, &key, &data, &next), ret >= 0) {
+      const SessionStats &stat = table.second->at(ret);
+      const std::lock_guard<std::mutex> lock(stat.mutex);
+      for (size_t i = 0; i < num_buckets; i++) {
+        latency[i] += stat.latency_histogram.bucket(i);
+        jitter[i] += stat.jitter_histogram.bucket(i);
+      }
+      sessions++;
+    }
+  }
+
+  bess::utils::OpenMetricsWriter::Labels labels = {{"module", name()}};
+  w->Gauge("bess_flow_measure_sessions", "Sessions tracked by FlowMeasure",
+           labels, sessions);
+
+  // Bucket i counts [i, i + 1) * width; its representative value, as in
+  // Histogram::Summarize(), is i * width. The last one is above the range.
+  auto add = [&](const char *metric, const char *help,
+                 const std::vector<uint64_t> &buckets) {
+    const double width = SessionStats::kBucketWidthNs / 1e9;
+    bess::utils::OpenMetricsWriter::Buckets om_buckets;
+    uint64_t count = 0;
+    double sum = 0;
+    for (size_t i = 0; i < num_buckets; i++) {
+      if (i + 1 < num_buckets) {
+        om_buckets.emplace_back((i + 1) * width, buckets[i]);
+      }
+      count += buckets[i];
+      sum += i * width * buckets[i];
+    }
+    w->Histogram(metric, help, labels, om_buckets, sum, count);
+  };
+  add("bess_flow_measure_latency_seconds", "Packet latency seen by FlowMeasure",
+      latency);
+  add("bess_flow_measure_jitter_seconds", "Packet jitter seen by FlowMeasure",
+      jitter);
+}
+
+int FlowMeasure::MoveTable(const std::string &hash_name, rte_hash **table,
+                           std::vector<SessionStats> *data) {
+  rte_hash_parameters hash_params = {};
+  hash_params.name = hash_name.c_str();
+  hash_params.entries = data->size();
+  hash_params.key_len = sizeof(TableKey);
+  hash_params.hash_func = rte_jhash;
+  hash_params.socket_id = socket();
+  hash_params.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY;
+
+  rte_hash *new_table = rte_hash_create(&hash_params);
+  if (!new_table) {
+    return -rte_errno;
+  }
+
+  // Fresh pages for the stats (and their histograms) come from `socket()`.
+  // Live sessions keep their histogram buckets, which are swapped, not copied.
+  bess::utils::ScopedNodePreference numa(socket());
+  std::vector<SessionStats> new_data(data->size());
+
+  const void *key = nullptr;
+  void *unused = nullptr;
+  uint32_t next = 0;
+  int32_t old_pos;
+  while (old_pos = rte_hash_iterate(*table, &key, &unused, &next),
+         old_pos >= 0) {
+    int32_t new_pos = rte_hash_add_key(new_table, key);
+    if (new_pos < 0) {
+      rte_hash_free(new_table);
+      return new_pos;
+    }
+    SessionStats &src = data->at(old_pos);
+    SessionStats &dst = new_data[new_pos];
+    dst.pkt_count = src.pkt_count;
+    dst.byte_count = src.byte_count;
+    dst.last_latency = src.last_latency;
+    dst.latency_histogram.swap(src.latency_histogram);
+    dst.jitter_histogram.swap(src.jitter_histogram);
+  }
+
+  rte_hash_free(*table);
+  *table = new_table;
+  data->swap(new_data);
+  return 0;
+}
+
+void FlowMeasure::OnSocketChange() {
+  if (!table_a_ || !table_b_ || socket() == table_socket_) {
+    return;
+  }
+
+  std::string suffix = std::to_string(socket());
+  int ret = MoveTable(name() + "Ta" + suffix, &table_a_, &table_data_a_);
+  if (ret == 0) {
+    ret = MoveTable(name() + "Tb" + suffix, &table_b_, &table_data_b_);
+  }
+  if (ret) {
+    LOG(WARNING) << name() << ": failed to move tables to socket " << socket()
+                 << ": " << rte_strerror(-ret);
+    return;
+  }
+
+  table_socket_ = socket();
+}
+
 void FlowMeasure::DeInit() {
   rte_hash_free(table_a_);
   rte_hash_free(table_b_);
@@ -20,6 +20,7 @@ class FlowMeasure final : public Module {
         current_flag_value_(),
         table_a_(nullptr),
         table_b_(nullptr),
+        table_socket_(-1),
         ts_attr_id_(-1),
         fseid_attr_id_(-1),
         pdr_attr_id_(-1) {
@@ -33,12 +34,15 @@ class FlowMeasure final : public Module {
   void DeInit() override;
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
   std::string GetDesc() const override { return ""; };
+  void CollectMetrics(bess::utils::OpenMetricsWriter *w) const override;
   CommandResponse CommandReadStats(
       const bess::pb::FlowMeasureCommandReadArg &arg);
   CommandResponse CommandFlipFlag(
       const bess::pb::FlowMeasureCommandFlipArg &arg);
 
  private:
+  void OnSocketChange() override;
+
   // Flag represents a collection of possible values to select buffer sides.
   enum class Flag {
     FLAG_VALUE_INVALID = 0,
@@ -112,6 +116,12 @@ class FlowMeasure final : public Module {
       jitter_histogram.Reset();
     }
   };
+  // Recreates `*table` as `hash_name` on `socket()` and rebuilds `*data`
+  // there, carrying over all sessions. Returns 0 on success, -errno on
+  // failure with the old table left in place.
+  int MoveTable(const std::string &hash_name, rte_hash **table,
+                std::vector<SessionStats> *data);
+
   bool leader_;
   Flag current_flag_value_;  // protected by flag_mutex_
   mutable std::mutex flag_mutex_;
@@ -119,6 +129,7 @@ class FlowMeasure final : public Module {
   rte_hash *table_b_;
   std::vector<SessionStats> table_data_a_;
   std::vector<SessionStats> table_data_b_;
+  int table_socket_;  // NUMA node the hash tables were created on
   int ts_attr_id_;
   int fseid_attr_id_;
   int pdr_attr_id_;
@@ -21,6 +21,8 @@
 /* for GetDesc() */
 #include "utils/format.h"
 #include <rte_jhash.h>
+/* for std::min() */
+#include <algorithm>
 /*----------------------------------------------------------------------------------*/
 using bess::utils::Ethernet;
 using bess::utils::Gtpv1;
@@ -31,6 +33,9 @@ void GtpuDecap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 	int cnt = batch->cnt();//read a packet from batch
 	for (int i = 0; i < cnt; i++) {
 		bess::Packet *p = batch->pkts()[i]; //caulate gtpu offset
+		/* Headers may straddle segments for scattered (e.g., jumbo) frames
+		 */
+		p->Pullup(std::min(p->total_len(), GTPU_MAX_HEADER_LEN));
 		/* Trim iph->ihl<<2 + sizeof(Udp) + size of Gtpv1 header
 		 */
 		Ethernet *eth = p->head_data<Ethernet *>();
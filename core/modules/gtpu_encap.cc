@@ -69,7 +69,7 @@ struct [[gnu::packed]] PacketTemplate {
     iph.header_length = (sizeof(Ipv4) >> 2);
     iph.type_of_service = 0;
     iph.length = (be16_t)0;  // to fill in
-    iph.id = (be16_t)0x513;
+    iph.id = (be16_t)0;  // to fill in
     iph.fragment_offset = (be16_t)0;
     iph.ttl = 64;
     iph.protocol = IPPROTO_UDP;
@@ -120,25 +120,32 @@ void GtpuEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
                << ", tunnel out teid: " << at_tout_teid
                << ", tunnel out udp port: " << at_tout_uport << std::endl;
 
-    uint16_t pkt_len = p->total_len() - sizeof(Ethernet);
-    Ethernet *eth = p->head_data<Ethernet *>();
-
-    /* pre-allocate space for encaped header(s) */
-    char *new_p = static_cast<char *>(p->prepend(encap_size));
-    if (new_p == NULL) {
-      /* failed to prepend header space for encaped packet */
+    uint32_t pkt_len = p->total_len() - sizeof(Ethernet);
+    if (unlikely(pkt_len + encap_size > UINT16_MAX)) {
+      /* outer IP length would overflow (e.g., LRO-merged packet) */
       EmitPacket(ctx, p, DEFAULT_GATE);
-      DLOG(INFO) << "prepend() failed!" << std::endl;
       continue;
     }
 
-    /* setting Ethernet header */
-    memcpy(new_p, eth, sizeof(Ethernet));
+    /* inner Ethernet header is dropped; outer one is added downstream */
+    p->adj(sizeof(Ethernet));
+
+    /* pre-allocate space for encaped header(s). If the headroom runs out,
+     * a new segment is linked in front of the packet to hold them */
+    bess::Packet *head = bess::Packet::PrependSegment(p, encap_size);
+    if (head == nullptr) {
+      /* failed to allocate header space for encaped packet */
+      p->prepend(sizeof(Ethernet));
+      EmitPacket(ctx, p, DEFAULT_GATE);
+      DLOG(INFO) << "PrependSegment() failed!" << std::endl;
+      continue;
+    }
+    p = head;
 
     /* get pointers to header offsets */
-    Ipv4 *iph = (Ipv4 *)(new_p + sizeof(Ethernet));
+    Ipv4 *iph = p->head_data<Ipv4 *>();
 
-    Udp *udph = (Udp *)(new_p + sizeof(Ethernet) + sizeof(Ipv4));
+    Udp *udph = (Udp *)((uint8_t *)iph + sizeof(Ipv4));
 
     Gtpv1 *gtph = (Gtpv1 *)((uint8_t *)iph + offsetof(PacketTemplate, gtph));
 
@@ -171,11 +178,10 @@ void GtpuEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
     /* setting outer IP header */
     iph->length = (be16_t)(iplen);
+    iph->id = (be16_t)(ip_ids_[ctx->wid].next++);
     iph->src = (be32_t)(at_tout_sip);
     iph->dst = (be32_t)(at_tout_dip);
 
-    p->adj(sizeof(*eth));
-
     EmitPacket(ctx, p, FORWARD_GATE);
   }
 }
@@ -23,7 +23,14 @@
 /*----------------------------------------------------------------------------------*/
 class GtpuEncap final : public Module {
  public:
-  GtpuEncap() { max_allowed_workers_ = Worker::kMaxWorkers; }
+  GtpuEncap() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+    // Workers start 1024 IDs apart, so that they do not reuse each other's
+    // IDs for the same tunnel endpoints until one has sent 1024 more packets.
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      ip_ids_[wid].next = wid << 10;
+    }
+  }
 
   /* Gates: (0) Default, (1) Forward */
   static const gate_idx_t kNumOGates = 2;
@@ -40,6 +47,14 @@ class GtpuEncap final : public Module {
   int tout_dip_attr = -1;
   int tout_teid = -1;
   int tout_uport = -1;
+
+  // Outer IPv4 IDs, per worker. Outer packets may be fragmented downstream
+  // (e.g., by IPFrag), and fragments of different datagrams must not share
+  // an ID.
+  struct alignas(64) IpId {
+    uint16_t next;
+  };
+  IpId ip_ids_[Worker::kMaxWorkers];
 };
 /*----------------------------------------------------------------------------------*/
 #endif  // BESS_MODULES_GTPUENCAP_H_
\ No newline at end of file
@@ -14,6 +14,8 @@
 #include "utils/tcp.h"
 /* for gtp header */
 #include "utils/gtp.h"
+/* for std::min() */
+#include <algorithm>
 /*----------------------------------------------------------------------------------*/
 using bess::utils::Ethernet;
 using bess::utils::Gtpv1;
@@ -54,6 +56,8 @@ void GtpuParser::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *p = batch->pkts()[i];
+    /* make sure all headers we look at are in the first segment */
+    p->Pullup(std::min(p->total_len(), GTPU_MAX_HEADER_LEN));
     eth = p->head_data<Ethernet *>();
     if (eth->ether_type != (be16_t)(Ethernet::kIpv4) &&
         eth->ether_type != (be16_t)(Ethernet::kArp)) {
@@ -0,0 +1,112 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ip_defrag.h"
+
+#include <rte_errno.h>
+
+#include "../utils/checksum.h"
+#include "../utils/ether.h"
+#include "../utils/ip.h"
+#include "../utils/time.h"
+
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::be16_t;
+
+// Number of fragments to prefetch ahead when freeing the death row
+static const uint32_t kDeathRowPrefetch = 3;
+
+CommandResponse IPDefrag::Init(const bess::pb::IPDefragArg &arg) {
+  uint32_t num_flows = arg.num_flows() ?: kDefaultNumFlows;
+  uint32_t ttl_ms = arg.flow_ttl_ms() ?: kDefaultFlowTtlMs;
+  uint64_t ttl_cycles = tsc_hz / 1000 * ttl_ms;
+
+  if (arg.numa() < 0 || arg.numa() >= RTE_MAX_NUMA_NODES) {
+    return CommandFailure(EINVAL, "Invalid 'numa': %d", arg.numa());
+  }
+
+  tbl_ = rte_ip_frag_table_create(num_flows, IP_FRAG_TBL_BUCKET_ENTRIES,
+                                  num_flows, ttl_cycles, arg.numa());
+  if (!tbl_) {
+    return CommandFailure(rte_errno, "DPDK error: %s", rte_strerror(rte_errno));
+  }
+
+  return CommandSuccess();
+}
+
+void IPDefrag::DeInit() {
+  if (tbl_) {
+    rte_ip_frag_table_destroy(tbl_);
+    tbl_ = nullptr;
+  }
+  rte_ip_frag_free_death_row(&death_row_, 0);
+}
+
+void IPDefrag::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+  uint64_t now = rdtsc();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+
+    if (eth->ether_type != be16_t(Ethernet::Type::kIpv4) ||
+        likely(!rte_ipv4_frag_pkt_is_fragmented(
+            reinterpret_cast<struct rte_ipv4_hdr *>(ip)))) {
+      EmitPacket(ctx, pkt);
+      continue;
+    }
+
+    struct rte_mbuf *m = reinterpret_cast<struct rte_mbuf *>(pkt);
+    m->l2_len = sizeof(*eth);
+    m->l3_len = ip->header_length << 2;
+
+    // Returns the reassembled datagram once the last missing fragment
+    // arrives; until then the fragment is held in the table.
+    struct rte_mbuf *mo = rte_ipv4_frag_reassemble_packet(
+        tbl_, &death_row_, m, now, reinterpret_cast<struct rte_ipv4_hdr *>(ip));
+    if (!mo) {
+      continue;
+    }
+
+    pkt = reinterpret_cast<bess::Packet *>(mo);
+    ip = reinterpret_cast<Ipv4 *>(pkt->head_data<Ethernet *>() + 1);
+    ip->checksum = bess::utils::CalculateIpv4Checksum(*ip);
+
+    EmitPacket(ctx, pkt);
+  }
+
+  // Frees fragments of expired or evicted datagrams
+  rte_ip_frag_free_death_row(&death_row_, kDeathRowPrefetch);
+}
+
+ADD_MODULE(IPDefrag, "ip_defrag", "reassembles fragmented IPv4 datagrams")
@@ -0,0 +1,65 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_IP_DEFRAG_H_
+#define BESS_MODULES_IP_DEFRAG_H_
+
+#include <rte_ip_frag.h>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+
+// Reassembles fragmented IPv4 datagrams, e.g., GTP-U packets fragmented by a
+// gNB, so that downstream modules see complete headers. Fragments are held in
+// a bounded table until the datagram is complete or its time limit expires;
+// expired or evicted fragments are dropped. Reassembled datagrams are emitted
+// as chained packets, without copying the payload.
+// The fragment table is not thread-safe, so the module runs on one worker.
+class IPDefrag final : public Module {
+ public:
+  static const uint32_t kDefaultNumFlows = 4096;
+  static const uint32_t kDefaultFlowTtlMs = 1000;
+
+  IPDefrag() : Module(), tbl_(), death_row_() {}
+
+  CommandResponse Init(const bess::pb::IPDefragArg &arg);
+
+  void DeInit() override;
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  struct rte_ip_frag_tbl *tbl_;
+
+  // Fragments to be freed at the end of the current batch
+  struct rte_ip_frag_death_row death_row_;
+};
+
+#endif  // BESS_MODULES_IP_DEFRAG_H_
@@ -0,0 +1,123 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ip_frag.h"
+
+#include <rte_ip_frag.h>
+
+#include "../utils/checksum.h"
+#include "../utils/ether.h"
+#include "../utils/ip.h"
+
+using bess::utils::Ethernet;
+using bess::utils::Ipv4;
+using bess::utils::be16_t;
+
+CommandResponse IPFrag::Init(const bess::pb::IPFragArg &arg) {
+  // The configured MTU is the full Ethernet frame size, including CRC.
+  int32_t min_mtu = sizeof(Ethernet) + RTE_ETHER_CRC_LEN + RTE_ETHER_MIN_MTU;
+  if (arg.mtu() < min_mtu || arg.mtu() > UINT16_MAX) {
+    return CommandFailure(EINVAL, "'mtu' must be in [%d, %d]", min_mtu,
+                          UINT16_MAX);
+  }
+
+  ip_mtu_ = arg.mtu() - sizeof(Ethernet) - RTE_ETHER_CRC_LEN;
+
+  return CommandSuccess();
+}
+
+void IPFrag::Fragment(Context *ctx, bess::Packet *pkt) {
+  Ethernet eth = *pkt->head_data<Ethernet *>();
+  Ipv4 *ip = reinterpret_cast<Ipv4 *>(pkt->head_data<Ethernet *>() + 1);
+
+  if (ip->fragment_offset & be16_t(Ipv4::Flag::kDF)) {
+    DropPacket(ctx, pkt);
+    return;
+  }
+
+  // Payload of each fragment must be a multiple of 8 bytes.
+  uint16_t ip_hdr_len = ip->header_length << 2;
+  uint16_t frag_mtu = ip_hdr_len + ((ip_mtu_ - ip_hdr_len) & ~7);
+
+  // DPDK expects the IP header at the beginning of the packet.
+  pkt->adj(sizeof(Ethernet));
+
+  struct rte_mempool *pool = current_worker.packet_pool()->pool();
+  bess::Packet *frags[kMaxFragments];
+  int32_t cnt = rte_ipv4_fragment_packet(
+      reinterpret_cast<struct rte_mbuf *>(pkt),
+      reinterpret_cast<struct rte_mbuf **>(frags), kMaxFragments, frag_mtu,
+      pool, pool);
+
+  if (cnt < 0) {
+    DropPacket(ctx, pkt);
+    return;
+  }
+
+  for (int32_t i = 0; i < cnt; i++) {
+    bess::Packet *frag = frags[i];
+
+    // Each fragment starts with a freshly allocated header segment.
+    frag->copy_metadata(pkt);
+
+    Ipv4 *frag_ip = frag->head_data<Ipv4 *>();
+    frag_ip->checksum = bess::utils::CalculateIpv4Checksum(*frag_ip);
+
+    Ethernet *frag_eth = static_cast<Ethernet *>(frag->prepend(sizeof(eth)));
+    *frag_eth = eth;
+
+    EmitPacket(ctx, frag);
+  }
+
+  // Fragments hold their own references to the payload.
+  bess::Packet::Free(pkt);
+}
+
+void IPFrag::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+
+    // Runt frames are passed on as they are; they need no fragmenting, and
+    // their length would underflow below.
+    if (unlikely(pkt->total_len() < sizeof(Ethernet) + sizeof(Ipv4)) ||
+        likely(pkt->total_len() - sizeof(*eth) <= ip_mtu_) ||
+        eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
+      EmitPacket(ctx, pkt);
+      continue;
+    }
+
+    Fragment(ctx, pkt);
+  }
+}
+
+ADD_MODULE(IPFrag, "ip_frag", "fragments IPv4 datagrams larger than the MTU")
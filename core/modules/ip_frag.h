@@ -0,0 +1,61 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_IP_FRAG_H_
+#define BESS_MODULES_IP_FRAG_H_
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+
+// Fragments IPv4 datagrams that do not fit in the configured MTU, e.g., after
+// GTP-U encapsulation. Fragments reference the payload of the original packet
+// through indirect mbufs, so the payload is never copied; only a new header
+// segment is allocated per fragment.
+// Oversized datagrams with the DF bit set are dropped.
+class IPFrag final : public Module {
+ public:
+  // Upper bound on the number of fragments per datagram
+  static const int kMaxFragments = bess::PacketBatch::kMaxBurst;
+
+  IPFrag() : Module(), ip_mtu_() { max_allowed_workers_ = Worker::kMaxWorkers; }
+
+  CommandResponse Init(const bess::pb::IPFragArg &arg);
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  // Fragments pkt (which is freed) and emits the fragments.
+  void Fragment(Context *ctx, bess::Packet *pkt);
+
+  // Largest IP datagram (header included) that is sent unfragmented
+  uint16_t ip_mtu_;
+};
+
+#endif  // BESS_MODULES_IP_FRAG_H_
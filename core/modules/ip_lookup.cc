@@ -27,12 +27,15 @@
 // CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
-
 #include "ip_lookup.h"
 
 #include <rte_config.h>
 #include <rte_errno.h>
 #include <rte_lpm.h>
+#include <rte_lpm6.h>
+
+#include <fstream>
+#include <sstream>
 
 #include "../utils/bits.h"
 #include "../utils/ether.h"
@@ -47,107 +50,122 @@ static inline int is_valid_gate(gate_idx_t gate) {
 
 const Commands IPLookup::cmds = {
     {"add", "IPLookupCommandAddArg", MODULE_CMD_FUNC(&IPLookup::CommandAdd),
-     Command::THREAD_UNSAFE},
-    {"delete", "IPLookupCommandDeleteArg", MODULE_CMD_FUNC(&IPLookup::CommandDelete),
-     Command::THREAD_UNSAFE},
+     Command::THREAD_SAFE},
+    {"delete", "IPLookupCommandDeleteArg",
+     MODULE_CMD_FUNC(&IPLookup::CommandDelete), Command::THREAD_SAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&IPLookup::CommandClear),
-     Command::THREAD_UNSAFE}};
+     Command::THREAD_SAFE},
+    {"load", "IPLookupCommandLoadArg", MODULE_CMD_FUNC(&IPLookup::CommandLoad),
+     Command::THREAD_SAFE},
+    {"get_runtime_config", "EmptyArg",
+     MODULE_CMD_FUNC(&IPLookup::GetRuntimeConfig), Command::THREAD_SAFE},
+    {"set_runtime_config", "IPLookupConfig",
+     MODULE_CMD_FUNC(&IPLookup::SetRuntimeConfig), Command::THREAD_SAFE}};
 
 CommandResponse IPLookup::Init(const bess::pb::IPLookupArg &arg) {
-  struct rte_lpm_config conf = {
-      .max_rules = arg.max_rules() ? arg.max_rules() : 1024,
-      .number_tbl8s = arg.max_tbl8s() ? arg.max_tbl8s() : 128,
-      .flags = 0,
-  };
+  conf_.max_rules = arg.max_rules() ? arg.max_rules() : 1024;
+  conf_.max_tbl8s = arg.max_tbl8s() ? arg.max_tbl8s() : 128;
+  conf_.ipv6 = arg.ipv6();
+  conf_.max_rules6 = arg.max_rules6() ? arg.max_rules6() : 1024;
+  conf_.max_tbl8s6 = arg.max_tbl8s6() ? arg.max_tbl8s6() : 1024;
 
   default_gate_ = DROP_GATE;
 
-  lpm_ = rte_lpm_create(name().c_str(), /* socket_id = */ 0, &conf);
-
-  if (!lpm_) {
-    return CommandFailure(rte_errno, "DPDK error: %s", rte_strerror(rte_errno));
+  // No worker is attached yet, so socket() is usually -1 (any node) here.
+  // OnSocketChange() re-homes the tables once the placement is known.
+  for (Fib &fib : fibs_) {
+    int ret = CreateFib(socket(), &fib);
+    if (ret) {
+      DeInit();
+      return CommandFailure(-ret, "DPDK error: %s", rte_strerror(-ret));
+    }
   }
+  active_ = &fibs_[0];
 
   return CommandSuccess();
 }
 
 void IPLookup::DeInit() {
-  if (lpm_) {
-    rte_lpm_free(lpm_);
+  for (Fib &fib : fibs_) {
+    FreeFib(&fib);
   }
 }
 
+std::string IPLookup::GetDesc() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num_routes6 = 0;
+  for (const auto &it : routes_) {
+    num_routes6 += it.first.v6;
+  }
+  return bess::utils::Format("%zu IPv4 + %zu IPv6 routes",
+                             routes_.size() - num_routes6, num_routes6);
+}
+
 void IPLookup::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   using bess::utils::Ethernet;
   using bess::utils::Ipv4;
+  using bess::utils::Ipv6;
+  using bess::utils::be16_t;
 
-  gate_idx_t default_gate = default_gate_;
+  Fib *fib = active_.load(std::memory_order_acquire);
+  gate_idx_t default_gate = fib->default_gate;
 
   int cnt = batch->cnt();
-  int i;
+  gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
+
+  // IPv4 destinations (host order) are gathered so that they can be looked
+  // up four at a time.
+  uint32_t addrs[bess::PacketBatch::kMaxBurst];
+  int idx[bess::PacketBatch::kMaxBurst];
+  int n = 0;
+
+  for (int i = 0; i < cnt; i++) {
+    Ethernet *eth = batch->pkts()[i]->head_data<Ethernet *>();
+
+    out_gates[i] = default_gate;
+
+    if (eth->ether_type == be16_t(Ethernet::Type::kIpv4)) {
+      Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+      addrs[n] = ip->dst.value();
+      idx[n++] = i;
+    } else if (eth->ether_type == be16_t(Ethernet::Type::kIpv6) && fib->lpm6) {
+      Ipv6 *ip = reinterpret_cast<Ipv6 *>(eth + 1);
+      uint32_t next_hop;
+      if (rte_lpm6_lookup(fib->lpm6, ip->dst, &next_hop) == 0) {
+        out_gates[i] = next_hop;
+      }
+    }
+  }
 
-#if VECTOR_OPTIMIZATION
-  // Convert endianness for four addresses at the same time
-  const __m128i bswap_mask =
-      _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  int j = 0;
 
+#if VECTOR_OPTIMIZATION
   /* 4 at a time */
-  for (i = 0; i + 3 < cnt; i += 4) {
-    Ethernet *eth;
-    Ipv4 *ip;
-
-    uint32_t a0, a1, a2, a3;
+  for (; j + 3 < n; j += 4) {
     uint32_t next_hops[4];
+    __m128i ip_addr =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&addrs[j]));
 
-    __m128i ip_addr;
-
-    eth = batch->pkts()[i]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a0 = ip->dst.raw_value();
-
-    eth = batch->pkts()[i + 1]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a1 = ip->dst.raw_value();
-
-    eth = batch->pkts()[i + 2]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a2 = ip->dst.raw_value();
+    rte_lpm_lookupx4(fib->lpm, ip_addr, next_hops, default_gate);
 
-    eth = batch->pkts()[i + 3]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-    a3 = ip->dst.raw_value();
-
-    ip_addr = _mm_set_epi32(a3, a2, a1, a0);
-    ip_addr = _mm_shuffle_epi8(ip_addr, bswap_mask);
-
-    rte_lpm_lookupx4(lpm_, ip_addr, next_hops, default_gate);
-
-    EmitPacket(ctx, batch->pkts()[i], next_hops[0]);
-    EmitPacket(ctx, batch->pkts()[i + 1], next_hops[1]);
-    EmitPacket(ctx, batch->pkts()[i + 2], next_hops[2]);
-    EmitPacket(ctx, batch->pkts()[i + 3], next_hops[3]);
+    out_gates[idx[j]] = next_hops[0];
+    out_gates[idx[j + 1]] = next_hops[1];
+    out_gates[idx[j + 2]] = next_hops[2];
+    out_gates[idx[j + 3]] = next_hops[3];
   }
 #endif
 
   /* process the rest one by one */
-  for (; i < cnt; i++) {
-    Ethernet *eth;
-    Ipv4 *ip;
-
+  for (; j < n; j++) {
     uint32_t next_hop;
-    int ret;
-
-    eth = batch->pkts()[i]->head_data<Ethernet *>();
-    ip = (Ipv4 *)(eth + 1);
-
-    ret = rte_lpm_lookup(lpm_, ip->dst.value(), &next_hop);
-
-    if (ret == 0) {
-      EmitPacket(ctx, batch->pkts()[i], next_hop);
-    } else {
-      EmitPacket(ctx, batch->pkts()[i], default_gate);
+    if (rte_lpm_lookup(fib->lpm, addrs[j], &next_hop) == 0) {
+      out_gates[idx[j]] = next_hop;
     }
   }
+
+  for (int i = 0; i < cnt; i++) {
+    EmitPacket(ctx, batch->pkts()[i], out_gates[i]);
+  }
 }
 
 ParsedPrefix IPLookup::ParseIpv4Prefix(
@@ -183,59 +201,405 @@ ParsedPrefix IPLookup::ParseIpv4Prefix(
   return std::make_tuple(0, "", net_addr);
 }
 
+CommandResponse IPLookup::ParsePrefix(const std::string &prefix,
+                                      uint64_t prefix_len, Prefix *out) {
+  out->addr.fill(0);
+
+  if (prefix.find(':') == std::string::npos) {
+    ParsedPrefix parsed = ParseIpv4Prefix(prefix, prefix_len);
+    if (std::get<0>(parsed)) {
+      return CommandFailure(std::get<0>(parsed), "%s",
+                            std::get<1>(parsed).c_str());
+    }
+    be32_t net_addr = std::get<2>(parsed);
+    memcpy(out->addr.data(), &net_addr, sizeof(net_addr));
+    out->v6 = false;
+    out->len = prefix_len;
+    return CommandSuccess();
+  }
+
+  uint8_t addr[16];
+  if (!bess::utils::ParseIpv6Address(prefix, &addr)) {
+    return CommandFailure(EINVAL, "Invalid IP prefix: %s", prefix.c_str());
+  }
+  if (prefix_len > 128) {
+    return CommandFailure(EINVAL, "Invalid prefix length: %" PRIu64,
+                          prefix_len);
+  }
+  for (size_t i = 0; i < 16; i++) {
+    uint8_t mask = 0;
+    if (prefix_len >= (i + 1) * 8) {
+      mask = 0xff;
+    } else if (prefix_len > i * 8) {
+      mask = 0xff << (8 - (prefix_len - i * 8));
+    }
+    if (addr[i] & ~mask) {
+      return CommandFailure(EINVAL, "Invalid IP prefix %s/%" PRIu64,
+                            prefix.c_str(), prefix_len);
+    }
+  }
+  if (!conf_.ipv6) {
+    return CommandFailure(EINVAL, "IPv6 is not enabled on this module");
+  }
+
+  memcpy(out->addr.data(), addr, sizeof(addr));
+  out->v6 = true;
+  out->len = prefix_len;
+  return CommandSuccess();
+}
+
+int IPLookup::CreateFib(int socket, Fib *fib) {
+  // rte_lpm names must be unique process-wide and short, so tables are
+  // numbered rather than named after the module.
+  static std::atomic<uint32_t> next_id;
+  uint32_t id = next_id++;
+
+  struct rte_lpm_config conf = {
+      .max_rules = conf_.max_rules,
+      .number_tbl8s = conf_.max_tbl8s,
+      .flags = 0,
+  };
+
+  socket = (socket < 0) ? SOCKET_ID_ANY : socket;
+
+  fib->lpm = rte_lpm_create(bess::utils::Format("ipl4_%u", id).c_str(),
+                            socket, &conf);
+  if (!fib->lpm) {
+    return -rte_errno;
+  }
+
+  fib->lpm6 = nullptr;
+  if (conf_.ipv6) {
+    struct rte_lpm6_config conf6 = {
+        .max_rules = conf_.max_rules6,
+        .number_tbl8s = conf_.max_tbl8s6,
+        .flags = 0,
+    };
+
+    fib->lpm6 = rte_lpm6_create(bess::utils::Format("ipl6_%u", id).c_str(),
+                                socket, &conf6);
+    if (!fib->lpm6) {
+      int ret = -rte_errno;
+      rte_lpm_free(fib->lpm);
+      fib->lpm = nullptr;
+      return ret;
+    }
+  }
+
+  fib->default_gate = default_gate_;
+  return 0;
+}
+
+void IPLookup::FreeFib(Fib *fib) {
+  if (fib->lpm) {
+    rte_lpm_free(fib->lpm);
+    fib->lpm = nullptr;
+  }
+  if (fib->lpm6) {
+    rte_lpm6_free(fib->lpm6);
+    fib->lpm6 = nullptr;
+  }
+}
+
+int IPLookup::ApplyOp(Fib *fib, const RouteOp &op) {
+  const Prefix &p = op.prefix;
+
+  if (op.kind == RouteOp::kClear) {
+    rte_lpm_delete_all(fib->lpm);
+    if (fib->lpm6) {
+      rte_lpm6_delete_all(fib->lpm6);
+    }
+    return 0;
+  }
+
+  if (p.len == 0) {
+    fib->default_gate = (op.kind == RouteOp::kAdd) ? op.gate : DROP_GATE;
+    return 0;
+  }
+
+  if (!p.v6) {
+    be32_t net_addr;
+    memcpy(&net_addr, p.addr.data(), sizeof(net_addr));
+    if (op.kind == RouteOp::kAdd) {
+      return rte_lpm_add(fib->lpm, net_addr.value(), p.len, op.gate);
+    }
+    return rte_lpm_delete(fib->lpm, net_addr.value(), p.len);
+  }
+
+  uint8_t addr[16];
+  memcpy(addr, p.addr.data(), sizeof(addr));
+  if (op.kind == RouteOp::kAdd) {
+    return rte_lpm6_add(fib->lpm6, addr, p.len, op.gate);
+  }
+  return rte_lpm6_delete(fib->lpm6, addr, p.len);
+}
+
+int IPLookup::SyncFib(Fib *fib) {
+  RouteOp clear = {RouteOp::kClear, Prefix(), 0};
+  ApplyOp(fib, clear);
+  fib->default_gate = default_gate_;
+
+  for (const auto &it : routes_) {
+    RouteOp op = {RouteOp::kAdd, it.first, it.second};
+    int ret = ApplyOp(fib, op);
+    if (ret) {
+      return ret;
+    }
+  }
+  return 0;
+}
+
+static std::string AddrToString(const uint8_t *addr, bool v6) {
+  if (v6) {
+    uint8_t buf[16];
+    memcpy(buf, addr, sizeof(buf));
+    return bess::utils::ToIpv6Address(buf);
+  }
+  be32_t net_addr;
+  memcpy(&net_addr, addr, sizeof(net_addr));
+  return bess::utils::ToIpv4Address(net_addr);
+}
+
+static std::string PrefixToString(const uint8_t *addr, bool v6, int len) {
+  return bess::utils::Format("%s/%d", AddrToString(addr, v6).c_str(), len);
+}
+
+CommandResponse IPLookup::Update(const std::vector<RouteOp> &ops) {
+  Fib *active = active_.load(std::memory_order_relaxed);
+  Fib *standby = (active == &fibs_[0]) ? &fibs_[1] : &fibs_[0];
+
+  for (const RouteOp &op : ops) {
+    int ret = ApplyOp(standby, op);
+    if (ret) {
+      // Roll the standby copy back to the (unchanged) route set.
+      int err = SyncFib(standby);
+      if (err) {
+        LOG(ERROR) << name() << ": failed to restore standby table: "
+                   << rte_strerror(-err);
+      }
+      return CommandFailure(-ret, "Failed to %s %s: %s",
+                            op.kind == RouteOp::kAdd ? "add" : "delete",
+                            PrefixToString(op.prefix.addr.data(), op.prefix.v6,
+                                           op.prefix.len)
+                                .c_str(),
+                            rte_strerror(-ret));
+    }
+  }
+
+  for (const RouteOp &op : ops) {
+    switch (op.kind) {
+      case RouteOp::kAdd:
+        if (op.prefix.len == 0) {
+          default_gate_ = op.gate;
+          default_v6_ = op.prefix.v6;
+        } else {
+          routes_[op.prefix] = op.gate;
+        }
+        break;
+      case RouteOp::kDelete:
+        if (op.prefix.len == 0) {
+          default_gate_ = DROP_GATE;
+        } else {
+          routes_.erase(op.prefix);
+        }
+        break;
+      case RouteOp::kClear:
+        routes_.clear();
+        break;
+    }
+  }
+
+  active_.store(standby, std::memory_order_release);
+
+  // Wait until no worker can be reading the previous copy, then replay the
+  // same updates on it so that it becomes an identical standby.
+  synchronize_workers();
+
+  for (const RouteOp &op : ops) {
+    if (ApplyOp(active, op)) {
+      int err = SyncFib(active);
+      if (err) {
+        LOG(ERROR) << name() << ": failed to rebuild standby table: "
+                   << rte_strerror(-err);
+      }
+      break;
+    }
+  }
+
+  return CommandSuccess();
+}
+
 CommandResponse IPLookup::CommandAdd(
     const bess::pb::IPLookupCommandAddArg &arg) {
   gate_idx_t gate = arg.gate();
-  uint64_t prefix_len = arg.prefix_len();
-  ParsedPrefix prefix = ParseIpv4Prefix(arg.prefix(), prefix_len);
-  if (std::get<0>(prefix)) {
-    return CommandFailure(std::get<0>(prefix), "%s",
-			  std::get<1>(prefix).c_str());
+  RouteOp op = {RouteOp::kAdd, Prefix(), gate};
+
+  CommandResponse err = ParsePrefix(arg.prefix(), arg.prefix_len(), &op.prefix);
+  if (err.error().code() != 0) {
+    return err;
   }
 
   if (!is_valid_gate(gate)) {
     return CommandFailure(EINVAL, "Invalid gate: %hu", gate);
   }
 
-  if (prefix_len == 0) {
-    default_gate_ = gate;
-  } else {
-    be32_t net_addr = std::get<2>(prefix);
-    int ret = rte_lpm_add(lpm_, net_addr.value(), prefix_len, gate);
-    if (ret) {
-      return CommandFailure(-ret, "rpm_lpm_add() failed");
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Update({op});
+}
+
+CommandResponse IPLookup::CommandDelete(
+    const bess::pb::IPLookupCommandDeleteArg &arg) {
+  RouteOp op = {RouteOp::kDelete, Prefix(), 0};
+
+  CommandResponse err = ParsePrefix(arg.prefix(), arg.prefix_len(), &op.prefix);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (op.prefix.len && routes_.find(op.prefix) == routes_.end()) {
+    return CommandFailure(ENOENT, "No such route: %s/%" PRIu64,
+                          arg.prefix().c_str(), arg.prefix_len());
+  }
+  return Update({op});
+}
+
+CommandResponse IPLookup::CommandClear(const bess::pb::EmptyArg &) {
+  RouteOp op = {RouteOp::kClear, Prefix(), 0};
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Update({op});
+}
+
+// Each line of the file is "<prefix>/<prefix_len> <gate>". Blank lines and
+// lines starting with '#' are ignored. The whole file is applied as one
+// update: workers see either none or all of its routes.
+CommandResponse IPLookup::CommandLoad(
+    const bess::pb::IPLookupCommandLoadArg &arg) {
+  std::ifstream file(arg.filename());
+  if (!file) {
+    return CommandFailure(errno, "Cannot open %s", arg.filename().c_str());
+  }
+
+  std::vector<RouteOp> ops;
+  if (arg.clear()) {
+    ops.push_back({RouteOp::kClear, Prefix(), 0});
+  }
+
+  std::string line;
+  for (int lineno = 1; std::getline(file, line); lineno++) {
+    std::istringstream ss(line);
+    std::string cidr;
+    uint64_t gate;
+
+    if (!(ss >> cidr) || cidr[0] == '#') {
+      continue;
+    }
+
+    size_t delim = cidr.find('/');
+    char *end = nullptr;
+    uint64_t prefix_len = 0;
+    if (delim != std::string::npos) {
+      prefix_len = strtoull(cidr.c_str() + delim + 1, &end, 10);
     }
+    if (delim == std::string::npos || end == cidr.c_str() + delim + 1 ||
+        *end != '\0' || !(ss >> gate)) {
+      return CommandFailure(EINVAL, "%s:%d: expected '<prefix>/<len> <gate>'",
+                            arg.filename().c_str(), lineno);
+    }
+
+    RouteOp op = {RouteOp::kAdd, Prefix(), static_cast<gate_idx_t>(gate)};
+    CommandResponse err =
+        ParsePrefix(cidr.substr(0, delim), prefix_len, &op.prefix);
+    if (err.error().code() != 0) {
+      return CommandFailure(err.error().code(), "%s:%d: %s",
+                            arg.filename().c_str(), lineno,
+                            err.error().errmsg().c_str());
+    }
+    if (gate > UINT16_MAX || !is_valid_gate(op.gate)) {
+      return CommandFailure(EINVAL, "%s:%d: Invalid gate: %" PRIu64,
+                            arg.filename().c_str(), lineno, gate);
+    }
+    ops.push_back(op);
   }
 
-  return CommandSuccess();
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Update(ops);
 }
 
-CommandResponse IPLookup::CommandDelete(
-    const bess::pb::IPLookupCommandDeleteArg &arg) {
-  uint64_t prefix_len = arg.prefix_len();
-  ParsedPrefix prefix = ParseIpv4Prefix(arg.prefix(), prefix_len);
-  if (std::get<0>(prefix)) {
-    return CommandFailure(std::get<0>(prefix), "%s",
-			  std::get<1>(prefix).c_str());
-  }
-
-  if (prefix_len == 0) {
-    default_gate_ = DROP_GATE;
-  } else {
-    be32_t net_addr = std::get<2>(prefix);
-    int ret = rte_lpm_delete(lpm_, net_addr.value(), prefix_len);
-    if (ret) {
-      return CommandFailure(-ret, "rpm_lpm_delete() failed");
+// Retrieves an IPLookupConfig that would restore the current routes: the /0
+// route, in the family it was given in, then all IPv4 and IPv6 prefixes.
+CommandResponse IPLookup::GetRuntimeConfig(const bess::pb::EmptyArg &) {
+  bess::pb::IPLookupConfig r;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (default_gate_ != DROP_GATE) {
+    bess::pb::IPLookupCommandAddArg *rule = r.add_rules();
+    rule->set_prefix(default_v6_ ? "::" : "0.0.0.0");
+    rule->set_prefix_len(0);
+    rule->set_gate(default_gate_);
+  }
+  for (const auto &it : routes_) {
+    bess::pb::IPLookupCommandAddArg *rule = r.add_rules();
+    rule->set_prefix(AddrToString(it.first.addr.data(), it.first.v6));
+    rule->set_prefix_len(it.first.len);
+    rule->set_gate(it.second);
+  }
+  return CommandSuccess(r);
+}
+
+// Replaces all routes in one update, as CommandLoad() does.
+CommandResponse IPLookup::SetRuntimeConfig(
+    const bess::pb::IPLookupConfig &arg) {
+  // A clear keeps the default route, so delete it too.
+  std::vector<RouteOp> ops = {{RouteOp::kClear, Prefix(), 0},
+                              {RouteOp::kDelete, Prefix(), 0}};
+  ops.reserve(arg.rules_size() + ops.size());
+
+  for (const auto &rule : arg.rules()) {
+    RouteOp op = {RouteOp::kAdd, Prefix(),
+                  static_cast<gate_idx_t>(rule.gate())};
+    CommandResponse err =
+        ParsePrefix(rule.prefix(), rule.prefix_len(), &op.prefix);
+    if (err.error().code() != 0) {
+      return err;
+    }
+    if (rule.gate() > UINT16_MAX || !is_valid_gate(op.gate)) {
+      return CommandFailure(EINVAL, "Invalid gate: %" PRIu64, rule.gate());
     }
+    ops.push_back(op);
   }
 
-  return CommandSuccess();
+  std::lock_guard<std::mutex> lock(mutex_);
+  return Update(ops);
 }
 
-CommandResponse IPLookup::CommandClear(const bess::pb::EmptyArg &) {
-  rte_lpm_delete_all(lpm_);
-  return CommandSuccess();
+void IPLookup::OnSocketChange() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Workers are paused, so copies can be replaced without synchronization.
+  // Replacing one at a time keeps at most three copies allocated.
+  for (int n = 0; n < 2; n++) {
+    Fib *active = active_.load(std::memory_order_relaxed);
+    Fib *standby = (active == &fibs_[0]) ? &fibs_[1] : &fibs_[0];
+    Fib fresh = {};
+
+    int ret = CreateFib(socket(), &fresh);
+    if (ret == 0) {
+      ret = SyncFib(&fresh);
+    }
+    if (ret) {
+      FreeFib(&fresh);
+      LOG(WARNING) << name() << ": failed to move tables to socket "
+                   << socket() << ": " << rte_strerror(-ret);
+      return;
+    }
+
+    FreeFib(standby);
+    *standby = fresh;
+    active_.store(standby, std::memory_order_release);
+  }
 }
 
 ADD_MODULE(IPLookup, "ip_lookup",
-           "performs Longest Prefix Match on IPv4 packets")
+           "performs Longest Prefix Match on IPv4/IPv6 packets")
@@ -31,6 +31,13 @@
 #ifndef BESS_MODULES_IPLOOKUP_H_
 #define BESS_MODULES_IPLOOKUP_H_
 
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../utils/endian.h"
@@ -38,13 +45,23 @@
 using bess::utils::be32_t;
 using ParsedPrefix = std::tuple<int, std::string, be32_t>;
 
+// IPLookup performs longest prefix match over the IPv4 (rte_lpm) or IPv6
+// (rte_lpm6) destination address. The forwarding tables are double-buffered:
+// route updates are applied to the standby copy, which is then swapped in
+// atomically, so workers keep forwarding while routes change.
 class IPLookup final : public Module {
  public:
   static const gate_idx_t kNumOGates = MAX_GATES;
 
   static const Commands cmds;
 
-  IPLookup() : Module(), lpm_(), default_gate_() {
+  IPLookup()
+      : Module(),
+        conf_(),
+        fibs_(),
+        active_(nullptr),
+        default_gate_(DROP_GATE),
+        default_v6_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -54,14 +71,86 @@ class IPLookup final : public Module {
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  std::string GetDesc() const override;
+
   CommandResponse CommandAdd(const bess::pb::IPLookupCommandAddArg &arg);
   CommandResponse CommandDelete(const bess::pb::IPLookupCommandDeleteArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandLoad(const bess::pb::IPLookupCommandLoadArg &arg);
+  CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
+  CommandResponse SetRuntimeConfig(const bess::pb::IPLookupConfig &arg);
 
  private:
-  struct rte_lpm *lpm_;
-  gate_idx_t default_gate_;
+  void OnSocketChange() override;
+
+  // An IPv4 address is kept in the first 4 bytes of `addr`, network order.
+  struct Prefix {
+    bool v6;
+    std::array<uint8_t, 16> addr;
+    uint8_t len;
+
+    bool operator<(const Prefix &o) const {
+      return std::tie(v6, addr, len) < std::tie(o.v6, o.addr, o.len);
+    }
+  };
+
+  struct RouteOp {
+    enum Kind { kAdd, kDelete, kClear } kind;
+    Prefix prefix;
+    gate_idx_t gate;
+  };
+
+  // One copy of the forwarding state read by the datapath.
+  struct Fib {
+    struct rte_lpm *lpm;
+    struct rte_lpm6 *lpm6;
+    gate_idx_t default_gate;
+  };
+
+  struct Config {
+    uint32_t max_rules;
+    uint32_t max_tbl8s;
+    bool ipv6;
+    uint32_t max_rules6;
+    uint32_t max_tbl8s6;
+  };
+
   ParsedPrefix ParseIpv4Prefix(const std::string &prefix, uint64_t prefix_len);
+
+  // Parses an IPv4 or IPv6 prefix into `*out`.
+  CommandResponse ParsePrefix(const std::string &prefix, uint64_t prefix_len,
+                              Prefix *out);
+
+  // Allocates empty tables on NUMA node `socket` (or any node if negative).
+  int CreateFib(int socket, Fib *fib);
+  void FreeFib(Fib *fib);
+
+  // Applies `op` to `fib`. Returns 0 or a negative errno.
+  int ApplyOp(Fib *fib, const RouteOp &op);
+
+  // Rebuilds `fib` from `routes_`. Returns 0 or a negative errno.
+  int SyncFib(Fib *fib);
+
+  // Applies `ops` to the standby copy, swaps it in and, once no worker can
+  // see the previous copy, brings that one up to date too. On failure the
+  // route set is left unchanged. Must be called with `mutex_` held.
+  CommandResponse Update(const std::vector<RouteOp> &ops);
+
+  Config conf_;
+
+  // `fibs_[0]` and `fibs_[1]`; `active_` points to the one used by workers.
+  Fib fibs_[2];
+  std::atomic<Fib *> active_;
+
+  // Control-plane copy of all IPv4 and IPv6 routes but /0, used to rebuild
+  // tables and to report them (rte_lpm6 cannot be walked).
+  std::map<Prefix, gate_idx_t> routes_;
+  // The gate of the /0 route, shared by both families, and whether it was
+  // given as ::/0.
+  gate_idx_t default_gate_;
+  bool default_v6_;
+
+  mutable std::mutex mutex_;
 };
 
 #endif  // BESS_MODULES_IPLOOKUP_H_
@@ -27,586 +27,237 @@
 // CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
-
 #include "l2_forward.h"
 
-#include <rte_hash_crc.h>
+#include <chrono>
 
 #include "../utils/endian.h"
-#include "../utils/simd.h"
+#include "../utils/format.h"
+#include "../utils/time.h"
 
-#define MAX_TABLE_SIZE (1048576 * 64)
 #define DEFAULT_TABLE_SIZE 1024
-#define MAX_BUCKET_SIZE 4
-
-typedef uint64_t mac_addr_t;
-
-static int is_power_of_2(uint64_t n) {
-  return (n != 0 && ((n & (n - 1)) == 0));
-}
-
-/*
- * l2_init:
- *  Initilizes the l2_table.
- *  It creates the slots of MAX_TABLE_SIZE multiplied by MAX_BUCKET_SIZE.
- *
- * @l2tbl: pointer to
- * @size: number of hash value entries. must be power of 2, greater than 0, and
- *        less than equal to MAX_TABLE_SIZE (2^30)
- * @bucket: number of slots per hash value. must be power of 2, greater than 0,
- *        and less than equal to MAX_BUCKET_SIZE (4)
- */
-static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
-  if (size <= 0 || size > MAX_TABLE_SIZE || !is_power_of_2(size)) {
-    return -EINVAL;
-  }
-
-  if (bucket <= 0 || bucket > MAX_BUCKET_SIZE || !is_power_of_2(bucket)) {
-    return -EINVAL;
-  }
-
-  if (l2tbl == nullptr) {
-    return -EINVAL;
-  }
-
-  l2tbl->table = new(std::nothrow) l2_entry[size * bucket]{};
-
-  if (l2tbl->table == nullptr) {
-    return -ENOMEM;
-  }
 
-  l2tbl->size = size;
-  l2tbl->bucket = bucket;
+// Number of buckets expired per acquisition of the table lock, so that
+// workers learning addresses are not locked out for long.
+#define SWEEP_CHUNK 1024
 
-  /* calculates the log_2 (size) */
-  l2tbl->size_power = 0;
-  while (size > 1) {
-    size = size >> 1;
-    l2tbl->size_power += 1;
-  }
-
-  return 0;
-}
+using bess::utils::MacTable;
 
-static int l2_deinit(struct l2_table *l2tbl) {
-  if (l2tbl == nullptr || l2tbl->table == nullptr || l2tbl->size == 0 ||
-      l2tbl->bucket == 0) {
-    return -EINVAL;
-  }
-
-  delete[] l2tbl->table;
-  *l2tbl = {};
-  return 0;
+static inline int is_valid_gate(gate_idx_t gate) {
+  return (gate < MAX_GATES || gate == DROP_GATE);
 }
 
-static uint32_t l2_ib_to_offset(struct l2_table *l2tbl, int index, int bucket) {
-  return index * l2tbl->bucket + bucket;
-}
-
-static uint32_t l2_hash(mac_addr_t addr) {
-  return rte_hash_crc_8byte(addr, 0);
-}
+static uint64_t l2_addr_to_u64(char *addr) {
+  uint64_t a = *(reinterpret_cast<uint32_t *>(addr));
+  uint64_t b = *(reinterpret_cast<uint16_t *>(addr + 4));
 
-static uint32_t l2_hash_to_index(uint32_t hash, uint32_t size) {
-  return hash & (size - 1);
+  return a | (b << 32);
 }
 
-static uint32_t l2_alt_index(uint32_t hash, uint32_t size_power,
-                             uint32_t index) {
-  uint64_t tag = (hash >> size_power) + 1;
-  tag = tag * 0x5bd1e995;
-  return (index ^ tag) & ((0x1lu << (size_power - 1)) - 1);
-}
+static int parse_mac_addr(const char *str, char *addr) {
+  if (str != nullptr && addr != nullptr) {
+    int r = sscanf(str, "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx", addr, addr + 1,
+                   addr + 2, addr + 3, addr + 4, addr + 5);
 
-#if __AVX__
-const union {
-  uint64_t val[4];
-  __m256d _mask;
-} _mask = {.val = {0x8000ffffFFFFffffull, 0x8000ffffFFFFffffull,
-                   0x8000ffffFFFFffffull, 0x8000ffffFFFFffffull}};
-
-// Do not call these functions directly. Use find_index() instead. See below.
-static inline int find_index_avx(uint64_t addr, uint64_t *table) {
-  DCHECK(reinterpret_cast<uintptr_t>(table) % 32 == 0);
-  __m256d _addr = (__m256d)_mm256_set1_epi64x(addr | (1ull << 63));
-  __m256d _table = _mm256_load_pd((double *)table);
-  _table = _mm256_and_pd(_table, _mask._mask);
-  __m256d cmp = _mm256_cmp_pd(_addr, _table, _CMP_EQ_OQ);
-
-  return __builtin_ffs(_mm256_movemask_pd(cmp));
-}
-#else
-static inline int find_index_basic(uint64_t addr, uint64_t *table) {
-  for (int i = 0; i < 4; i++) {
-    if ((addr | (1ull << 63)) == (table[i] & 0x8000ffffFFFFffffull)) {
-      return i + 1;
+    if (r != 6) {
+      return -EINVAL;
     }
   }
 
   return 0;
 }
-#endif
-
-// Finds addr from a 4-way bucket *table and returns its index + 1.
-// Returns zero if not found.
-static inline int find_index(uint64_t addr, uint64_t *table, const uint64_t) {
-#if __AVX__
-  return find_index_avx(addr, table);
-#else
-  return find_index_basic(addr, table);
-#endif
-}
-
-static inline int l2_find(struct l2_table *l2tbl, uint64_t addr,
-                          gate_idx_t *gate) {
-  size_t i;
-  int ret = -ENOENT;
-  uint32_t hash, idx1, offset;
-  struct l2_entry *tbl = l2tbl->table;
-
-  hash = l2_hash(addr);
-  idx1 = l2_hash_to_index(hash, l2tbl->size);
-
-  offset = l2_ib_to_offset(l2tbl, idx1, 0);
 
-  if (l2tbl->bucket == 4) {
-    int tmp1 = find_index(addr, &tbl[offset].entry, l2tbl->count);
-    if (tmp1) {
-      *gate = tbl[offset + tmp1 - 1].gate;
-      return 0;
-    }
-
-    idx1 = l2_alt_index(hash, l2tbl->size_power, idx1);
-    offset = l2_ib_to_offset(l2tbl, idx1, 0);
-
-    int tmp2 = find_index(addr, &tbl[offset].entry, l2tbl->count);
-
-    if (tmp2) {
-      *gate = tbl[offset + tmp2 - 1].gate;
-      return 0;
-    }
+/******************************************************************************/
 
-  } else {
-    /* search buckets for first index */
-    for (i = 0; i < l2tbl->bucket; i++) {
-      if (tbl[offset].occupied && addr == tbl[offset].addr) {
-        *gate = tbl[offset].gate;
-        return 0;
-      }
+const Commands L2Forward::cmds = {
+    {"add", "L2ForwardCommandAddArg", MODULE_CMD_FUNC(&L2Forward::CommandAdd),
+     Command::THREAD_SAFE},
+    {"delete", "L2ForwardCommandDeleteArg",
+     MODULE_CMD_FUNC(&L2Forward::CommandDelete), Command::THREAD_SAFE},
+    {"set_default_gate", "L2ForwardCommandSetDefaultGateArg",
+     MODULE_CMD_FUNC(&L2Forward::CommandSetDefaultGate), Command::THREAD_SAFE},
+    {"lookup", "L2ForwardCommandLookupArg",
+     MODULE_CMD_FUNC(&L2Forward::CommandLookup), Command::THREAD_SAFE},
+    {"populate", "L2ForwardCommandPopulateArg",
+     MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_SAFE},
+};
 
-      offset++;
-    }
+CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
+  int ret = 0;
+  int64_t size = arg.size();
+  int64_t bucket = arg.bucket();
 
-    idx1 = l2_alt_index(hash, l2tbl->size_power, idx1);
-    offset = l2_ib_to_offset(l2tbl, idx1, 0);
-    /* search buckets for alternate index */
-    for (i = 0; i < l2tbl->bucket; i++) {
-      if (tbl[offset].occupied && addr == tbl[offset].addr) {
-        *gate = tbl[offset].gate;
-        return 0;
-      }
+  default_gate_ = DROP_GATE;
 
-      offset++;
-    }
+  // Ages are compared as signed 32-bit tick differences (see
+  // MacTable::Expire()), and a tick is a little less than a second.
+  if (arg.age() > INT32_MAX) {
+    return CommandFailure(EINVAL, "'age' must be at most %d", INT32_MAX);
   }
 
-  return ret;
-}
-
-static int l2_find_offset(struct l2_table *l2tbl, uint64_t addr,
-                          uint32_t *offset_out) {
-  size_t i;
-  uint32_t hash, idx1, offset;
-  struct l2_entry *tbl = l2tbl->table;
-
-  hash = l2_hash(addr);
-  idx1 = l2_hash_to_index(hash, l2tbl->size);
-
-  offset = l2_ib_to_offset(l2tbl, idx1, 0);
-  /* search buckets for first index */
-  for (i = 0; i < l2tbl->bucket; i++) {
-    if (tbl[offset].occupied && addr == tbl[offset].addr) {
-      *offset_out = offset;
-      return 0;
-    }
-
-    offset++;
+  if (size == 0) {
+    size = DEFAULT_TABLE_SIZE;
   }
-
-  idx1 = l2_alt_index(hash, l2tbl->size_power, idx1);
-  offset = l2_ib_to_offset(l2tbl, idx1, 0);
-  /* search buckets for alternate index */
-  for (i = 0; i < l2tbl->bucket; i++) {
-    if (tbl[offset].occupied && addr == tbl[offset].addr) {
-      *offset_out = offset;
-      return 0;
-    }
-
-    offset++;
+  if (bucket == 0) {
+    bucket = MacTable::kBucketSize;
   }
 
-  return -ENOENT;
-}
-
-static int l2_find_slot(struct l2_table *l2tbl, mac_addr_t addr, uint32_t *idx,
-                        uint32_t *bucket) {
-  size_t i, j;
-  uint32_t hash;
-  uint32_t idx1, idx_v1, idx_v2;
-  uint32_t offset1, offset2;
-  struct l2_entry *tbl = l2tbl->table;
-
-  hash = l2_hash(addr);
-  idx1 = l2_hash_to_index(hash, l2tbl->size);
-
-  /* if there is available slot */
-  for (i = 0; i < l2tbl->bucket; i++) {
-    offset1 = l2_ib_to_offset(l2tbl, idx1, i);
-    if (!tbl[offset1].occupied) {
-      *idx = idx1;
-      *bucket = i;
-      return 0;
-    }
+  if (size < 0 || bucket < 0) {
+    ret = -EINVAL;
+  } else {
+    ret = table_.Init(size, bucket);
   }
 
-  offset1 = l2_ib_to_offset(l2tbl, idx1, 0);
-
-  /* try moving */
-  for (i = 0; i < l2tbl->bucket; i++) {
-    offset1 = l2_ib_to_offset(l2tbl, idx1, i);
-    hash = l2_hash(tbl[offset1].addr);
-    idx_v1 = l2_hash_to_index(hash, l2tbl->size);
-    idx_v2 = l2_alt_index(hash, l2tbl->size_power, idx_v1);
-
-    /* if the alternate bucket is same as original skip it */
-    if (idx_v1 == idx_v2 || idx1 == idx_v2)
-      break;
-
-    for (j = 0; j < l2tbl->bucket; j++) {
-      offset2 = l2_ib_to_offset(l2tbl, idx_v2, j);
-      if (!tbl[offset2].occupied) {
-        /* move offset1 to offset2 */
-        tbl[offset2] = tbl[offset1];
-        /* clear offset1 */
-        tbl[offset1].occupied = 0;
-
-        *idx = idx1;
-        *bucket = 0;
-        return 0;
-      }
-    }
+  if (ret != 0) {
+    return CommandFailure(-ret,
+                          "initialization failed with argument "
+                          "size: '%" PRId64 "' bucket: '%" PRId64 "'",
+                          size, bucket);
   }
 
-  /* TODO:if alternate index is also full then start move */
-  return -ENOMEM;
-}
-
-static int l2_add_entry(struct l2_table *l2tbl, mac_addr_t addr,
-                        gate_idx_t gate) {
-  uint32_t offset;
-  uint32_t index;
-  uint32_t bucket;
-  gate_idx_t gate_idx_tmp;
+  learn_ = arg.learn();
+  // Round up to whole ticks.
+  max_age_ = (arg.age() * 1000000000ull + (1ull << kTickShift) - 1) >>
+             kTickShift;
 
-  /* if addr already exist then fail */
-  if (l2_find(l2tbl, addr, &gate_idx_tmp) == 0) {
-    return -EEXIST;
+  if (learn_ && max_age_) {
+    stop_sweeper_ = false;
+    sweeper_ = std::thread(&L2Forward::RunSweeper, this);
   }
 
-  /* find slots to put entry */
-  if (l2_find_slot(l2tbl, addr, &index, &bucket) != 0) {
-    return -ENOMEM;
-  }
-
-  /* insert entry into empty slot */
-  offset = l2_ib_to_offset(l2tbl, index, bucket);
-
-  l2tbl->table[offset].addr = addr;
-  l2tbl->table[offset].gate = gate;
-  l2tbl->table[offset].occupied = 1;
-  l2tbl->count++;
-  return 0;
+  return CommandSuccess();
 }
 
-static int l2_del_entry(struct l2_table *l2tbl, uint64_t addr) {
-  uint32_t offset = 0xFFFFFFFF;
-
-  if (l2_find_offset(l2tbl, addr, &offset)) {
-    return -ENOENT;
+void L2Forward::DeInit() {
+  if (sweeper_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(sweeper_mutex_);
+      stop_sweeper_ = true;
+    }
+    sweeper_cv_.notify_all();
+    sweeper_.join();
   }
 
-  l2tbl->table[offset].addr = 0;
-  l2tbl->table[offset].gate = 0;
-  l2tbl->table[offset].occupied = 0;
-  l2tbl->count--;
-  return 0;
+  table_.DeInit();
 }
 
-static int l2_flush(struct l2_table *l2tbl) {
-  if (nullptr == l2tbl || nullptr == l2tbl->table) {
-    return -EINVAL;
+void L2Forward::OnSocketChange() {
+  int ret = table_.MoveToSocket(socket());
+  if (ret) {
+    LOG(WARNING) << name() << ": failed to move MAC table to socket "
+                 << socket() << ": " << strerror(-ret);
   }
-
-  memset(l2tbl->table, 0,
-         sizeof(struct l2_entry) * l2tbl->size * l2tbl->bucket);
-
-  return 0;
-}
-
-static uint64_t l2_addr_to_u64(char *addr) {
-  uint64_t a = *(reinterpret_cast<uint32_t *>(addr));
-  uint64_t b = *(reinterpret_cast<uint16_t *>(addr + 4));
-
-  return a | (b << 32);
 }
 
-/******************************************************************************/
-// TODO(barath): Move this test code elsewhere.
-
-#include <limits.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-static void l2_forward_init_test() {
-  int ret;
-  struct l2_table l2tbl;
-
-  ret = l2_init(&l2tbl, 0, 0);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_init(&l2tbl, 4, 0);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_init(&l2tbl, 0, 2);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_init(&l2tbl, 4, 2);
-  DCHECK(!ret);
-  ret = l2_deinit(&l2tbl);
-  DCHECK_EQ(ret, 0);
-
-  ret = l2_init(&l2tbl, 4, 4);
-  DCHECK(!ret);
-  ret = l2_deinit(&l2tbl);
-  DCHECK_EQ(ret, 0);
-
-  ret = l2_init(&l2tbl, 4, 8);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_init(&l2tbl, 6, 4);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_init(&l2tbl, 2 << 10, 2);
-  DCHECK_EQ(ret, 0);
-  ret = l2_deinit(&l2tbl);
-  DCHECK_EQ(ret, 0);
-
-  ret = l2_init(&l2tbl, 2 << 10, 3);
-  DCHECK_EQ(ret, 0);
-}
-
-static void l2_forward_entry_test() {
-  int ret;
-  struct l2_table l2tbl;
-
-  uint64_t addr1 = 0x0123456701234567;
-  uint64_t addr2 = 0x9876543210987654;
-  uint16_t index1 = 0x0123;
-  uint16_t gate_index = -1;
-
-  ret = l2_init(&l2tbl, 4, 4);
-  DCHECK_EQ(ret, 0);
-
-  ret = l2_add_entry(&l2tbl, addr1, index1);
-  LOG(INFO) << "add entry: " << addr1 << ", index: " << index1;
-  DCHECK_EQ(ret, 0);
-
-  ret = l2_find(&l2tbl, addr1, &gate_index);
-  LOG(INFO) << "find entry: " << addr1 << ", index: " << gate_index;
-  DCHECK_EQ(ret, 0);
-  DCHECK_EQ(index1, gate_index);
-
-  ret = l2_find(&l2tbl, addr2, &gate_index);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_del_entry(&l2tbl, addr1);
-  DCHECK_EQ(ret, 0);
-
-  ret = l2_del_entry(&l2tbl, addr2);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_find(&l2tbl, addr1, &gate_index);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_deinit(&l2tbl);
-  DCHECK_EQ(ret, 0);
+std::string L2Forward::GetDesc() const {
+  if (!learn_) {
+    return bess::utils::Format("%zu entries", table_.count());
+  }
+  return bess::utils::Format("%zu entries, learning (%" PRIu64 " failed)",
+                             table_.count(), learn_failures_.load());
 }
 
-static void l2_forward_flush_test() {
-  int ret;
-  struct l2_table l2tbl;
-
-  uint64_t addr1 = 0x0123456701234567;
-  uint16_t index1 = 0x0123;
-  uint16_t gate_index;
-
-  ret = l2_init(&l2tbl, 4, 4);
-  DCHECK_EQ(ret, 0);
+void L2Forward::RunSweeper() {
+  std::unique_lock<std::mutex> lock(sweeper_mutex_);
 
-  ret = l2_add_entry(&l2tbl, addr1, index1);
-  DCHECK_EQ(ret, 0);
+  while (!sweeper_cv_.wait_for(lock, std::chrono::seconds(1),
+                               [this] { return stop_sweeper_; })) {
+    uint32_t now = tsc_to_ns(rdtsc()) >> kTickShift;
 
-  ret = l2_flush(&l2tbl);
-  DCHECK_EQ(ret, 0);
-
-  ret = l2_find(&l2tbl, addr1, &gate_index);
-  DCHECK_LT(ret, 0);
-
-  ret = l2_deinit(&l2tbl);
-  DCHECK_EQ(ret, 0);
+    for (size_t b = 0; b < table_.num_buckets(); b += SWEEP_CHUNK) {
+      std::lock_guard<std::mutex> table_lock(table_.mutex());
+      table_.Expire(b, SWEEP_CHUNK, now, max_age_);
+    }
+  }
 }
 
-static void l2_forward_collision_test() {
-  const int h_size = 4;
-  const int b_size = 4;
-  const int max_hb_cnt = h_size * b_size;
+void L2Forward::Learn(Context *ctx, const uint64_t *src_addrs,
+                      const uint64_t *src_entries, const uint32_t *src_slots,
+                      int cnt) {
+  uint32_t now = ctx->current_ns >> kTickShift;
+  gate_idx_t igate = ctx->current_igate;
 
-  int ret;
-  int i;
-  struct l2_table l2tbl;
+  int pending[bess::PacketBatch::kMaxBurst];
+  int n = 0;
 
-  uint64_t addr[max_hb_cnt];
-  uint16_t idx[max_hb_cnt];
-  int success[max_hb_cnt];
-  uint32_t offset;
-
-  ret = l2_init(&l2tbl, h_size, b_size);
-  DCHECK_EQ(ret, 0);
+  for (int i = 0; i < cnt; i++) {
+    uint64_t entry = src_entries[i];
 
-  /* collision happens */
-  for (i = 0; i < max_hb_cnt; i++) {
-    addr[i] = random() % ULONG_MAX;
-    idx[i] = random() % USHRT_MAX;
+    if (entry) {
+      if (MacTable::EntryIsStatic(entry)) {
+        continue;
+      }
+      if (MacTable::EntryGate(entry) == igate) {
+        table_.Touch(src_slots[i], now);
+        continue;
+      }
+    } else if (src_addrs[i] & 1) {
+      // Group (multicast/broadcast) addresses are never sources.
+      continue;
+    }
 
-    ret = l2_add_entry(&l2tbl, addr[i], idx[i]);
-    LOG(INFO) << "insert result: " << addr[i] << " " << idx[i] << " " << ret;
-    success[i] = (ret >= 0);
+    pending[n++] = i;
   }
 
-  /* collision happens */
-  for (i = 0; i < max_hb_cnt; i++) {
-    uint16_t gate_index;
-    gate_index = 0;
-    offset = 0;
-
-    ret = l2_find(&l2tbl, addr[i], &gate_index);
-
-    LOG(INFO) << "find result: " << addr[i] << " " << gate_index << " "
-              << offset;
-
-    if (success[i]) {
-      DCHECK_EQ(ret, 0);
-      DCHECK_EQ(idx[i], gate_index);
-    } else {
-      DCHECK_NE(ret, 0);
-    }
+  if (n == 0) {
+    return;
   }
 
-  ret = l2_deinit(&l2tbl);
-  DCHECK_EQ(ret, 0);
-}
-
-int test_all() {
-  l2_forward_init_test();
-  l2_forward_entry_test();
-  l2_forward_flush_test();
-  l2_forward_collision_test();
-
-  return 0;
-}
-
-static int parse_mac_addr(const char *str, char *addr) {
-  if (str != nullptr && addr != nullptr) {
-    int r = sscanf(str, "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx", addr, addr + 1,
-                   addr + 2, addr + 3, addr + 4, addr + 5);
+  std::unique_lock<std::mutex> lock(table_.mutex(), std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
 
-    if (r != 6) {
-      return -EINVAL;
+  for (int j = 0; j < n; j++) {
+    if (table_.Learn(src_addrs[pending[j]], igate, now)) {
+      learn_failures_++;
     }
   }
-
-  return 0;
 }
 
-/******************************************************************************/
-
-const Commands L2Forward::cmds = {
-    {"add", "L2ForwardCommandAddArg", MODULE_CMD_FUNC(&L2Forward::CommandAdd),
-     Command::THREAD_UNSAFE},
-    {"delete", "L2ForwardCommandDeleteArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandDelete), Command::THREAD_UNSAFE},
-    {"set_default_gate", "L2ForwardCommandSetDefaultGateArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandSetDefaultGate), Command::THREAD_SAFE},
-    {"lookup", "L2ForwardCommandLookupArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandLookup), Command::THREAD_SAFE},
-    {"populate", "L2ForwardCommandPopulateArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_UNSAFE},
-};
+void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
 
-CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
-  int ret = 0;
-  int size = arg.size();
-  int bucket = arg.bucket();
+  int cnt = batch->cnt();
 
-  default_gate_ = DROP_GATE;
+  uint64_t addrs[bess::PacketBatch::kMaxBurst];
+  uint64_t entries[bess::PacketBatch::kMaxBurst];
+  uint32_t slots[bess::PacketBatch::kMaxBurst];
+  gate_idx_t out_gates[bess::PacketBatch::kMaxBurst];
 
-  if (size == 0) {
-    size = DEFAULT_TABLE_SIZE;
-  }
-  if (bucket == 0) {
-    bucket = MAX_BUCKET_SIZE;
+  // read destination MAC address (first 6 bytes)
+  // NOTE: assumes little endian
+  for (int i = 0; i < cnt; i++) {
+    addrs[i] =
+        *(batch->pkts()[i]->head_data<uint64_t *>()) & 0x0000ffffffffffff;
   }
 
-  ret = l2_init(&l2_table_, size, bucket);
+  table_.FindBulk(addrs, cnt, entries, slots);
 
-  if (ret != 0) {
-    return CommandFailure(-ret,
-                          "initialization failed with argument "
-                          "size: '%d' bucket: '%d'",
-                          size, bucket);
+  for (int i = 0; i < cnt; i++) {
+    out_gates[i] =
+        entries[i] ? MacTable::EntryGate(entries[i]) : default_gate;
   }
 
-  return CommandSuccess();
-}
-
-void L2Forward::DeInit() {
-  l2_deinit(&l2_table_);
-}
+  if (learn_) {
+    // read source MAC address (bytes 6-11)
+    for (int i = 0; i < cnt; i++) {
+      addrs[i] = *(batch->pkts()[i]->head_data<uint64_t *>(4)) >> 16;
+    }
 
-void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
-  gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+    table_.FindBulk(addrs, cnt, entries, slots);
+    Learn(ctx, addrs, entries, slots, cnt);
+  }
 
-  int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
-    bess::Packet *snb = batch->pkts()[i];
-
-    gate_idx_t out_gate;
-    // read destination MAC address (first 6 bytes)
-    // NOTE: assumes little endian
-    int ret = l2_find(&l2_table_,
-                      *(snb->head_data<uint64_t *>()) & 0x0000ffffffffffff,
-                      &out_gate);
-    if (ret != 0) {
-      EmitPacket(ctx, snb, default_gate);
-    } else {
-      EmitPacket(ctx, snb, out_gate);
-    }
+    EmitPacket(ctx, batch->pkts()[i], out_gates[i]);
   }
 }
 
 CommandResponse L2Forward::CommandAdd(
     const bess::pb::L2ForwardCommandAddArg &arg) {
+  std::lock_guard<std::mutex> lock(table_.mutex());
+
   for (int i = 0; i < arg.entries_size(); i++) {
     const auto &entry = arg.entries(i);
 
@@ -623,11 +274,15 @@ CommandResponse L2Forward::CommandAdd(
       return CommandFailure(EINVAL, "%s is not a proper mac address", str_addr);
     }
 
-    int r = l2_add_entry(&l2_table_, l2_addr_to_u64(addr), gate);
+    if (gate < 0 || !is_valid_gate(gate)) {
+      return CommandFailure(EINVAL, "Invalid gate: %d", gate);
+    }
+
+    int r = table_.Add(l2_addr_to_u64(addr), gate, true, 0);
 
     if (r == -EEXIST) {
       return CommandFailure(EEXIST, "MAC address '%s' already exist", str_addr);
-    } else if (r == -ENOMEM) {
+    } else if (r == -ENOSPC) {
       return CommandFailure(ENOMEM, "Not enough space");
     } else if (r != 0) {
       return CommandFailure(-r);
@@ -639,6 +294,8 @@ CommandResponse L2Forward::CommandAdd(
 
 CommandResponse L2Forward::CommandDelete(
     const bess::pb::L2ForwardCommandDeleteArg &arg) {
+  std::lock_guard<std::mutex> lock(table_.mutex());
+
   for (int i = 0; i < arg.addrs_size(); i++) {
     const auto &_addr = arg.addrs(i);
 
@@ -653,7 +310,7 @@ CommandResponse L2Forward::CommandDelete(
       return CommandFailure(EINVAL, "%s is not a proper mac address", str_addr);
     }
 
-    int r = l2_del_entry(&l2_table_, l2_addr_to_u64(addr));
+    int r = table_.Delete(l2_addr_to_u64(addr));
 
     if (r == -ENOENT) {
       return CommandFailure(ENOENT, "MAC address '%s' does not exist",
@@ -689,16 +346,12 @@ CommandResponse L2Forward::CommandLookup(
       return CommandFailure(EINVAL, "%s is not a proper mac address", str_addr);
     }
 
-    gate_idx_t gate;
-    int r = l2_find(&l2_table_, l2_addr_to_u64(addr), &gate);
-
-    if (r == -ENOENT) {
+    uint64_t entry;
+    if (table_.Find(l2_addr_to_u64(addr), &entry) == MacTable::kInvalidSlot) {
       return CommandFailure(ENOENT, "MAC address '%s' does not exist",
                             str_addr);
-    } else if (r != 0) {
-      return CommandFailure(EINVAL, "Unknown Error: %d\n", r);
     }
-    ret.add_gates(gate);
+    ret.add_gates(MacTable::EntryGate(entry));
   }
 
   return CommandSuccess(ret);
@@ -722,15 +375,21 @@ CommandResponse L2Forward::CommandPopulate(
 
   base_u64 = l2_addr_to_u64(base_str);
 
+  if (arg.gate_count() <= 0 || arg.gate_count() > MAX_GATES) {
+    return CommandFailure(EINVAL, "gate_count must be in [1, %d]", MAX_GATES);
+  }
+
   int cnt = arg.count();
   int gate_cnt = arg.gate_count();
 
   base_u64 = bess::utils::be64_t::swap(base_u64) >> 16;
   base_u64 = base_u64 >> 16;
 
+  std::lock_guard<std::mutex> lock(table_.mutex());
+
   for (int i = 0; i < cnt; i++) {
-    l2_add_entry(&l2_table_, bess::utils::be64_t::swap(base_u64 << 16),
-                 i % gate_cnt);
+    table_.Add(bess::utils::be64_t::swap(base_u64 << 16), i % gate_cnt, true,
+               0);
 
     base_u64++;
   }
@@ -31,39 +31,40 @@
 #ifndef BESS_MODULES_L2FORWARD_H_
 #define BESS_MODULES_L2FORWARD_H_
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/mac_table.h"
 
 #if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
 #error this code assumes little endian architecture (x86)
 #endif
 
-struct alignas(32) l2_entry {
-  union {
-    struct {
-      uint64_t addr : 48;
-      uint64_t gate : 15;
-      uint64_t occupied : 1;
-    };
-    uint64_t entry;
-  };
-};
-
-struct l2_table {
-  struct l2_entry *table;
-  uint64_t size;
-  uint64_t size_power;
-  uint64_t bucket;
-  uint64_t count;
-};
-
+// L2Forward forwards packets by destination MAC address. With learning
+// enabled, it also learns source MAC addresses from traffic: a packet that
+// arrives on input gate N teaches that its source address is reachable via
+// output gate N. Learned entries not seen for `age` seconds are removed by a
+// background sweeper thread.
 class L2Forward final : public Module {
  public:
+  static const gate_idx_t kNumIGates = MAX_GATES;
   static const gate_idx_t kNumOGates = MAX_GATES;
 
   static const Commands cmds;
 
-  L2Forward() : Module(), l2_table_(), default_gate_() {
+  // Timestamps of learned entries are in units of 2^30 ns (~1.07 s).
+  static const int kTickShift = 30;
+
+  L2Forward()
+      : Module(),
+        default_gate_(),
+        learn_(),
+        max_age_(),
+        learn_failures_(),
+        stop_sweeper_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -73,6 +74,8 @@ class L2Forward final : public Module {
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  std::string GetDesc() const override;
+
   CommandResponse CommandAdd(const bess::pb::L2ForwardCommandAddArg &arg);
   CommandResponse CommandDelete(const bess::pb::L2ForwardCommandDeleteArg &arg);
   CommandResponse CommandSetDefaultGate(
@@ -82,8 +85,27 @@ class L2Forward final : public Module {
       const bess::pb::L2ForwardCommandPopulateArg &arg);
 
  private:
-  struct l2_table l2_table_;
+  void OnSocketChange() override;
+
+  // Learns the source addresses of `batch` that are new or have moved.
+  // Never blocks: if another thread is updating the table, the addresses
+  // are learned from later packets instead.
+  void Learn(Context *ctx, const uint64_t *src_addrs,
+             const uint64_t *src_entries, const uint32_t *src_slots, int cnt);
+
+  void RunSweeper();
+
+  bess::utils::MacTable table_;
   gate_idx_t default_gate_;
+
+  bool learn_;
+  uint32_t max_age_;  // in ticks, 0 if learned entries never expire
+  std::atomic<uint64_t> learn_failures_;  // table full
+
+  std::thread sweeper_;
+  std::mutex sweeper_mutex_;
+  std::condition_variable sweeper_cv_;
+  bool stop_sweeper_;
 };
 
 #endif  // BESS_MODULES_L2FORWARD_H_
@@ -0,0 +1,199 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Benchmarks for the MAC table of L2Forward: lookup and learning rates with
+// up to 1M addresses, and lookups while another thread keeps learning.
+
+#include "l2_forward.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../utils/random.h"
+
+using bess::utils::MacTable;
+
+static const size_t kBatchSize = 32;
+static const size_t kNumKeys = 1 << 16;
+
+// Random unicast addresses
+static std::vector<uint64_t> RandomAddrs(size_t n, uint64_t seed) {
+  Random rng(seed);
+  std::vector<uint64_t> addrs(n);
+  for (uint64_t &addr : addrs) {
+    addr = ((static_cast<uint64_t>(rng.Get()) << 32) | rng.Get()) &
+           MacTable::kAddrMask & ~1ull;
+  }
+  return addrs;
+}
+
+class MacTableFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    if (state.thread_index() != 0) {
+      return;
+    }
+
+    size_t n = state.range(0);
+
+    // Sized for at most 50% load, as L2Forward would be configured.
+    size_t num_buckets = 1;
+    while (num_buckets * MacTable::kBucketSize < 2 * n) {
+      num_buckets <<= 1;
+    }
+    table_.Init(num_buckets, MacTable::kBucketSize);
+
+    addrs_ = RandomAddrs(n, 0);
+    spare_ = RandomAddrs(n, 1);
+
+    keys_.resize(kNumKeys);
+    Random rng(2);
+    for (uint64_t &key : keys_) {
+      key = addrs_[rng.GetRange(n)];
+    }
+  }
+
+  void TearDown(benchmark::State &state) override {
+    if (state.thread_index() == 0) {
+      table_.DeInit();
+    }
+  }
+
+ protected:
+  void Populate() {
+    std::lock_guard<std::mutex> lock(table_.mutex());
+    for (size_t i = 0; i < addrs_.size(); i++) {
+      table_.Learn(addrs_[i], i % 64, 0);
+    }
+  }
+
+  MacTable table_;
+  std::vector<uint64_t> addrs_;
+  std::vector<uint64_t> spare_;
+  std::vector<uint64_t> keys_;
+};
+
+BENCHMARK_DEFINE_F(MacTableFixture, Lookup)(benchmark::State &state) {
+  Populate();
+
+  uint64_t entry;
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(table_.Find(keys_[i], &entry));
+    i = (i + 1) % kNumKeys;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(MacTableFixture, LookupBulk)(benchmark::State &state) {
+  Populate();
+
+  uint64_t entries[kBatchSize];
+  uint32_t slots[kBatchSize];
+  size_t i = 0;
+  for (auto _ : state) {
+    table_.FindBulk(&keys_[i], kBatchSize, entries, slots);
+    benchmark::DoNotOptimize(slots);
+    i = (i + kBatchSize) % kNumKeys;
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+// Learning rate of new addresses, from an empty table up to range(0) entries.
+BENCHMARK_DEFINE_F(MacTableFixture, Learn)(benchmark::State &state) {
+  size_t i = 0;
+  for (auto _ : state) {
+    if (i == addrs_.size()) {
+      state.PauseTiming();
+      table_.Clear();
+      i = 0;
+      state.ResumeTiming();
+    }
+
+    std::lock_guard<std::mutex> lock(table_.mutex());
+    benchmark::DoNotOptimize(table_.Learn(addrs_[i], i % 64, 0));
+    i++;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Thread 0 keeps replacing table entries (one delete and one learn per
+// iteration) while the other threads perform bulk lookups.
+BENCHMARK_DEFINE_F(MacTableFixture, LookupWhileLearning)
+(benchmark::State &state) {
+  if (state.thread_index() == 0) {
+    Populate();
+  }
+
+  if (state.thread_index() == 0) {
+    size_t i = 0;
+    bool swapped = false;
+    for (auto _ : state) {
+      std::lock_guard<std::mutex> lock(table_.mutex());
+      const std::vector<uint64_t> &out = swapped ? spare_ : addrs_;
+      const std::vector<uint64_t> &in = swapped ? addrs_ : spare_;
+      table_.Delete(out[i]);
+      table_.Learn(in[i], i % 64, 0);
+      if (++i == addrs_.size()) {
+        i = 0;
+        swapped = !swapped;
+      }
+    }
+    state.SetLabel("learner");
+    state.SetItemsProcessed(state.iterations());
+    return;
+  }
+
+  uint64_t entries[kBatchSize];
+  uint32_t slots[kBatchSize];
+  size_t i = 0;
+  for (auto _ : state) {
+    table_.FindBulk(&keys_[i], kBatchSize, entries, slots);
+    benchmark::DoNotOptimize(slots);
+    i = (i + kBatchSize) % kNumKeys;
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(MacTableFixture, Lookup)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(MacTableFixture, LookupBulk)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(MacTableFixture, Learn)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(MacTableFixture, LookupWhileLearning)
+    ->Arg(1000000)
+    ->Threads(2)
+    ->Threads(4);
+
+BENCHMARK_MAIN();
@@ -30,6 +30,7 @@
 #include "nat.h"
 
 #include <algorithm>
+#include <cstring>
 #include <numeric>
 #include <string>
 
@@ -39,9 +40,11 @@
 #include "../utils/format.h"
 #include "../utils/icmp.h"
 #include "../utils/ip.h"
+#include "../utils/numa.h"
 #include "../utils/tcp.h"
 #include "../utils/udp.h"
 
+using bess::utils::Cgnat;
 using bess::utils::Ethernet;
 using bess::utils::Ipv4;
 using IpProto = bess::utils::Ipv4::Proto;
@@ -59,7 +62,11 @@ const Commands NAT::cmds = {
     {"get_runtime_config", "EmptyArg", MODULE_CMD_FUNC(&NAT::GetRuntimeConfig),
      Command::THREAD_SAFE},
     {"set_runtime_config", "EmptyArg", MODULE_CMD_FUNC(&NAT::SetRuntimeConfig),
-     Command::THREAD_SAFE}};
+     Command::THREAD_SAFE},
+    {"get_cgnat_stats", "EmptyArg", MODULE_CMD_FUNC(&NAT::CommandGetCgnatStats),
+     Command::THREAD_SAFE},
+    {"cgnat_lookup", "NATCommandCgnatLookupArg",
+     MODULE_CMD_FUNC(&NAT::CommandCgnatLookup), Command::THREAD_SAFE}};
 
 // TODO(torek): move this to set/get runtime config
 CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
@@ -109,6 +116,58 @@ CommandResponse NAT::Init(const bess::pb::NATArg &arg) {
   // Sort so that GetInitialArg is predictable and consistent.
   std::sort(ext_addrs_.begin(), ext_addrs_.end());
 
+  if (arg.has_cgnat()) {
+    for (const auto &address_range : arg.ext_addrs()) {
+      if (address_range.port_ranges_size()) {
+        return CommandFailure(EINVAL,
+                              "port ranges cannot be used with cgnat, see "
+                              "block_size and port_min");
+      }
+    }
+    return InitCgnat(arg.cgnat());
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse NAT::InitCgnat(const bess::pb::NATArg::CgnatConfig &arg) {
+  bess::utils::Ipv4Prefix prefix(arg.int_prefix());
+
+  Cgnat::Config config;
+  config.int_addr = prefix.addr;
+  config.int_prefix_len = prefix.prefix_length();
+  config.ext_addrs = ext_addrs_;
+  config.port_min = arg.port_min() ?: 1024;
+  config.block_size = arg.block_size() ?: 1008;
+  config.partitions = arg.num_workers() ?: 1;
+  config.max_sessions = arg.max_sessions() ?: (1 << 20);
+  config.timeout_ns = kTimeOutNs;
+
+  if (arg.port_min() > UINT16_MAX || arg.block_size() > UINT16_MAX ||
+      arg.num_workers() > Worker::kMaxWorkers) {
+    return CommandFailure(EINVAL, "port_min, block_size or num_workers is "
+                                  "out of range");
+  }
+
+  cgnat_.reset(new Cgnat());
+  int ret = cgnat_->Init(config);
+  if (ret < 0) {
+    cgnat_.reset();
+  }
+  if (ret == -ERANGE) {
+    return CommandFailure(ERANGE,
+                          "%zu external addresses cannot give every address "
+                          "of %s a block of %u ports",
+                          ext_addrs_.size(), arg.int_prefix().c_str(),
+                          config.block_size);
+  } else if (ret < 0) {
+    return CommandFailure(-ret,
+                          "invalid cgnat config: int_prefix must be /8 to "
+                          "/32 without host bits, and block_size at least "
+                          "num_workers");
+  }
+
+  max_allowed_workers_ = config.partitions;
   return CommandSuccess();
 }
 
@@ -117,6 +176,9 @@ CommandResponse NAT::GetInitialArg(const bess::pb::EmptyArg &) {
   for (size_t i = 0; i < ext_addrs_.size(); i++) {
     auto ext = resp.add_ext_addrs();
     ext->set_ext_addr(ToIpv4Address(ext_addrs_[i]));
+    if (cgnat_) {
+      continue;
+    }
     for (auto irange : port_ranges_[i]) {
       auto erange = ext->add_port_ranges();
       erange->set_begin((uint32_t)irange.begin);
@@ -124,6 +186,16 @@ CommandResponse NAT::GetInitialArg(const bess::pb::EmptyArg &) {
       erange->set_suspended(irange.suspended);
     }
   }
+  if (cgnat_) {
+    const Cgnat::Config &config = cgnat_->config();
+    auto *cgnat = resp.mutable_cgnat();
+    cgnat->set_int_prefix(ToIpv4Address(config.int_addr) + "/" +
+                          std::to_string(config.int_prefix_len));
+    cgnat->set_block_size(config.block_size);
+    cgnat->set_port_min(config.port_min);
+    cgnat->set_num_workers(config.partitions);
+    cgnat->set_max_sessions(config.max_sessions);
+  }
   return CommandSuccess(resp);
 }
 
@@ -135,6 +207,89 @@ CommandResponse NAT::SetRuntimeConfig(const bess::pb::EmptyArg &) {
   return CommandSuccess();
 }
 
+CommandResponse NAT::CommandGetCgnatStats(const bess::pb::EmptyArg &) {
+  if (!cgnat_) {
+    return CommandFailure(EINVAL, "not in cgnat mode");
+  }
+
+  // Counters are read while workers update them; each one is consistent on
+  // its own.
+  bess::pb::NATCommandGetCgnatStatsResponse r;
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    const CgnatWorker &w = cgnat_workers_[wid];
+    if (!w.partition && !w.unassigned) {
+      continue;
+    }
+    auto *stats = r.add_workers();
+    stats->set_wid(wid);
+    stats->set_unassigned(w.unassigned);
+    if (w.partition) {
+      stats->set_partition(w.partition->index());
+      stats->set_sessions(w.partition->sessions());
+      stats->set_expired(w.partition->expired());
+      stats->set_alloc_failures(w.partition->alloc_failures());
+    } else {
+      stats->set_partition(-1);
+    }
+  }
+  return CommandSuccess(r);
+}
+
+CommandResponse NAT::CommandCgnatLookup(
+    const bess::pb::NATCommandCgnatLookupArg &arg) {
+  if (!cgnat_) {
+    return CommandFailure(EINVAL, "not in cgnat mode");
+  }
+
+  be32_t addr;
+  if (!bess::utils::ParseIpv4Address(arg.addr(), &addr)) {
+    return CommandFailure(EINVAL, "invalid IP address %s", arg.addr().c_str());
+  }
+
+  be32_t int_addr = addr;
+  if (std::binary_search(ext_addrs_.begin(), ext_addrs_.end(), addr)) {
+    if (arg.port() > UINT16_MAX ||
+        !cgnat_->MapExternal(addr, arg.port(), &int_addr)) {
+      return CommandFailure(ENOENT, "port %u of %s is not assigned",
+                            arg.port(), arg.addr().c_str());
+    }
+  }
+
+  be32_t ext_addr;
+  uint16_t port_first, port_last;
+  if (!cgnat_->MapInternal(int_addr, &ext_addr, &port_first, &port_last)) {
+    return CommandFailure(ENOENT, "%s is neither an internal nor an external "
+                                  "address",
+                          arg.addr().c_str());
+  }
+
+  bess::pb::NATCommandCgnatLookupResponse r;
+  r.set_int_addr(ToIpv4Address(int_addr));
+  r.set_ext_addr(ToIpv4Address(ext_addr));
+  r.set_port_first(port_first);
+  r.set_port_last(port_last);
+  return CommandSuccess(r);
+}
+
+void NAT::AddActiveWorker(int wid, const Task *task) {
+  Module::AddActiveWorker(wid, task);
+
+  // Workers are paused here. Each gets a partition of the port blocks for
+  // good, allocated on its NUMA node.
+  CgnatWorker &w = cgnat_workers_[wid];
+  if (!cgnat_ || w.partition) {
+    return;
+  }
+  if (next_partition_ >= cgnat_->config().partitions) {
+    LOG(ERROR) << name() << ": worker " << wid
+               << " exceeds num_workers; its packets will be dropped";
+    return;
+  }
+
+  bess::utils::ScopedNodePreference numa(workers[wid]->socket());
+  w.partition.reset(new Cgnat::Partition(cgnat_.get(), next_partition_++));
+}
+
 static inline std::pair<bool, Endpoint> ExtractEndpoint(const Ipv4 *ip,
                                                         const void *l4,
                                                         NAT::Direction dir) {
@@ -364,9 +519,91 @@ inline void NAT::DoProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   }
 }
 
+template <NAT::Direction dir>
+inline void NAT::DoProcessBatchCgnat(Context *ctx, bess::PacketBatch *batch) {
+  gate_idx_t ogate_idx = dir == kForward ? 1 : 0;
+  int cnt = batch->cnt();
+  CgnatWorker &w = cgnat_workers_[ctx->wid];
+
+  if (dir == kForward && !w.partition) {
+    w.unassigned += cnt;
+    for (int i = 0; i < cnt; i++) {
+      DropPacket(ctx, batch->pkts()[i]);
+    }
+    return;
+  }
+
+  Ipv4 *ips[bess::PacketBatch::kMaxBurst];
+  void *l4s[bess::PacketBatch::kMaxBurst];
+  Endpoint before[bess::PacketBatch::kMaxBurst];
+  int idx[bess::PacketBatch::kMaxBurst];
+  int n = 0;
+
+  // Pass 1: extract the endpoints to translate.
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    size_t ip_bytes = (ip->header_length) << 2;
+    void *l4 = reinterpret_cast<uint8_t *>(ip) + ip_bytes;
+
+    bool valid_protocol;
+    std::tie(valid_protocol, before[n]) = ExtractEndpoint(ip, l4, dir);
+    if (!valid_protocol ||
+        (before[n].port == be16_t(0) && before[n].protocol != IpProto::kIcmp)) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+
+    ips[n] = ip;
+    l4s[n] = l4;
+    idx[n++] = i;
+  }
+
+  // Pass 2: batched lookups. Endpoint and Cgnat::Key share their layout.
+  static_assert(sizeof(Endpoint) == sizeof(Cgnat::Key), "layout mismatch");
+  Cgnat::Key keys[bess::PacketBatch::kMaxBurst];
+  Cgnat::Key after[bess::PacketBatch::kMaxBurst];
+  memcpy(keys, before, n * sizeof(Endpoint));
+  bool found[bess::PacketBatch::kMaxBurst];
+
+  if (dir == kForward) {
+    w.partition->Translate(keys, n, ctx->current_ns, after, found);
+  } else {
+    cgnat_->ReverseBulk(keys, n, after, found);
+  }
+
+  // Pass 3: rewrite and emit, in order.
+  for (int j = 0; j < n; j++) {
+    bess::Packet *pkt = batch->pkts()[idx[j]];
+    if (!found[j]) {
+      DropPacket(ctx, pkt);
+      continue;
+    }
+    Endpoint translated;
+    memcpy(&translated, &after[j], sizeof(translated));
+    Stamp<dir>(ips[j], l4s[j], before[j], translated);
+    EmitPacket(ctx, pkt, ogate_idx);
+  }
+
+  if (dir == kForward) {
+    w.partition->Sweep(ctx->current_ns, kCgnatSweepSlots);
+  }
+}
+
 void NAT::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t incoming_gate = ctx->current_igate;
 
+  if (cgnat_) {
+    if (incoming_gate == 0) {
+      DoProcessBatchCgnat<kForward>(ctx, batch);
+    } else {
+      DoProcessBatchCgnat<kReverse>(ctx, batch);
+    }
+    return;
+  }
+
   if (incoming_gate == 0) {
     DoProcessBatch<kForward>(ctx, batch);
   } else {
@@ -375,6 +612,14 @@ void NAT::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 }
 
 std::string NAT::GetDesc() const {
+  if (cgnat_) {
+    size_t sessions = 0;
+    for (const CgnatWorker &w : cgnat_workers_) {
+      sessions += w.partition ? w.partition->sessions() : 0;
+    }
+    return bess::utils::Format("%zu sessions", sessions);
+  }
+
   // Divide by 2 since the table has both forward and reverse entries
   return bess::utils::Format("%zu entries", map_.Count() / 2);
 }
@@ -37,11 +37,13 @@
 #include <rte_hash_crc.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "../utils/cgnat.h"
 #include "../utils/cuckoo_map.h"
 #include "../utils/endian.h"
 #include "../utils/random.h"
@@ -65,6 +67,11 @@
 // Then the packet is updated to A':a' ===> B:b (with entry 1).
 // When a return packet B:b ===> A':a' comes in, the destination (since it is
 // reverse dir) endpoint is B:b ===> A:a (with entry 2).
+//
+// CGNAT mode (NATArg.cgnat) replaces the table above with bess::utils::Cgnat:
+// each internal address owns a fixed port block on one external address, and
+// each worker allocates ports from its own slice of every block, so the module
+// can run on many workers without sharing any per-flow state.
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
@@ -143,13 +150,20 @@ class NAT final : public Module {
 
   static const Commands cmds;
 
+  NAT() : Module(), next_partition_() {}
+
   CommandResponse Init(const bess::pb::NATArg &arg);
   CommandResponse GetInitialArg(const bess::pb::EmptyArg &arg);
   CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
   CommandResponse SetRuntimeConfig(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandGetCgnatStats(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandCgnatLookup(
+      const bess::pb::NATCommandCgnatLookupArg &arg);
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  void AddActiveWorker(int wid, const Task *task) override;
+
   // returns the number of active NAT entries (flows)
   std::string GetDesc() const override;
 
@@ -163,11 +177,24 @@ class NAT final : public Module {
   // how many times shall we try to find a free port number?
   static const int kMaxTrials = 128;
 
+  // CGNAT ports checked for idle sessions per batch, by each worker.
+  static const size_t kCgnatSweepSlots = 64;
+
+  struct alignas(64) CgnatWorker {
+    std::unique_ptr<bess::utils::Cgnat::Partition> partition;
+    uint64_t unassigned;  // packets dropped for lack of a partition
+  };
+
+  CommandResponse InitCgnat(const bess::pb::NATArg::CgnatConfig &arg);
+
   HashTable::Entry *CreateNewEntry(const Endpoint &internal, uint64_t now);
 
   template <Direction dir>
   void DoProcessBatch(Context *ctx, bess::PacketBatch *batch);
 
+  template <Direction dir>
+  void DoProcessBatchCgnat(Context *ctx, bess::PacketBatch *batch);
+
   std::vector<be32_t> ext_addrs_;
 
   // Port ranges available for each address. The first index is the same as the
@@ -176,6 +203,11 @@ class NAT final : public Module {
 
   HashTable map_;
   Random rng_;
+
+  // CGNAT mode only
+  std::unique_ptr<bess::utils::Cgnat> cgnat_;
+  CgnatWorker cgnat_workers_[Worker::kMaxWorkers];
+  int next_partition_;
 };
 
 #endif  // BESS_MODULES_NAT_H_
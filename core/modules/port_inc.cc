@@ -29,6 +29,7 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "port_inc.h"
+#include "../packet_trace.h"
 #include "../utils/format.h"
 
 const Commands PortInc::cmds = {
@@ -76,6 +77,16 @@ CommandResponse PortInc::Init(const bess::pb::PortIncArg &arg) {
     }
   }
 
+  if (bess::trace::enabled()) {
+    // bess::trace::AttachModule() picks this up as trace_attr_id().
+    int attr_id = AddMetadataAttr(
+        bess::trace::kAttrName, sizeof(uint64_t),
+        bess::metadata::Attribute::AccessMode::kWrite);
+    if (attr_id < 0) {
+      return CommandFailure(-attr_id);
+    }
+  }
+
   if (arg.prefetch()) {
     prefetch_ = 1;
   }
@@ -153,6 +164,10 @@ struct task_result PortInc::RunTask(Context *ctx, bess::PacketBatch *batch,
     p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
   }
 
+  if (trace_attr_id() >= 0) {
+    bess::trace::Stamp(ctx, this, trace_attr_id(), batch);
+  }
+
   RunNextModule(ctx, batch);
 
   return {.block = false,
@@ -9,6 +9,7 @@
 #include "utils/format.h"
 
 #include <rte_cycles.h>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -28,7 +29,11 @@ const Commands Qos::cmds = {
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&Qos::CommandClear),
      Command::THREAD_SAFE},
     {"set_default_gate", "QosCommandSetDefaultGateArg",
-     MODULE_CMD_FUNC(&Qos::CommandSetDefaultGate), Command::THREAD_SAFE}};
+     MODULE_CMD_FUNC(&Qos::CommandSetDefaultGate), Command::THREAD_SAFE},
+    {"get_runtime_config", "EmptyArg", MODULE_CMD_FUNC(&Qos::GetRuntimeConfig),
+     Command::THREAD_SAFE},
+    {"set_runtime_config", "QosConfig",
+     MODULE_CMD_FUNC(&Qos::SetRuntimeConfig), Command::THREAD_UNSAFE}};
 
 CommandResponse Qos::AddFieldOne(const bess::pb::Field &field,
                                  struct MeteringField *f, uint8_t type) {
@@ -349,7 +354,7 @@ CommandResponse Qos::CommandAdd(const bess::pb::QosCommandAddArg &arg) {
   MeteringKey key = {{0}};
 
   MKey l;
-  value v;
+  value v = {};
   v.ogate = gate;
   CommandResponse err = ExtractKeyMask(arg, &key, &v.Data, &l);
 
@@ -375,10 +380,9 @@ CommandResponse Qos::CommandAdd(const bess::pb::QosCommandAddArg &arg) {
                << " cir: " << cir << " pir: " << pir << " cbs: " << cbs
                << " pbs: " << pbs << " ebs: " << ebs << std::endl;
 
-    struct rte_meter_trtcm_params app_trtcm_params = {
-        .cir = cir, .pir = pir, .cbs = cbs, .pbs = pbs};
+    v.params = {.cir = cir, .pir = pir, .cbs = cbs, .pbs = pbs};
 
-    int ret = rte_meter_trtcm_profile_config(&v.p, &app_trtcm_params);
+    int ret = rte_meter_trtcm_profile_config(&v.p, &v.params);
     if (ret)
       return CommandFailure(
           ret, "Insert Failed - rte_meter_trtcm_profile_config failed");
@@ -411,6 +415,14 @@ void Qos::Clear() {
   table_.Clear();
 }
 
+void Qos::OnSocketChange() {
+  int ret = table_.MoveToSocket(socket());
+  if (ret) {
+    LOG(WARNING) << name() << ": failed to move meter table to socket "
+                 << socket() << ": " << strerror(-ret);
+  }
+}
+
 void Qos::DeInit() {
   table_.DeInit();
 }
@@ -421,6 +433,52 @@ CommandResponse Qos::CommandSetDefaultGate(
   return CommandSuccess();
 }
 
+// Reads the `size`-byte little-endian integer at `pos` of `data`.
+static uint64_t ReadField(const void *data, int pos, int size) {
+  uint64_t v = 0;
+  memcpy(&v, reinterpret_cast<const uint8_t *>(data) + pos, size);
+  return v;
+}
+
+// Retrieves a QosConfig that would restore this module's runtime
+// configuration, from the meter table itself. Fields and values are reported
+// as integers, and `ebs`, which trTCM meters do not use, as 0.
+CommandResponse Qos::GetRuntimeConfig(const bess::pb::EmptyArg &) {
+  bess::pb::QosConfig r;
+
+  r.set_default_gate(default_gate_);
+  table_.ForEach([&](const MeteringKey &key, const value &v) {
+    bess::pb::QosCommandAddArg *rule = r.add_rules();
+    rule->set_gate(v.ogate);
+    if (v.ogate == METER_GATE) {
+      rule->set_cir(v.params.cir);
+      rule->set_pir(v.params.pir);
+      rule->set_cbs(v.params.cbs);
+      rule->set_pbs(v.params.pbs);
+      rule->set_deduct_len(v.deduct_len);
+    }
+    for (const auto &f : fields_) {
+      rule->add_fields()->set_value_int(ReadField(&key, f.pos, f.size));
+    }
+    for (const auto &f : values_) {
+      rule->add_values()->set_value_int(ReadField(&v.Data, f.pos, f.size));
+    }
+  });
+  return CommandSuccess(r);
+}
+
+CommandResponse Qos::SetRuntimeConfig(const bess::pb::QosConfig &arg) {
+  Qos::Clear();
+  default_gate_ = arg.default_gate();
+  for (const auto &rule : arg.rules()) {
+    CommandResponse err = Qos::CommandAdd(rule);
+    if (err.error().code() != 0) {
+      return err;
+    }
+  }
+  return CommandSuccess();
+}
+
 std::string Qos::GetDesc() const {
   return bess::utils::Format("%zu fields, %zu rules", fields_.size(),
                              table_.Count());
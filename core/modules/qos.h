@@ -38,6 +38,9 @@ enum { FieldType = 0, ValueType };
 struct value {
   gate_idx_t ogate;
   int64_t deduct_len;
+  // The rates and burst sizes `p` was configured with, which it does not
+  // keep as such, for get_runtime_config.
+  struct rte_meter_trtcm_params params;
   struct rte_meter_trtcm_profile p;
   struct rte_meter_trtcm m;
   MeteringKey Data;
@@ -68,6 +71,8 @@ class Qos final : public Module {
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
   CommandResponse CommandSetDefaultGate(
       const bess::pb::QosCommandSetDefaultGateArg &arg);
+  CommandResponse GetRuntimeConfig(const bess::pb::EmptyArg &arg);
+  CommandResponse SetRuntimeConfig(const bess::pb::QosConfig &arg);
   template <typename T>
   CommandResponse ExtractKeyMask(const T &arg, MeteringKey *key,
                                  MeteringKey *val, MKey *l);
@@ -80,6 +85,7 @@ class Qos final : public Module {
   std::string GetDesc() const override;
 
  private:
+  void OnSocketChange() override;
   int DelEntry(MeteringKey *key);
   void Clear();
   gate_idx_t default_gate_;
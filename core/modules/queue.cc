@@ -30,7 +30,9 @@
 
 #include "queue.h"
 
+#include <cinttypes>
 #include <cstdlib>
+#include <new>
 
 #include "../utils/format.h"
 
@@ -51,6 +53,37 @@ const Commands Queue::cmds = {
      MODULE_CMD_FUNC(&Queue::SetRuntimeConfig), Command::THREAD_UNSAFE}};
 
 int Queue::Resize(int slots) {
+  if (use_mpmc_) {
+    bess::utils::MpmcRing *old_queue = mpmc_queue_;
+    bess::utils::MpmcRing *new_queue =
+        new (std::nothrow) bess::utils::MpmcRing(slots);
+    if (!new_queue) {
+      return -ENOMEM;
+    }
+
+    /* migrate packets from the old queue */
+    if (old_queue) {
+      void *pkt;
+
+      while (old_queue->Dequeue(&pkt) == 0) {
+        if (new_queue->Enqueue(pkt) != 0) {
+          bess::Packet::Free(static_cast<bess::Packet *>(pkt));
+        }
+      }
+
+      delete old_queue;
+    }
+
+    mpmc_queue_ = new_queue;
+    size_ = slots;
+
+    if (backpressure_) {
+      AdjustWaterLevels();
+    }
+
+    return 0;
+  }
+
   struct llring *old_queue = queue_;
   struct llring *new_queue;
 
@@ -92,6 +125,15 @@ int Queue::Resize(int slots) {
   return 0;
 }
 
+void Queue::Drain() {
+  bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+  uint32_t cnt;
+
+  while ((cnt = Dequeue(pkts, bess::PacketBatch::kMaxBurst)) > 0) {
+    bess::Packet::Free(pkts, cnt);
+  }
+}
+
 CommandResponse Queue::Init(const bess::pb::QueueArg &arg) {
   task_id_t tid;
   CommandResponse err;
@@ -102,6 +144,7 @@ CommandResponse Queue::Init(const bess::pb::QueueArg &arg) {
   }
 
   burst_ = bess::PacketBatch::kMaxBurst;
+  use_mpmc_ = arg.mpmc_ring();
 
   if (arg.backpressure()) {
     VLOG(1) << "Backpressure enabled for " << name() << "::Queue";
@@ -137,10 +180,16 @@ CommandResponse Queue::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   ret.set_size(size_);
   ret.set_prefetch(prefetch_);
   ret.set_backpressure(backpressure_);
+  ret.set_mpmc_ring(use_mpmc_);
   return CommandSuccess(ret);
 }
 
 CommandResponse Queue::SetRuntimeConfig(const bess::pb::QueueArg &arg) {
+  // proto3 cannot tell an omitted bool from false, so only a request to
+  // switch an llring-backed queue to MPMC is treated as a change.
+  if (arg.mpmc_ring() && !use_mpmc_) {
+    return CommandFailure(EINVAL, "mpmc_ring cannot be changed at runtime");
+  }
   if (size_ != arg.size() && arg.size() != 0) {
     CommandResponse err = SetSize(arg.size());
     if (err.error().code() != 0) {
@@ -153,27 +202,21 @@ CommandResponse Queue::SetRuntimeConfig(const bess::pb::QueueArg &arg) {
 }
 
 void Queue::DeInit() {
-  bess::Packet *pkt;
-
-  if (queue_) {
-    while (llring_sc_dequeue(queue_, (void **)&pkt) == 0) {
-      bess::Packet::Free(pkt);
-    }
-    std::free(queue_);
+  if (queue_ || mpmc_queue_) {
+    Drain();
   }
+  std::free(queue_);
+  delete mpmc_queue_;
 }
 
 std::string Queue::GetDesc() const {
-  const struct llring *ring = queue_;
-
-  return bess::utils::Format("%u/%u", llring_count(ring), ring->common.slots);
+  return bess::utils::Format("%u/%" PRIu64, Count(), size_);
 }
 
 /* from upstream */
 void Queue::ProcessBatch(Context *, bess::PacketBatch *batch) {
-  int queued =
-      llring_mp_enqueue_burst(queue_, (void **)batch->pkts(), batch->cnt());
-  if (backpressure_ && llring_count(queue_) > high_water_) {
+  int queued = Enqueue(batch->pkts(), batch->cnt());
+  if (backpressure_ && Count() > high_water_) {
     SignalOverload();
   }
 
@@ -202,7 +245,7 @@ struct task_result Queue::RunTask(Context *ctx, bess::PacketBatch *batch,
 
   uint64_t total_bytes = 0;
 
-  uint32_t cnt = llring_sc_dequeue_burst(queue_, (void **)batch->pkts(), burst);
+  uint32_t cnt = Dequeue(batch->pkts(), burst);
 
   if (cnt == 0) {
     return {.block = true, .packets = 0, .bits = 0};
@@ -224,7 +267,7 @@ struct task_result Queue::RunTask(Context *ctx, bess::PacketBatch *batch,
 
   RunNextModule(ctx, batch);
 
-  if (backpressure_ && llring_count(queue_) < low_water_) {
+  if (backpressure_ && Count() < low_water_) {
     SignalUnderload();
   }
 
@@ -271,7 +314,7 @@ CommandResponse Queue::CommandSetSize(
 CommandResponse Queue::CommandGetStatus(
     const bess::pb::QueueCommandGetStatusArg &) {
   bess::pb::QueueCommandGetStatusResponse resp;
-  resp.set_count(llring_count(queue_));
+  resp.set_count(Count());
   resp.set_size(size_);
   resp.set_enqueued(stats_.enqueued);
   resp.set_dequeued(stats_.dequeued);
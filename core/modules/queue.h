@@ -34,6 +34,7 @@
 #include "../kmod/llring.h"
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/mpmc_ring.h"
 
 class Queue : public Module {
  public:
@@ -42,6 +43,8 @@ class Queue : public Module {
   Queue()
       : Module(),
         queue_(),
+        mpmc_queue_(),
+        use_mpmc_(),
         prefetch_(),
         backpressure_(),
         burst_(),
@@ -80,12 +83,41 @@ class Queue : public Module {
 
   int Resize(int slots);
 
+  // Dispatch to whichever ring backs this queue.
+  uint32_t Enqueue(bess::Packet **pkts, uint32_t cnt) {
+    if (use_mpmc_) {
+      return mpmc_queue_->EnqueueBurst(reinterpret_cast<void **>(pkts), cnt);
+    }
+    return llring_mp_enqueue_burst(queue_, reinterpret_cast<void **>(pkts),
+                                   cnt);
+  }
+
+  uint32_t Dequeue(bess::Packet **pkts, uint32_t cnt) {
+    if (use_mpmc_) {
+      return mpmc_queue_->DequeueBurst(reinterpret_cast<void **>(pkts), cnt);
+    }
+    return llring_sc_dequeue_burst(queue_, reinterpret_cast<void **>(pkts),
+                                   cnt);
+  }
+
+  uint32_t Count() const {
+    return use_mpmc_ ? mpmc_queue_->Count() : llring_count(queue_);
+  }
+
+  // Frees all packets still held in the queue.
+  void Drain();
+
   // Readjusts the water level according to `size_`.
   void AdjustWaterLevels();
 
   CommandResponse SetSize(uint64_t size);
 
   struct llring *queue_;
+
+  // Batch-optimized ring used instead of `queue_` when `use_mpmc_` is set
+  bess::utils::MpmcRing *mpmc_queue_;
+  bool use_mpmc_;
+
   bool prefetch_;
 
   // Whether backpressure should be applied or not
@@ -30,6 +30,7 @@
 
 #include "queue_inc.h"
 
+#include "../packet_trace.h"
 #include "../port.h"
 #include "../utils/format.h"
 
@@ -55,6 +56,16 @@ CommandResponse QueueInc::Init(const bess::pb::QueueIncArg &arg) {
   port_ = it->second;
   burst_ = bess::PacketBatch::kMaxBurst;
 
+  if (bess::trace::enabled()) {
+    // bess::trace::AttachModule() picks this up as trace_attr_id().
+    int attr_id = AddMetadataAttr(
+        bess::trace::kAttrName, sizeof(uint64_t),
+        bess::metadata::Attribute::AccessMode::kWrite);
+    if (attr_id < 0) {
+      return CommandFailure(-attr_id);
+    }
+  }
+
   if (arg.prefetch()) {
     prefetch_ = 1;
   }
@@ -125,6 +136,10 @@ struct task_result QueueInc::RunTask(Context *ctx, bess::PacketBatch *batch,
     p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
   }
 
+  if (trace_attr_id() >= 0) {
+    bess::trace::Stamp(ctx, this, trace_attr_id(), batch);
+  }
+
   RunNextModule(ctx, batch);
 
   return {.block = false,
@@ -29,6 +29,8 @@
 
 #include "replicate.h"
 
+#include "../packet_trace.h"
+
 const Commands Replicate::cmds = {
     {"set_gates", "ReplicateCommandSetGatesArg",
      MODULE_CMD_FUNC(&Replicate::CommandSetGates), Command::THREAD_UNSAFE},
@@ -71,6 +73,7 @@ void Replicate::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     for (int j = 1; j < ngates_; j++) {
       bess::Packet *newpkt = bess::Packet::copy(tocopy);
       if (newpkt) {
+        bess::trace::Clear(this, newpkt);
         EmitPacket(ctx, newpkt, gates_[j]);
       }
     }
@@ -0,0 +1,364 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "sdf_classifier.h"
+
+#include <string>
+
+#include "../utils/ether.h"
+#include "../utils/format.h"
+#include "../utils/ip.h"
+#include "../utils/udp.h"
+#include "../worker.h"
+
+using bess::metadata::Attribute;
+
+// XXX: this is repeated in many modules. get rid of them when converting .h to
+// .hh, etc... it's in defined in some old header
+static inline int is_valid_gate(gate_idx_t gate) {
+  return (gate < MAX_GATES || gate == DROP_GATE);
+}
+
+// Parses "a.b.c.d/len" (or "a.b.c.d" for a host address) into a range of
+// host-order addresses. An empty string matches any address.
+static bool ParsePrefix(const std::string &str, HyperSplit::Range *range) {
+  using bess::utils::be32_t;
+
+  if (str.empty()) {
+    *range = HyperSplit::FullRange(HyperSplit::kSrcIp);
+    return true;
+  }
+
+  size_t delim_pos = str.find('/');
+  int len = 32;
+  if (delim_pos != std::string::npos) {
+    const std::string len_str = str.substr(delim_pos + 1);
+    if (len_str.empty() ||
+        len_str.find_first_not_of("0123456789") != std::string::npos ||
+        len_str.size() > 2) {
+      return false;
+    }
+    len = std::stoi(len_str);
+    if (len > 32) {
+      return false;
+    }
+  }
+
+  be32_t addr;
+  if (!bess::utils::ParseIpv4Address(str.substr(0, delim_pos), &addr)) {
+    return false;
+  }
+
+  *range = HyperSplit::PrefixRange(addr.value(), len);
+  return true;
+}
+
+static bool ParsePortRange(uint32_t lo, uint32_t hi, HyperSplit::Range *range) {
+  if (lo == 0 && hi == 0) {
+    *range = HyperSplit::FullRange(HyperSplit::kSrcPort);
+    return true;
+  }
+  if (lo > hi || hi > UINT16_MAX) {
+    return false;
+  }
+  *range = {lo, hi};
+  return true;
+}
+
+const Commands SdfClassifier::cmds = {
+    {"add", "SdfClassifierCommandAddArg",
+     MODULE_CMD_FUNC(&SdfClassifier::CommandAdd), Command::THREAD_SAFE},
+    {"delete", "SdfClassifierCommandDeleteArg",
+     MODULE_CMD_FUNC(&SdfClassifier::CommandDelete), Command::THREAD_SAFE},
+    {"clear", "EmptyArg", MODULE_CMD_FUNC(&SdfClassifier::CommandClear),
+     Command::THREAD_SAFE},
+    {"commit", "EmptyArg", MODULE_CMD_FUNC(&SdfClassifier::CommandCommit),
+     Command::THREAD_SAFE},
+    {"set_default_gate", "SdfClassifierCommandSetDefaultGateArg",
+     MODULE_CMD_FUNC(&SdfClassifier::CommandSetDefaultGate),
+     Command::THREAD_SAFE}};
+
+CommandResponse SdfClassifier::Init(const bess::pb::SdfClassifierArg &arg) {
+  if (arg.leaf_size()) {
+    leaf_size_ = arg.leaf_size();
+  }
+
+  if (!arg.result_attr().empty()) {
+    result_attr_id_ = AddMetadataAttr(arg.result_attr(), sizeof(uint64_t),
+                                      Attribute::AccessMode::kWrite);
+    if (result_attr_id_ < 0) {
+      return CommandFailure(-result_attr_id_, "add_metadata_attr() failed");
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &rule : arg.rules()) {
+    RuleEntry entry;
+    CommandResponse err = ParseRule(rule, &entry);
+    if (err.has_error()) {
+      return err;
+    }
+    rules_[rule.id()] = entry;
+  }
+
+  Rebuild();
+  return CommandSuccess();
+}
+
+void SdfClassifier::DeInit() {
+  // The module is detached from all workers at this point
+  delete tree_.exchange(nullptr);
+}
+
+std::string SdfClassifier::GetDesc() const {
+  const Tree *tree = tree_.load();
+  if (!tree) {
+    return "0 rules";
+  }
+  return bess::utils::Format("%zu rules, %zu nodes, depth %zu",
+                             tree->engine.num_rules(), tree->engine.num_nodes(),
+                             tree->engine.max_depth());
+}
+
+CommandResponse SdfClassifier::ParseRule(
+    const bess::pb::SdfClassifierRule &rule, RuleEntry *entry) const {
+  HyperSplit::Rule *r = &entry->rule;
+
+  if (!is_valid_gate(rule.gate())) {
+    return CommandFailure(EINVAL, "rule %u: invalid gate %u", rule.id(),
+                          rule.gate());
+  }
+
+  if (!ParsePrefix(rule.src_ip(), &r->ranges[HyperSplit::kSrcIp])) {
+    return CommandFailure(EINVAL, "rule %u: invalid src_ip '%s'", rule.id(),
+                          rule.src_ip().c_str());
+  }
+  if (!ParsePrefix(rule.dst_ip(), &r->ranges[HyperSplit::kDstIp])) {
+    return CommandFailure(EINVAL, "rule %u: invalid dst_ip '%s'", rule.id(),
+                          rule.dst_ip().c_str());
+  }
+  if (!ParsePortRange(rule.src_port_lo(), rule.src_port_hi(),
+                      &r->ranges[HyperSplit::kSrcPort])) {
+    return CommandFailure(EINVAL, "rule %u: invalid src port range %u-%u",
+                          rule.id(), rule.src_port_lo(), rule.src_port_hi());
+  }
+  if (!ParsePortRange(rule.dst_port_lo(), rule.dst_port_hi(),
+                      &r->ranges[HyperSplit::kDstPort])) {
+    return CommandFailure(EINVAL, "rule %u: invalid dst port range %u-%u",
+                          rule.id(), rule.dst_port_lo(), rule.dst_port_hi());
+  }
+
+  if (rule.ip_proto() > UINT8_MAX) {
+    return CommandFailure(EINVAL, "rule %u: invalid ip_proto %u", rule.id(),
+                          rule.ip_proto());
+  } else if (rule.ip_proto() == 0) {
+    r->ranges[HyperSplit::kProto] = HyperSplit::FullRange(HyperSplit::kProto);
+  } else {
+    r->ranges[HyperSplit::kProto] = {rule.ip_proto(), rule.ip_proto()};
+  }
+
+  r->priority = rule.priority();
+  r->id = 0;  // assigned by Rebuild()
+
+  entry->action.gate = rule.gate();
+  entry->action.result = rule.result();
+  return CommandSuccess();
+}
+
+void SdfClassifier::Rebuild() {
+  Tree *tree = new Tree(leaf_size_);
+  std::vector<HyperSplit::Rule> rules;
+
+  rules.reserve(rules_.size());
+  tree->actions.reserve(rules_.size());
+  for (const auto &it : rules_) {
+    HyperSplit::Rule rule = it.second.rule;
+    rule.id = tree->actions.size();
+    rules.push_back(rule);
+    tree->actions.push_back(it.second.action);
+  }
+
+  tree->engine.Build(rules);
+  pending_ = false;
+
+  Tree *old_tree = tree_.exchange(tree);
+  if (old_tree) {
+    // Wait until no worker can still be traversing the old tree
+    synchronize_workers();
+    delete old_tree;
+  }
+}
+
+CommandResponse SdfClassifier::CommandAdd(
+    const bess::pb::SdfClassifierCommandAddArg &arg) {
+  std::vector<RuleEntry> entries(arg.rules_size());
+
+  for (int i = 0; i < arg.rules_size(); i++) {
+    CommandResponse err = ParseRule(arg.rules(i), &entries[i]);
+    if (err.has_error()) {
+      return err;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < arg.rules_size(); i++) {
+    rules_[arg.rules(i).id()] = entries[i];
+  }
+
+  if (arg.defer()) {
+    pending_ = true;
+  } else {
+    Rebuild();
+  }
+  return CommandSuccess();
+}
+
+CommandResponse SdfClassifier::CommandDelete(
+    const bess::pb::SdfClassifierCommandDeleteArg &arg) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (uint32_t id : arg.ids()) {
+    if (rules_.find(id) == rules_.end()) {
+      return CommandFailure(ENOENT, "rule %u does not exist", id);
+    }
+  }
+
+  for (uint32_t id : arg.ids()) {
+    rules_.erase(id);
+  }
+
+  if (arg.defer()) {
+    pending_ = true;
+  } else {
+    Rebuild();
+  }
+  return CommandSuccess();
+}
+
+CommandResponse SdfClassifier::CommandClear(const bess::pb::EmptyArg &) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  rules_.clear();
+  Rebuild();
+  return CommandSuccess();
+}
+
+CommandResponse SdfClassifier::CommandCommit(const bess::pb::EmptyArg &) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (pending_) {
+    Rebuild();
+  }
+  return CommandSuccess();
+}
+
+CommandResponse SdfClassifier::CommandSetDefaultGate(
+    const bess::pb::SdfClassifierCommandSetDefaultGateArg &arg) {
+  if (!is_valid_gate(arg.gate())) {
+    return CommandFailure(EINVAL, "invalid gate %u", arg.gate());
+  }
+  default_gate_ = arg.gate();
+  return CommandSuccess();
+}
+
+void SdfClassifier::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  using bess::utils::be16_t;
+  using bess::utils::Ethernet;
+  using bess::utils::Ipv4;
+  using bess::utils::Udp;
+
+  // Keys of classifiable (IPv4) packets, compacted to the front
+  HyperSplit::Key keys[bess::PacketBatch::kMaxBurst];
+  const HyperSplit::Rule *matches[bess::PacketBatch::kMaxBurst];
+  int key_idx[bess::PacketBatch::kMaxBurst];  // packet index -> key, or -1
+
+  const Tree *tree = tree_.load(std::memory_order_acquire);
+  gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+
+  int cnt = batch->cnt();
+  int n_keys = 0;
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    key_idx[i] = -1;
+
+    Ethernet *eth = pkt->head_data<Ethernet *>();
+    if (pkt->head_len() < sizeof(*eth) + sizeof(Ipv4) ||
+        eth->ether_type != be16_t(Ethernet::Type::kIpv4)) {
+      continue;
+    }
+
+    Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+    size_t ip_bytes = ip->header_length << 2;
+    HyperSplit::Key *key = &keys[n_keys];
+
+    key->fields[HyperSplit::kSrcIp] = ip->src.value();
+    key->fields[HyperSplit::kDstIp] = ip->dst.value();
+    key->fields[HyperSplit::kProto] = ip->protocol;
+    key->fields[HyperSplit::kSrcPort] = 0;
+    key->fields[HyperSplit::kDstPort] = 0;
+
+    // Only the first fragment (offset 0) carries the L4 header
+    bool first_frag = (ip->fragment_offset & be16_t(0x1fff)) == be16_t(0);
+    if ((ip->protocol == Ipv4::Proto::kTcp ||
+         ip->protocol == Ipv4::Proto::kUdp) &&
+        first_frag &&
+        pkt->head_len() >= sizeof(*eth) + ip_bytes + sizeof(Udp)) {
+      Udp *udp =
+          reinterpret_cast<Udp *>(reinterpret_cast<uint8_t *>(ip) + ip_bytes);
+      key->fields[HyperSplit::kSrcPort] = udp->src_port.value();
+      key->fields[HyperSplit::kDstPort] = udp->dst_port.value();
+    }
+
+    key_idx[i] = n_keys++;
+  }
+
+  if (tree) {
+    tree->engine.MatchBatch(keys, n_keys, matches);
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    const HyperSplit::Rule *match =
+        (tree && key_idx[i] >= 0) ? matches[key_idx[i]] : nullptr;
+
+    if (!match) {
+      EmitPacket(ctx, pkt, default_gate);
+      continue;
+    }
+
+    const Action &action = tree->actions[match->id];
+    if (result_attr_id_ >= 0) {
+      set_attr<uint64_t>(this, result_attr_id_, pkt, action.result);
+    }
+    EmitPacket(ctx, pkt, action.gate);
+  }
+}
+
+ADD_MODULE(SdfClassifier, "sdf_classifier",
+           "classifies packets with 5-tuple range/prefix filters")
@@ -0,0 +1,123 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_MODULES_SDF_CLASSIFIER_H_
+#define BESS_MODULES_SDF_CLASSIFIER_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "../module.h"
+#include "../pb/module_msg.pb.h"
+#include "../utils/hyper_split.h"
+
+using bess::utils::HyperSplit;
+
+// SdfClassifier matches packets against 5-tuple filters with port ranges,
+// address prefixes and priorities (e.g., 5G SDF filters of PDRs). Rules are
+// compiled into a HyperSplit decision tree on the control path and swapped
+// into the datapath atomically, so workers never block on rule updates.
+class SdfClassifier final : public Module {
+ public:
+  static const gate_idx_t kNumOGates = MAX_GATES;
+
+  static const Commands cmds;
+
+  SdfClassifier()
+      : Module(),
+        default_gate_(DROP_GATE),
+        result_attr_id_(-1),
+        leaf_size_(HyperSplit::kDefaultLeafSize),
+        tree_(nullptr),
+        mutex_(),
+        rules_(),
+        pending_() {
+    max_allowed_workers_ = Worker::kMaxWorkers;
+  }
+
+  CommandResponse Init(const bess::pb::SdfClassifierArg &arg);
+
+  void DeInit() override;
+
+  void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+  std::string GetDesc() const override;
+
+  CommandResponse CommandAdd(const bess::pb::SdfClassifierCommandAddArg &arg);
+  CommandResponse CommandDelete(
+      const bess::pb::SdfClassifierCommandDeleteArg &arg);
+  CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandCommit(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandSetDefaultGate(
+      const bess::pb::SdfClassifierCommandSetDefaultGateArg &arg);
+
+ private:
+  struct Action {
+    gate_idx_t gate;
+    uint64_t result;
+  };
+
+  // An immutable, compiled snapshot of the rule set
+  struct Tree {
+    explicit Tree(size_t leaf_size) : engine(leaf_size) {}
+
+    HyperSplit engine;
+    std::vector<Action> actions;  // indexed by HyperSplit::Rule::id
+  };
+
+  struct RuleEntry {
+    HyperSplit::Rule rule;
+    Action action;
+  };
+
+  CommandResponse ParseRule(const bess::pb::SdfClassifierRule &rule,
+                            RuleEntry *entry) const;
+
+  // Compiles rules_ into a new Tree and publishes it to the datapath.
+  void Rebuild();
+
+  gate_idx_t default_gate_;
+  int result_attr_id_;
+  size_t leaf_size_;
+
+  std::atomic<Tree *> tree_;
+
+  // Control-path copy of the rule set, keyed by rule id. Commands only
+  // touch this (never the published Tree), under mutex_.
+  std::mutex mutex_;
+  std::map<uint32_t, RuleEntry> rules_;
+
+  // True if rules_ has deferred changes not yet compiled into tree_.
+  bool pending_;
+};
+
+#endif  // BESS_MODULES_SDF_CLASSIFIER_H_
@@ -30,13 +30,17 @@
 #include "url_filter.h"
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <tuple>
 
+#include "../packet_trace.h"
 #include "../utils/checksum.h"
 #include "../utils/ether.h"
 #include "../utils/format.h"
 #include "../utils/http_parser.h"
 #include "../utils/ip.h"
+#include "../utils/tls.h"
 
 using bess::utils::Ethernet;
 using bess::utils::Ipv4;
@@ -92,6 +96,7 @@ struct[[gnu::packed]] PacketTemplate {
 };
 
 static const char HTTP_HEADER_HOST[] = "Host";
+static const char TLS_CONTENT_HANDSHAKE = 0x16;
 static const char HTTP_403_BODY[] =
     "HTTP/1.1 403 Bad Forbidden\r\nConnection: Closed\r\n\r\n";
 
@@ -173,20 +178,102 @@ inline static bess::Packet *GenerateResetPacket(
   return pkt;
 }
 
-CommandResponse UrlFilter::Init(const bess::pb::UrlFilterArg &arg) {
+// Lowercases `domain` and strips a leading "*." or "." and a trailing ".".
+static std::string NormalizeDomain(const std::string &domain) {
+  size_t begin = 0;
+  size_t end = domain.size();
+  if (domain.compare(0, 2, "*.") == 0) {
+    begin = 2;
+  } else if (domain.compare(0, 1, ".") == 0) {
+    begin = 1;
+  }
+  if (end > begin && domain[end - 1] == '.') {
+    end--;
+  }
+  std::string ret = domain.substr(begin, end - begin);
+  std::transform(ret.begin(), ret.end(), ret.begin(), ::tolower);
+  return ret;
+}
+
+// Normalizes `domains` into `out`. Returns false, with `*bad` set to the
+// offending entry, if any of them is empty once normalized.
+static bool NormalizeDomains(
+    const google::protobuf::RepeatedPtrField<std::string> &domains,
+    std::vector<std::string> *out, std::string *bad) {
+  for (const auto &domain : domains) {
+    out->push_back(NormalizeDomain(domain));
+    if (out->back().empty()) {
+      *bad = domain;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Builds a matcher of the reversed, "."-terminated forms of `domains`.
+static void CompileDomains(const std::set<std::string> &domains,
+                           AhoCorasick *matcher) {
+  std::vector<std::string> patterns;
+  patterns.reserve(domains.size());
+  for (const auto &domain : domains) {
+    patterns.emplace_back(domain.rbegin(), domain.rend());
+    patterns.back().push_back('.');
+  }
+  matcher->Build(patterns);
+}
+
+CommandResponse UrlFilter::AddRules(const bess::pb::UrlFilterArg &arg) {
+  std::vector<std::string> domains;
+  std::string bad;
+  if (!NormalizeDomains(arg.domains(), &domains, &bad)) {
+    return CommandFailure(EINVAL, "invalid domain '%s'", bad.c_str());
+  }
+
   for (const auto &url : arg.blacklist()) {
     blacklist_[url.host()].Insert(url.path(), {});
   }
+
+  if (!domains.empty()) {
+    domains_.insert(domains.begin(), domains.end());
+    CompileDomains(domains_, &domain_matcher_);
+  }
   return CommandSuccess();
 }
 
+bool UrlFilter::MatchDomain(const char *host, size_t len) const {
+  if (domains_.empty()) {
+    return false;
+  }
+
+  const char *colon = static_cast<const char *>(memchr(host, ':', len));
+  if (colon) {
+    len = colon - host;
+  }
+  if (len > 0 && host[len - 1] == '.') {
+    len--;
+  }
+
+  char buf[256];
+  if (len == 0 || len >= sizeof(buf)) {
+    return false;
+  }
+  std::reverse_copy(host, host + len, buf);
+  buf[len] = '.';
+  return domain_matcher_.MatchPrefix(buf, len + 1) >= 0;
+}
+
+CommandResponse UrlFilter::Init(const bess::pb::UrlFilterArg &arg) {
+  return AddRules(arg);
+}
+
 CommandResponse UrlFilter::CommandAdd(const bess::pb::UrlFilterArg &arg) {
-  Init(arg);
-  return CommandSuccess();
+  return AddRules(arg);
 }
 
 CommandResponse UrlFilter::CommandClear(const bess::pb::EmptyArg &) {
   blacklist_.clear();
+  domains_.clear();
+  CompileDomains(domains_, &domain_matcher_);
   return CommandSuccess();
 }
 
@@ -194,8 +281,12 @@ CommandResponse UrlFilter::CommandClear(const bess::pb::EmptyArg &) {
 // such a way that SetRuntimeConfig would build the same one.
 CommandResponse UrlFilter::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::UrlFilterArg resp;
-  // Our return value is empty since we return
-  // the current blacklist as the runtime config.
+  // The blocked domains are reported here, so that a module re-created from
+  // this argument alone already filters by them. The blacklist is left to
+  // the runtime config.
+  for (const auto &domain : domains_) {
+    resp.add_domains(domain);
+  }
   return CommandSuccess(resp);
 }
 
@@ -220,19 +311,45 @@ CommandResponse UrlFilter::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   std::stable_sort(
       resp.mutable_blacklist()->begin(), resp.mutable_blacklist()->end(),
       [](const rule_t &a, const rule_t &b) { return a.host() < b.host(); });
+  for (const auto &domain : domains_) {
+    resp.add_domains(domain);
+  }
   return CommandSuccess(resp);
 }
 
-// Restores the module's configuration.
+// Restores the module's configuration. The new rules are built on the side
+// and swapped in only once they are all valid, so that a bad config leaves
+// the current rules in place.
 CommandResponse UrlFilter::SetRuntimeConfig(
     const bess::pb::UrlFilterConfig &arg) {
-  blacklist_.clear();
+  std::vector<std::string> normalized;
+  std::string bad;
+  if (!NormalizeDomains(arg.domains(), &normalized, &bad)) {
+    return CommandFailure(EINVAL, "invalid domain '%s'", bad.c_str());
+  }
+
+  std::unordered_map<std::string, Trie<std::tuple<>>> blacklist;
   for (const auto &url : arg.blacklist()) {
-    blacklist_[url.host()].Insert(url.path(), {});
+    blacklist[url.host()].Insert(url.path(), {});
   }
+
+  std::set<std::string> domains(normalized.begin(), normalized.end());
+  AhoCorasick domain_matcher;
+  CompileDomains(domains, &domain_matcher);
+
+  blacklist_.swap(blacklist);
+  domains_.swap(domains);
+  std::swap(domain_matcher_, domain_matcher);
   return CommandSuccess();
 }
 
+void UrlFilter::EmitGenerated(Context *ctx, bess::Packet *pkt,
+                              gate_idx_t ogate) {
+  // The buffer may still hold the trace stamp of a packet freed earlier.
+  bess::trace::Clear(this, pkt);
+  EmitPacket(ctx, pkt, ogate);
+}
+
 void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t igate = ctx->current_igate;
 
@@ -320,26 +437,46 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     // We are by definition still analyzing.  See if we can determine
     // the final disposition of this flow.
     bool matched = false;
-    struct phr_header headers[16];
-    size_t num_headers = 16, method_len, path_len;
-    int minor_version;
-    const char *method, *path;
-    int parse_result = phr_parse_request(
-        buffer.buf(), buffer.contiguous_len(), &method, &method_len, &path,
-        &path_len, &minor_version, headers, &num_headers, 0);
-
-    // -2 means incomplete
-    if (parse_result > 0 || parse_result == -2) {
-      const std::string path_str(path, path_len);
-
-      // Look for the Host header
-      for (size_t j = 0; j < num_headers && !matched; ++j) {
-        if (strncmp(headers[j].name, HTTP_HEADER_HOST, headers[j].name_len) ==
-            0) {
-          const std::string host(headers[j].value, headers[j].value_len);
-          const auto rule_iterator = blacklist_.find(host);
-          matched = rule_iterator != blacklist_.end() &&
-                    rule_iterator->second.Match(path_str);
+    bool incomplete;
+    bool tls = buffer.contiguous_len() > 0 &&
+               buffer.buf()[0] == TLS_CONTENT_HANDSHAKE;
+
+    if (tls) {
+      // HTTPS: the only thing we can see is the SNI of the ClientHello.
+      const char *name;
+      size_t name_len;
+      int parse_result =
+          bess::utils::ParseTlsSni(buffer.buf(), buffer.contiguous_len(),
+                                   &name, &name_len, &tls_scratch_);
+      incomplete = parse_result == -2;
+      // A ClientHello too large to inspect may hide a blocked name; do not
+      // let it through.
+      matched = (parse_result == 0 && MatchDomain(name, name_len)) ||
+                (parse_result == -3 && !domains_.empty());
+    } else {
+      struct phr_header headers[16];
+      size_t num_headers = 16, method_len, path_len;
+      int minor_version;
+      const char *method, *path;
+      int parse_result = phr_parse_request(
+          buffer.buf(), buffer.contiguous_len(), &method, &method_len, &path,
+          &path_len, &minor_version, headers, &num_headers, 0);
+
+      // -2 means incomplete
+      incomplete = parse_result == -2;
+      if (parse_result > 0 || parse_result == -2) {
+        const std::string path_str(path, path_len);
+
+        // Look for the Host header
+        for (size_t j = 0; j < num_headers && !matched; ++j) {
+          if (strncmp(headers[j].name, HTTP_HEADER_HOST,
+                      headers[j].name_len) == 0) {
+            const std::string host(headers[j].value, headers[j].value_len);
+            const auto rule_iterator = blacklist_.find(host);
+            matched = (rule_iterator != blacklist_.end() &&
+                       rule_iterator->second.Match(path_str)) ||
+                      MatchDomain(host.data(), host.size());
+          }
         }
       }
     }
@@ -351,33 +488,51 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       // to pass the flow, there is no more need to reconstruct the flow.
       // NOTE: if FIN is lost on its way to destination, this will simply pass
       // the retransmitted packet.
-      if (parse_result != -2 || (tcp->flags & Tcp::Flag::kFin)) {
+      if (!incomplete || (tcp->flags & Tcp::Flag::kFin)) {
         flow_cache_.erase(it);
       }
+    } else if (tls) {
+      it->second.SetAnalyzed();
+
+      // No 403 for HTTPS: just reset both ends.
+      EmitGenerated(ctx,
+                    GenerateResetPacket(eth->src_addr, eth->dst_addr, ip->src,
+                                        ip->dst, tcp->src_port, tcp->dst_port,
+                                        tcp->seq_num, tcp->ack_num),
+                    0);
+      EmitGenerated(ctx,
+                    GenerateResetPacket(eth->dst_addr, eth->src_addr, ip->dst,
+                                        ip->src, tcp->dst_port, tcp->src_port,
+                                        tcp->ack_num, tcp->seq_num),
+                    1);
+      DropPacket(ctx, pkt);
     } else {
       // No need to keep reconstructing, just mark it as analyzed
       // (and hence blocked).
       it->second.SetAnalyzed();
 
       // Inject RST to destination
-      EmitPacket(ctx, GenerateResetPacket(eth->src_addr, eth->dst_addr, ip->src,
-                                          ip->dst, tcp->src_port, tcp->dst_port,
-                                          tcp->seq_num, tcp->ack_num),
-                 0);
+      EmitGenerated(ctx,
+                    GenerateResetPacket(eth->src_addr, eth->dst_addr, ip->src,
+                                        ip->dst, tcp->src_port, tcp->dst_port,
+                                        tcp->seq_num, tcp->ack_num),
+                    0);
 
       // Inject 403 to source. 403 should arrive earlier than RST.
-      EmitPacket(ctx, Generate403Packet(eth->dst_addr, eth->src_addr, ip->dst,
-                                        ip->src, tcp->dst_port, tcp->src_port,
-                                        tcp->ack_num, tcp->seq_num),
-                 1);
+      EmitGenerated(ctx,
+                    Generate403Packet(eth->dst_addr, eth->src_addr, ip->dst,
+                                      ip->src, tcp->dst_port, tcp->src_port,
+                                      tcp->ack_num, tcp->seq_num),
+                    1);
 
       // Inject RST to source
-      EmitPacket(ctx, GenerateResetPacket(
-                          eth->dst_addr, eth->src_addr, ip->dst, ip->src,
-                          tcp->dst_port, tcp->src_port,
-                          be32_t(tcp->ack_num.value() + strlen(HTTP_403_BODY)),
-                          tcp->seq_num),
-                 1);
+      EmitGenerated(ctx,
+                    GenerateResetPacket(
+                        eth->dst_addr, eth->src_addr, ip->dst, ip->src,
+                        tcp->dst_port, tcp->src_port,
+                        be32_t(tcp->ack_num.value() + strlen(HTTP_403_BODY)),
+                        tcp->seq_num),
+                    1);
 
       // Drop the data packet
       DropPacket(ctx, pkt);
@@ -386,7 +541,8 @@ void UrlFilter::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 }
 
 std::string UrlFilter::GetDesc() const {
-  return bess::utils::Format("%zu hosts", blacklist_.size());
+  return bess::utils::Format("%zu hosts, %zu domains", blacklist_.size(),
+                             domains_.size());
 }
 
-ADD_MODULE(UrlFilter, "url-filter", "Filter HTTP connection")
+ADD_MODULE(UrlFilter, "url-filter", "Filter HTTP/HTTPS connection")
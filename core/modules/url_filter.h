@@ -34,6 +34,7 @@
 #include <rte_hash_crc.h>
 
 #include <map>
+#include <set>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -42,9 +43,11 @@
 #include "../module.h"
 #include "../packet.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/aho_corasick.h"
 #include "../utils/tcp_flow_reconstruct.h"
 #include "../utils/trie.h"
 
+using bess::utils::AhoCorasick;
 using bess::utils::TcpFlowReconstruct;
 using bess::utils::Trie;
 using bess::utils::be16_t;
@@ -106,7 +109,8 @@ class FlowRecord {
 };
 
 // A module of HTTP URL filtering. Ends an HTTP connection if the Host field
-// matches the blacklist.
+// matches the blacklist, or an HTTP/HTTPS connection if the Host field or the
+// TLS SNI is one of the blocked domains or a subdomain thereof.
 // igate/ogate 0: traffic from internal network to external network
 // igate/ogate 1: traffic from external network to internal network
 class UrlFilter final : public Module {
@@ -130,8 +134,28 @@ class UrlFilter final : public Module {
   CommandResponse SetRuntimeConfig(const bess::pb::UrlFilterConfig &arg);
 
  private:
+  CommandResponse AddRules(const bess::pb::UrlFilterArg &arg);
+
+  // Returns true if `host` (possibly with a ":port" suffix) is a blocked
+  // domain or a subdomain of one.
+  bool MatchDomain(const char *host, size_t len) const;
+
+  // Sends out a packet generated by this module.
+  void EmitGenerated(Context *ctx, bess::Packet *pkt, gate_idx_t ogate);
+
   std::unordered_map<std::string, Trie<std::tuple<>>> blacklist_;
+
+  // Blocked domains, lowercased, and a matcher of their reversed forms with a
+  // trailing ".", anchored at the end of the host: "example.com" becomes
+  // "moc.elpmaxe.", which is a prefix of the "."-terminated reverse of both
+  // "example.com" and "www.example.com", but not of "badexample.com".
+  std::set<std::string> domains_;
+  AhoCorasick domain_matcher_;
+
   std::unordered_map<Flow, FlowRecord, FlowHash> flow_cache_;
+
+  // Reassembles ClientHellos split across TLS records.
+  std::string tls_scratch_;
 };
 
 #endif  // BESS_MODULES_URL_FILTER_H_
@@ -29,9 +29,15 @@
 
 // Benchmark for UrlFilter module.
 
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
 #include <benchmark/benchmark.h>
 #include <glog/logging.h>
 
+#include "../utils/random.h"
 #include "url_filter.h"
 
 // Benchmarks the NAT flow hash.
@@ -46,4 +52,119 @@ static void BM_FlowHash(benchmark::State& state) {
 
 BENCHMARK(BM_FlowHash);
 
+// state.range(0) random blocked domains, and hosts to look up: half are
+// subdomains of blocked domains, half are not blocked.
+class DomainFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    Random rng(0);
+    domains_.clear();
+    hosts_.clear();
+    for (int i = 0; i < state.range(0); i++) {
+      domains_.push_back(RandomLabel(&rng) + "." + RandomLabel(&rng) + ".com");
+    }
+    for (int i = 0; i < kNumHosts; i++) {
+      if (i % 2) {
+        hosts_.push_back("www." + domains_[rng.GetRange(domains_.size())]);
+      } else {
+        hosts_.push_back("www." + RandomLabel(&rng) + ".com");
+      }
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    domains_.clear();
+    hosts_.clear();
+  }
+
+ protected:
+  static const int kNumHosts = 4096;
+
+  static std::string RandomLabel(Random *rng) {
+    std::string label(4 + rng->GetRange(8), ' ');
+    for (char &c : label) {
+      c = 'a' + rng->GetRange(26);
+    }
+    return label;
+  }
+
+  std::vector<std::string> ReversedPatterns() const {
+    std::vector<std::string> ret;
+    for (const auto &domain : domains_) {
+      ret.emplace_back(domain.rbegin(), domain.rend());
+      ret.back().push_back('.');
+    }
+    return ret;
+  }
+
+  std::vector<std::string> domains_;
+  std::vector<std::string> hosts_;
+};
+
+// The per-entry scheme: one hash lookup per suffix of the host that starts
+// at a label, as a hash table keyed by host (like the blacklist) needs to
+// match subdomains.
+BENCHMARK_DEFINE_F(DomainFixture, BM_DomainHashPerLabel)
+(benchmark::State &state) {
+  std::unordered_set<std::string> table(domains_.begin(), domains_.end());
+  size_t i = 0;
+  size_t matched = 0;
+  while (state.KeepRunning()) {
+    const std::string &host = hosts_[i++ % kNumHosts];
+    for (size_t pos = 0; pos != std::string::npos;
+         pos = host.find('.', pos + 1)) {
+      if (table.count(host.substr(pos ? pos + 1 : 0))) {
+        matched++;
+        break;
+      }
+    }
+  }
+  benchmark::DoNotOptimize(matched);
+  state.SetItemsProcessed(state.iterations());
+}
+
+// The compiled matcher as used by UrlFilter: reversed domains with a trailing
+// ".", matched anchored against the reversed host.
+BENCHMARK_DEFINE_F(DomainFixture, BM_DomainAhoCorasick)
+(benchmark::State &state) {
+  AhoCorasick matcher;
+  matcher.Build(ReversedPatterns());
+
+  size_t i = 0;
+  size_t matched = 0;
+  while (state.KeepRunning()) {
+    const std::string &host = hosts_[i++ % kNumHosts];
+    char buf[256];
+    std::reverse_copy(host.begin(), host.end(), buf);
+    buf[host.size()] = '.';
+    matched += matcher.MatchPrefix(buf, host.size() + 1) >= 0;
+  }
+  benchmark::DoNotOptimize(matched);
+  state.SetItemsProcessed(state.iterations());
+  state.counters["MB"] = matcher.memory_bytes() / 1e6;
+}
+
+// Compiling the matcher, i.e., the cost of an add/clear command.
+BENCHMARK_DEFINE_F(DomainFixture, BM_DomainAhoCorasickBuild)
+(benchmark::State &state) {
+  std::vector<std::string> patterns = ReversedPatterns();
+  while (state.KeepRunning()) {
+    AhoCorasick matcher;
+    matcher.Build(patterns);
+    benchmark::DoNotOptimize(matcher.num_states());
+  }
+  state.SetItemsProcessed(state.iterations() * patterns.size());
+}
+
+BENCHMARK_REGISTER_F(DomainFixture, BM_DomainHashPerLabel)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(DomainFixture, BM_DomainAhoCorasick)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000);
+BENCHMARK_REGISTER_F(DomainFixture, BM_DomainAhoCorasickBuild)
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
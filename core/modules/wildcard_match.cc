@@ -30,6 +30,8 @@
 
 #include "wildcard_match.h"
 
+#include <algorithm>
+#include <climits>
 #include <string>
 #include <vector>
 
@@ -157,85 +159,117 @@ CommandResponse WildcardMatch::Init(const bess::pb::WildcardMatchArg &arg) {
   return CommandSuccess();
 }
 
-inline gate_idx_t WildcardMatch::LookupEntry(const wm_hkey_t &key,
-                                             gate_idx_t def_gate,
-                                             bess::Packet *pkt) {
-  struct WmData result = {
-      .priority = INT_MIN, .ogate = def_gate, .keyv = {{0}}};
+void WildcardMatch::LookupBatch(const wm_hkey_t *keys, int cnt,
+                                const struct WmData **results) const {
+  const wm_hash hasher(total_key_size_);
+  const wm_eq eq(total_key_size_);
 
-  for (auto &tuple : tuples_) {
-    const auto &ht = tuple.ht;
-    wm_hkey_t key_masked;
+  wm_hkey_t masked[bess::PacketBatch::kMaxBurst] __ymm_aligned;
+  HashResult hashes[bess::PacketBatch::kMaxBurst];
+  int best[bess::PacketBatch::kMaxBurst];
+  uint64_t best_seq[bess::PacketBatch::kMaxBurst];
+
+  uint64_t pending = (1ull << cnt) - 1;
+  for (int i = 0; i < cnt; i++) {
+    results[i] = nullptr;
+    best[i] = INT_MIN;
+  }
+
+  for (const auto &tuple : tuples_) {
+    // Tuples are sorted by decreasing max_priority: a packet whose current
+    // match is better than this tuple's best rule is done. An equal one may
+    // still lose the tie to a newer tuple.
+    for (uint64_t m = pending; m; m &= m - 1) {
+      int i = __builtin_ctzll(m);
+      if (results[i] && best[i] > tuple.max_priority) {
+        pending &= ~(1ull << i);
+      }
+    }
+
+    if (!pending) {
+      break;
+    }
 
-    mask(&key_masked, key, tuple.mask, total_key_size_);
+    const auto &ht = tuple.ht;
 
-    const auto *entry =
-        ht.Find(key_masked, wm_hash(total_key_size_), wm_eq(total_key_size_));
+    for (uint64_t m = pending; m; m &= m - 1) {
+      int i = __builtin_ctzll(m);
+      mask(&masked[i], keys[i], tuple.mask, total_key_size_);
+      hashes[i] = ht.HashKey(masked[i], hasher);
+      ht.Prefetch(hashes[i]);
+    }
 
-    if (entry && entry->second.priority >= result.priority) {
-      result = entry->second;
+    for (uint64_t m = pending; m; m &= m - 1) {
+      int i = __builtin_ctzll(m);
+      const auto *entry = ht.FindHashed(hashes[i], masked[i], eq);
+      if (entry && (entry->second.priority > best[i] ||
+                    (entry->second.priority == best[i] &&
+                     (!results[i] || tuple.seq > best_seq[i])))) {
+        results[i] = &entry->second;
+        best[i] = entry->second.priority;
+        best_seq[i] = tuple.seq;
+      }
     }
   }
+}
 
-  /* if lookup was successful, then set values (if possible) */
-  if (result.ogate != default_gate_) {
-    size_t num_values_ = values_.size();
-    for (size_t i = 0; i < num_values_; i++) {
-      int value_size = values_[i].size;
-      int value_pos = values_[i].pos;
-      int value_off = values_[i].offset;
-      int value_attr_id = values_[i].attr_id;
-      uint8_t *data = pkt->head_data<uint8_t *>() + value_off;
-
-      DLOG(INFO) << "off: " << (int)value_off << ", sz: " << value_size
-                 << std::endl;
-      if (value_attr_id < 0) { /* if it is offset-based */
-        memcpy(data, reinterpret_cast<uint8_t *>(&result.keyv) + value_pos,
-               value_size);
-      } else { /* if it is attribute-based */
-        typedef struct {
-          uint8_t bytes[bess::metadata::kMetadataAttrMaxSize];
-        } value_t;
-        uint8_t *buf = (uint8_t *)&result.keyv + value_pos;
-
-        DLOG(INFO) << "Setting value " << std::hex
-                   << *(reinterpret_cast<uint64_t *>(buf))
-                   << " for attr_id: " << value_attr_id
-                   << " of size: " << value_size
-                   << " at value_pos: " << value_pos << std::endl;
-
-        switch (value_size) {
-          case 1:
-            set_attr<uint8_t>(this, value_attr_id, pkt, *((uint8_t *)buf));
-            break;
-          case 2:
-            set_attr<uint16_t>(this, value_attr_id, pkt,
-                               *((uint16_t *)((uint8_t *)buf)));
-            break;
-          case 4:
-            set_attr<uint32_t>(this, value_attr_id, pkt,
-                               *((uint32_t *)((uint8_t *)buf)));
-            break;
-          case 8:
-            set_attr<uint64_t>(this, value_attr_id, pkt,
-                               *((uint64_t *)((uint8_t *)buf)));
-            break;
-          default: {
-            void *mt_ptr =
-                _ptr_attr_with_offset<value_t>(attr_offset(value_attr_id), pkt);
-            bess::utils::CopySmall(mt_ptr, buf, value_size);
-          } break;
-        }
+void WildcardMatch::SetValues(bess::Packet *pkt, const struct WmData &rule) {
+  size_t num_values_ = values_.size();
+  for (size_t i = 0; i < num_values_; i++) {
+    int value_size = values_[i].size;
+    int value_pos = values_[i].pos;
+    int value_off = values_[i].offset;
+    int value_attr_id = values_[i].attr_id;
+    uint8_t *data = pkt->head_data<uint8_t *>() + value_off;
+
+    DLOG(INFO) << "off: " << (int)value_off << ", sz: " << value_size
+               << std::endl;
+    if (value_attr_id < 0) { /* if it is offset-based */
+      memcpy(data, reinterpret_cast<const uint8_t *>(&rule.keyv) + value_pos,
+             value_size);
+    } else { /* if it is attribute-based */
+      typedef struct {
+        uint8_t bytes[bess::metadata::kMetadataAttrMaxSize];
+      } value_t;
+      const uint8_t *buf = (const uint8_t *)&rule.keyv + value_pos;
+
+      DLOG(INFO) << "Setting value " << std::hex
+                 << *(reinterpret_cast<const uint64_t *>(buf))
+                 << " for attr_id: " << value_attr_id
+                 << " of size: " << value_size
+                 << " at value_pos: " << value_pos << std::endl;
+
+      switch (value_size) {
+        case 1:
+          set_attr<uint8_t>(this, value_attr_id, pkt, *buf);
+          break;
+        case 2:
+          set_attr<uint16_t>(this, value_attr_id, pkt,
+                             *((const uint16_t *)buf));
+          break;
+        case 4:
+          set_attr<uint32_t>(this, value_attr_id, pkt,
+                             *((const uint32_t *)buf));
+          break;
+        case 8:
+          set_attr<uint64_t>(this, value_attr_id, pkt,
+                             *((const uint64_t *)buf));
+          break;
+        default: {
+          void *mt_ptr =
+              _ptr_attr_with_offset<value_t>(attr_offset(value_attr_id), pkt);
+          bess::utils::CopySmall(mt_ptr, buf, value_size);
+        } break;
       }
     }
   }
-  return result.ogate;
 }
 
 void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t default_gate;
 
   wm_hkey_t keys[bess::PacketBatch::kMaxBurst] __ymm_aligned;
+  const struct WmData *results[bess::PacketBatch::kMaxBurst];
 
   int cnt = batch->cnt();
 
@@ -272,9 +306,19 @@ void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     }
   }
 
+  LookupBatch(keys, cnt, results);
+
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    EmitPacket(ctx, pkt, LookupEntry(keys[i], default_gate, pkt));
+    gate_idx_t ogate = default_gate;
+
+    /* if lookup was successful, then set values (if possible) */
+    if (results[i] && results[i]->ogate != default_gate) {
+      ogate = results[i]->ogate;
+      SetValues(pkt, *results[i]);
+    }
+
+    EmitPacket(ctx, pkt, ogate);
   }
 }
 
@@ -406,20 +450,38 @@ int WildcardMatch::AddTuple(wm_hkey_t *mask) {
   tuples_.emplace_back();
   struct WmTuple &tuple = tuples_.back();
   bess::utils::Copy(&tuple.mask, mask, sizeof(*mask));
+  tuple.max_priority = INT_MIN;
+  tuple.seq = next_tuple_seq_++;
 
   return int(tuples_.size() - 1);
 }
 
+void WildcardMatch::SortTuples() {
+  std::stable_sort(tuples_.begin(), tuples_.end(),
+                   [](const WmTuple &a, const WmTuple &b) {
+                     return a.max_priority > b.max_priority;
+                   });
+}
+
 bool WildcardMatch::DelEntry(int idx, wm_hkey_t *key) {
   struct WmTuple &tuple = tuples_[idx];
-  bool ret =
-      tuple.ht.Remove(*key, wm_hash(total_key_size_), wm_eq(total_key_size_));
-  if (!ret) {
-    return ret;
+  const auto *entry =
+      tuple.ht.Find(*key, wm_hash(total_key_size_), wm_eq(total_key_size_));
+  if (!entry) {
+    return false;
   }
 
+  int priority = entry->second.priority;
+  tuple.ht.Remove(*key, wm_hash(total_key_size_), wm_eq(total_key_size_));
+
   if (tuple.ht.Count() == 0) {
     tuples_.erase(tuples_.begin() + idx);
+  } else if (priority >= tuple.max_priority) {
+    tuple.max_priority = INT_MIN;
+    for (const auto &e : tuple.ht) {
+      tuple.max_priority = std::max(tuple.max_priority, e.second.priority);
+    }
+    SortTuples();
   }
 
   return true;
@@ -460,12 +522,21 @@ CommandResponse WildcardMatch::CommandAdd(
     }
   }
 
-  auto *ret = tuples_[idx].ht.Insert(key, data, wm_hash(total_key_size_),
-                                     wm_eq(total_key_size_));
+  struct WmTuple &tuple = tuples_[idx];
+  auto *ret = tuple.ht.Insert(key, data, wm_hash(total_key_size_),
+                              wm_eq(total_key_size_));
   if (ret == nullptr) {
+    if (tuple.ht.Count() == 0) {
+      tuples_.erase(tuples_.begin() + idx);
+    }
     return CommandFailure(EINVAL, "failed to add a rule");
   }
 
+  if (priority > tuple.max_priority) {
+    tuple.max_priority = priority;
+    SortTuples();
+  }
+
   return CommandSuccess();
 }
 
@@ -498,9 +569,7 @@ CommandResponse WildcardMatch::CommandClear(const bess::pb::EmptyArg &) {
 }
 
 void WildcardMatch::Clear() {
-  for (auto &tuple : tuples_) {
-    tuple.ht.Clear();
-  }
+  tuples_.clear();
 }
 
 // Retrieves a WildcardMatchArg that would reconstruct this module.
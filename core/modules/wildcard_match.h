@@ -42,7 +42,7 @@
 using bess::utils::CuckooMap;
 using bess::utils::HashResult;
 
-#define MAX_TUPLES 8
+#define MAX_TUPLES 64
 #define MAX_FIELDS 8
 #define MAX_FIELD_SIZE 8
 static_assert(MAX_FIELD_SIZE <= sizeof(uint64_t),
@@ -142,7 +142,8 @@ class WildcardMatch final : public Module {
         total_value_size_(),
         fields_(),
         values_(),
-        tuples_() {
+        tuples_(),
+        next_tuple_seq_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -162,14 +163,30 @@ class WildcardMatch final : public Module {
   CommandResponse CommandSetDefaultGate(
       const bess::pb::WildcardMatchCommandSetDefaultGateArg &arg);
 
+  // Finds the highest-priority rule matching each of `keys[0..cnt)`, storing
+  // it in `results[i]`, or nullptr if no rule matches. `cnt` must not exceed
+  // bess::PacketBatch::kMaxBurst.
+  void LookupBatch(const wm_hkey_t *keys, int cnt,
+                   const struct WmData **results) const;
+
  private:
   struct WmTuple {
     CuckooMap<wm_hkey_t, struct WmData, wm_hash, wm_eq> ht;
     wm_hkey_t mask;
+    // Highest priority among the rules in `ht`. May overestimate after rules
+    // are overwritten, which only costs an unnecessary probe.
+    int max_priority;
+    // Creation order. Among matches of equal priority, the one in the most
+    // recently created tuple wins, as when tuples were probed in that order.
+    uint64_t seq;
   };
 
-  gate_idx_t LookupEntry(const wm_hkey_t &key, gate_idx_t def_gate,
-                         bess::Packet *pkt);
+  // Writes the values of the matched `rule` into `pkt`.
+  void SetValues(bess::Packet *pkt, const struct WmData &rule);
+
+  // Keeps `tuples_` ordered by decreasing `max_priority`, so that lookups can
+  // stop as soon as no later tuple can hold a better match.
+  void SortTuples();
 
   CommandResponse AddFieldOne(const bess::pb::Field &field, struct WmField *f,
                               uint8_t type);
@@ -194,6 +211,7 @@ class WildcardMatch final : public Module {
   std::vector<struct WmField> fields_;
   std::vector<struct WmField> values_;
   std::vector<struct WmTuple> tuples_;
+  uint64_t next_tuple_seq_;
 };
 
 #endif  // BESS_MODULES_WILDCARDMATCH_H_
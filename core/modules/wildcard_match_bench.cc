@@ -0,0 +1,169 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark for WildcardMatch tuple-space lookups, sweeping the number of
+// distinct masks (tuples) and the total number of rules.
+
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "../utils/random.h"
+#include "wildcard_match.h"
+
+namespace {
+
+const int kBurst = bess::PacketBatch::kMaxBurst;
+const int kNumKeys = 4096;
+
+// src IP, dst IP, src port, dst port, protocol, as in an SDF filter
+const int kFieldOffsets[] = {26, 30, 34, 36, 23};
+const int kFieldSizes[] = {4, 4, 2, 2, 1};
+const int kNumFields = sizeof(kFieldSizes) / sizeof(kFieldSizes[0]);
+
+struct Rule {
+  std::string values[kNumFields];
+  std::string masks[kNumFields];
+};
+
+std::string Be32(uint32_t v) {
+  v = htonl(v);
+  return std::string(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+std::string Be16(uint16_t v) {
+  v = htons(v);
+  return std::string(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+uint32_t PrefixMask(int len) {
+  return len ? ~0u << (32 - len) : 0;
+}
+
+// Mask `m` matches a /8../32 source prefix and a /32, /24 or /16 destination
+// prefix, so that up to 75 masks are distinct. Ports are wildcarded.
+Rule MakeRule(int m, Random *rng) {
+  uint32_t src_mask = PrefixMask(8 + m % 25);
+  uint32_t dst_mask = PrefixMask(32 - (m / 25) * 8);
+
+  Rule r;
+  r.values[0] = Be32(rng->Get() & src_mask);
+  r.masks[0] = Be32(src_mask);
+  r.values[1] = Be32(rng->Get() & dst_mask);
+  r.masks[1] = Be32(dst_mask);
+  r.values[2] = r.masks[2] = Be16(0);
+  r.values[3] = r.masks[3] = Be16(0);
+  r.values[4] = std::string(1, 17);
+  r.masks[4] = std::string(1, '\xff');
+  return r;
+}
+
+// Builds a lookup key matching `r`, with random bits in wildcarded positions.
+wm_hkey_t MakeKey(const Rule &r, Random *rng) {
+  wm_hkey_t key = {{0}};
+  uint8_t *p = reinterpret_cast<uint8_t *>(key.u64_arr);
+  for (int i = 0; i < kNumFields; i++) {
+    for (int j = 0; j < kFieldSizes[i]; j++) {
+      uint8_t m = r.masks[i][j];
+      *p++ = (r.values[i][j] & m) | (rng->Get() & ~m);
+    }
+  }
+  return key;
+}
+
+void BM_LookupBatch(benchmark::State &state) {
+  const int num_masks = state.range(0);
+  const int num_rules = state.range(1);
+  Random rng(0x5eed);
+
+  WildcardMatch wm;
+  bess::pb::WildcardMatchArg arg;
+  for (int i = 0; i < kNumFields; i++) {
+    bess::pb::Field *f = arg.add_fields();
+    f->set_offset(kFieldOffsets[i]);
+    f->set_num_bytes(kFieldSizes[i]);
+  }
+  CHECK_EQ(wm.Init(arg).error().code(), 0);
+
+  std::vector<Rule> rules;
+  for (int i = 0; i < num_rules; i++) {
+    rules.push_back(MakeRule(i % num_masks, &rng));
+
+    bess::pb::WildcardMatchCommandAddArg add;
+    add.set_gate(i % 16);
+    add.set_priority(rng.GetRange(1000));
+    for (int j = 0; j < kNumFields; j++) {
+      add.add_values()->set_value_bin(rules.back().values[j]);
+      add.add_masks()->set_value_bin(rules.back().masks[j]);
+    }
+    CHECK_EQ(wm.CommandAdd(add).error().code(), 0);
+  }
+
+  // 3 out of 4 keys hit some rule, the rest probe every tuple and miss.
+  std::vector<wm_hkey_t> keys(kNumKeys);
+  for (int i = 0; i < kNumKeys; i++) {
+    if (i % 4 == 3) {
+      Rule r = MakeRule(0, &rng);
+      r.values[4] = std::string(1, 6);
+      keys[i] = MakeKey(r, &rng);
+    } else {
+      keys[i] = MakeKey(rules[rng.GetRange(num_rules)], &rng);
+    }
+  }
+
+  const struct WmData *results[kBurst];
+  int offset = 0;
+  for (auto _ : state) {
+    wm.LookupBatch(&keys[offset], kBurst, results);
+    benchmark::DoNotOptimize(results);
+    offset = (offset + kBurst) % kNumKeys;
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+void SweepArgs(benchmark::internal::Benchmark *b) {
+  for (int masks : {1, 4, 16, 64}) {
+    for (int rules : {1 << 10, 1 << 14, 1 << 17}) {
+      b->Args({masks, rules});
+    }
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_LookupBatch)->Apply(SweepArgs);
+
+BENCHMARK_MAIN();
@@ -53,6 +53,22 @@ DEFINE_string(modules, bess::bessd::GetCurrentDirectory() + "modules",
               "Load modules from the specified directory");
 DEFINE_bool(core_dump, false, "Generate a core dump on fatal faults");
 DEFINE_bool(no_crashlog, false, "Disable the generation of a crash log file");
+static bool ValidateTraceSample(const char *, int32_t value) {
+  if (value < 0) {
+    LOG(ERROR) << "Invalid trace sampling period: " << value;
+    return false;
+  }
+
+  return true;
+}
+DEFINE_int32(trace_sample, 0,
+             "Trace 1 in N packets received by PortInc/QueueInc through the "
+             "pipeline, for DumpTrace. 0 disables tracing");
+static const bool _trace_sample_dummy[[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_trace_sample, &ValidateTraceSample);
+DEFINE_bool(perf_counters, false,
+            "Count hardware events (instructions, cache misses, ...) for each "
+            "task run, reported by GetTcStats. Costs ~200 cycles per task run");
 
 // Note: currently BESS-managed hugepages do not support VFIO driver,
 //       so DPDK is default for now.
@@ -99,6 +115,28 @@ DEFINE_int32(
 static const bool _p_dummy[[maybe_unused]] =
     google::RegisterFlagValidator(&FLAGS_p, &ValidateTCPPort);
 
+static bool ValidateGrpcThreads(const char *, int32_t value) {
+  if (value <= 0) {
+    LOG(ERROR) << "Invalid number of gRPC threads: " << value;
+    return false;
+  }
+
+  return true;
+}
+DEFINE_int32(grpc_threads, 4,
+             "Specifies how many threads poll for gRPC requests. Requests "
+             "that do not change the pipeline are handled concurrently");
+static const bool _grpc_threads_dummy[[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_grpc_threads, &ValidateGrpcThreads);
+
+DEFINE_string(metrics_url, "",
+              "Specifies the host:port where BESS serves Prometheus/"
+              "OpenMetrics metrics over HTTP, at /metrics. Disabled if empty");
+
+DEFINE_string(restore, "",
+              "Rebuilds the pipeline from a file written by SaveSnapshot "
+              "before serving requests");
+
 static bool ValidateMegabytesPerSocket(const char *, int32_t value) {
   if (value < 0) {
     LOG(ERROR) << "Invalid memory size: " << value;
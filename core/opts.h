@@ -43,6 +43,11 @@ DECLARE_int32(c);
 DECLARE_string(b);
 DECLARE_int32(p);
 DECLARE_string(grpc_url);
+DECLARE_int32(grpc_threads);
+DECLARE_string(metrics_url);
+DECLARE_string(restore);
+DECLARE_bool(perf_counters);
+DECLARE_int32(trace_sample);
 DECLARE_int32(m);
 DECLARE_bool(skip_root_check);
 DECLARE_string(modules);
@@ -30,8 +30,10 @@
 
 #include "packet.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -43,6 +45,7 @@
 #include "dpdk.h"
 #include "opts.h"
 #include "utils/common.h"
+#include "utils/copy.h"
 
 namespace bess {
 
@@ -62,6 +65,70 @@ Packet *Packet::copy(const Packet *src) {
   return dst;
 }
 
+bool Packet::PullupSlow(uint16_t len) {
+  if (pkt_len_ < len || buf_len_ < len) {
+    return false;
+  }
+
+  // Not enough tailroom: slide the data of the first segment toward the
+  // beginning of the buffer.
+  if (data_off_ + len > buf_len_) {
+    uint16_t new_off = buf_len_ - len;
+    char *data = static_cast<char *>(buf_addr_);
+    memmove(data + new_off, data + data_off_, data_len_);
+    data_off_ = new_off;
+  }
+
+  char *dst = head_data<char *>() + data_len_;
+  uint16_t needed = len - data_len_;
+  while (needed > 0) {
+    Packet *seg = next_;
+    uint16_t copy_len = std::min(needed, seg->data_len_);
+
+    bess::utils::Copy(dst, seg->head_data(), copy_len);
+    dst += copy_len;
+    needed -= copy_len;
+    data_len_ += copy_len;
+    seg->data_off_ += copy_len;
+    seg->data_len_ -= copy_len;
+
+    if (seg->data_len_ == 0) {
+      next_ = seg->next_;
+      nb_segs_--;
+      seg->next_ = nullptr;
+      seg->nb_segs_ = 1;
+      rte_pktmbuf_free_seg(&seg->mbuf_);
+    }
+  }
+
+  return true;
+}
+
+Packet *Packet::PrependSegmentSlow(Packet *pkt, uint16_t len) {
+  Packet *head = reinterpret_cast<Packet *>(rte_pktmbuf_alloc(pkt->pool_));
+  if (!head) {
+    return nullptr;  // FAIL.
+  }
+
+  DCHECK_LE(len, head->buf_len_);
+
+  // Place the new data at the end of the buffer, leaving as much headroom as
+  // possible for further encapsulation.
+  head->data_off_ = head->buf_len_ - len;
+  head->data_len_ = len;
+  head->pkt_len_ = pkt->pkt_len_ + len;
+  head->nb_segs_ = pkt->nb_segs_ + 1;
+  head->next_ = pkt;
+
+  head->mbuf_.port = pkt->mbuf_.port;
+  head->mbuf_.ol_flags = pkt->mbuf_.ol_flags;
+  head->mbuf_.packet_type = pkt->mbuf_.packet_type;
+  head->mbuf_.hash = pkt->mbuf_.hash;
+  head->copy_metadata(pkt);
+
+  return head;
+}
+
 // basically rte_hexdump() from eal_common_hexdump.c
 static std::string HexDump(const void *buffer, size_t len) {
   std::ostringstream dump;
@@ -42,6 +42,7 @@
 
 #include "metadata.h"
 #include "snbuf_layout.h"
+#include "utils/copy.h"
 #include "worker.h"
 
 /* NOTE: NEVER use rte_pktmbuf_*() directly,
@@ -54,8 +55,8 @@ static_assert(SNBUF_HEADROOM == RTE_PKTMBUF_HEADROOM,
 static_assert(SNBUF_IMMUTABLE_OFF == 128,
               "Packet immbutable offset must be 128");
 static_assert(SNBUF_METADATA_OFF == 192, "Packet metadata offset must by 192");
-static_assert(SNBUF_SCRATCHPAD_OFF == 320,
-              "Packet scratchpad offset must be 320");
+static_assert(SNBUF_SCRATCHPAD_OFF == 192 + SNBUF_METADATA,
+              "Packet scratchpad offset must follow the metadata area");
 
 namespace bess {
 
@@ -103,6 +104,11 @@ class alignas(64) Packet {
     return reinterpret_cast<T>(metadata_);
   }
 
+  // Copies all metadata attribute values of src into this packet
+  void copy_metadata(const Packet *src) {
+    bess::utils::CopyInlined(metadata_, src->metadata_, SNBUF_METADATA);
+  }
+
   template <typename T = char *>
   T scratchpad() {
     return reinterpret_cast<T>(scratchpad_);
@@ -176,6 +182,27 @@ class alignas(64) Packet {
     DCHECK_EQ(ret, 0);
   }
 
+  // Make the first len bytes contiguous in the first segment, so that they
+  // can be accessed with head_data(). Data is moved from the following
+  // segments as needed. Returns false if the packet is shorter than len.
+  bool Pullup(uint16_t len) {
+    if (likely(data_len_ >= len)) {
+      return true;
+    }
+    return PullupSlow(len);
+  }
+
+  // Same as prepend(), but if there is not enough headroom, a new segment
+  // holding the len bytes is linked in front of pkt. Metadata is carried over
+  // to the new first segment. Returns the (possibly new) head of the packet,
+  // or nullptr if memory allocation failed, in which case pkt is unchanged.
+  static Packet *PrependSegment(Packet *pkt, uint16_t len) {
+    if (likely(pkt->prepend(len))) {
+      return pkt;
+    }
+    return PrependSegmentSlow(pkt, len);
+  }
+
   // Duplicate a new Packet object, allocated from the same PacketPool as src.
   // Returns nullptr if memory allocation failed
   static Packet *copy(const Packet *src);
@@ -318,6 +345,9 @@ class alignas(64) Packet {
   char headroom_[SNBUF_HEADROOM];
   char data_[SNBUF_DATA];
 
+  bool PullupSlow(uint16_t len);
+  static Packet *PrependSegmentSlow(Packet *pkt, uint16_t len);
+
   friend class PacketPool;
 };
 
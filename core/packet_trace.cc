@@ -0,0 +1,103 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "packet_trace.h"
+
+#include <glog/logging.h>
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace bess {
+namespace trace {
+
+Ring *rings[Worker::kMaxWorkers];
+
+// Names of all modules ever attached, indexed by module ID.
+static std::mutex names_mutex;
+static std::vector<std::string> names;
+
+void InitWorker(int wid) {
+  // Kept when the worker is destroyed, since Drain() may be reading it.
+  if (enabled() && !rings[wid]) {
+    rings[wid] = new Ring();
+  }
+}
+
+void AttachModule(Module *m) {
+  if (!enabled()) {
+    return;
+  }
+
+  uint32_t module_id;
+  {
+    std::lock_guard<std::mutex> lock(names_mutex);
+    module_id = names.size();
+    names.push_back(m->name());
+  }
+
+  int attr_id = -1;
+  const auto &attrs = m->all_attrs();
+  for (size_t i = 0; i < attrs.size(); i++) {
+    if (attrs[i].name == kAttrName) {
+      attr_id = i;
+      break;
+    }
+  }
+  if (attr_id < 0) {
+    attr_id = m->AddMetadataAttr(kAttrName, sizeof(uint64_t),
+                                 bess::metadata::Attribute::AccessMode::kRead);
+    if (attr_id < 0) {
+      LOG(WARNING) << m->name() << ": packets will not be traced: "
+                   << strerror(-attr_id);
+    }
+  }
+
+  m->set_trace(attr_id, module_id);
+}
+
+std::string ModuleName(uint32_t module_id) {
+  std::lock_guard<std::mutex> lock(names_mutex);
+  return module_id < names.size() ? names[module_id] : "";
+}
+
+uint64_t Drain(const std::function<void(int, const Record &)> &f) {
+  uint64_t dropped = 0;
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    Ring *ring = rings[wid];
+    if (ring) {
+      dropped += ring->Drain([&](const Record &r) { f(wid, r); });
+    }
+  }
+  return dropped;
+}
+
+}  // namespace trace
+}  // namespace bess
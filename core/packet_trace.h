@@ -0,0 +1,206 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#ifndef BESS_PACKET_TRACE_H_
+#define BESS_PACKET_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "module.h"
+#include "opts.h"
+#include "packet.h"
+#include "pktbatch.h"
+#include "utils/time.h"
+#include "worker.h"
+
+// Samples packets as they enter BESS and records when they reach each module,
+// to find out which modules add latency in a running pipeline.
+//
+// With --trace_sample=N, ingress modules (PortInc, QueueInc) write the TSC
+// into the "trace_stamp" metadata attribute of 1 in N packets, and 0 into the
+// others. Every other module reads the attribute, so that it survives the
+// whole pipeline. Before a module processes a batch, the packets with a stamp
+// get a record in the ring of the current worker. DumpTrace drains the rings,
+// and latency between modules is computed offline (see "show trace" in
+// bessctl).
+//
+// Packets allocated mid-pipeline (e.g., by UrlFilter or Replicate) carry
+// whatever stamp their buffer held when it was last freed. Modules that
+// allocate packets clear it with Clear(), and RecordArrival() ignores stamps
+// from the future or older than kMaxAgeSec, for packets it cannot vouch for.
+//
+// Without the flag, no attribute is declared, and the datapath cost is one
+// predictable branch per module visit.
+namespace bess {
+namespace trace {
+
+static const char *const kAttrName = "trace_stamp";
+
+// No packet is expected to spend this long in the pipeline.
+static const uint64_t kMaxAgeSec = 1;
+
+struct Record {
+  uint64_t stamp;      // TSC when the packet was sampled (0: not sampled)
+  uint64_t tsc;        // TSC when the packet reached the module
+  uint32_t pkt_index;  // With `stamp`, tells packets apart
+  uint32_t module_id;  // See ModuleName()
+};
+
+// Records of one worker. The worker pushes, DumpTrace() drains. Records are
+// dropped (and counted) if the ring is full.
+class Ring {
+ public:
+  static const size_t kSize = 16384;
+
+  Ring() : countdown(FLAGS_trace_sample), head_(), tail_(), dropped_() {}
+
+  void Push(const Record &r) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kSize) {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+      return;
+    }
+    records_[head % kSize] = r;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  // Calls `f` on all records, oldest first, and removes them. Returns the
+  // number of records dropped so far.
+  uint64_t Drain(const std::function<void(const Record &)> &f) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    for (; tail != head; tail++) {
+      f(records_[tail % kSize]);
+    }
+    tail_.store(tail, std::memory_order_release);
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Packets to go before the next sample. Only used by the owning worker.
+  uint32_t countdown;
+
+ private:
+  alignas(64) std::atomic<uint64_t> head_;
+  alignas(64) std::atomic<uint64_t> tail_;
+  std::atomic<uint64_t> dropped_;
+  Record records_[kSize];
+};
+
+extern Ring *rings[Worker::kMaxWorkers];
+
+static inline bool enabled() {
+  return FLAGS_trace_sample > 0;
+}
+
+// Called before each worker thread starts.
+void InitWorker(int wid);
+
+// Called on each new module. Lets it read the stamp attribute (unless it has
+// declared the attribute itself) and gives it a name in the records.
+void AttachModule(Module *m);
+
+// Returns the name of the module with the given ID, which stays valid after
+// the module is destroyed.
+std::string ModuleName(uint32_t module_id);
+
+// Calls `f` on the records of all workers and removes them. Returns the total
+// number of records dropped so far. Must not run concurrently with itself.
+uint64_t Drain(const std::function<void(int, const Record &)> &f);
+
+// Called by an ingress module on packets it received, with the attribute it
+// declared for writing.
+static inline void Stamp(Context *ctx, const Module *m, int attr_id,
+                         bess::PacketBatch *batch) {
+  Ring *ring = rings[ctx->wid];
+  bess::metadata::mt_offset_t offset = m->attr_offset(attr_id);
+  if (!ring || offset < 0) {
+    return;
+  }
+
+  for (int i = 0; i < batch->cnt(); i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint64_t stamp = 0;
+    if (--ring->countdown == 0) {
+      ring->countdown = FLAGS_trace_sample;
+      stamp = rdtsc();
+      ring->Push({stamp, stamp, pkt->index(), m->trace_module_id()});
+    }
+    _set_attr_with_offset<uint64_t>(offset, pkt, stamp);
+  }
+}
+
+// Called by a module on a packet it allocated, so that the packet is not taken
+// for a sampled one.
+static inline void Clear(const Module *m, bess::Packet *pkt) {
+  int attr_id = m->trace_attr_id();
+  if (attr_id < 0) {
+    return;
+  }
+  bess::metadata::mt_offset_t offset = m->attr_offset(attr_id);
+  if (offset >= 0) {
+    _set_attr_with_offset<uint64_t>(offset, pkt, 0);
+  }
+}
+
+// Called before `m` processes `batch`.
+static inline void RecordArrival(Context *ctx, const Module *m,
+                                 const bess::PacketBatch *batch) {
+  Ring *ring = rings[ctx->wid];
+  int attr_id = m->trace_attr_id();
+  if (!ring || attr_id < 0) {
+    return;
+  }
+  bess::metadata::mt_offset_t offset = m->attr_offset(attr_id);
+  if (offset < 0) {
+    return;  // No ingress module upstream
+  }
+
+  uint64_t now = 0;
+  for (int i = 0; i < batch->cnt(); i++) {
+    const bess::Packet *pkt = batch->pkts()[i];
+    uint64_t stamp = _get_attr_with_offset<uint64_t>(offset, pkt);
+    if (unlikely(stamp)) {
+      if (!now) {
+        now = rdtsc();
+      }
+      if (stamp <= now && now - stamp <= kMaxAgeSec * tsc_hz) {
+        ring->Push({stamp, now, pkt->index(), m->trace_module_id()});
+      }
+    }
+  }
+}
+
+}  // namespace trace
+}  // namespace bess
+
+#endif  // BESS_PACKET_TRACE_H_
@@ -0,0 +1,92 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "numa_placement.h"
+
+#include <set>
+
+#include "../gate.h"
+#include "../module.h"
+#include "../module_graph.h"
+
+const std::string NumaPlacement::kName = "numa_placement";
+
+NumaPlacement::NumaPlacement() : bess::ResumeHook(kName, kPriority, true) {}
+
+CommandResponse NumaPlacement::Init(const bess::pb::EmptyArg &) {
+  return CommandSuccess();
+}
+
+void NumaPlacement::Run() {
+  std::set<const Module *> changed;
+
+  for (const auto &it : ModuleGraph::GetAllModules()) {
+    if (it.second->UpdateActiveSockets()) {
+      changed.insert(it.second);
+    }
+  }
+
+  if (changed.empty()) {
+    return;
+  }
+
+  // Only report edges touching a module whose placement changed, so that a
+  // long-standing cross-socket hop is not logged on every resume.
+  for (const auto &it : ModuleGraph::GetAllModules()) {
+    const Module *m = it.second;
+    for (const bess::OGate *ogate : m->ogates()) {
+      if (!ogate) {
+        continue;
+      }
+      const Module *next = ogate->next();
+      if (changed.count(m) == 0 && changed.count(next) == 0) {
+        continue;
+      }
+      if (m->active_sockets() && next->active_sockets() &&
+          (m->active_sockets() & next->active_sockets()) == 0) {
+        LOG(WARNING) << "Gate " << m->name() << ":" << ogate->gate_idx()
+                     << " -> " << next->name()
+                     << " crosses NUMA sockets (0x" << std::hex
+                     << m->active_sockets() << " -> 0x"
+                     << next->active_sockets() << std::dec << ")";
+      }
+    }
+  }
+}
+
+ADD_RESUME_HOOK(NumaPlacement)
+
+bool __enable_NumaPlacement = []() {
+  bool ret = bess::global_resume_hooks.emplace(new NumaPlacement()).second;
+  if (!ret) {
+    LOG(ERROR) << "Failed to enable NumaPlacement hook by default";
+  }
+  return ret;
+}();
@@ -174,6 +174,9 @@ class Scheduler {
   // Return the number of traffic classes, managed by this scheduler.
   size_t NumTcs() const { return root_ ? root_->Size() : 0; }
 
+  // Only updated by the worker running this scheduler.
+  const struct sched_stats &stats() const { return stats_; }
+
   // For testing
   SchedWakeupQueue &wakeup_queue() { return wakeup_queue_; }
 
@@ -199,6 +202,17 @@ class Scheduler {
   // towards the root.
   void UnblockTowardsRoot(TrafficClass *c, uint64_t tsc);
 
+  // Adds the hardware events counted since "before" to the stats of "leaf".
+  static void AccountPerf(const utils::PerfCounters *perf,
+                          const utils::perf_arr_t before,
+                          LeafTrafficClass *leaf) {
+    utils::perf_arr_t after;
+    perf->Read(after);
+    for (int i = 0; i < utils::NUM_PERF_EVENTS; i++) {
+      leaf->stats_.perf[i] += after[i] - before[i];
+    }
+  }
+
   TrafficClass *root_;
 
   RoundRobinTrafficClass *default_rr_class_;
@@ -268,11 +282,21 @@ class DefaultScheduler : public Scheduler {
       ctx->task = leaf->task();
       ctx->silent_drops = 0;
 
+      const utils::PerfCounters *perf = current_worker.perf_counters();
+      utils::perf_arr_t perf_before;
+      if (perf) {
+        perf->Read(perf_before);
+      }
+
       // Run.
       auto ret = (*ctx->task)(ctx);
 
       now = rdtsc();
 
+      if (perf) {
+        AccountPerf(perf, perf_before, leaf);
+      }
+
       // Account.
       usage[RESOURCE_COUNT] = 1;
       usage[RESOURCE_CYCLE] = now - this->checkpoint_;
@@ -298,6 +322,7 @@ class DefaultScheduler : public Scheduler {
     }
 
     this->checkpoint_ = now;
+    current_worker.incr_rounds();
   }
 };
 
@@ -354,10 +379,20 @@ class ExperimentalScheduler : public Scheduler {
 
       ctx->task = leaf->task();
 
+      const utils::PerfCounters *perf = current_worker.perf_counters();
+      utils::perf_arr_t perf_before;
+      if (perf) {
+        perf->Read(perf_before);
+      }
+
       // Run.
       auto ret = (*ctx->task)(ctx);
       now = rdtsc();
 
+      if (perf) {
+        AccountPerf(perf, perf_before, leaf);
+      }
+
       if (ret.packets == 0 && ret.block) {
         constexpr uint64_t kMaxWait = 1ull << 20;
         uint64_t wait = std::min(kMaxWait, leaf->wait_cycles() << 1);
@@ -391,6 +426,7 @@ class ExperimentalScheduler : public Scheduler {
     }
 
     this->checkpoint_ = now;
+    current_worker.incr_rounds();
   }
 };
 
@@ -45,6 +45,13 @@
  *
  * Stride will be 2624B, because of mempool's per-object header which takes 64B.
  *
+ * The metadata area can be enlarged to 192 or 256 bytes at build time with the
+ * METADATA_SIZE environment variable (e.g., METADATA_SIZE=256 ./build.py),
+ * which shifts every later field by the same amount. Keeping it a multiple of
+ * the cache line size keeps the later areas cache-aligned. The kernel module
+ * must be built with the same value, as it locates the scratchpad and data
+ * areas of vport buffers through these offsets.
+ *
  * Invariants:
  *  * When packets are newly allocated, the data should be filled from _data.
  *  * The packet data may reside in the _headroom + _data areas,
@@ -52,7 +59,12 @@
  */
 #define SNBUF_MBUF 128
 #define SNBUF_IMMUTABLE 64
+#ifndef SNBUF_METADATA
 #define SNBUF_METADATA 128
+#endif
+#if SNBUF_METADATA < 128 || SNBUF_METADATA > 256 || SNBUF_METADATA % 64
+#error "SNBUF_METADATA must be 128, 192, or 256"
+#endif
 #define SNBUF_SCRATCHPAD 64
 #define SNBUF_RESERVE (SNBUF_IMMUTABLE + SNBUF_METADATA + SNBUF_SCRATCHPAD)
 #define SNBUF_HEADROOM 128
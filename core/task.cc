@@ -34,6 +34,7 @@
 
 #include "gate.h"
 #include "module.h"
+#include "packet_trace.h"
 
 // Called when the leaf that owns this task is destroyed.
 void Task::Detach() {
@@ -81,6 +82,9 @@ struct task_result Task::operator()(Context *ctx) const {
     }
 
     Module *m = igate->module();
+    if (unlikely(FLAGS_trace_sample)) {
+      bess::trace::RecordArrival(ctx, m, batch);
+    }
     m->ProcessBatch(ctx, batch);  // process module
     m->ProcessOGates(ctx);        // process ogates
   }
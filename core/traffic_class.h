@@ -44,6 +44,7 @@
 #include "task.h"
 #include "utils/common.h"
 #include "utils/extended_priority_queue.h"
+#include "utils/perf_counters.h"
 #include "utils/simd.h"
 #include "utils/time.h"
 
@@ -81,6 +82,9 @@ typedef int32_t resource_share_t;
 struct tc_stats {
   resource_arr_t usage;
   uint64_t cnt_throttled;
+  // Hardware events while running the task. Only counted for leaves, and only
+  // with --perf_counters.
+  utils::perf_arr_t perf;
 };
 
 class Scheduler;
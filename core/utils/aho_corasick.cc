@@ -0,0 +1,171 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "aho_corasick.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace bess {
+namespace utils {
+
+void AhoCorasick::Build(const std::vector<std::string> &patterns,
+                        bool nocase) {
+  nocase_ = nocase;
+  num_patterns_ = patterns.size();
+
+  std::vector<std::string> keys(patterns.size());
+  for (size_t i = 0; i < patterns.size(); i++) {
+    keys[i] = patterns[i];
+    if (nocase) {
+      for (char &ch : keys[i]) {
+        ch = Lower(ch);
+      }
+    }
+  }
+
+  // With the patterns sorted, a new node is always the last child of its
+  // parent, and the path of the previous pattern tells where to branch off.
+  // The sort is stable, so duplicates keep the id of their first occurrence.
+  std::vector<uint32_t> sorted(keys.size());
+  std::iota(sorted.begin(), sorted.end(), 0);
+  std::stable_sort(sorted.begin(), sorted.end(), [&keys](uint32_t a,
+                                                         uint32_t b) {
+    return keys[a] < keys[b];
+  });
+
+  // Temporary trie, in insertion order. Node 0 is the root.
+  std::vector<uint32_t> first_child(1), next_sibling(1), last_child(1);
+  std::vector<uint8_t> byte(1);
+  std::vector<int32_t> match(1, -1);
+  std::vector<uint32_t> path(1, 0);  // nodes of the previous pattern
+  const std::string *prev = nullptr;
+
+  for (uint32_t id : sorted) {
+    const std::string &key = keys[id];
+    if (key.empty()) {
+      continue;
+    }
+
+    size_t lcp = 0;
+    if (prev) {
+      size_t max = std::min(prev->size(), key.size());
+      while (lcp < max && (*prev)[lcp] == key[lcp]) {
+        lcp++;
+      }
+    }
+    path.resize(lcp + 1);
+
+    for (size_t i = lcp; i < key.size(); i++) {
+      uint32_t parent = path.back();
+      uint32_t node = byte.size();
+      first_child.push_back(0);
+      next_sibling.push_back(0);
+      last_child.push_back(0);
+      byte.push_back(key[i]);
+      match.push_back(-1);
+
+      if (last_child[parent]) {
+        next_sibling[last_child[parent]] = node;
+      } else {
+        first_child[parent] = node;
+      }
+      last_child[parent] = node;
+      path.push_back(node);
+    }
+
+    if (match[path.back()] < 0) {
+      match[path.back()] = id;
+    }
+    prev = &key;
+  }
+
+  // Renumber so that the children of each state are consecutive states.
+  // Child blocks are allocated in DFS order: a chain of single children, as
+  // the tail of a pattern usually is, then takes consecutive states and is
+  // walked with sequential memory accesses.
+  size_t n = byte.size();
+  std::vector<uint32_t> order(n);  // new id -> old id
+  child_begin_.assign(n, 0);
+  num_children_.assign(n, 0);
+  order[0] = 0;
+  size_t tail = 1;
+  std::vector<uint32_t> stack(1, 0);
+  while (!stack.empty()) {
+    uint32_t s = stack.back();
+    stack.pop_back();
+    child_begin_[s] = tail;
+    for (uint32_t c = first_child[order[s]]; c; c = next_sibling[c]) {
+      order[tail++] = c;
+    }
+    num_children_[s] = tail - child_begin_[s];
+    for (uint32_t c = tail; c > child_begin_[s]; c--) {
+      stack.push_back(c - 1);
+    }
+  }
+
+  in_byte_.assign(n + 16, 0);
+  match_.resize(n);
+  for (size_t s = 0; s < n; s++) {
+    in_byte_[s] = byte[order[s]];
+    match_[s] = match[order[s]];
+  }
+
+  std::fill(std::begin(root_next_), std::end(root_next_), 0);
+  for (uint32_t c = child_begin_[0]; c < child_begin_[0] + num_children_[0];
+       c++) {
+    root_next_[in_byte_[c]] = c;
+  }
+
+  // Failure links, in BFS order so that those of shallower states are known.
+  fail_.assign(n, 0);
+  out_.assign(n, 0);
+  std::vector<uint32_t> queue(1, 0);
+  for (size_t i = 0; i < queue.size(); i++) {
+    uint32_t p = queue[i];
+    for (uint32_t s = child_begin_[p]; s < child_begin_[p] + num_children_[p];
+         s++) {
+      queue.push_back(s);
+      uint8_t c = in_byte_[s];
+      uint32_t f = 0;
+      if (p != 0) {
+        f = fail_[p];
+        while (f != 0 && !Goto(f, c)) {
+          f = fail_[f];
+        }
+        f = Goto(f, c);
+      }
+      fail_[s] = f;
+      out_[s] = (match_[f] >= 0) ? f : out_[f];
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,196 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Aho-Corasick multi-pattern matcher, compiled once from a pattern set and
+// then shared read-only by any number of threads.
+//
+// States are numbered so that the children of a state are consecutive states
+// and need no explicit edge targets: a state only stores where its children
+// begin and how many there are, and each state stores the byte leading to it.
+// Finding a transition thus scans a short run of bytes, 16 at a time with
+// SSE2. The root has a dense table, since nearly every text byte at the root
+// would otherwise search its (largest) child list. Memory is ~19 bytes per
+// trie node, about 230 MB for a million 20-character domains.
+
+#ifndef BESS_UTILS_AHO_CORASICK_H_
+#define BESS_UTILS_AHO_CORASICK_H_
+
+#include <x86intrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+class AhoCorasick {
+ public:
+  AhoCorasick() : nocase_(), num_patterns_(), root_next_() {}
+
+  // Compiles the automaton from `patterns`, replacing the previous one. The
+  // id of a pattern is its index in `patterns`; empty patterns never match,
+  // and duplicates take the id of their first occurrence. With `nocase`,
+  // ASCII letters match regardless of case.
+  void Build(const std::vector<std::string> &patterns, bool nocase = true);
+
+  // Calls `fn(int id, size_t end)` for every occurrence of a pattern in
+  // `text`, where `end` is one past its last byte. Occurrences ending at the
+  // same position are reported longest first.
+  template <typename F>
+  void Scan(const char *text, size_t len, F &&fn) const {
+    uint32_t s = 0;
+    for (size_t i = 0; i < len; i++) {
+      s = Next(s, text[i]);
+      for (uint32_t m = (match_[s] >= 0) ? s : out_[s]; m; m = out_[m]) {
+        fn(match_[m], i + 1);
+      }
+    }
+  }
+
+  // Returns true if any pattern occurs in `text`.
+  bool Contains(const char *text, size_t len) const {
+    uint32_t s = 0;
+    for (size_t i = 0; i < len; i++) {
+      s = Next(s, text[i]);
+      if (match_[s] >= 0 || out_[s]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns the id of the longest pattern that is a suffix of `text`, or -1.
+  int MatchSuffix(const char *text, size_t len) const {
+    uint32_t s = 0;
+    for (size_t i = 0; i < len; i++) {
+      s = Next(s, text[i]);
+    }
+    return (match_[s] >= 0) ? match_[s] : match_[out_[s]];
+  }
+
+  // Returns the id of the longest pattern that is a prefix of `text`, or -1.
+  // Only follows trie edges, so it stops at the first byte that no pattern
+  // continues with; for anchored lookups (e.g., domains reversed) this is
+  // much cheaper than a Scan.
+  int MatchPrefix(const char *text, size_t len) const {
+    int ret = -1;
+    uint32_t s = 0;
+    for (size_t i = 0; i < len; i++) {
+      s = Goto(s, nocase_ ? Lower(text[i]) : text[i]);
+      if (!s) {
+        break;
+      }
+      if (match_[s] >= 0) {
+        ret = match_[s];
+      }
+    }
+    return ret;
+  }
+
+  size_t num_patterns() const { return num_patterns_; }
+  size_t num_states() const { return fail_.size(); }
+  size_t memory_bytes() const {
+    return child_begin_.size() * sizeof(uint32_t) +
+           num_children_.size() * sizeof(uint16_t) + in_byte_.size() +
+           fail_.size() * sizeof(uint32_t) + out_.size() * sizeof(uint32_t) +
+           match_.size() * sizeof(int32_t) + sizeof(root_next_);
+  }
+
+ private:
+  // Returns the child of `s` by byte `c`, or 0 (the root is nobody's child).
+  uint32_t Goto(uint32_t s, uint8_t c) const {
+    if (s == 0) {
+      return root_next_[c];
+    }
+
+    uint32_t begin = child_begin_[s];
+    uint32_t end = begin + num_children_[s];
+    if (end - begin <= 1) {  // most states, e.g., the tail of a pattern
+      return (begin < end && in_byte_[begin] == c) ? begin : 0;
+    }
+#if __SSE2__
+    const __m128i needle = _mm_set1_epi8(c);
+    for (uint32_t i = begin; i < end; i += 16) {
+      __m128i bytes = _mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(&in_byte_[i]));
+      uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, needle));
+      if (end - i < 16) {
+        mask &= (1u << (end - i)) - 1;
+      }
+      if (mask) {
+        return i + __builtin_ctz(mask);
+      }
+    }
+#else
+    for (uint32_t i = begin; i < end; i++) {
+      if (in_byte_[i] == c) {
+        return i;
+      }
+    }
+#endif
+    return 0;
+  }
+
+  uint32_t Next(uint32_t s, char ch) const {
+    uint8_t c = nocase_ ? Lower(ch) : ch;
+    while (true) {
+      uint32_t t = Goto(s, c);
+      if (t || s == 0) {
+        return t;
+      }
+      s = fail_[s];
+    }
+  }
+
+  static uint8_t Lower(char ch) {
+    uint8_t c = ch;
+    return (static_cast<uint8_t>(c - 'A') < 26) ? c | 0x20 : c;
+  }
+
+  bool nocase_;
+  size_t num_patterns_;
+
+  // Per state. The children of s are states [child_begin_[s],
+  // child_begin_[s] + num_children_[s]); in_byte_ is padded for 16-byte loads.
+  std::vector<uint32_t> child_begin_;
+  std::vector<uint16_t> num_children_;
+  std::vector<uint8_t> in_byte_;  // byte on the edge from the parent
+  std::vector<uint32_t> fail_;
+  std::vector<uint32_t> out_;  // nearest state on the fail chain that matches
+  std::vector<int32_t> match_;  // pattern id ending here, or -1
+
+  uint32_t root_next_[256];
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_AHO_CORASICK_H_
@@ -0,0 +1,127 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "aho_corasick.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "random.h"
+
+namespace {
+
+using bess::utils::AhoCorasick;
+
+using Matches = std::set<std::pair<int, size_t>>;
+
+Matches ScanAll(const AhoCorasick &ac, const std::string &text) {
+  Matches ret;
+  ac.Scan(text.data(), text.size(),
+          [&ret](int id, size_t end) { ret.emplace(id, end); });
+  return ret;
+}
+
+TEST(AhoCorasickTest, Basic) {
+  AhoCorasick ac;
+  ac.Build({"he", "she", "his", "hers", "", "she"});
+  EXPECT_EQ(6, ac.num_patterns());
+
+  // Duplicates keep the first id; empty patterns never match.
+  Matches expected = {{1, 4}, {0, 4}, {3, 6}};
+  EXPECT_EQ(expected, ScanAll(ac, "ushers"));
+  EXPECT_TRUE(ac.Contains("ahisb", 5));
+  EXPECT_FALSE(ac.Contains("hxe", 3));
+
+  EXPECT_EQ(1, ac.MatchSuffix("ushe", 4));  // longest first
+  EXPECT_EQ(0, ac.MatchSuffix("the", 3));
+  EXPECT_EQ(-1, ac.MatchSuffix("hero", 4));
+  EXPECT_EQ(-1, ac.MatchSuffix("", 0));
+
+  EXPECT_EQ(3, ac.MatchPrefix("hersh", 5));  // longest first
+  EXPECT_EQ(0, ac.MatchPrefix("hex", 3));
+  EXPECT_EQ(-1, ac.MatchPrefix("the", 3));
+  EXPECT_EQ(-1, ac.MatchPrefix("h", 1));
+}
+
+TEST(AhoCorasickTest, Case) {
+  AhoCorasick ac;
+  ac.Build({".Example.COM"});
+  EXPECT_EQ(0, ac.MatchSuffix("www.EXAMPLE.com", 15));
+
+  ac.Build({".Example.COM"}, false);
+  EXPECT_EQ(-1, ac.MatchSuffix("www.EXAMPLE.com", 15));
+  EXPECT_EQ(0, ac.MatchSuffix("www.Example.COM", 15));
+  EXPECT_EQ(-1, ac.MatchPrefix(".example.com", 12));
+  EXPECT_EQ(0, ac.MatchPrefix(".Example.COM", 12));
+}
+
+// Checks all occurrences against a naive search, with a small alphabet so
+// that patterns overlap a lot, and more than 16 children per state.
+TEST(AhoCorasickTest, RandomAgainstNaive) {
+  Random rng(1);
+  for (int round = 0; round < 20; round++) {
+    int alphabet = (round % 2) ? 3 : 40;
+    std::vector<std::string> patterns(200);
+    for (auto &p : patterns) {
+      size_t len = 1 + rng.GetRange(6);
+      for (size_t i = 0; i < len; i++) {
+        p.push_back('0' + rng.GetRange(alphabet));
+      }
+    }
+    AhoCorasick ac;
+    ac.Build(patterns, false);
+
+    std::string text;
+    for (int i = 0; i < 2000; i++) {
+      text.push_back('0' + rng.GetRange(alphabet));
+    }
+
+    Matches expected;
+    for (size_t id = 0; id < patterns.size(); id++) {
+      const std::string &p = patterns[id];
+      size_t first = std::find(patterns.begin(), patterns.end(), p) -
+                     patterns.begin();
+      if (first != id) {
+        continue;
+      }
+      for (size_t pos = text.find(p); pos != std::string::npos;
+           pos = text.find(p, pos + 1)) {
+        expected.emplace(id, pos + p.size());
+      }
+    }
+    ASSERT_EQ(expected, ScanAll(ac, text)) << round;
+  }
+}
+
+}  // namespace
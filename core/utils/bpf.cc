@@ -11,6 +11,43 @@
 namespace bess {
 namespace utils {
 
+bool bpf_merge_programs(
+    const std::vector<const std::vector<struct bpf_insn> *> &progs,
+    std::vector<struct bpf_insn> *merged) {
+  merged->clear();
+
+  for (size_t i = 0; i < progs.size(); i++) {
+    const std::vector<struct bpf_insn> &prog = *progs[i];
+    size_t next = merged->size() + prog.size(); // entry of the next program
+
+    for (const struct bpf_insn &ins : prog) {
+      struct bpf_insn out = ins;
+
+      if (ins.code == (BPF_RET | BPF_K)) {
+        if (ins.k != 0) {
+          // Accepted: report which program it was
+          out.k = i + 1;
+        } else if (i + 1 < progs.size()) {
+          // Rejected: fall through to the next program. Since this does not
+          // change the number of instructions, relative jumps stay valid.
+          out.code = BPF_JMP | BPF_JA;
+          out.jt = out.jf = 0;
+          out.k = next - (merged->size() + 1);
+        } else {
+          out.k = progs.size() + 1;
+        }
+      } else if (BPF_CLASS(ins.code) == BPF_RET) {
+        merged->clear();
+        return false;
+      }
+
+      merged->push_back(out);
+    }
+  }
+
+  return true;
+}
+
 #ifdef __x86_64 // JIT compilation code only works in 64-bit
                 /*
                  * Registers
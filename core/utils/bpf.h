@@ -13,6 +13,7 @@
 #include <pcap.h>
 #include <string>
 #include <sys/mman.h>
+#include <vector>
 
 namespace bess {
 namespace utils {
@@ -29,8 +30,21 @@ struct Filter {
   int gate;
   int priority;    // higher number == higher priority
   std::string exp; // original filter expression string
+  std::vector<struct bpf_insn> insns; // compiled program, before JIT
 };
 
+// Chains the given programs, in order, into a single program that returns
+// i + 1 if the i-th program is the first one to accept the packet, or
+// progs.size() + 1 if none does. Each program is entered with A and X left
+// over from the previous one, which generated (pcap) code never relies on.
+// As with any BPF program, the merged program returns 0 when some program
+// aborts (e.g., an out-of-bounds packet access). In that case the caller
+// must evaluate the programs one by one, since a later one may still match.
+// Returns false if a program cannot be merged (it returns the A register).
+bool bpf_merge_programs(
+    const std::vector<const std::vector<struct bpf_insn> *> &progs,
+    std::vector<struct bpf_insn> *merged);
+
 #ifdef __x86_64
 bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
                                   size_t *size);
@@ -0,0 +1,159 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#ifndef BESS_UTILS_CAPTURE_RING_H_
+#define BESS_UTILS_CAPTURE_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace bess {
+namespace utils {
+
+// A single-producer, single-consumer ring of variable-size records, for
+// handing captured packets from a worker to a writer thread. A record is a
+// fixed header, then `meta_len` bytes of opaque metadata, then `caplen` bytes
+// of packet data, padded to 8 bytes. Records never wrap around the end of the
+// ring, so the consumer always sees them contiguous.
+//
+// The producer reserves any number of records and then publishes them all
+// with one Commit(), so the shared head index is written once per batch.
+class CaptureRing {
+ public:
+  struct Record {
+    uint32_t size;  // of the whole record; 0 marks a skip to the ring start
+    uint32_t meta_len;
+    uint32_t caplen;
+    uint32_t orig_len;
+    uint64_t tsc;
+
+    char *meta() { return reinterpret_cast<char *>(this + 1); }
+    char *data() { return meta() + meta_len; }
+    const char *meta() const {
+      return reinterpret_cast<const char *>(this + 1);
+    }
+    const char *data() const { return meta() + meta_len; }
+  };
+
+  static_assert(sizeof(Record) % 8 == 0, "Record must be 8-byte aligned");
+
+  // `bytes` must be a power of two, and at least twice the largest record.
+  explicit CaptureRing(size_t bytes)
+      : mask_(bytes - 1),
+        buf_(new uint64_t[bytes / sizeof(uint64_t)]),
+        head_(0),
+        reserved_(0),
+        cached_tail_(0),
+        tail_(0) {}
+
+  size_t bytes() const { return mask_ + 1; }
+
+  // Returns a record with room for `meta_len` and `caplen` bytes, with its
+  // lengths filled in, or nullptr if the ring is full. Producer only.
+  Record *Reserve(uint32_t meta_len, uint32_t caplen) {
+    size_t size = (sizeof(Record) + meta_len + caplen + 7) & ~size_t{7};
+    size_t offset = reserved_ & mask_;
+    size_t skip = (offset + size > bytes()) ? bytes() - offset : 0;
+
+    if (reserved_ + skip + size - cached_tail_ > bytes()) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (reserved_ + skip + size - cached_tail_ > bytes()) {
+        return nullptr;
+      }
+    }
+
+    if (skip) {
+      At(offset)->size = 0;
+      reserved_ += skip;
+      offset = 0;
+    }
+
+    Record *rec = At(offset);
+    rec->size = size;
+    rec->meta_len = meta_len;
+    rec->caplen = caplen;
+    reserved_ += size;
+    return rec;
+  }
+
+  // Makes all reserved records visible to the consumer. Producer only.
+  void Commit() { head_.store(reserved_, std::memory_order_release); }
+
+  // Calls `fn(const Record &)` for each committed record, up to `max_bytes`
+  // of them (but at least one), and then releases them. Returns the number of
+  // records. Consumer only.
+  template <typename F>
+  size_t Drain(size_t max_bytes, F &&fn) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t end = tail + max_bytes;
+    size_t cnt = 0;
+
+    while (tail != head && (cnt == 0 || tail < end)) {
+      const Record *rec = At(tail & mask_);
+      if (rec->size == 0) {
+        tail += bytes() - (tail & mask_);
+        continue;
+      }
+      fn(*rec);
+      tail += rec->size;
+      cnt++;
+    }
+
+    tail_.store(tail, std::memory_order_release);
+    return cnt;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  Record *At(size_t offset) const {
+    return reinterpret_cast<Record *>(reinterpret_cast<char *>(buf_.get()) +
+                                      offset);
+  }
+
+  const size_t mask_;
+  std::unique_ptr<uint64_t[]> buf_;
+
+  alignas(64) std::atomic<uint64_t> head_;
+  uint64_t reserved_;     // producer's head, including uncommitted records
+  uint64_t cached_tail_;  // producer's last view of tail_
+
+  alignas(64) std::atomic<uint64_t> tail_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CAPTURE_RING_H_
@@ -0,0 +1,120 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "capture_ring.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::CaptureRing;
+
+TEST(CaptureRingTest, FullAndWrap) {
+  CaptureRing ring(1024);
+  EXPECT_TRUE(ring.Empty());
+
+  // 24 + 100 bytes -> 128 bytes each; 8 of them fill the ring.
+  for (int i = 0; i < 8; i++) {
+    CaptureRing::Record *rec = ring.Reserve(0, 100);
+    ASSERT_NE(nullptr, rec);
+    EXPECT_EQ(128, rec->size);
+    rec->data()[0] = i;
+  }
+  EXPECT_EQ(nullptr, ring.Reserve(0, 1));
+  EXPECT_TRUE(ring.Empty());  // nothing committed yet
+  ring.Commit();
+
+  std::vector<int> seen;
+  auto collect = [&seen](const CaptureRing::Record &rec) {
+    seen.push_back(rec.data()[0]);
+  };
+  EXPECT_EQ(3, ring.Drain(300, collect));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), seen);
+
+  // 3 * 128 bytes are free at the start, but a 400-byte record must not wrap
+  // around: it fits after skipping 128 more.
+  EXPECT_EQ(nullptr, ring.Reserve(8, 360));
+  EXPECT_EQ(1, ring.Drain(1, collect));
+  CaptureRing::Record *rec = ring.Reserve(8, 360);
+  ASSERT_NE(nullptr, rec);
+  rec->data()[0] = 42;
+  ring.Commit();
+
+  seen.clear();
+  EXPECT_EQ(5, ring.Drain(1024, collect));
+  EXPECT_EQ(std::vector<int>({4, 5, 6, 7, 42}), seen);
+  EXPECT_TRUE(ring.Empty());
+}
+
+TEST(CaptureRingTest, ProducerConsumer) {
+  const uint32_t kCount = 100000;
+  CaptureRing ring(4096);
+
+  std::thread producer([&ring]() {
+    for (uint32_t i = 0; i < kCount;) {
+      CaptureRing::Record *rec = ring.Reserve(sizeof(i), i % 200);
+      if (!rec) {
+        ring.Commit();
+        std::this_thread::yield();
+        continue;
+      }
+      memcpy(rec->meta(), &i, sizeof(i));
+      memset(rec->data(), i, rec->caplen);
+      if (++i % 16 == 0) {
+        ring.Commit();
+      }
+    }
+    ring.Commit();
+  });
+
+  uint32_t next = 0;
+  bool ok = true;
+  while (next < kCount) {
+    size_t cnt = ring.Drain(1000, [&next, &ok](const CaptureRing::Record &rec) {
+      uint32_t i;
+      memcpy(&i, rec.meta(), sizeof(i));
+      ok &= i == next && rec.caplen == next % 200;
+      for (uint32_t j = 0; j < rec.caplen; j++) {
+        ok &= rec.data()[j] == static_cast<char>(next);
+      }
+      next++;
+    });
+    if (cnt == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(ok);
+  EXPECT_TRUE(ring.Empty());
+}
+
+}  // namespace
@@ -0,0 +1,207 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "capture_writer.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <ctime>
+
+#include "time.h"
+
+namespace bess {
+namespace utils {
+
+void CaptureWriterThread::Run() {
+  owner_->Run();
+}
+
+CaptureWriter::CaptureWriter(FifoOpener *opener, int num_producers)
+    : opener_(opener),
+      num_producers_(num_producers),
+      producers_(new Producer[num_producers]()),
+      ring_bytes_(kDefaultRingBytes),
+      snaplen_(),
+      sample_(),
+      formatter_(),
+      tsc_base_(),
+      ns_base_(),
+      discarded_(),
+      written_bytes_(),
+      running_(),
+      thread_(this) {}
+
+CaptureWriter::~CaptureWriter() {
+  Stop();
+  for (int i = 0; i < num_producers_; i++) {
+    delete producers_[i].ring.load();
+  }
+}
+
+int CaptureWriter::Init(size_t ring_bytes, uint32_t snaplen, uint32_t sample,
+                        Formatter formatter) {
+  if (running_) {
+    return -EBUSY;
+  }
+  if (ring_bytes == 0) {
+    ring_bytes = kDefaultRingBytes;
+  }
+  // A ring must hold at least a couple of the largest (64 KB) packets.
+  if ((ring_bytes & (ring_bytes - 1)) || ring_bytes < (1 << 18)) {
+    return -EINVAL;
+  }
+
+  ring_bytes_ = ring_bytes;
+  snaplen_ = snaplen;
+  sample_ = sample;
+  formatter_ = formatter;
+  return 0;
+}
+
+void CaptureWriter::AddProducer(int p) {
+  Producer &producer = producers_[p];
+  if (!producer.ring.load(std::memory_order_relaxed)) {
+    producer.ring.store(new CaptureRing(ring_bytes_),
+                        std::memory_order_release);
+  }
+}
+
+bool CaptureWriter::Start() {
+  if (running_) {
+    return true;
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  tsc_base_ = rdtsc();
+  ns_base_ = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+  running_ = thread_.Start();
+  return running_;
+}
+
+void CaptureWriter::Stop() {
+  if (running_) {
+    thread_.Terminate();
+    thread_.Reset();
+    running_ = false;
+  }
+}
+
+CaptureWriter::Stats CaptureWriter::GetStats() const {
+  Stats stats = {};
+  for (int i = 0; i < num_producers_; i++) {
+    stats.seen += producers_[i].seen;
+    stats.captured += producers_[i].captured;
+    stats.dropped += producers_[i].dropped;
+  }
+  stats.discarded = discarded_.load(std::memory_order_relaxed);
+  stats.written_bytes = written_bytes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+size_t CaptureWriter::Fill(std::string *out) {
+  size_t cnt = 0;
+  for (int i = 0; i < num_producers_ && out->size() < kWriteBytes; i++) {
+    CaptureRing *ring = producers_[i].ring.load(std::memory_order_acquire);
+    if (!ring) {
+      continue;
+    }
+    cnt += ring->Drain(kWriteBytes - out->size(),
+                       [this, out](const CaptureRing::Record &rec) {
+                         // The TSC may be slightly off across cores.
+                         int64_t cycles = rec.tsc - tsc_base_;
+                         uint64_t ts_ns =
+                             (cycles >= 0) ? ns_base_ + tsc_to_ns(cycles)
+                                           : ns_base_ - tsc_to_ns(-cycles);
+                         formatter_(rec, ts_ns, out);
+                       });
+  }
+  return cnt;
+}
+
+void CaptureWriter::Wait(int fd, int timeout_ms) {
+  struct pollfd pfd = {.fd = fd, .events = POLLOUT, .revents = 0};
+  struct timespec ts = {.tv_sec = 0, .tv_nsec = timeout_ms * 1000000l};
+  ppoll(&pfd, (fd >= 0) ? 1 : 0, &ts, thread_.Sigmask());
+}
+
+void CaptureWriter::Run() {
+  std::string out;
+  out.reserve(kWriteBytes * 2);
+  size_t offset = 0;     // of the unwritten part of `out`
+  size_t records = 0;    // in `out`
+  uint32_t out_gen = 0;  // of the FIFO `out` was started on
+
+  while (!thread_.IsExitRequested()) {
+    int fd;
+    uint32_t gen;
+    std::tie(fd, gen) = opener_->GetCurrentFd();
+
+    if (offset == out.size()) {
+      out.clear();
+      offset = 0;
+      records = Fill(&out);
+      out_gen = gen;
+      if (out.empty()) {
+        Wait(-1, 1);
+        continue;
+      }
+    }
+
+    // A new reader must start at a record boundary, and there is no reader
+    // to write to while the FIFO is closed.
+    if (!opener_->IsValidFd(fd) || gen != out_gen) {
+      discarded_.fetch_add(records, std::memory_order_relaxed);
+      offset = out.size();
+      continue;
+    }
+
+    ssize_t ret = write(fd, out.data() + offset, out.size() - offset);
+    if (ret >= 0) {
+      offset += ret;
+      written_bytes_.fetch_add(ret, std::memory_order_relaxed);
+    } else if (errno == EAGAIN) {
+      Wait(fd, 10);
+    } else if (errno != EINTR) {
+      if (errno == EPIPE) {
+        opener_->MarkDead(fd, gen);
+      }
+      discarded_.fetch_add(records, std::memory_order_relaxed);
+      offset = out.size();
+    }
+  }
+
+  thread_.BeginExiting();
+}
+
+}  // namespace utils
+}  // namespace bess
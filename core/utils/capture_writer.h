@@ -0,0 +1,192 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#ifndef BESS_UTILS_CAPTURE_WRITER_H_
+#define BESS_UTILS_CAPTURE_WRITER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "capture_ring.h"
+#include "fifo_opener.h"
+#include "syscallthread.h"
+
+namespace bess {
+namespace utils {
+
+class CaptureWriter;  // forward
+
+// The writer thread of a CaptureWriter. It only blocks in ppoll(), so it
+// needs no knock thread to be told to exit.
+class CaptureWriterThread final : public SyscallThreadPfuncs {
+ public:
+  explicit CaptureWriterThread(CaptureWriter *owner) : owner_(owner) {}
+  void Run() override;
+
+ private:
+  CaptureWriter *owner_;
+};
+
+// CaptureWriter takes packet captures off the datapath. Each producer (worker)
+// copies packets into its own CaptureRing, and a background thread formats
+// the records and writes them to the FIFO of a FifoOpener in large chunks.
+// When the writer falls behind and a ring fills up, packets are dropped (and
+// counted) rather than slowing down the producer. Rings are allocated up
+// front by AddProducer(), never on the datapath.
+//
+// Producers may also sample one in every `sample` packets, and truncate
+// packets to `snaplen` bytes.
+class CaptureWriter {
+ public:
+  // Appends the file format of `rec`, captured at `ts_ns` nanoseconds since
+  // the Epoch, to `out`. Called on the writer thread only.
+  using Formatter = std::function<void(const CaptureRing::Record &rec,
+                                       uint64_t ts_ns, std::string *out)>;
+
+  static constexpr size_t kDefaultRingBytes = 4 << 20;
+
+  struct Stats {
+    uint64_t seen;           // packets seen by producers
+    uint64_t captured;       // packets queued for the writer
+    uint64_t dropped;        // packets dropped for a full (or no) ring
+    uint64_t discarded;      // queued packets lost with a closed FIFO
+    uint64_t written_bytes;  // bytes written to the FIFO
+  };
+
+  CaptureWriter(FifoOpener *opener, int num_producers);
+  ~CaptureWriter();
+
+  // Sets the parameters, only before Start(). `ring_bytes` (0 means
+  // kDefaultRingBytes) must be a power of two, `snaplen` 0 means no
+  // truncation, and `sample` 0 or 1 means capturing every packet. Returns 0
+  // or -EINVAL.
+  int Init(size_t ring_bytes, uint32_t snaplen, uint32_t sample,
+           Formatter formatter);
+
+  // Allocates the ring of producer `p`, if it has none yet. Call after Init(),
+  // from the control thread, while `p` cannot be in Reserve(). Packets of a
+  // producer without a ring are dropped.
+  void AddProducer(int p);
+
+  // Starts/stops the writer thread. Records not written yet are discarded
+  // when stopping.
+  bool Start();
+  void Stop();
+
+  // Returns a record to fill in with `meta_len` bytes of metadata and the
+  // first `caplen` bytes of a packet of `pkt_len` (of `orig_len` in total)
+  // bytes, with `caplen` already truncated to the snaplen, or nullptr if the
+  // packet is not to be captured. Producer `p` only.
+  CaptureRing::Record *Reserve(int p, uint32_t meta_len, uint32_t pkt_len,
+                               uint32_t orig_len, uint64_t tsc) {
+    Producer &producer = producers_[p];
+    producer.seen++;
+    if (sample_ > 1) {
+      if (producer.countdown > 0) {
+        producer.countdown--;
+        return nullptr;
+      }
+      producer.countdown = sample_ - 1;
+    }
+
+    CaptureRing *ring = producer.ring.load(std::memory_order_relaxed);
+    uint32_t caplen = (snaplen_ && pkt_len > snaplen_) ? snaplen_ : pkt_len;
+    CaptureRing::Record *rec = ring ? ring->Reserve(meta_len, caplen) : nullptr;
+    if (!rec) {
+      producer.dropped++;
+      return nullptr;
+    }
+    rec->orig_len = orig_len;
+    rec->tsc = tsc;
+    producer.captured++;
+    return rec;
+  }
+
+  // Hands over the records reserved by producer `p` to the writer.
+  void Commit(int p) {
+    CaptureRing *ring = producers_[p].ring.load(std::memory_order_relaxed);
+    if (ring) {
+      ring->Commit();
+    }
+  }
+
+  uint32_t snaplen() const { return snaplen_; }
+
+  Stats GetStats() const;
+
+ private:
+  friend class CaptureWriterThread;
+
+  // Producers' output is formatted and written in chunks of about this size.
+  static constexpr size_t kWriteBytes = 1 << 20;
+
+  struct alignas(64) Producer {
+    std::atomic<CaptureRing *> ring;
+    uint64_t seen;
+    uint64_t captured;
+    uint64_t dropped;
+    uint32_t countdown;  // packets to skip before the next sampled one
+  };
+
+  // Moves up to about kWriteBytes worth of records from the rings to `out`.
+  // Returns the number of records.
+  size_t Fill(std::string *out);
+
+  // Waits until `fd` is writable (or, with fd < 0, for a short while).
+  void Wait(int fd, int timeout_ms);
+
+  void Run();
+
+  FifoOpener *opener_;
+  const int num_producers_;
+  std::unique_ptr<Producer[]> producers_;
+
+  size_t ring_bytes_;
+  uint32_t snaplen_;
+  uint32_t sample_;
+  Formatter formatter_;
+
+  // The wall clock time at tsc_base_, to convert timestamps.
+  uint64_t tsc_base_;
+  uint64_t ns_base_;
+
+  std::atomic<uint64_t> discarded_;
+  std::atomic<uint64_t> written_bytes_;
+
+  bool running_;
+  CaptureWriterThread thread_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CAPTURE_WRITER_H_
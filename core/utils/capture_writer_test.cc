@@ -0,0 +1,176 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "capture_writer.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "time.h"
+
+namespace {
+
+using bess::utils::CaptureRing;
+using bess::utils::CaptureWriter;
+using bess::utils::FifoOpener;
+
+class TestFifoOpener final : public FifoOpener {
+ public:
+  bool InitFifo(int fd) override { return write(fd, "H", 1) == 1; }
+};
+
+// Formats a record as "<caplen>/<orig_len>:<data>;".
+void Format(const CaptureRing::Record &rec, uint64_t, std::string *out) {
+  *out += std::to_string(rec.caplen) + "/" + std::to_string(rec.orig_len) +
+          ":" + std::string(rec.data(), rec.caplen) + ";";
+}
+
+class CaptureWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char tmpl[] = "/tmp/capture_writer_test.XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(tmpl));
+    dir_ = tmpl;
+    path_ = dir_ + "/fifo";
+    ASSERT_EQ(0, mkfifo(path_.c_str(), 0600));
+    reader_ = open(path_.c_str(), O_RDONLY | O_NONBLOCK);
+    ASSERT_GE(reader_, 0);
+    ASSERT_EQ(0, opener_.Init(path_, false));
+    ASSERT_EQ(0, opener_.OpenNow());
+  }
+
+  void TearDown() override {
+    opener_.Shutdown();
+    close(reader_);
+    unlink(path_.c_str());
+    rmdir(dir_.c_str());
+  }
+
+  // Reads from the FIFO until `len` bytes arrive or a second passes.
+  std::string Read(size_t len) {
+    std::string ret;
+    for (int i = 0; i < 100 && ret.size() < len; i++) {
+      char buf[4096];
+      ssize_t n = read(reader_, buf, sizeof(buf));
+      if (n > 0) {
+        ret.append(buf, n);
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    }
+    return ret;
+  }
+
+  std::string dir_;
+  std::string path_;
+  int reader_;
+  TestFifoOpener opener_;
+};
+
+void Capture(CaptureWriter *writer, int p, const std::string &pkt) {
+  CaptureRing::Record *rec = writer->Reserve(p, 0, pkt.size(), pkt.size(), 0);
+  if (rec) {
+    memcpy(rec->data(), pkt.data(), rec->caplen);
+  }
+}
+
+TEST_F(CaptureWriterTest, SnaplenAndSample) {
+  CaptureWriter writer(&opener_, 2);
+  EXPECT_EQ(-EINVAL, writer.Init(1000000, 4, 2, Format));
+  ASSERT_EQ(0, writer.Init(0, 4, 2, Format));
+  writer.AddProducer(0);
+  writer.AddProducer(1);
+  ASSERT_TRUE(writer.Start());
+
+  Capture(&writer, 0, "abcdef");  // sampled
+  Capture(&writer, 0, "xyz");     // not sampled
+  Capture(&writer, 0, "gh");      // sampled
+  writer.Commit(0);
+  EXPECT_EQ("H4/6:abcd;2/2:gh;", Read(17));
+
+  Capture(&writer, 1, "ijk");
+  writer.Commit(1);
+  EXPECT_EQ("3/3:ijk;", Read(8));
+
+  CaptureWriter::Stats stats = writer.GetStats();
+  EXPECT_EQ(4, stats.seen);
+  EXPECT_EQ(3, stats.captured);
+  EXPECT_EQ(0, stats.dropped);
+  EXPECT_EQ(0, stats.discarded);
+  EXPECT_EQ(24, stats.written_bytes);
+}
+
+TEST_F(CaptureWriterTest, Drops) {
+  CaptureWriter writer(&opener_, 1);
+  ASSERT_EQ(0, writer.Init(1 << 18, 0, 0, Format));
+  writer.AddProducer(0);
+
+  // Without the writer running, the ring fills up.
+  std::string pkt(1000, 'x');
+  for (int i = 0; i < 300; i++) {
+    Capture(&writer, 0, pkt);
+  }
+  writer.Commit(0);
+  CaptureWriter::Stats stats = writer.GetStats();
+  EXPECT_EQ(300, stats.seen);
+  EXPECT_EQ(256, stats.captured);  // 1024-byte records in a 256 KB ring
+  EXPECT_EQ(44, stats.dropped);
+
+  ASSERT_TRUE(writer.Start());
+  std::string expected = "1000/1000:" + pkt + ";";
+  EXPECT_EQ(1 + 256 * expected.size(), Read(1 + 256 * expected.size()).size());
+}
+
+TEST_F(CaptureWriterTest, NoRing) {
+  CaptureWriter writer(&opener_, 2);
+  ASSERT_EQ(0, writer.Init(0, 0, 0, Format));
+  writer.AddProducer(1);
+  ASSERT_TRUE(writer.Start());
+
+  Capture(&writer, 0, "abc");
+  writer.Commit(0);
+  Capture(&writer, 1, "def");
+  writer.Commit(1);
+  EXPECT_EQ("H3/3:def;", Read(9));
+
+  CaptureWriter::Stats stats = writer.GetStats();
+  EXPECT_EQ(2, stats.seen);
+  EXPECT_EQ(1, stats.captured);
+  EXPECT_EQ(1, stats.dropped);
+}
+
+}  // namespace
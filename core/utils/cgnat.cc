@@ -0,0 +1,368 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "cgnat.h"
+
+#include <netinet/in.h>
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+// Sessions are looked up in chunks of this many packets: all buckets of a
+// chunk are prefetched before the first one is probed.
+constexpr size_t kLookupChunk = 32;
+
+}  // namespace
+
+HashResult Cgnat::Key::Hash::operator()(const Key &key) const {
+  uint64_t w;
+  memcpy(&w, &key, sizeof(w));
+  return _mm_crc32_u64(0, w);
+}
+
+bool Cgnat::Key::EqualTo::operator()(const Key &lhs, const Key &rhs) const {
+  return memcmp(&lhs, &rhs, sizeof(Key)) == 0;
+}
+
+uint32_t Cgnat::ProtoCode(uint16_t proto) {
+  switch (proto) {
+    case IPPROTO_TCP:
+      return 1;
+    case IPPROTO_UDP:
+      return 2;
+    case IPPROTO_ICMP:
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+int Cgnat::Init(const Config &config) {
+  if (config.int_prefix_len < 8 || config.int_prefix_len > 32 ||
+      config.ext_addrs.empty() || config.port_min == 0 ||
+      config.block_size == 0 ||
+      config.partitions < 1 || config.partitions > kMaxPartitions ||
+      config.block_size < config.partitions) {
+    return -EINVAL;
+  }
+
+  uint32_t mask = ~0u << (32 - config.int_prefix_len);
+  if (config.int_prefix_len == 32) {
+    mask = ~0u;
+  }
+  if ((config.int_addr.value() & ~mask) != 0) {
+    return -EINVAL;
+  }
+
+  uint32_t blocks_per_addr = (65536 - config.port_min) / config.block_size;
+  uint64_t num_subs = 1ull << (32 - config.int_prefix_len);
+  if (num_subs > blocks_per_addr * config.ext_addrs.size()) {
+    return -ERANGE;
+  }
+
+  config_ = config;
+  std::sort(config_.ext_addrs.begin(), config_.ext_addrs.end());
+  if (std::adjacent_find(config_.ext_addrs.begin(), config_.ext_addrs.end()) !=
+      config_.ext_addrs.end()) {
+    return -EINVAL;
+  }
+
+  // The common case of a single range of external addresses needs no search.
+  ext_addrs_contiguous_ = config_.ext_addrs.back().value() -
+                              config_.ext_addrs.front().value() ==
+                          config_.ext_addrs.size() - 1;
+  num_subs_ = num_subs;
+  blocks_per_addr_ = blocks_per_addr;
+  ports_per_part_ = config.block_size / config.partitions;
+  slots_.reset(new std::atomic<uint32_t>[num_subs * config.block_size]());
+  return 0;
+}
+
+int64_t Cgnat::Subscriber(be32_t int_addr) const {
+  uint32_t sub = int_addr.value() - config_.int_addr.value();
+  return (sub < num_subs_) ? static_cast<int64_t>(sub) : -1;
+}
+
+int64_t Cgnat::SlotIndex(be32_t ext_addr, uint16_t ext_port,
+                         uint32_t *sub) const {
+  const auto &addrs = config_.ext_addrs;
+  uint64_t addr_idx;
+  if (ext_addrs_contiguous_) {
+    addr_idx = ext_addr.value() - addrs[0].value();
+    if (addr_idx >= addrs.size()) {
+      return -1;
+    }
+  } else {
+    auto it = std::lower_bound(addrs.begin(), addrs.end(), ext_addr);
+    if (it == addrs.end() || !(*it == ext_addr)) {
+      return -1;
+    }
+    addr_idx = it - addrs.begin();
+  }
+
+  if (ext_port < config_.port_min) {
+    return -1;
+  }
+
+  uint32_t offset = ext_port - config_.port_min;
+  uint32_t block = offset / config_.block_size;
+  if (block >= blocks_per_addr_) {
+    return -1;
+  }
+
+  uint64_t s = addr_idx * blocks_per_addr_ + block;
+  if (s >= num_subs_) {
+    return -1;
+  }
+
+  *sub = s;
+  return s * config_.block_size + offset % config_.block_size;
+}
+
+bool Cgnat::Reverse(be32_t ext_addr, be16_t ext_port, uint16_t proto,
+                    Key *internal) const {
+  uint32_t sub;
+  int64_t idx = SlotIndex(ext_addr, ext_port.value(), &sub);
+  if (idx < 0) {
+    return false;
+  }
+
+  uint32_t slot = slots_[idx].load(std::memory_order_acquire);
+  if (ProtoCode(proto) == 0 || (slot >> 16) != ProtoCode(proto)) {
+    return false;
+  }
+
+  internal->addr = InternalAddr(sub);
+  internal->port = be16_t(slot & 0xffff);
+  internal->proto = proto;
+  return true;
+}
+
+void Cgnat::ReverseBulk(const Key *external, size_t n, Key *internal,
+                        bool *found) const {
+  int64_t idx[kLookupChunk];
+  uint32_t subs[kLookupChunk];
+
+  for (size_t base = 0; base < n; base += kLookupChunk) {
+    size_t cnt = std::min(n - base, kLookupChunk);
+
+    for (size_t i = 0; i < cnt; i++) {
+      const Key &ext = external[base + i];
+      idx[i] = SlotIndex(ext.addr, ext.port.value(), &subs[i]);
+      if (idx[i] >= 0) {
+        __builtin_prefetch(&slots_[idx[i]]);
+      }
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      const Key &ext = external[base + i];
+      Key &in = internal[base + i];
+      uint32_t code = ProtoCode(ext.proto);
+      found[base + i] = false;
+      if (idx[i] < 0 || code == 0) {
+        continue;
+      }
+
+      uint32_t slot = slots_[idx[i]].load(std::memory_order_acquire);
+      if ((slot >> 16) == code) {
+        in.addr = InternalAddr(subs[i]);
+        in.port = be16_t(slot & 0xffff);
+        in.proto = ext.proto;
+        found[base + i] = true;
+      }
+    }
+  }
+}
+
+bool Cgnat::MapInternal(be32_t int_addr, be32_t *ext_addr,
+                        uint16_t *port_first, uint16_t *port_last) const {
+  int64_t sub = Subscriber(int_addr);
+  if (sub < 0) {
+    return false;
+  }
+
+  *ext_addr = ExternalAddr(sub);
+  *port_first = FirstPort(sub);
+  *port_last = *port_first + config_.block_size - 1;
+  return true;
+}
+
+bool Cgnat::MapExternal(be32_t ext_addr, uint16_t ext_port,
+                        be32_t *int_addr) const {
+  uint32_t sub;
+  if (SlotIndex(ext_addr, ext_port, &sub) < 0) {
+    return false;
+  }
+
+  *int_addr = InternalAddr(sub);
+  return true;
+}
+
+Cgnat::Partition::Partition(Cgnat *cgnat, int index)
+    : cgnat_(cgnat),
+      index_(index),
+      map_(align_ceil_pow2(
+               std::max<size_t>(cgnat->config().max_sessions / 2, 1)),
+           std::max<size_t>(cgnat->config().max_sessions, 1)),
+      rng_(),
+      sweep_cursor_(),
+      alloc_failures_(),
+      expired_() {}
+
+void Cgnat::Partition::Translate(const Key *internal, size_t n,
+                                 uint64_t now_ns, Key *external, bool *found) {
+  HashResult hashes[kLookupChunk];
+
+  for (size_t base = 0; base < n; base += kLookupChunk) {
+    size_t cnt = std::min(n - base, kLookupChunk);
+
+    for (size_t i = 0; i < cnt; i++) {
+      hashes[i] = map_.HashKey(internal[base + i]);
+      map_.Prefetch(hashes[i]);
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      const Key &key = internal[base + i];
+      SessionMap::Entry *entry = map_.FindHashed(hashes[i], key);
+      if (!entry && !(entry = Allocate(key, now_ns))) {
+        found[base + i] = false;
+        continue;
+      }
+
+      entry->second.last_refresh = now_ns;
+      Key &ext = external[base + i];
+      ext.addr = cgnat_->ExternalAddr(entry->second.sub);
+      ext.port = be16_t(entry->second.ext_port);
+      ext.proto = key.proto;
+      found[base + i] = true;
+    }
+  }
+}
+
+bool Cgnat::Partition::Reclaim(uint32_t sub, uint64_t slot, uint64_t now_ns) {
+  uint32_t word = cgnat_->slots_[slot].load(std::memory_order_relaxed);
+  if (word == 0) {
+    return true;
+  }
+
+  Key old;
+  old.addr = cgnat_->InternalAddr(sub);
+  old.port = be16_t(word & 0xffff);
+  switch (word >> 16) {
+    case 1:
+      old.proto = IPPROTO_TCP;
+      break;
+    case 2:
+      old.proto = IPPROTO_UDP;
+      break;
+    default:
+      old.proto = IPPROTO_ICMP;
+      break;
+  }
+
+  const SessionMap::Entry *entry = map_.Find(old);
+  if (entry && now_ns - entry->second.last_refresh <=
+                   cgnat_->config_.timeout_ns) {
+    return false;
+  }
+
+  if (entry) {
+    map_.Remove(old);
+    expired_++;
+  }
+  cgnat_->slots_[slot].store(0, std::memory_order_release);
+  return true;
+}
+
+Cgnat::Partition::SessionMap::Entry *Cgnat::Partition::Allocate(
+    const Key &key, uint64_t now_ns) {
+  int64_t sub = cgnat_->Subscriber(key.addr);
+  if (sub < 0 || ProtoCode(key.proto) == 0 ||
+      map_.Count() >= cgnat_->config_.max_sessions) {
+    alloc_failures_++;
+    return nullptr;
+  }
+
+  uint32_t ports = cgnat_->ports_per_part_;
+  uint32_t offset = index_ * ports;  // of this partition within the block
+  uint64_t first_slot = sub * cgnat_->config_.block_size + offset;
+
+  // Start at a random port, then probe linearly, reclaiming idle sessions.
+  uint32_t start = rng_.GetRange(ports);
+  for (uint32_t i = 0; i < ports; i++) {
+    uint32_t j = start + i;
+    if (j >= ports) {
+      j -= ports;
+    }
+
+    if (!Reclaim(sub, first_slot + j, now_ns)) {
+      continue;
+    }
+
+    uint16_t ext_port = cgnat_->FirstPort(sub) + offset + j;
+    SessionMap::Entry *entry =
+        map_.Insert(key, Session{static_cast<uint32_t>(sub), ext_port, now_ns});
+    if (!entry) {
+      break;
+    }
+    cgnat_->slots_[first_slot + j].store(MakeSlot(key.proto, key.port),
+                                         std::memory_order_release);
+    return entry;
+  }
+
+  alloc_failures_++;
+  return nullptr;
+}
+
+void Cgnat::Partition::Sweep(uint64_t now_ns, size_t max_slots) {
+  uint32_t ports = cgnat_->ports_per_part_;
+  uint64_t total = static_cast<uint64_t>(cgnat_->num_subs_) * ports;
+  uint32_t offset = index_ * ports;
+
+  for (size_t i = 0; i < max_slots; i++) {
+    uint32_t sub = sweep_cursor_ / ports;
+    uint64_t slot =
+        sub * cgnat_->config_.block_size + offset + sweep_cursor_ % ports;
+    Reclaim(sub, slot, now_ns);
+
+    if (++sweep_cursor_ == total) {
+      sweep_cursor_ = 0;
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,211 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Deterministic carrier-grade NAT state (RFC 7422).
+//
+// Every subscriber, i.e., internal address within `int_prefix`, owns a fixed
+// block of `block_size` ports on one external address, computed from its
+// address alone: subscriber i gets block (i % blocks_per_addr) of external
+// address (i / blocks_per_addr). The mapping therefore never has to be logged
+// per flow; it can be recomputed from the configuration (see MapInternal() and
+// MapExternal()).
+//
+// Each block is split further into `partitions` equal sub-blocks, one per
+// worker, so that workers allocate ports without sharing anything: a
+// Partition holds the sessions (internal endpoint -> external port) created by
+// its worker. The reverse direction needs no hash lookup at all: the external
+// port indexes a slot table recording the internal port it was allocated to.
+// Only the owning partition writes a slot; any worker may read it.
+
+#ifndef BESS_UTILS_CGNAT_H_
+#define BESS_UTILS_CGNAT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "cuckoo_map.h"
+#include "endian.h"
+#include "random.h"
+
+namespace bess {
+namespace utils {
+
+class Cgnat {
+ public:
+  static constexpr int kMaxPartitions = 64;
+
+  struct Config {
+    be32_t int_addr;  // internal prefix
+    int int_prefix_len;
+    std::vector<be32_t> ext_addrs;
+    uint16_t port_min;    // first external port to hand out
+    uint16_t block_size;  // ports per subscriber
+    int partitions;       // usually one per worker
+    size_t max_sessions;  // per partition
+    uint64_t timeout_ns;  // idle sessions may be reclaimed after this
+  };
+
+  // Internal endpoint of a session. `proto` is IPPROTO_TCP, _UDP or _ICMP;
+  // for ICMP, `port` is the query identifier.
+  struct alignas(8) Key {
+    be32_t addr;
+    be16_t port;
+    uint16_t proto;
+
+    struct Hash {
+      HashResult operator()(const Key &key) const;
+    };
+
+    struct EqualTo {
+      bool operator()(const Key &lhs, const Key &rhs) const;
+    };
+  };
+  static_assert(sizeof(Key) == 8, "Key must be 8 bytes");
+
+  // The sessions and allocator of one worker. Not thread-safe.
+  class Partition {
+   public:
+    Partition(Cgnat *cgnat, int index);
+
+    // Resolves the external endpoint of each of the `n` internal endpoints,
+    // allocating a port for new sessions and refreshing existing ones.
+    // `found[i]` is false if `internal[i]` is not a subscriber or no port
+    // could be allocated. Lookups are batched, with hash buckets prefetched.
+    void Translate(const Key *internal, size_t n, uint64_t now_ns,
+                   Key *external, bool *found);
+
+    // Reclaims idle sessions among the next `max_slots` ports of this
+    // partition (round-robin over all subscribers), so that sessions of
+    // subscribers that went away do not fill the table.
+    void Sweep(uint64_t now_ns, size_t max_slots);
+
+    int index() const { return index_; }
+    size_t sessions() const { return map_.Count(); }
+    uint64_t alloc_failures() const { return alloc_failures_; }
+    uint64_t expired() const { return expired_; }
+
+   private:
+    struct Session {
+      uint32_t sub;  // subscriber index
+      uint16_t ext_port;
+      uint64_t last_refresh;  // in ns
+    };
+
+    using SessionMap = CuckooMap<Key, Session, Key::Hash, Key::EqualTo>;
+
+    // Returns the new session for `key`, or nullptr.
+    SessionMap::Entry *Allocate(const Key &key, uint64_t now_ns);
+
+    // Frees the port of slot `slot` if its session is idle.
+    bool Reclaim(uint32_t sub, uint64_t slot, uint64_t now_ns);
+
+    Cgnat *cgnat_;
+    int index_;
+    SessionMap map_;
+    Random rng_;
+    uint64_t sweep_cursor_;
+    uint64_t alloc_failures_;
+    uint64_t expired_;
+  };
+
+  Cgnat()
+      : config_(),
+        ext_addrs_contiguous_(),
+        num_subs_(),
+        blocks_per_addr_(),
+        ports_per_part_() {}
+
+  // Returns 0, or -EINVAL if the configuration is inconsistent, or -ERANGE if
+  // the external addresses cannot give every subscriber a block.
+  int Init(const Config &config);
+
+  // Resolves the internal endpoint of the external address/port `ext_addr`,
+  // `ext_port` for protocol `proto`. Safe to call from any thread.
+  bool Reverse(be32_t ext_addr, be16_t ext_port, uint16_t proto,
+               Key *internal) const;
+
+  // Reverse() for `n` packets, with slot table cache misses overlapped.
+  // `found[i]` tells whether `internal[i]` is valid.
+  void ReverseBulk(const Key *external, size_t n, Key *internal,
+                   bool *found) const;
+
+  // Deterministic mapping, in both directions. Port ranges are inclusive.
+  bool MapInternal(be32_t int_addr, be32_t *ext_addr, uint16_t *port_first,
+                   uint16_t *port_last) const;
+  bool MapExternal(be32_t ext_addr, uint16_t ext_port, be32_t *int_addr) const;
+
+  const Config &config() const { return config_; }
+  uint32_t num_subscribers() const { return num_subs_; }
+  uint16_t ports_per_partition() const { return ports_per_part_; }
+
+ private:
+  // 0 for unsupported protocols, which thus never match a slot.
+  static uint32_t ProtoCode(uint16_t proto);
+
+  static uint32_t MakeSlot(uint16_t proto, be16_t int_port) {
+    return (ProtoCode(proto) << 16) | int_port.value();
+  }
+
+  // Subscriber index of `int_addr`, or -1.
+  int64_t Subscriber(be32_t int_addr) const;
+
+  // Index in slots_ of external `ext_addr`:`ext_port`, or -1.
+  int64_t SlotIndex(be32_t ext_addr, uint16_t ext_port, uint32_t *sub) const;
+
+  be32_t InternalAddr(uint32_t sub) const {
+    return be32_t(config_.int_addr.value() + sub);
+  }
+
+  be32_t ExternalAddr(uint32_t sub) const {
+    return config_.ext_addrs[sub / blocks_per_addr_];
+  }
+
+  uint16_t FirstPort(uint32_t sub) const {
+    return config_.port_min + (sub % blocks_per_addr_) * config_.block_size;
+  }
+
+  Config config_;  // ext_addrs sorted
+  bool ext_addrs_contiguous_;
+  uint32_t num_subs_;
+  uint32_t blocks_per_addr_;
+  uint16_t ports_per_part_;
+
+  // One entry per external port handed out to subscribers, indexed by
+  // subscriber * block_size + (port - FirstPort(subscriber)). Each holds
+  // ProtoCode() << 16 | internal port, or 0 if the port is free.
+  std::unique_ptr<std::atomic<uint32_t>[]> slots_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CGNAT_H_
@@ -0,0 +1,139 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Benchmarks for the CGNAT engine: per-worker session lookups (forward) and
+// slot table lookups (reverse), with all sessions already established.
+
+#include "cgnat.h"
+
+#include <netinet/in.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::Cgnat;
+
+static const size_t kBatch = 32;
+
+// Sets up a /14 of subscribers (262144) behind 4096 external addresses, with
+// state.range(0) sessions spread over them.
+class CgnatFixture : public benchmark::Fixture {
+ public:
+  CgnatFixture() : cgnat_(), partition_(), internal_(), external_() {}
+
+  void SetUp(benchmark::State &state) override {
+    Cgnat::Config config;
+    config.int_addr = be32_t(0x64400000);
+    config.int_prefix_len = 14;
+    for (uint32_t i = 0; i < 4096; i++) {
+      config.ext_addrs.push_back(be32_t(0xc6120000 + i));
+    }
+    config.port_min = 1024;
+    config.block_size = 1008;
+    config.partitions = 1;
+    config.max_sessions = state.range(0);
+    config.timeout_ns = 300ull * 1000 * 1000 * 1000;
+
+    cgnat_ = new Cgnat();
+    cgnat_->Init(config);
+    partition_ = new Cgnat::Partition(cgnat_, 0);
+
+    Random rng(0);
+    internal_.resize(state.range(0));
+    external_.resize(state.range(0));
+    for (auto &key : internal_) {
+      key.addr = be32_t(0x64400000 + rng.GetRange(1 << 14 << 4));
+      key.port = be16_t(1024 + rng.GetRange(60000));
+      key.proto = IPPROTO_UDP;
+    }
+    for (size_t i = 0; i < internal_.size(); i++) {
+      bool ok;
+      partition_->Translate(&internal_[i], 1, 0, &external_[i], &ok);
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    delete partition_;
+    delete cgnat_;
+    internal_.clear();
+    external_.clear();
+  }
+
+ protected:
+  Cgnat *cgnat_;
+  Cgnat::Partition *partition_;
+  std::vector<Cgnat::Key> internal_;
+  std::vector<Cgnat::Key> external_;
+};
+
+BENCHMARK_DEFINE_F(CgnatFixture, Forward)(benchmark::State &state) {
+  Random rng(1);
+  Cgnat::Key in[kBatch], out[kBatch];
+  bool found[kBatch];
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < kBatch; i++) {
+      in[i] = internal_[rng.GetRange(internal_.size())];
+    }
+    partition_->Translate(in, kBatch, 1, out, found);
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+BENCHMARK_DEFINE_F(CgnatFixture, Reverse)(benchmark::State &state) {
+  Random rng(1);
+  Cgnat::Key in[kBatch], out[kBatch];
+  bool found[kBatch];
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < kBatch; i++) {
+      in[i] = external_[rng.GetRange(external_.size())];
+    }
+    cgnat_->ReverseBulk(in, kBatch, out, found);
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+BENCHMARK_REGISTER_F(CgnatFixture, Forward)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Arg(1000000);
+BENCHMARK_REGISTER_F(CgnatFixture, Reverse)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Arg(1000000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,257 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "cgnat.h"
+
+#include <netinet/in.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::Cgnat;
+
+constexpr uint64_t kSec = 1000000000ull;
+
+Cgnat::Config MakeConfig(int partitions) {
+  Cgnat::Config config;
+  config.int_addr = be32_t(0x64400000);  // 100.64.0.0/16
+  config.int_prefix_len = 16;
+  config.ext_addrs = {be32_t(0xcb007102), be32_t(0xcb007101)};
+  config.port_min = 1024;
+  config.block_size = 2016;  // 32 blocks per external address
+  config.partitions = partitions;
+  config.max_sessions = 100000;
+  config.timeout_ns = 300 * kSec;
+  return config;
+}
+
+Cgnat::Key MakeKey(uint32_t addr, uint16_t port, uint16_t proto) {
+  Cgnat::Key key;
+  key.addr = be32_t(addr);
+  key.port = be16_t(port);
+  key.proto = proto;
+  return key;
+}
+
+// Returns the external port of `key`, or 0 on failure.
+uint16_t TranslateOne(Cgnat::Partition *p, const Cgnat::Key &key,
+                      uint64_t now) {
+  Cgnat::Key ext;
+  bool found;
+  p->Translate(&key, 1, now, &ext, &found);
+  return found ? ext.port.value() : 0;
+}
+
+TEST(CgnatTest, Config) {
+  Cgnat cgnat;
+  Cgnat::Config config = MakeConfig(4);
+
+  // 65536 subscribers do not fit in 2 * 32 blocks.
+  EXPECT_EQ(-ERANGE, cgnat.Init(config));
+
+  config.int_prefix_len = 26;
+  config.int_addr = be32_t(0x64400001);  // host bits set
+  EXPECT_EQ(-EINVAL, cgnat.Init(config));
+
+  config.int_addr = be32_t(0x64400000);
+  ASSERT_EQ(0, cgnat.Init(config));
+  EXPECT_EQ(64, cgnat.num_subscribers());
+  EXPECT_EQ(504, cgnat.ports_per_partition());
+}
+
+// The mapping depends on the configuration only, in both directions.
+TEST(CgnatTest, DeterministicMapping) {
+  // Contiguous external addresses take a faster path.
+  for (uint32_t second : {0xcb007102, 0xcb007180}) {
+    Cgnat cgnat;
+    Cgnat::Config config = MakeConfig(1);
+    config.int_prefix_len = 26;
+    config.ext_addrs = {be32_t(second), be32_t(0xcb007101)};
+    ASSERT_EQ(0, cgnat.Init(config));
+
+    std::set<std::pair<uint32_t, uint16_t>> blocks;
+    for (uint32_t i = 0; i < 64; i++) {
+      be32_t ext;
+      uint16_t first, last;
+      ASSERT_TRUE(
+          cgnat.MapInternal(be32_t(0x64400000 + i), &ext, &first, &last));
+      EXPECT_EQ(2015, last - first);
+      EXPECT_GE(first, 1024);
+      // Lowest external address first.
+      EXPECT_EQ(i < 32 ? 0xcb007101 : second, ext.value());
+      EXPECT_TRUE(blocks.emplace(ext.value(), first).second);
+
+      be32_t int_addr;
+      ASSERT_TRUE(cgnat.MapExternal(ext, first, &int_addr));
+      EXPECT_EQ(0x64400000 + i, int_addr.value());
+      ASSERT_TRUE(cgnat.MapExternal(ext, last, &int_addr));
+      EXPECT_EQ(0x64400000 + i, int_addr.value());
+    }
+
+    be32_t ext, int_addr;
+    uint16_t first, last;
+    EXPECT_FALSE(cgnat.MapInternal(be32_t(0x64400040), &ext, &first, &last));
+    EXPECT_FALSE(cgnat.MapExternal(be32_t(0xcb007101), 1023, &int_addr));
+    EXPECT_FALSE(cgnat.MapExternal(be32_t(0xcb007103), 2000, &int_addr));
+    EXPECT_FALSE(cgnat.MapExternal(be32_t(0xcb007100), 2000, &int_addr));
+  }
+}
+
+TEST(CgnatTest, TranslateAndReverse) {
+  Cgnat cgnat;
+  Cgnat::Config config = MakeConfig(2);
+  config.int_prefix_len = 26;
+  ASSERT_EQ(0, cgnat.Init(config));
+
+  Cgnat::Partition p0(&cgnat, 0);
+  Cgnat::Partition p1(&cgnat, 1);
+
+  Cgnat::Key keys[3] = {MakeKey(0x64400005, 40000, IPPROTO_TCP),
+                        MakeKey(0x64400005, 40000, IPPROTO_UDP),
+                        MakeKey(0x64400005, 40000, IPPROTO_TCP)};
+  Cgnat::Key exts[3];
+  bool found[3];
+  p0.Translate(keys, 3, 1, exts, found);
+  ASSERT_TRUE(found[0] && found[1] && found[2]);
+  be16_t ports[3] = {exts[0].port, exts[1].port, exts[2].port};
+  EXPECT_NE(ports[0], ports[1]);
+  EXPECT_EQ(ports[0], ports[2]);
+  EXPECT_EQ(IPPROTO_UDP, exts[1].proto);
+  EXPECT_EQ(2, p0.sessions());
+
+  // Ports come from the partition's half of the subscriber's block.
+  be32_t ext;
+  uint16_t first, last;
+  ASSERT_TRUE(cgnat.MapInternal(keys[0].addr, &ext, &first, &last));
+  EXPECT_EQ(ext, exts[0].addr);
+  EXPECT_GE(ports[0].value(), first);
+  EXPECT_LT(ports[0].value(), first + 1008);
+
+  uint16_t port1 = TranslateOne(&p1, keys[0], 1);
+  EXPECT_GE(port1, first + 1008);
+  EXPECT_LE(port1, last);
+
+  Cgnat::Key in;
+  ASSERT_TRUE(cgnat.Reverse(ext, ports[0], IPPROTO_TCP, &in));
+  EXPECT_EQ(keys[0].addr, in.addr);
+  EXPECT_EQ(keys[0].port, in.port);
+  EXPECT_FALSE(cgnat.Reverse(ext, ports[0], IPPROTO_UDP, &in));
+  EXPECT_TRUE(cgnat.Reverse(ext, ports[1], IPPROTO_UDP, &in));
+  EXPECT_FALSE(cgnat.Reverse(ext, be16_t(last), IPPROTO_TCP, &in));
+
+  Cgnat::Key ext_keys[2] = {MakeKey(ext.value(), ports[0].value(), IPPROTO_TCP),
+                            MakeKey(ext.value(), 80, IPPROTO_TCP)};
+  Cgnat::Key internal[2];
+  cgnat.ReverseBulk(ext_keys, 2, internal, found);
+  EXPECT_TRUE(found[0]);
+  EXPECT_EQ(keys[0].port, internal[0].port);
+  EXPECT_FALSE(found[1]);
+
+  // Not a subscriber.
+  Cgnat::Key outsider = MakeKey(0x0a000001, 1234, IPPROTO_UDP);
+  EXPECT_EQ(0, TranslateOne(&p0, outsider, 1));
+  EXPECT_EQ(1, p0.alloc_failures());
+}
+
+TEST(CgnatTest, ExhaustionAndReclaim) {
+  Cgnat cgnat;
+  Cgnat::Config config = MakeConfig(4);
+  config.int_prefix_len = 26;
+  ASSERT_EQ(0, cgnat.Init(config));
+  Cgnat::Partition p(&cgnat, 3);
+
+  std::set<uint16_t> used;
+  for (uint16_t i = 0; i < 504; i++) {
+    Cgnat::Key key = MakeKey(0x64400007, 10000 + i, IPPROTO_UDP);
+    uint16_t port = TranslateOne(&p, key, 0);
+    ASSERT_NE(0, port);
+    EXPECT_TRUE(used.insert(port).second);
+  }
+
+  Cgnat::Key extra = MakeKey(0x64400007, 20000, IPPROTO_UDP);
+  EXPECT_EQ(0, TranslateOne(&p, extra, 10 * kSec));
+  EXPECT_EQ(1, p.alloc_failures());
+
+  // Other subscribers are not affected.
+  Cgnat::Key other = MakeKey(0x64400008, 20000, IPPROTO_UDP);
+  EXPECT_NE(0, TranslateOne(&p, other, 10 * kSec));
+
+  // Once idle sessions time out, their ports are reused.
+  EXPECT_NE(0, TranslateOne(&p, extra, 301 * kSec));
+  EXPECT_EQ(1, p.expired());
+
+  // The sweeper reclaims the other idle sessions, of all subscribers.
+  p.Sweep(400 * kSec, 64 * 504);
+  EXPECT_EQ(1, p.sessions());
+  EXPECT_EQ(505, p.expired());
+}
+
+// Reverse lookups from other threads run concurrently with allocation.
+TEST(CgnatTest, ConcurrentReverse) {
+  Cgnat cgnat;
+  Cgnat::Config config = MakeConfig(1);
+  config.int_prefix_len = 26;
+  config.timeout_ns = 0;  // every allocation may reclaim
+  ASSERT_EQ(0, cgnat.Init(config));
+  Cgnat::Partition p(&cgnat, 0);
+
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> bad(0);
+  std::thread reader([&]() {
+    be32_t ext;
+    uint16_t first, last;
+    cgnat.MapInternal(be32_t(0x64400001), &ext, &first, &last);
+    while (!stop) {
+      for (uint32_t port = first; port <= last; port++) {
+        Cgnat::Key in;
+        if (cgnat.Reverse(ext, be16_t(port), IPPROTO_UDP, &in) &&
+            (in.addr.value() != 0x64400001 || in.port.value() < 30000)) {
+          bad++;
+        }
+      }
+    }
+  });
+
+  for (uint64_t t = 1; t < 20000; t++) {
+    Cgnat::Key key = MakeKey(0x64400001, 30000 + t % 3000, IPPROTO_UDP);
+    ASSERT_NE(0, TranslateOne(&p, key, t));
+  }
+  stop = true;
+  reader.join();
+  EXPECT_EQ(0, bad);
+}
+
+}  // namespace
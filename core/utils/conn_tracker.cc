@@ -0,0 +1,424 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "conn_tracker.h"
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "icmp.h"
+#include "tcp.h"
+#include "udp.h"
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+constexpr uint64_t kSec = 1000000000ull;
+
+// Flows are looked up in chunks of this many packets: all buckets of a chunk
+// are prefetched before the first one is probed.
+constexpr size_t kLookupChunk = 32;
+
+constexpr uint16_t kFragmentOffsetMask = 0x1fff;
+
+inline uint64_t Endpoint(be32_t addr, be16_t port) {
+  return (static_cast<uint64_t>(addr.raw_value()) << 16) | port.raw_value();
+}
+
+}  // namespace
+
+HashResult ConnTracker::FlowKey::Hash::operator()(const FlowKey &key) const {
+  uint64_t w[2];
+  memcpy(w, &key, sizeof(w));
+  return _mm_crc32_u64(_mm_crc32_u64(0, w[0]), w[1]);
+}
+
+bool ConnTracker::FlowKey::EqualTo::operator()(const FlowKey &lhs,
+                                               const FlowKey &rhs) const {
+  uint64_t a[2], b[2];
+  memcpy(a, &lhs, sizeof(a));
+  memcpy(b, &rhs, sizeof(b));
+  return ((a[0] ^ b[0]) | (a[1] ^ b[1])) == 0;
+}
+
+FlowTuple ConnTracker::Flow::tuple(Direction dir) const {
+  int src = orig ^ dir;
+  FlowTuple t;
+  t.src_addr = key.addr[src];
+  t.dst_addr = key.addr[src ^ 1];
+  t.src_port = key.port[src];
+  t.dst_port = key.port[src ^ 1];
+  t.proto = key.proto;
+  return t;
+}
+
+// Defaults follow the Linux nf_conntrack sysctls.
+ConnTracker::Config::Config()
+    : max_flows(65536), tcp_loose(true), timeout_ns(), tick_shift(24) {
+  timeout_ns[kTcpSynSent] = 120 * kSec;
+  timeout_ns[kTcpSynRecv] = 60 * kSec;
+  timeout_ns[kTcpEstablished] = 432000 * kSec;
+  timeout_ns[kTcpFinWait] = 120 * kSec;
+  timeout_ns[kTcpTimeWait] = 120 * kSec;
+  timeout_ns[kTcpClose] = 10 * kSec;
+  timeout_ns[kUnreplied] = 30 * kSec;
+  timeout_ns[kReplied] = 120 * kSec;
+}
+
+void ConnTracker::Init(const Config &config, uint64_t now_ns) {
+  config_ = config;
+  stats_ = {};
+
+  size_t max_flows = std::max<size_t>(config.max_flows, 1);
+  flows_ = std::vector<Flow>(max_flows);
+  free_.clear();
+  free_.reserve(max_flows);
+  for (size_t i = max_flows; i > 0; i--) {
+    free_.push_back(i - 1);
+  }
+
+  // Keep buckets at most half full, so that inserts rarely need to kick
+  // entries around (4 entries per bucket).
+  size_t buckets = align_ceil_pow2(std::max<size_t>(max_flows / 2, 1));
+  map_.reset(new FlowMap(buckets, max_flows));
+  wheel_.reset(new TimerWheel(config.tick_shift, now_ns));
+}
+
+bool ConnTracker::ParseIpv4(const Ipv4 *ip, size_t len, Packet *pkt) {
+  size_t ihl = ip->header_length << 2;
+  if (len < sizeof(Ipv4) || ihl < sizeof(Ipv4) || len < ihl) {
+    return false;
+  }
+
+  FlowTuple &t = pkt->tuple;
+  t.src_addr = ip->src;
+  t.dst_addr = ip->dst;
+  t.src_port = be16_t(0);
+  t.dst_port = be16_t(0);
+  t.proto = ip->protocol;
+  pkt->tcp_flags = 0;
+  pkt->length = ip->length.value();
+
+  if ((ip->fragment_offset.value() & kFragmentOffsetMask) != 0) {
+    return true;
+  }
+
+  const void *l4 = reinterpret_cast<const char *>(ip) + ihl;
+  size_t l4_len = len - ihl;
+
+  switch (ip->protocol) {
+    case Ipv4::Proto::kTcp: {
+      if (l4_len < sizeof(Tcp)) {
+        return false;
+      }
+      const Tcp *tcp = static_cast<const Tcp *>(l4);
+      t.src_port = tcp->src_port;
+      t.dst_port = tcp->dst_port;
+      pkt->tcp_flags = tcp->flags;
+      break;
+    }
+    case Ipv4::Proto::kUdp: {
+      if (l4_len < sizeof(Udp)) {
+        return false;
+      }
+      const Udp *udp = static_cast<const Udp *>(l4);
+      t.src_port = udp->src_port;
+      t.dst_port = udp->dst_port;
+      break;
+    }
+    case Ipv4::Proto::kIcmp: {
+      if (l4_len < sizeof(Icmp)) {
+        return false;
+      }
+      const Icmp *icmp = static_cast<const Icmp *>(l4);
+      // Echo, timestamp and information request/reply pairs share the
+      // identifier; errors are tracked as a flow of their own.
+      switch (icmp->type) {
+        case 0:   // echo reply
+        case 8:   // echo request
+        case 13:  // timestamp
+        case 14:  // timestamp reply
+        case 15:  // information request
+        case 16:  // information reply
+          t.src_port = icmp->ident;
+          t.dst_port = icmp->ident;
+          break;
+        default:
+          break;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+
+  return true;
+}
+
+int ConnTracker::MakeKey(const FlowTuple &tuple, FlowKey *key) {
+  int side = Endpoint(tuple.src_addr, tuple.src_port) >
+                     Endpoint(tuple.dst_addr, tuple.dst_port)
+                 ? 1
+                 : 0;
+  key->addr[side] = tuple.src_addr;
+  key->port[side] = tuple.src_port;
+  key->addr[side ^ 1] = tuple.dst_addr;
+  key->port[side ^ 1] = tuple.dst_port;
+  key->proto = tuple.proto;
+  return side;
+}
+
+void ConnTracker::Track(const Packet *pkts, size_t n, uint64_t now_ns,
+                        Result *results) {
+  FlowKey keys[kLookupChunk];
+  int sides[kLookupChunk];
+  HashResult hashes[kLookupChunk];
+
+  for (size_t base = 0; base < n; base += kLookupChunk) {
+    size_t cnt = std::min(n - base, kLookupChunk);
+
+    for (size_t i = 0; i < cnt; i++) {
+      sides[i] = MakeKey(pkts[base + i].tuple, &keys[i]);
+      hashes[i] = map_->HashKey(keys[i]);
+      map_->Prefetch(hashes[i]);
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      const Packet &pkt = pkts[base + i];
+      Result &res = results[base + i];
+
+      // Flows created earlier in the same chunk are found here as well.
+      const auto *entry = map_->FindHashed(hashes[i], keys[i]);
+      Flow *flow;
+      if (entry) {
+        flow = &flows_[entry->second];
+        res.created = false;
+      } else {
+        flow = Create(keys[i], sides[i], pkt, now_ns);
+        if (!flow) {
+          res.flow = nullptr;
+          res.dir = kOriginal;
+          res.created = false;
+          continue;
+        }
+        res.created = true;
+      }
+
+      Direction dir = (sides[i] == flow->orig) ? kOriginal : kReply;
+      Update(flow, dir, pkt, now_ns);
+      res.flow = flow;
+      res.dir = dir;
+    }
+  }
+}
+
+ConnTracker::Flow *ConnTracker::Find(const FlowTuple &tuple, Direction *dir) {
+  FlowKey key;
+  int side = MakeKey(tuple, &key);
+  const auto *entry = map_->Find(key);
+  if (!entry) {
+    return nullptr;
+  }
+
+  Flow *flow = &flows_[entry->second];
+  *dir = (side == flow->orig) ? kOriginal : kReply;
+  return flow;
+}
+
+ConnTracker::Flow *ConnTracker::Create(const FlowKey &key, int side,
+                                       const Packet &pkt, uint64_t now_ns) {
+  State state = kUnreplied;
+  if (key.proto == Ipv4::Proto::kTcp) {
+    uint8_t flags = pkt.tcp_flags & (Tcp::Flag::kSyn | Tcp::Flag::kAck |
+                                     Tcp::Flag::kRst);
+    if (flags == Tcp::Flag::kSyn) {
+      state = kTcpSynSent;
+    } else if (config_.tcp_loose && !(flags & Tcp::Flag::kRst)) {
+      state = kTcpEstablished;
+    } else {
+      stats_.invalid++;
+      return nullptr;
+    }
+  }
+
+  if (free_.empty()) {
+    stats_.table_full++;
+    return nullptr;
+  }
+
+  uint32_t idx = free_.back();
+  if (!map_->Insert(key, idx)) {
+    stats_.table_full++;
+    return nullptr;
+  }
+  free_.pop_back();
+
+  Flow *flow = &flows_[idx];
+  flow->key = key;
+  flow->orig = side;
+  flow->state = state;
+  flow->fin_seen = 0;
+  flow->deadline = now_ns + config_.timeout_ns[state];
+  flow->packets[kOriginal] = flow->packets[kReply] = 0;
+  flow->bytes[kOriginal] = flow->bytes[kReply] = 0;
+  flow->user_data = 0;
+  wheel_->Schedule(&flow->timer, flow->deadline);
+
+  stats_.created++;
+  return flow;
+}
+
+void ConnTracker::Update(Flow *flow, Direction dir, const Packet &pkt,
+                         uint64_t now_ns) {
+  flow->packets[dir]++;
+  flow->bytes[dir] += pkt.length;
+
+  if (flow->key.proto == Ipv4::Proto::kTcp) {
+    flow->state =
+        TcpTransition(flow->state, dir, pkt.tcp_flags, &flow->fin_seen);
+  } else if (dir == kReply) {
+    flow->state = kReplied;
+  }
+
+  // Extending the deadline is free: the timer notices when it fires. Only a
+  // shorter one (e.g., after a FIN or RST) needs the timer to be moved.
+  uint64_t deadline = now_ns + config_.timeout_ns[flow->state];
+  if ((deadline >> config_.tick_shift) < flow->timer.expiry) {
+    wheel_->Schedule(&flow->timer, deadline);
+  }
+  flow->deadline = deadline;
+}
+
+ConnTracker::State ConnTracker::TcpTransition(State state, Direction dir,
+                                              uint8_t flags,
+                                              uint8_t *fin_seen) {
+  if (flags & Tcp::Flag::kRst) {
+    return kTcpClose;
+  }
+
+  bool syn = flags & Tcp::Flag::kSyn;
+  bool ack = flags & Tcp::Flag::kAck;
+
+  if (syn) {
+    if (!ack) {
+      // A new connection reusing the tuple of a closed one.
+      if (dir == kOriginal && (state == kTcpTimeWait || state == kTcpClose)) {
+        *fin_seen = 0;
+        return kTcpSynSent;
+      }
+      return state;
+    }
+    if (dir == kReply && state == kTcpSynSent) {
+      return kTcpSynRecv;
+    }
+    return state;
+  }
+
+  if (flags & Tcp::Flag::kFin) {
+    *fin_seen |= 1 << dir;
+    if (*fin_seen == ((1 << kOriginal) | (1 << kReply))) {
+      return kTcpTimeWait;
+    }
+    if (state == kTcpTimeWait || state == kTcpClose) {
+      return state;
+    }
+    return kTcpFinWait;
+  }
+
+  if (ack && dir == kOriginal && state == kTcpSynRecv) {
+    return kTcpEstablished;
+  }
+
+  return state;
+}
+
+void ConnTracker::Expire(uint64_t now_ns) {
+  wheel_->Advance(now_ns, [this, now_ns](TimerWheel::Timer *t) {
+    Flow *flow = FlowOf(t);
+    if (flow->deadline > now_ns) {
+      wheel_->Schedule(t, flow->deadline);
+      return;
+    }
+
+    stats_.expired++;
+    if (config_.on_expire) {
+      config_.on_expire(*flow);
+    }
+    Release(flow);
+  });
+}
+
+void ConnTracker::Delete(Flow *flow) {
+  Release(flow);
+}
+
+void ConnTracker::Release(Flow *flow) {
+  wheel_->Cancel(&flow->timer);
+  map_->Remove(flow->key);
+  free_.push_back(flow - flows_.data());
+}
+
+void ConnTracker::Clear() {
+  for (Flow &flow : flows_) {
+    if (flow.timer.armed()) {
+      Release(&flow);
+    }
+  }
+  stats_ = {};
+}
+
+const char *ConnTracker::StateName(State state) {
+  switch (state) {
+    case kTcpSynSent:
+      return "SYN_SENT";
+    case kTcpSynRecv:
+      return "SYN_RECV";
+    case kTcpEstablished:
+      return "ESTABLISHED";
+    case kTcpFinWait:
+      return "FIN_WAIT";
+    case kTcpTimeWait:
+      return "TIME_WAIT";
+    case kTcpClose:
+      return "CLOSE";
+    case kUnreplied:
+      return "UNREPLIED";
+    case kReplied:
+      return "REPLIED";
+    default:
+      return "UNKNOWN";
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
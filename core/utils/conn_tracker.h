@@ -0,0 +1,241 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Connection tracking engine shared by stateful modules.
+//
+// A ConnTracker maps IPv4 5-tuples to bidirectional flows. Both directions of
+// a connection share one Flow, keyed by the tuple with its two endpoints in
+// canonical order, and each packet is classified as belonging to the original
+// or the reply direction. TCP flows follow a simplified version of the Linux
+// conntrack state machine, with a timeout per state; other protocols are
+// either unreplied or replied.
+//
+// Expiry is driven by a hierarchical timer wheel. A packet only pushes the
+// deadline of its flow forward; when the timer fires on a flow that has seen
+// traffic since, it is simply rescheduled, so the per-packet cost stays O(1)
+// and the wheel is touched at most once per timeout period per flow.
+//
+// A ConnTracker is not thread-safe. Modules keep one per worker, which
+// requires both directions of a connection to be steered to the same worker,
+// e.g., with symmetric RSS on the NIC (see PMDPortArg.symmetric_rss).
+
+#ifndef BESS_UTILS_CONN_TRACKER_H_
+#define BESS_UTILS_CONN_TRACKER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cuckoo_map.h"
+#include "endian.h"
+#include "ip.h"
+#include "timer_wheel.h"
+
+namespace bess {
+namespace utils {
+
+// A 5-tuple as seen in a packet. For ICMP query messages, the identifier is
+// used for both ports; for protocols without ports, both are zero.
+struct FlowTuple {
+  be32_t src_addr;
+  be32_t dst_addr;
+  be16_t src_port;
+  be16_t dst_port;
+  uint8_t proto;
+};
+
+class ConnTracker {
+ public:
+  enum Direction : uint8_t {
+    kOriginal = 0,
+    kReply = 1,
+  };
+
+  enum State : uint8_t {
+    kTcpSynSent = 0,
+    kTcpSynRecv,
+    kTcpEstablished,
+    kTcpFinWait,
+    kTcpTimeWait,
+    kTcpClose,
+    kUnreplied,  // non-TCP, seen in the original direction only
+    kReplied,    // non-TCP, seen in both directions
+    kNumStates,
+  };
+
+  // Both endpoints of a flow, lower one (by address, then port) first.
+  struct alignas(16) FlowKey {
+    be32_t addr[2];
+    be16_t port[2];
+    uint32_t proto;
+
+    struct Hash {
+      HashResult operator()(const FlowKey &key) const;
+    };
+
+    struct EqualTo {
+      bool operator()(const FlowKey &lhs, const FlowKey &rhs) const;
+    };
+  };
+  static_assert(sizeof(FlowKey) == 16, "FlowKey must be 16 bytes");
+
+  struct Flow {
+    FlowKey key;
+    uint8_t orig;      // index in `key` of the original direction's source
+    State state;
+    uint8_t fin_seen;  // bit (1 << Direction) set once a FIN was seen
+    uint64_t deadline;  // in ns
+    uint64_t packets[2];  // indexed by Direction
+    uint64_t bytes[2];
+    uint64_t user_data;  // free for the owner of the ConnTracker to use
+    TimerWheel::Timer timer;
+
+    // Returns the 5-tuple of direction `dir`.
+    FlowTuple tuple(Direction dir) const;
+  };
+
+  // The fields of a packet that the tracker needs.
+  struct Packet {
+    FlowTuple tuple;
+    uint8_t tcp_flags;  // Tcp::Flag bits, for TCP only
+    uint16_t length;    // IP length, for byte counters
+  };
+
+  // Per-packet outcome of Track(). `flow` is nullptr if the packet did not
+  // belong to an existing flow and none could be created for it.
+  struct Result {
+    Flow *flow;
+    Direction dir;
+    bool created;
+  };
+
+  // Upper bound on Config::max_flows. Tables are preallocated, at roughly
+  // 100 bytes per flow, so this caps a worker's table at about 400 MB.
+  static const size_t kMaxFlows = 1 << 22;
+
+  struct Config {
+    Config();
+
+    size_t max_flows;
+    // Pick up TCP connections mid-stream, i.e., without having seen their
+    // SYN. Otherwise a TCP packet that starts no flow is invalid.
+    bool tcp_loose;
+    uint64_t timeout_ns[kNumStates];
+    // Expiry granularity is 2^tick_shift ns.
+    int tick_shift;
+    // Called for every flow about to be removed by expiry.
+    std::function<void(const Flow &)> on_expire;
+  };
+
+  struct Stats {
+    uint64_t created;
+    uint64_t expired;
+    uint64_t invalid;     // TCP packets starting no flow
+    uint64_t table_full;  // packets for which no flow could be created
+  };
+
+  ConnTracker() : flows_(), free_(), map_(), wheel_(), config_(), stats_() {}
+
+  // Allocates all memory up front, so that construction is the only place
+  // pages are touched (see ScopedNodePreference).
+  void Init(const Config &config, uint64_t now_ns);
+
+  // Extracts the tracker's view of an IPv4 packet of which `len` bytes are
+  // available from `ip`. Returns false if the headers are truncated.
+  // Non-first fragments carry no L4 header and are tracked with zero ports.
+  static bool ParseIpv4(const Ipv4 *ip, size_t len, Packet *pkt);
+
+  // Looks up (or creates) the flow of each of `n` packets and updates its
+  // state, counters and deadline. Lookups are batched, so that bucket cache
+  // misses of the packets overlap.
+  void Track(const Packet *pkts, size_t n, uint64_t now_ns, Result *results);
+
+  // Lookup without side effects. Returns nullptr if there is no such flow.
+  Flow *Find(const FlowTuple &tuple, Direction *dir);
+
+  // Removes every flow whose deadline has passed by `now_ns`. Cheap enough to
+  // call once per batch: it returns right away until a tick has elapsed.
+  void Expire(uint64_t now_ns);
+
+  // Removes `flow` right away, without calling on_expire.
+  void Delete(Flow *flow);
+
+  // Removes all flows, without calling on_expire, and resets the stats.
+  void Clear();
+
+  template <typename F>
+  void ForEach(F &&fn) {
+    for (auto &entry : *map_) {
+      fn(flows_[entry.second]);
+    }
+  }
+
+  size_t count() const { return map_ ? map_->Count() : 0; }
+  size_t capacity() const { return flows_.size(); }
+  const Stats &stats() const { return stats_; }
+  const Config &config() const { return config_; }
+
+  static const char *StateName(State state);
+
+  // TCP state after a packet with `flags` in direction `dir`.
+  static State TcpTransition(State state, Direction dir, uint8_t flags,
+                             uint8_t *fin_seen);
+
+ private:
+  using FlowMap =
+      CuckooMap<FlowKey, uint32_t, FlowKey::Hash, FlowKey::EqualTo>;
+
+  // Returns the index in `key` of the tuple's source.
+  static int MakeKey(const FlowTuple &tuple, FlowKey *key);
+
+  Flow *Create(const FlowKey &key, int side, const Packet &pkt,
+               uint64_t now_ns);
+  void Update(Flow *flow, Direction dir, const Packet &pkt, uint64_t now_ns);
+  void Release(Flow *flow);
+
+  static Flow *FlowOf(TimerWheel::Timer *t) {
+    return reinterpret_cast<Flow *>(reinterpret_cast<char *>(t) -
+                                    offsetof(Flow, timer));
+  }
+
+  std::vector<Flow> flows_;
+  std::vector<uint32_t> free_;  // indices of unused entries of flows_
+  std::unique_ptr<FlowMap> map_;
+  std::unique_ptr<TimerWheel> wheel_;
+  Config config_;
+  Stats stats_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CONN_TRACKER_H_
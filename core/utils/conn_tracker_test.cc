@@ -0,0 +1,268 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "conn_tracker.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tcp.h"
+
+namespace {
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::ConnTracker;
+using bess::utils::FlowTuple;
+using bess::utils::Ipv4;
+using bess::utils::Tcp;
+
+constexpr uint64_t kSec = 1000000000ull;
+
+ConnTracker::Packet MakePacket(uint32_t src, uint16_t sport, uint32_t dst,
+                               uint16_t dport, uint8_t proto,
+                               uint8_t flags = 0) {
+  ConnTracker::Packet pkt;
+  pkt.tuple.src_addr = be32_t(src);
+  pkt.tuple.dst_addr = be32_t(dst);
+  pkt.tuple.src_port = be16_t(sport);
+  pkt.tuple.dst_port = be16_t(dport);
+  pkt.tuple.proto = proto;
+  pkt.tcp_flags = flags;
+  pkt.length = 100;
+  return pkt;
+}
+
+ConnTracker::Packet Reverse(const ConnTracker::Packet &pkt,
+                            uint8_t flags = 0) {
+  const FlowTuple &t = pkt.tuple;
+  return MakePacket(t.dst_addr.value(), t.dst_port.value(), t.src_addr.value(),
+                    t.src_port.value(), t.proto, flags);
+}
+
+ConnTracker::Result TrackOne(ConnTracker *ct, const ConnTracker::Packet &pkt,
+                             uint64_t now) {
+  ConnTracker::Result res;
+  ct->Track(&pkt, 1, now, &res);
+  return res;
+}
+
+// Both directions map to the same flow, with the direction of the first
+// packet being the original one.
+TEST(ConnTrackerTest, Bidirectional) {
+  ConnTracker ct;
+  ct.Init(ConnTracker::Config(), 0);
+
+  auto fwd = MakePacket(0x0a000002, 5000, 0x0a000001, 53, Ipv4::Proto::kUdp);
+  auto r1 = TrackOne(&ct, fwd, 1);
+  ASSERT_NE(nullptr, r1.flow);
+  EXPECT_TRUE(r1.created);
+  EXPECT_EQ(ConnTracker::kOriginal, r1.dir);
+  EXPECT_EQ(ConnTracker::kUnreplied, r1.flow->state);
+
+  auto r2 = TrackOne(&ct, Reverse(fwd), 2);
+  EXPECT_EQ(r1.flow, r2.flow);
+  EXPECT_FALSE(r2.created);
+  EXPECT_EQ(ConnTracker::kReply, r2.dir);
+  EXPECT_EQ(ConnTracker::kReplied, r2.flow->state);
+  EXPECT_EQ(1, r2.flow->packets[ConnTracker::kOriginal]);
+  EXPECT_EQ(1, r2.flow->packets[ConnTracker::kReply]);
+  EXPECT_EQ(1, ct.count());
+
+  FlowTuple orig = r1.flow->tuple(ConnTracker::kOriginal);
+  EXPECT_EQ(fwd.tuple.src_addr, orig.src_addr);
+  EXPECT_EQ(fwd.tuple.src_port, orig.src_port);
+  EXPECT_EQ(fwd.tuple.dst_addr, orig.dst_addr);
+  EXPECT_EQ(fwd.tuple.dst_port, orig.dst_port);
+
+  ConnTracker::Direction dir;
+  EXPECT_EQ(r1.flow, ct.Find(Reverse(fwd).tuple, &dir));
+  EXPECT_EQ(ConnTracker::kReply, dir);
+
+  // Same ports but a different protocol is a different flow.
+  auto tcp = MakePacket(0x0a000002, 5000, 0x0a000001, 53, Ipv4::Proto::kTcp,
+                        Tcp::Flag::kSyn);
+  auto r3 = TrackOne(&ct, tcp, 3);
+  EXPECT_NE(r1.flow, r3.flow);
+  EXPECT_EQ(2, ct.count());
+}
+
+TEST(ConnTrackerTest, TcpStateMachine) {
+  ConnTracker::Config config;
+  config.tcp_loose = false;
+  ConnTracker ct;
+  ct.Init(config, 0);
+
+  auto syn = MakePacket(0xc0a80001, 40000, 0x08080808, 443, Ipv4::Proto::kTcp,
+                        Tcp::Flag::kSyn);
+
+  // Without tcp_loose, only a SYN starts a flow.
+  auto ack = syn;
+  ack.tcp_flags = Tcp::Flag::kAck;
+  EXPECT_EQ(nullptr, TrackOne(&ct, ack, 1).flow);
+  EXPECT_EQ(1, ct.stats().invalid);
+
+  ConnTracker::Flow *flow = TrackOne(&ct, syn, 1).flow;
+  ASSERT_NE(nullptr, flow);
+  EXPECT_EQ(ConnTracker::kTcpSynSent, flow->state);
+
+  TrackOne(&ct, Reverse(syn, Tcp::Flag::kSyn | Tcp::Flag::kAck), 2);
+  EXPECT_EQ(ConnTracker::kTcpSynRecv, flow->state);
+
+  TrackOne(&ct, ack, 3);
+  EXPECT_EQ(ConnTracker::kTcpEstablished, flow->state);
+
+  auto fin = syn;
+  fin.tcp_flags = Tcp::Flag::kFin | Tcp::Flag::kAck;
+  TrackOne(&ct, fin, 4);
+  EXPECT_EQ(ConnTracker::kTcpFinWait, flow->state);
+
+  TrackOne(&ct, Reverse(syn, Tcp::Flag::kFin | Tcp::Flag::kAck), 5);
+  EXPECT_EQ(ConnTracker::kTcpTimeWait, flow->state);
+
+  // A new SYN reopens the flow.
+  EXPECT_EQ(flow, TrackOne(&ct, syn, 6).flow);
+  EXPECT_EQ(ConnTracker::kTcpSynSent, flow->state);
+  EXPECT_EQ(0, flow->fin_seen);
+
+  auto rst = Reverse(syn, Tcp::Flag::kRst);
+  TrackOne(&ct, rst, 7);
+  EXPECT_EQ(ConnTracker::kTcpClose, flow->state);
+}
+
+TEST(ConnTrackerTest, Expiry) {
+  ConnTracker::Config config;
+  config.tick_shift = 20;  // ~1ms
+  std::vector<FlowTuple> expired;
+  config.on_expire = [&](const ConnTracker::Flow &f) {
+    expired.push_back(f.tuple(ConnTracker::kOriginal));
+  };
+  ConnTracker ct;
+  ct.Init(config, 0);
+
+  auto udp = MakePacket(0x01020304, 1000, 0x05060708, 2000, Ipv4::Proto::kUdp);
+  auto tcp = MakePacket(0x01020304, 1000, 0x05060708, 2000, Ipv4::Proto::kTcp,
+                        Tcp::Flag::kAck);
+  TrackOne(&ct, udp, 0);
+  TrackOne(&ct, tcp, 0);  // picked up mid-stream: established
+  EXPECT_EQ(2, ct.count());
+
+  // Traffic keeps the UDP flow alive past its first deadline.
+  ct.Expire(20 * kSec);
+  TrackOne(&ct, udp, 20 * kSec);
+  ct.Expire(40 * kSec);
+  EXPECT_EQ(0, expired.size());
+  EXPECT_EQ(2, ct.count());
+
+  ct.Expire(51 * kSec);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(Ipv4::Proto::kUdp, expired[0].proto);
+  EXPECT_EQ(udp.tuple.src_port, expired[0].src_port);
+  EXPECT_EQ(1, ct.count());
+
+  // RST shortens the TCP deadline from days to seconds.
+  TrackOne(&ct, Reverse(tcp, Tcp::Flag::kRst), 60 * kSec);
+  ct.Expire(71 * kSec);
+  EXPECT_EQ(2, expired.size());
+  EXPECT_EQ(0, ct.count());
+  EXPECT_EQ(2, ct.stats().expired);
+
+  // The slots are reusable.
+  EXPECT_TRUE(TrackOne(&ct, udp, 72 * kSec).created);
+}
+
+TEST(ConnTrackerTest, TableFull) {
+  ConnTracker::Config config;
+  config.max_flows = 1000;
+  ConnTracker ct;
+  ct.Init(config, 0);
+
+  std::vector<ConnTracker::Packet> pkts;
+  for (uint32_t i = 0; i < 1200; i++) {
+    pkts.push_back(
+        MakePacket(0x0a000000 + i, 1234, 0x0b000000, 80, Ipv4::Proto::kUdp));
+  }
+  std::vector<ConnTracker::Result> results(pkts.size());
+  ct.Track(pkts.data(), pkts.size(), 0, results.data());
+
+  size_t created = 0;
+  for (const auto &res : results) {
+    created += res.created;
+  }
+  EXPECT_EQ(ct.count(), created);
+  EXPECT_GE(created, 950);
+  EXPECT_LE(created, 1000);
+  EXPECT_EQ(pkts.size() - created, ct.stats().table_full);
+
+  ct.Clear();
+  EXPECT_EQ(0, ct.count());
+  ct.Track(pkts.data(), 100, 0, results.data());
+  EXPECT_EQ(100, ct.count());
+}
+
+// Batched tracking must give the same results as one packet at a time,
+// including for flows whose both directions appear in the same batch.
+TEST(ConnTrackerTest, Bulk) {
+  ConnTracker ct_bulk;
+  ConnTracker ct_single;
+  ct_bulk.Init(ConnTracker::Config(), 0);
+  ct_single.Init(ConnTracker::Config(), 0);
+
+  std::vector<ConnTracker::Packet> pkts;
+  for (uint32_t i = 0; i < 500; i++) {
+    auto pkt = MakePacket(0x0a000000 + i % 37, 1000 + i % 11, 0x0b000001, 80,
+                          Ipv4::Proto::kUdp);
+    pkts.push_back(i % 3 ? pkt : Reverse(pkt));
+  }
+
+  std::vector<ConnTracker::Result> bulk(pkts.size());
+  ct_bulk.Track(pkts.data(), pkts.size(), 0, bulk.data());
+
+  for (size_t i = 0; i < pkts.size(); i++) {
+    auto single = TrackOne(&ct_single, pkts[i], 0);
+    ASSERT_NE(nullptr, bulk[i].flow);
+    EXPECT_EQ(single.dir, bulk[i].dir) << i;
+    EXPECT_EQ(single.created, bulk[i].created) << i;
+  }
+  EXPECT_EQ(ct_single.count(), ct_bulk.count());
+
+  for (const auto &pkt : pkts) {
+    ConnTracker::Direction dir;
+    const ConnTracker::Flow *a = ct_single.Find(pkt.tuple, &dir);
+    const ConnTracker::Flow *b = ct_bulk.Find(pkt.tuple, &dir);
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    EXPECT_EQ(a->state, b->state);
+    EXPECT_EQ(a->packets[0], b->packets[0]);
+    EXPECT_EQ(a->packets[1], b->packets[1]);
+  }
+}
+
+}  // namespace
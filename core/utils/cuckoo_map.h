@@ -50,7 +50,10 @@
 
 #include "../debug.h"
 #include "common.h"
+#include "numa.h"
 #include <iostream>
+#include <string>
+#include <rte_errno.h>
 #include <rte_hash.h>
 
 namespace bess {
@@ -80,6 +83,8 @@ class CuckooMap {
   bool IsDpdk = false;
   uint32_t key_len = 0;
   rte_hash_parameters rt;
+  // NUMA node the table storage is bound to, -1 if unbound
+  int socket_id_ = -1;
 
  public:
   struct rte_hash* hash = nullptr;
@@ -313,6 +318,37 @@ class CuckooMap {
     return ret;
   }
 
+  // Batched lookups can be split into three steps over a batch of keys, so that
+  // bucket cache misses overlap: HashKey(), Prefetch(), and then FindHashed().
+  HashResult HashKey(const K& key, const H& hasher = H()) const {
+    return Hash(key, hasher);
+  }
+
+  void Prefetch(HashResult primary) const {
+    __builtin_prefetch(&buckets_[primary & bucket_mask_]);
+  }
+
+  // Same as Find(), with `primary` previously computed by HashKey().
+  Entry* FindHashed(HashResult primary, const K& key, const E& eq = E()) {
+    return const_cast<Entry*>(
+        static_cast<
+            const typename std::remove_reference<decltype(*this)>::type&>(*this)
+            .FindHashed(primary, key, eq));
+  }
+
+  // const version of FindHashed()
+  const Entry* FindHashed(HashResult primary, const K& key,
+                          const E& eq = E()) const {
+    EntryIndex idx = FindWithHash(primary, key, eq);
+    if (idx == kInvalidEntryIdx) {
+      return nullptr;
+    }
+
+    const Entry* ret = &entries_[idx];
+    promise(ret != nullptr);
+    return ret;
+  }
+
   // Remove the stored entry by the key
   // Return false if not exist.
   bool Remove(const K& key, const H& hasher = H(), const E& eq = E()) {
@@ -359,6 +395,26 @@ class CuckooMap {
     }
   }
 
+  // Grows the table so that `n` entries in total can be inserted without
+  // rehashing along the way. Existing entries are kept. Buckets are sized for
+  // a load factor of at most 50%, beyond which insertions start to collide.
+  void Reserve(size_t n, const H& hasher = H(), const E& eq = E()) {
+    if (IsDpdk) {
+      return;
+    }
+
+    size_t num_buckets = buckets_.size();
+    while (num_buckets * kEntriesPerBucket < n * 2) {
+      num_buckets *= 2;
+    }
+
+    if (num_buckets > buckets_.size() || n > entries_.size()) {
+      Rehash<std::conditional_t<std::is_move_constructible<V>::value, V&&,
+                                const V&>>(
+          num_buckets, std::max(n, entries_.size()), hasher, eq);
+    }
+  }
+
   // Return the number of stored entries
   size_t Count() const {
     if (IsDpdk)
@@ -377,6 +433,50 @@ class CuckooMap {
     }
   }
 
+  // Re-homes the table onto NUMA node `socket_id`. A DPDK-backed table is
+  // rebuilt as `name` (which must not clash with the current rte_hash name),
+  // carrying over all keys and data pointers; otherwise the bucket and entry
+  // arrays are migrated in place and later growth stays on that node.
+  // Returns 0 on success, or -errno with the current table left intact.
+  // Not thread-safe with any other access to the table.
+  int MoveToSocket(int socket_id, const std::string& name = "") {
+    if (!IsDpdk) {
+      socket_id_ = socket_id;
+      int ret = MovePagesToNode(buckets_.data(),
+                                buckets_.size() * sizeof(Bucket), socket_id);
+      if (ret == 0) {
+        ret = MovePagesToNode(entries_.data(), entries_.size() * sizeof(Entry),
+                              socket_id);
+      }
+      return ret;
+    }
+
+    rte_hash_parameters params = rt;
+    params.name = name.c_str();
+    params.socket_id = socket_id;
+    struct rte_hash* new_hash = rte_hash_create(&params);
+    if (!new_hash) {
+      return -rte_errno;
+    }
+
+    const void* key;
+    void* data;
+    uint32_t next = 0;
+    while (rte_hash_iterate(hash, &key, &data, &next) >= 0) {
+      int ret = rte_hash_add_key_data(new_hash, key, data);
+      if (ret < 0) {
+        rte_hash_free(new_hash);
+        return ret;
+      }
+    }
+
+    rte_hash_free(hash);
+    hash = new_hash;
+    rt.socket_id = socket_id;
+    socket_id_ = socket_id;
+    return 0;
+  }
+
   // bulk data look up bess func
   int32_t lookup_bulk_data(const void** keys, uint32_t num_keys,
                            uint64_t* hit_mask, void* data[]) {
@@ -618,6 +718,7 @@ class CuckooMap {
 
   // Resize the space of entries. Grow less aggressively than buckets.
   void ExpandEntries() {
+    ScopedNodePreference numa(socket_id_);
     size_t old_size = entries_.size();
     size_t new_size = old_size + old_size / 2;
 
@@ -631,7 +732,15 @@ class CuckooMap {
   // Resize the space of buckets, and rehash existing entries
   template <typename VV>
   void ExpandBuckets(const H& hasher, const E& eq) {
-    CuckooMap<K, V, H, E> bigger(buckets_.size() * 2, entries_.size());
+    Rehash<VV>(buckets_.size() * 2, entries_.size(), hasher, eq);
+  }
+
+  // Move all entries into new bucket and entry arrays of the given sizes
+  template <typename VV>
+  void Rehash(size_t num_buckets, size_t num_entries, const H& hasher,
+              const E& eq) {
+    ScopedNodePreference numa(socket_id_);
+    CuckooMap<K, V, H, E> bigger(num_buckets, num_entries);
 
     for (auto& e : *this) {
       // While very unlikely, this DoEmplace() may cause recursive expansion
@@ -655,9 +764,10 @@ class CuckooMap {
   // # of entries
   size_t num_entries_;
 
-  // bucket and entry arrays grow independently
-  std::vector<Bucket> buckets_;
-  std::vector<Entry> entries_;
+  // bucket and entry arrays grow independently, each in pages of its own so
+  // that MoveToSocket() does not move anything else
+  std::vector<Bucket, PageAllocator<Bucket>> buckets_;
+  std::vector<Entry, PageAllocator<Entry>> entries_;
 
   // Stack of free entries
   std::stack<EntryIndex> free_entry_indices_;
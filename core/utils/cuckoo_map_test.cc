@@ -221,6 +221,29 @@ TEST(CuckooMapTest, Clear) {
   EXPECT_FALSE(cuckoo.Remove(2));
 }
 
+// Test Reserve function
+TEST(CuckooMapTest, Reserve) {
+  CuckooMap<uint32_t, uint16_t> cuckoo;
+
+  cuckoo.Insert(1, 99);
+  cuckoo.Insert(2, 98);
+  cuckoo.Reserve(10000);
+  EXPECT_EQ(cuckoo.Count(), 2);
+  EXPECT_EQ(cuckoo.Find(1)->second, 99);
+  EXPECT_EQ(cuckoo.Find(2)->second, 98);
+
+  for (uint32_t i = 3; i <= 10000; i++) {
+    ASSERT_NE(cuckoo.Insert(i, i & 0xffff), nullptr);
+  }
+  EXPECT_EQ(cuckoo.Count(), 10000);
+  EXPECT_EQ(cuckoo.Find(10000)->second, 10000);
+
+  // Reserving less than what is there is a no-op
+  cuckoo.Reserve(1);
+  EXPECT_EQ(cuckoo.Count(), 10000);
+  EXPECT_EQ(cuckoo.Find(1)->second, 99);
+}
+
 // Test iterators
 TEST(CuckooMapTest, Iterator) {
   CuckooMap<uint32_t, uint16_t> cuckoo;
@@ -0,0 +1,1815 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <sys/mman.h>
+#include <x86intrin.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+
+#include "endian.h"
+#include "format.h"
+#include "random.h"
+
+namespace bess {
+namespace utils {
+
+using namespace ebpf;
+
+// ---------------------------------------------------------------------------
+// Maps
+// ---------------------------------------------------------------------------
+
+namespace {
+
+class ScopedMcsLock {
+ public:
+  explicit ScopedMcsLock(mcslock_t *lock) : lock_(lock) {
+    mcs_lock(lock_, &node_);
+  }
+  ~ScopedMcsLock() { mcs_unlock(lock_, &node_); }
+
+ private:
+  mcslock_t *lock_;
+  mcslock_node_t node_;
+};
+
+uint32_t HashBytes(const void *key, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(key);
+  uint64_t hash = 0;
+
+  for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t)) {
+    uint64_t chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+    hash = _mm_crc32_u64(hash, chunk);
+    p += sizeof(uint64_t);
+  }
+  for (; len > 0; len--) {
+    hash = _mm_crc32_u8(hash, *p++);
+  }
+  return hash;
+}
+
+}  // namespace
+
+EbpfMap *EbpfMap::Create(Type type, uint32_t key_size, uint32_t value_size,
+                         uint32_t max_entries, std::string *err) {
+  // Keep every map under 4GB
+  const uint64_t kMaxBytes = 1ull << 32;
+
+  if (type != kArray && type != kHash) {
+    *err = "invalid map type";
+    return nullptr;
+  }
+  if (type == kArray && key_size != sizeof(uint32_t)) {
+    *err = "array maps must have 4-byte keys";
+    return nullptr;
+  }
+  if (key_size == 0 || key_size > kStackSize) {
+    *err = Format("invalid key size %u", key_size);
+    return nullptr;
+  }
+  if (value_size == 0 || value_size > kStackSize) {
+    *err = Format("invalid value size %u", value_size);
+    return nullptr;
+  }
+  if (max_entries == 0 ||
+      uint64_t{max_entries} * 2 * (key_size + value_size + 1) > kMaxBytes) {
+    *err = Format("invalid max_entries %u", max_entries);
+    return nullptr;
+  }
+
+  return new EbpfMap(type, key_size, value_size, max_entries);
+}
+
+EbpfMap::EbpfMap(Type type, uint32_t key_size, uint32_t value_size,
+                 uint32_t max_entries)
+    : type_(type),
+      key_size_(key_size),
+      value_size_(value_size),
+      max_entries_(max_entries),
+      num_slots_(max_entries),
+      count_(),
+      state_(),
+      keys_(),
+      values_() {
+  mcs_lock_init(&lock_);
+
+  if (type_ == kHash) {
+    // Keep the load factor under 50% for short probe sequences
+    num_slots_ = 1;
+    while (num_slots_ < size_t{max_entries} * 2) {
+      num_slots_ *= 2;
+    }
+    state_ = static_cast<uint8_t *>(calloc(num_slots_, 1));
+    keys_ = static_cast<uint8_t *>(calloc(num_slots_, key_size_));
+  }
+
+  // Values are 8-byte aligned so that programs can use 64-bit accesses
+  values_ = static_cast<uint8_t *>(
+      aligned_alloc(64, (num_slots_ * value_size_ + 63) / 64 * 64));
+  memset(values_, 0, num_slots_ * value_size_);
+}
+
+EbpfMap::~EbpfMap() {
+  free(state_);
+  free(keys_);
+  free(values_);
+}
+
+ssize_t EbpfMap::FindSlot(const void *key) {
+  size_t mask = num_slots_ - 1;
+  size_t slot = HashBytes(key, key_size_) & mask;
+
+  for (size_t i = 0; i < num_slots_; i++, slot = (slot + 1) & mask) {
+    if (state_[slot] == kEmpty) {
+      return -1;
+    }
+    if (state_[slot] == kUsed && memcmp(key_at(slot), key, key_size_) == 0) {
+      return slot;
+    }
+  }
+  return -1;
+}
+
+void *EbpfMap::Lookup(const void *key) {
+  if (type_ == kArray) {
+    uint32_t idx;
+    memcpy(&idx, key, sizeof(idx));
+    return (idx < max_entries_) ? value_at(idx) : nullptr;
+  }
+
+  ScopedMcsLock lock(&lock_);
+  ssize_t slot = FindSlot(key);
+  return (slot >= 0) ? value_at(slot) : nullptr;
+}
+
+int EbpfMap::Update(const void *key, const void *value, uint64_t flags) {
+  if (flags > kExist) {
+    return -EINVAL;
+  }
+
+  if (type_ == kArray) {
+    uint32_t idx;
+    memcpy(&idx, key, sizeof(idx));
+    if (idx >= max_entries_) {
+      return -E2BIG;
+    }
+    if (flags == kNoExist) {
+      return -EEXIST;  // array elements always exist
+    }
+    memcpy(value_at(idx), value, value_size_);
+    return 0;
+  }
+
+  ScopedMcsLock lock(&lock_);
+
+  ssize_t slot = FindSlot(key);
+  if (slot >= 0) {
+    if (flags == kNoExist) {
+      return -EEXIST;
+    }
+    memcpy(value_at(slot), value, value_size_);
+    return 0;
+  }
+
+  if (flags == kExist) {
+    return -ENOENT;
+  }
+  if (count_ >= max_entries_) {
+    return -E2BIG;
+  }
+
+  // Take the first free (empty or deleted) slot on the probe sequence.
+  // There is always one, since count_ < max_entries_ <= num_slots_ / 2.
+  size_t mask = num_slots_ - 1;
+  size_t free_slot = HashBytes(key, key_size_) & mask;
+  while (state_[free_slot] == kUsed) {
+    free_slot = (free_slot + 1) & mask;
+  }
+
+  memcpy(key_at(free_slot), key, key_size_);
+  memcpy(value_at(free_slot), value, value_size_);
+  state_[free_slot] = kUsed;
+  count_++;
+  return 0;
+}
+
+int EbpfMap::Delete(const void *key) {
+  if (type_ == kArray) {
+    return -EINVAL;
+  }
+
+  ScopedMcsLock lock(&lock_);
+
+  ssize_t slot = FindSlot(key);
+  if (slot < 0) {
+    return -ENOENT;
+  }
+
+  state_[slot] = kDeleted;
+  count_--;
+  return 0;
+}
+
+void EbpfMap::ForEach(
+    const std::function<void(const void *key, const void *value)> &f) {
+  if (type_ == kArray) {
+    for (uint32_t i = 0; i < max_entries_; i++) {
+      f(&i, value_at(i));
+    }
+    return;
+  }
+
+  ScopedMcsLock lock(&lock_);
+  for (size_t slot = 0; slot < num_slots_; slot++) {
+    if (state_[slot] == kUsed) {
+      f(key_at(slot), value_at(slot));
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Helper functions
+// ---------------------------------------------------------------------------
+
+namespace {
+
+using HelperFunc = uint64_t (*)(uint64_t, uint64_t, uint64_t, uint64_t,
+                                uint64_t);
+
+uint64_t HelperMapLookupElem(uint64_t map, uint64_t key, uint64_t, uint64_t,
+                             uint64_t) {
+  return reinterpret_cast<uintptr_t>(
+      reinterpret_cast<EbpfMap *>(map)->Lookup(
+          reinterpret_cast<const void *>(key)));
+}
+
+uint64_t HelperMapUpdateElem(uint64_t map, uint64_t key, uint64_t value,
+                             uint64_t flags, uint64_t) {
+  return reinterpret_cast<EbpfMap *>(map)->Update(
+      reinterpret_cast<const void *>(key),
+      reinterpret_cast<const void *>(value), flags);
+}
+
+uint64_t HelperMapDeleteElem(uint64_t map, uint64_t key, uint64_t, uint64_t,
+                             uint64_t) {
+  return reinterpret_cast<EbpfMap *>(map)->Delete(
+      reinterpret_cast<const void *>(key));
+}
+
+uint64_t HelperGetPrandomU32(uint64_t, uint64_t, uint64_t, uint64_t,
+                             uint64_t) {
+  static thread_local Random rng;
+  return rng.Get();
+}
+
+HelperFunc GetHelper(int32_t id) {
+  switch (id) {
+    case kHelperMapLookupElem:
+      return HelperMapLookupElem;
+    case kHelperMapUpdateElem:
+      return HelperMapUpdateElem;
+    case kHelperMapDeleteElem:
+      return HelperMapDeleteElem;
+    case kHelperGetPrandomU32:
+      return HelperGetPrandomU32;
+    default:
+      return nullptr;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Instruction semantics shared by the interpreter and the verifier
+// ---------------------------------------------------------------------------
+
+// Returns the immediate operand of an ALU instruction, as seen by the
+// instruction: sign-extended for 64-bit operations.
+uint64_t AluImm(const EbpfInsn &insn) {
+  return (Class(insn.code) == kAlu64) ? static_cast<int64_t>(insn.imm)
+                                      : static_cast<uint32_t>(insn.imm);
+}
+
+// Division by zero yields 0, and modulo by zero leaves dst unchanged
+uint64_t AluOp(uint8_t op, bool is64, uint64_t dst, uint64_t src) {
+  if (is64) {
+    switch (op) {
+      case kAdd:
+        return dst + src;
+      case kSub:
+        return dst - src;
+      case kMul:
+        return dst * src;
+      case kDiv:
+        return src ? dst / src : 0;
+      case kOr:
+        return dst | src;
+      case kAnd:
+        return dst & src;
+      case kLsh:
+        return dst << (src & 63);
+      case kRsh:
+        return dst >> (src & 63);
+      case kNeg:
+        return -dst;
+      case kMod:
+        return src ? dst % src : dst;
+      case kXor:
+        return dst ^ src;
+      case kMov:
+        return src;
+      case kArsh:
+        return static_cast<int64_t>(dst) >> (src & 63);
+    }
+  } else {
+    uint32_t d = dst;
+    uint32_t s = src;
+    switch (op) {
+      case kAdd:
+        return uint32_t{d + s};
+      case kSub:
+        return uint32_t{d - s};
+      case kMul:
+        return uint32_t{d * s};
+      case kDiv:
+        return s ? d / s : 0;
+      case kOr:
+        return d | s;
+      case kAnd:
+        return d & s;
+      case kLsh:
+        return uint32_t{d << (s & 31)};
+      case kRsh:
+        return d >> (s & 31);
+      case kNeg:
+        return uint32_t{-d};
+      case kMod:
+        return s ? d % s : d;
+      case kXor:
+        return d ^ s;
+      case kMov:
+        return s;
+      case kArsh:
+        return static_cast<uint32_t>(static_cast<int32_t>(d) >> (s & 31));
+    }
+  }
+  return 0;
+}
+
+uint64_t EndianOp(const EbpfInsn &insn, uint64_t dst) {
+  bool to_be = Src(insn.code) == kX;
+  switch (insn.imm) {
+    case 16:
+      return to_be ? __builtin_bswap16(dst) : static_cast<uint16_t>(dst);
+    case 32:
+      return to_be ? __builtin_bswap32(dst) : static_cast<uint32_t>(dst);
+    default:
+      return to_be ? __builtin_bswap64(dst) : dst;
+  }
+}
+
+bool JumpTaken(uint8_t op, uint64_t dst, uint64_t src) {
+  switch (op) {
+    case kJeq:
+      return dst == src;
+    case kJgt:
+      return dst > src;
+    case kJge:
+      return dst >= src;
+    case kJset:
+      return dst & src;
+    case kJne:
+      return dst != src;
+    case kJsgt:
+      return static_cast<int64_t>(dst) > static_cast<int64_t>(src);
+    case kJsge:
+      return static_cast<int64_t>(dst) >= static_cast<int64_t>(src);
+    case kJlt:
+      return dst < src;
+    case kJle:
+      return dst <= src;
+    case kJslt:
+      return static_cast<int64_t>(dst) < static_cast<int64_t>(src);
+    case kJsle:
+      return static_cast<int64_t>(dst) <= static_cast<int64_t>(src);
+  }
+  return false;
+}
+
+int SizeBytes(uint8_t code) {
+  switch (Size(code)) {
+    case kB:
+      return 1;
+    case kH:
+      return 2;
+    case kW:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+bool IsLdImm64(const EbpfInsn &insn) {
+  return insn.code == (kLd | kImm | kDw);
+}
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Interpreter
+// ---------------------------------------------------------------------------
+
+uint64_t EbpfProgram::Interpret(EbpfContext *ctx) const {
+  uint64_t reg[kNumRegs] = {};
+  uint64_t stack[kStackSize / sizeof(uint64_t)];
+
+  reg[1] = reinterpret_cast<uintptr_t>(ctx);
+  reg[10] = reinterpret_cast<uintptr_t>(stack + kStackSize / sizeof(uint64_t));
+
+  for (size_t pc = 0;; pc++) {
+    const EbpfInsn &insn = insns_[pc];
+    uint64_t &dst = reg[insn.dst_reg];
+    const uint64_t src = reg[insn.src_reg];
+
+    switch (Class(insn.code)) {
+      case kAlu:
+      case kAlu64: {
+        bool is64 = Class(insn.code) == kAlu64;
+        if (Op(insn.code) == kEnd) {
+          dst = EndianOp(insn, dst);
+        } else {
+          dst = AluOp(Op(insn.code), is64, dst,
+                      (Src(insn.code) == kX) ? src : AluImm(insn));
+        }
+        break;
+      }
+
+      case kLdx: {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(src) + insn.off;
+        switch (Size(insn.code)) {
+          case kB:
+            dst = *p;
+            break;
+          case kH:
+            dst = *reinterpret_cast<const uint16_t *>(p);
+            break;
+          case kW:
+            dst = *reinterpret_cast<const uint32_t *>(p);
+            break;
+          case kDw:
+            dst = *reinterpret_cast<const uint64_t *>(p);
+            break;
+        }
+        break;
+      }
+
+      case kSt:
+      case kStx: {
+        uint8_t *p = reinterpret_cast<uint8_t *>(dst) + insn.off;
+        uint64_t val = (Class(insn.code) == kStx)
+                           ? src
+                           : static_cast<uint64_t>(int64_t{insn.imm});
+        if (Mode(insn.code) == kXadd) {
+          if (Size(insn.code) == kW) {
+            __atomic_fetch_add(reinterpret_cast<uint32_t *>(p), val,
+                               __ATOMIC_RELAXED);
+          } else {
+            __atomic_fetch_add(reinterpret_cast<uint64_t *>(p), val,
+                               __ATOMIC_RELAXED);
+          }
+          break;
+        }
+        switch (Size(insn.code)) {
+          case kB:
+            *p = val;
+            break;
+          case kH:
+            *reinterpret_cast<uint16_t *>(p) = val;
+            break;
+          case kW:
+            *reinterpret_cast<uint32_t *>(p) = val;
+            break;
+          case kDw:
+            *reinterpret_cast<uint64_t *>(p) = val;
+            break;
+        }
+        break;
+      }
+
+      case kLd: {
+        if (IsLdImm64(insn)) {
+          dst = static_cast<uint32_t>(insn.imm) |
+                (static_cast<uint64_t>(insns_[pc + 1].imm) << 32);
+          pc++;
+          break;
+        }
+
+        // LD_ABS/LD_IND: R0 = ntoh(packet data), with R6 as the context
+        const EbpfContext *c = reinterpret_cast<const EbpfContext *>(reg[6]);
+        uint32_t off = insn.imm;
+        if (Mode(insn.code) == kInd) {
+          off += static_cast<uint32_t>(src);
+        }
+        int size = SizeBytes(insn.code);
+        if (uint64_t{off} + size > c->data_len) {
+          return 0;
+        }
+        const uint8_t *p = c->data + off;
+        switch (size) {
+          case 1:
+            reg[0] = *p;
+            break;
+          case 2: {
+            uint16_t v;
+            memcpy(&v, p, sizeof(v));  // packet data may be unaligned
+            reg[0] = be16_t::swap(v);
+            break;
+          }
+          case 4: {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            reg[0] = be32_t::swap(v);
+            break;
+          }
+        }
+        break;
+      }
+
+      case kJmp: {
+        uint8_t op = Op(insn.code);
+        if (op == kExit) {
+          return reg[0];
+        } else if (op == kCall) {
+          reg[0] = GetHelper(insn.imm)(reg[1], reg[2], reg[3], reg[4], reg[5]);
+        } else if (op == kJa ||
+                   JumpTaken(op, dst,
+                             (Src(insn.code) == kX)
+                                 ? src
+                                 : static_cast<int64_t>(insn.imm))) {
+          pc += insn.off;
+        }
+        break;
+      }
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Verifier
+// ---------------------------------------------------------------------------
+
+namespace {
+
+enum RegType : uint8_t {
+  kNotInit = 0,
+  kScalar,
+  kPtrToCtx,
+  kPtrToStack,
+  kPtrToMapValue,
+  kPtrToMapValueOrNull,
+  kConstMapPtr,
+};
+
+struct RegState {
+  RegType type;
+  bool known;    // for kScalar: value is a known constant
+  uint64_t val;  // for kScalar
+  int64_t off;   // for pointers: constant offset from the base
+  int map;       // for map pointers: map index
+
+  static RegState Scalar() { return {kScalar, false, 0, 0, -1}; }
+  static RegState Const(uint64_t v) { return {kScalar, true, v, 0, -1}; }
+  static RegState Ptr(RegType t, int64_t off = 0, int map = -1) {
+    return {t, false, 0, off, map};
+  }
+
+  bool is_pointer() const { return type != kNotInit && type != kScalar; }
+
+  bool operator==(const RegState &o) const {
+    return type == o.type && known == o.known && val == o.val &&
+           off == o.off && map == o.map;
+  }
+};
+
+struct State {
+  RegState regs[kNumRegs];
+};
+
+// Pointer offsets are kept well within the range of insn.off and int32_t
+const int64_t kMaxPtrOff = 1 << 29;
+
+class Verifier {
+ public:
+  Verifier(const std::vector<EbpfInsn> &insns,
+           const EbpfProgram::Config &config)
+      : insns_(insns),
+        config_(config),
+        states_(insns.size()),
+        reached_(insns.size()) {}
+
+  bool Run(std::string *err) {
+    if (!CheckStructure(err)) {
+      return false;
+    }
+
+    State entry = {};
+    entry.regs[1] = RegState::Ptr(kPtrToCtx);
+    entry.regs[10] = RegState::Ptr(kPtrToStack);
+    Propagate(0, entry);
+
+    // Since all jumps go forward, every predecessor of an instruction has
+    // been visited (and merged into its state) by the time we get to it.
+    for (size_t pc = 0; pc < insns_.size(); pc++) {
+      if (!reached_[pc]) {
+        continue;
+      }
+      if (!Step(pc, err)) {
+        *err = Format("insn %zu: %s", pc, err->c_str());
+        return false;
+      }
+      if (IsLdImm64(insns_[pc])) {
+        pc++;
+      }
+    }
+    return true;
+  }
+
+ private:
+  bool CheckStructure(std::string *err) {
+    size_t n = insns_.size();
+
+    if (n == 0 || n > kMaxInsns) {
+      *err = Format("program must have 1-%zu instructions", kMaxInsns);
+      return false;
+    }
+
+    std::vector<bool> second_half(n);
+    for (size_t pc = 0; pc < n; pc++) {
+      if (IsLdImm64(insns_[pc])) {
+        if (pc + 1 == n || insns_[pc + 1].code != 0) {
+          *err = Format("insn %zu: incomplete 64-bit immediate load", pc);
+          return false;
+        }
+        second_half[++pc] = true;
+      }
+    }
+
+    for (size_t pc = 0; pc < n; pc++) {
+      const EbpfInsn &insn = insns_[pc];
+      if (second_half[pc]) {
+        continue;
+      }
+      if (insn.dst_reg >= kNumRegs || insn.src_reg >= kNumRegs) {
+        *err = Format("insn %zu: invalid register", pc);
+        return false;
+      }
+
+      uint8_t cls = Class(insn.code);
+      uint8_t op = Op(insn.code);
+      size_t next = pc + (IsLdImm64(insn) ? 2 : 1);
+
+      if (cls == kJmp && op == kExit) {
+        continue;
+      }
+
+      if (cls == kJmp && op != kCall) {
+        if (insn.off < 0) {
+          *err = Format("insn %zu: backward jumps are not allowed", pc);
+          return false;
+        }
+        size_t target = pc + 1 + insn.off;
+        if (target >= n || second_half[target]) {
+          *err = Format("insn %zu: invalid jump target", pc);
+          return false;
+        }
+        if (op == kJa) {
+          continue;  // no fall-through
+        }
+      }
+
+      if (next >= n) {
+        *err = "program must end with exit or jump";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Propagate(size_t pc, const State &state) {
+    if (!reached_[pc]) {
+      reached_[pc] = true;
+      states_[pc] = state;
+      return;
+    }
+
+    State &cur = states_[pc];
+    for (int i = 0; i < kNumRegs; i++) {
+      RegState &a = cur.regs[i];
+      const RegState &b = state.regs[i];
+      if (a == b) {
+        continue;
+      }
+      if (a.type == kScalar && b.type == kScalar) {
+        a = RegState::Scalar();
+      } else {
+        a = RegState();  // unusable
+      }
+    }
+  }
+
+  bool ReadReg(const State &s, int reg, std::string *err) {
+    if (s.regs[reg].type == kNotInit) {
+      *err = Format("R%d is not initialized", reg);
+      return false;
+    }
+    return true;
+  }
+
+  bool WriteReg(int reg, std::string *err) {
+    if (reg == 10) {
+      *err = "R10 is read-only";
+      return false;
+    }
+    return true;
+  }
+
+  // Checks a memory access of size bytes at base + off
+  bool CheckAccess(const RegState &base, int16_t insn_off, int size,
+                   bool write, std::string *err) {
+    int64_t off = base.off + insn_off;
+    const int64_t attrs_off = offsetof(EbpfContext, attrs);
+
+    switch (base.type) {
+      case kPtrToStack:
+        if (off >= -kStackSize && off + size <= 0) {
+          return true;
+        }
+        *err = Format("invalid stack access at %" PRId64, off);
+        return false;
+
+      case kPtrToMapValue:
+        if (off >= 0 && off + size <= config_.maps[base.map]->value_size()) {
+          return true;
+        }
+        *err = Format("invalid map value access at %" PRId64, off);
+        return false;
+
+      case kPtrToCtx: {
+        int64_t end = attrs_off + config_.num_attrs * sizeof(uint64_t);
+        if (off < 0 || off + size > end) {
+          *err = Format("invalid context access at %" PRId64, off);
+          return false;
+        }
+        if (!write) {
+          return true;
+        }
+        int64_t slot = (off - attrs_off) / 8;
+        if (off < attrs_off || (off + size - 1 - attrs_off) / 8 != slot ||
+            !(config_.writable_attrs & (1u << slot))) {
+          *err = Format("context at %" PRId64 " is not writable", off);
+          return false;
+        }
+        return true;
+      }
+
+      case kPtrToMapValueOrNull:
+        *err = "map value pointer must be checked against NULL first";
+        return false;
+
+      default:
+        *err = "memory access via a non-pointer register";
+        return false;
+    }
+  }
+
+  bool StepAlu(const EbpfInsn &insn, State *s, std::string *err) {
+    bool is64 = Class(insn.code) == kAlu64;
+    uint8_t op = Op(insn.code);
+    RegState &dst = s->regs[insn.dst_reg];
+
+    if (!WriteReg(insn.dst_reg, err)) {
+      return false;
+    }
+
+    if (op == kEnd) {
+      if (is64 || (insn.imm != 16 && insn.imm != 32 && insn.imm != 64)) {
+        *err = "invalid byte swap";
+        return false;
+      }
+      if (!ReadReg(*s, insn.dst_reg, err)) {
+        return false;
+      }
+      if (dst.type != kScalar) {
+        *err = "byte swap of a pointer";
+        return false;
+      }
+      dst = dst.known ? RegState::Const(EndianOp(insn, dst.val))
+                      : RegState::Scalar();
+      return true;
+    }
+
+    if (op > kEnd) {
+      *err = "invalid ALU operation";
+      return false;
+    }
+
+    RegState src;
+    if (Src(insn.code) == kX) {
+      if (op == kNeg) {
+        *err = "invalid ALU operation";
+        return false;
+      }
+      if (!ReadReg(*s, insn.src_reg, err)) {
+        return false;
+      }
+      src = s->regs[insn.src_reg];
+    } else {
+      src = RegState::Const(AluImm(insn));
+      if ((op == kDiv || op == kMod) && insn.imm == 0) {
+        *err = "division by zero";
+        return false;
+      }
+      if ((op == kLsh || op == kRsh || op == kArsh) &&
+          static_cast<uint32_t>(insn.imm) >= (is64 ? 64u : 32u)) {
+        *err = "invalid shift";
+        return false;
+      }
+    }
+
+    if (op == kMov) {
+      if (src.is_pointer() && !is64) {
+        *err = "32-bit move of a pointer";
+        return false;
+      }
+      dst = src;
+      if (dst.type == kScalar && dst.known && !is64) {
+        dst.val = static_cast<uint32_t>(dst.val);
+      }
+      return true;
+    }
+
+    if (!ReadReg(*s, insn.dst_reg, err)) {
+      return false;
+    }
+
+    // Pointer arithmetic: only adding/subtracting constants
+    if (dst.is_pointer() || src.is_pointer()) {
+      if (!is64 || !dst.is_pointer() || src.type != kScalar || !src.known ||
+          (op != kAdd && op != kSub) || dst.type == kPtrToMapValueOrNull ||
+          dst.type == kConstMapPtr) {
+        *err = "invalid pointer arithmetic";
+        return false;
+      }
+      int64_t delta = static_cast<int64_t>(src.val);
+      if (delta > kMaxPtrOff || delta < -kMaxPtrOff) {
+        *err = "pointer offset out of range";
+        return false;
+      }
+      dst.off += (op == kAdd) ? delta : -delta;
+      if (dst.off > kMaxPtrOff || dst.off < -kMaxPtrOff) {
+        *err = "pointer offset out of range";
+        return false;
+      }
+      return true;
+    }
+
+    if (dst.known && src.known) {
+      dst = RegState::Const(AluOp(op, is64, dst.val, src.val));
+    } else {
+      dst = RegState::Scalar();
+    }
+    return true;
+  }
+
+  bool StepCall(const EbpfInsn &insn, State *s, std::string *err) {
+    int nargs;
+    switch (insn.imm) {
+      case kHelperMapLookupElem:
+      case kHelperMapDeleteElem:
+        nargs = 2;
+        break;
+      case kHelperMapUpdateElem:
+        nargs = 4;
+        break;
+      case kHelperGetPrandomU32:
+        nargs = 0;
+        break;
+      default:
+        *err = Format("unknown helper %d", insn.imm);
+        return false;
+    }
+
+    for (int i = 1; i <= nargs; i++) {
+      if (!ReadReg(*s, i, err)) {
+        return false;
+      }
+    }
+
+    RegState result = RegState::Scalar();
+
+    if (nargs > 0) {
+      const RegState &map = s->regs[1];
+      if (map.type != kConstMapPtr) {
+        *err = "R1 must be a map";
+        return false;
+      }
+      const EbpfMap *m = config_.maps[map.map];
+      if (!CheckAccess(s->regs[2], 0, m->key_size(), false, err)) {
+        return false;
+      }
+      if (s->regs[2].type != kPtrToStack) {
+        *err = "R2 must point to the stack";
+        return false;
+      }
+      if (insn.imm == kHelperMapUpdateElem) {
+        if (s->regs[3].type != kPtrToStack ||
+            !CheckAccess(s->regs[3], 0, m->value_size(), false, err)) {
+          *err = "R3 must point to a value on the stack";
+          return false;
+        }
+        if (s->regs[4].type != kScalar) {
+          *err = "R4 must be a scalar";
+          return false;
+        }
+      }
+      if (insn.imm == kHelperMapLookupElem) {
+        result = RegState::Ptr(kPtrToMapValueOrNull, 0, map.map);
+      }
+    }
+
+    // R1-R5 are caller-saved
+    for (int i = 1; i <= 5; i++) {
+      s->regs[i] = RegState();
+    }
+    s->regs[0] = result;
+    return true;
+  }
+
+  bool StepJmp(size_t pc, const EbpfInsn &insn, State *s, std::string *err) {
+    uint8_t op = Op(insn.code);
+
+    if (op == kJa) {
+      Propagate(pc + 1 + insn.off, *s);
+      return true;
+    }
+
+    if (op == kCall) {
+      if (!StepCall(insn, s, err)) {
+        return false;
+      }
+      Propagate(pc + 1, *s);
+      return true;
+    }
+
+    if (op == kExit) {
+      if (!ReadReg(*s, 0, err)) {
+        return false;
+      }
+      if (s->regs[0].type != kScalar) {
+        *err = "R0 must be a scalar at exit";
+        return false;
+      }
+      return true;
+    }
+
+    if (op > kJsle) {
+      *err = "invalid jump operation";
+      return false;
+    }
+
+    if (!ReadReg(*s, insn.dst_reg, err)) {
+      return false;
+    }
+    RegState &dst = s->regs[insn.dst_reg];
+    RegState src;
+    if (Src(insn.code) == kX) {
+      if (!ReadReg(*s, insn.src_reg, err)) {
+        return false;
+      }
+      src = s->regs[insn.src_reg];
+    } else {
+      src = RegState::Const(static_cast<int64_t>(insn.imm));
+    }
+
+    State taken = *s;
+    State not_taken = *s;
+
+    if (dst.type == kPtrToMapValueOrNull && src.type == kScalar &&
+        src.known && src.val == 0 && (op == kJeq || op == kJne)) {
+      // NULL check of a map lookup result
+      RegState value = RegState::Ptr(kPtrToMapValue, dst.off, dst.map);
+      RegState null = RegState::Const(0);
+      taken.regs[insn.dst_reg] = (op == kJeq) ? null : value;
+      not_taken.regs[insn.dst_reg] = (op == kJeq) ? value : null;
+    } else if (dst.is_pointer() || src.is_pointer()) {
+      *err = "pointer comparison";
+      return false;
+    }
+
+    Propagate(pc + 1 + insn.off, taken);
+    Propagate(pc + 1, not_taken);
+    return true;
+  }
+
+  bool Step(size_t pc, std::string *err) {
+    const EbpfInsn &insn = insns_[pc];
+    State s = states_[pc];
+
+    switch (Class(insn.code)) {
+      case kAlu:
+      case kAlu64:
+        if (!StepAlu(insn, &s, err)) {
+          return false;
+        }
+        break;
+
+      case kLdx:
+        if (Mode(insn.code) != kMem) {
+          *err = "invalid load";
+          return false;
+        }
+        if (!ReadReg(s, insn.src_reg, err) || !WriteReg(insn.dst_reg, err) ||
+            !CheckAccess(s.regs[insn.src_reg], insn.off,
+                         SizeBytes(insn.code), false, err)) {
+          return false;
+        }
+        s.regs[insn.dst_reg] = RegState::Scalar();
+        break;
+
+      case kSt:
+      case kStx: {
+        bool xadd = Mode(insn.code) == kXadd;
+        if (Mode(insn.code) != kMem && !(xadd && Class(insn.code) == kStx)) {
+          *err = "invalid store";
+          return false;
+        }
+        if (xadd && Size(insn.code) != kW && Size(insn.code) != kDw) {
+          *err = "invalid atomic add size";
+          return false;
+        }
+        if (!ReadReg(s, insn.dst_reg, err) ||
+            !CheckAccess(s.regs[insn.dst_reg], insn.off,
+                         SizeBytes(insn.code), true, err)) {
+          return false;
+        }
+        if (xadd && s.regs[insn.dst_reg].type == kPtrToCtx) {
+          *err = "atomic add to the context";
+          return false;
+        }
+        if (Class(insn.code) == kStx) {
+          if (!ReadReg(s, insn.src_reg, err)) {
+            return false;
+          }
+          if (s.regs[insn.src_reg].is_pointer()) {
+            *err = "storing a pointer is not allowed";
+            return false;
+          }
+        }
+        break;
+      }
+
+      case kLd:
+        if (IsLdImm64(insn)) {
+          if (!WriteReg(insn.dst_reg, err)) {
+            return false;
+          }
+          if (insn.src_reg == kPseudoMapIdx) {
+            if (insn.imm < 0 ||
+                static_cast<size_t>(insn.imm) >= config_.maps.size() ||
+                insns_[pc + 1].imm != 0) {
+              *err = Format("invalid map index %d", insn.imm);
+              return false;
+            }
+            s.regs[insn.dst_reg] = RegState::Ptr(kConstMapPtr, 0, insn.imm);
+          } else if (insn.src_reg == 0) {
+            s.regs[insn.dst_reg] = RegState::Const(
+                static_cast<uint32_t>(insn.imm) |
+                (static_cast<uint64_t>(insns_[pc + 1].imm) << 32));
+          } else {
+            *err = "invalid 64-bit immediate load";
+            return false;
+          }
+          Propagate(pc + 2, s);
+          return true;
+        }
+
+        if ((Mode(insn.code) != kAbs && Mode(insn.code) != kInd) ||
+            Size(insn.code) == kDw) {
+          *err = "invalid load";
+          return false;
+        }
+        if (s.regs[6].type != kPtrToCtx || s.regs[6].off != 0) {
+          *err = "R6 must point to the context for packet loads";
+          return false;
+        }
+        if (Mode(insn.code) == kAbs && insn.imm < 0) {
+          *err = "negative packet offset";
+          return false;
+        }
+        if (Mode(insn.code) == kInd &&
+            (!ReadReg(s, insn.src_reg, err) ||
+             s.regs[insn.src_reg].type != kScalar)) {
+          *err = "packet offset must be a scalar";
+          return false;
+        }
+        s.regs[0] = RegState::Scalar();
+        break;
+
+      case kJmp:
+        return StepJmp(pc, insn, &s, err);
+
+      default:
+        *err = "invalid instruction class";
+        return false;
+    }
+
+    Propagate(pc + 1, s);
+    return true;
+  }
+
+  const std::vector<EbpfInsn> &insns_;
+  const EbpfProgram::Config &config_;
+  std::vector<State> states_;
+  std::vector<bool> reached_;
+};
+
+}  // namespace
+
+bool EbpfProgram::Verify(const Config &config, std::string *err) const {
+  if (config.num_attrs < 0 || config.num_attrs > kMaxAttrs) {
+    *err = "too many metadata attributes";
+    return false;
+  }
+  return Verifier(insns_, config).Run(err);
+}
+
+// ---------------------------------------------------------------------------
+// x86-64 JIT
+// ---------------------------------------------------------------------------
+
+#ifdef __x86_64
+
+namespace {
+
+enum X86Reg {
+  RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+// eBPF registers are mapped so that R1-R5 are the argument registers and
+// R6-R9 are callee-saved, as in the System V ABI. R10 is the frame pointer.
+const int kRegMap[kNumRegs] = {RAX, RDI, RSI, RDX, RCX, R8,
+                               RBX, R13, R14, R15, RBP};
+
+// Scratch registers, not mapped to any eBPF register
+const int kTmp1 = R10;
+const int kTmp2 = R11;
+
+class JitCompiler {
+ public:
+  explicit JitCompiler(const std::vector<EbpfInsn> &insns)
+      : insns_(insns), insn_offsets_(insns.size()) {}
+
+  std::vector<uint8_t> Compile() {
+    EmitPrologue();
+
+    for (size_t pc = 0; pc < insns_.size(); pc++) {
+      insn_offsets_[pc] = code_.size();
+      EmitInsn(pc);
+      if (IsLdImm64(insns_[pc])) {
+        insn_offsets_[++pc] = code_.size();
+      }
+    }
+
+    abort_offset_ = code_.size();
+    Emit(0x31, 0xc0);  // xor eax, eax
+
+    exit_offset_ = code_.size();
+    EmitEpilogue();
+
+    for (const Fixup &f : fixups_) {
+      size_t target;
+      switch (f.kind) {
+        case kToInsn:
+          target = insn_offsets_[f.target];
+          break;
+        case kToAbort:
+          target = abort_offset_;
+          break;
+        default:
+          target = exit_offset_;
+          break;
+      }
+      int32_t rel = target - (f.pos + 4);
+      memcpy(&code_[f.pos], &rel, sizeof(rel));
+    }
+
+    return std::move(code_);
+  }
+
+ private:
+  enum FixupKind { kToInsn, kToAbort, kToExit };
+
+  struct Fixup {
+    size_t pos;  // of the rel32 operand
+    FixupKind kind;
+    size_t target;
+  };
+
+  void Emit(uint8_t b) { code_.push_back(b); }
+  void Emit(uint8_t b1, uint8_t b2) {
+    Emit(b1);
+    Emit(b2);
+  }
+  void Emit16(uint16_t v) {
+    Emit(v & 0xff);
+    Emit(v >> 8);
+  }
+  void Emit32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+      Emit((v >> (i * 8)) & 0xff);
+    }
+  }
+  void Emit64(uint64_t v) {
+    Emit32(v);
+    Emit32(v >> 32);
+  }
+
+  void EmitRex(bool w, int reg, int index, int rm, bool force = false) {
+    uint8_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) |
+                  (rm >> 3);
+    if (rex != 0x40 || force) {
+      Emit(rex);
+    }
+  }
+
+  void EmitModRM(int mod, int reg, int rm) {
+    Emit((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+  }
+
+  // [base + disp32] operand
+  void EmitMem(int reg, int base, int32_t disp) {
+    EmitModRM(2, reg, base);
+    if ((base & 7) == RSP) {
+      Emit(0x24);  // SIB: base only
+    }
+    Emit32(disp);
+  }
+
+  // <opcode> dst, src, e.g., 0x01 for add
+  void EmitRR(uint8_t opcode, bool w, int src, int dst) {
+    EmitRex(w, src, 0, dst);
+    Emit(opcode);
+    EmitModRM(3, src, dst);
+  }
+
+  // <group1 op> dst, imm32, e.g., ext 0 for add
+  void EmitRI(int ext, bool w, int dst, int32_t imm) {
+    EmitRex(w, 0, 0, dst);
+    Emit(0x81);
+    EmitModRM(3, ext, dst);
+    Emit32(imm);
+  }
+
+  void EmitMovImm(bool w, int dst, int32_t imm) {
+    if (w) {
+      EmitRex(true, 0, 0, dst);
+      Emit(0xc7);  // sign-extended
+      EmitModRM(3, 0, dst);
+    } else {
+      EmitRex(false, 0, 0, dst);
+      Emit(0xb8 + (dst & 7));  // zero-extended
+    }
+    Emit32(imm);
+  }
+
+  void EmitMovImm64(int dst, uint64_t imm) {
+    EmitRex(true, 0, 0, dst);
+    Emit(0xb8 + (dst & 7));
+    Emit64(imm);
+  }
+
+  void EmitJump(uint8_t opcode2, FixupKind kind, size_t target) {
+    if (opcode2 == 0xe9) {
+      Emit(0xe9);
+    } else {
+      Emit(0x0f, opcode2);
+    }
+    fixups_.push_back({code_.size(), kind, target});
+    Emit32(0);
+  }
+
+  void EmitPrologue() {
+    Emit(0x55);              // push rbp
+    Emit(0x48, 0x89);        // mov rbp, rsp
+    Emit(0xe5);
+    EmitRI(5, true, RSP, kStackSize);  // sub rsp, kStackSize
+    Emit(0x53);              // push rbx
+    Emit(0x41, 0x55);        // push r13
+    Emit(0x41, 0x56);        // push r14
+    Emit(0x41, 0x57);        // push r15
+  }
+
+  void EmitEpilogue() {
+    Emit(0x41, 0x5f);  // pop r15
+    Emit(0x41, 0x5e);  // pop r14
+    Emit(0x41, 0x5d);  // pop r13
+    Emit(0x5b);        // pop rbx
+    Emit(0xc9);        // leave
+    Emit(0xc3);        // ret
+  }
+
+  void EmitShift(uint8_t op, bool w, int dst, const EbpfInsn &insn) {
+    int ext = (op == kLsh) ? 4 : (op == kRsh) ? 5 : 7;
+
+    if (Src(insn.code) == kK) {
+      EmitRex(w, 0, 0, dst);
+      Emit(0xc1);
+      EmitModRM(3, ext, dst);
+      Emit(insn.imm);
+      return;
+    }
+
+    // The shift count must be in cl, which is R4
+    int src = kRegMap[insn.src_reg];
+    int target = (dst == RCX) ? kTmp1 : dst;
+    if (dst == RCX) {
+      EmitRR(0x89, true, RCX, kTmp1);
+    } else {
+      EmitRR(0x89, true, RCX, kTmp2);
+    }
+    if (src != RCX) {
+      EmitRR(0x89, true, src, RCX);
+    }
+    EmitRex(w, 0, 0, target);
+    Emit(0xd3);
+    EmitModRM(3, ext, target);
+    if (dst == RCX) {
+      EmitRR(0x89, true, kTmp1, RCX);
+    } else {
+      EmitRR(0x89, true, kTmp2, RCX);
+    }
+  }
+
+  void EmitDiv(uint8_t op, bool w, int dst, const EbpfInsn &insn) {
+    // kTmp2 = divisor
+    if (Src(insn.code) == kK) {
+      EmitMovImm(w, kTmp2, insn.imm);
+    } else {
+      EmitRR(0x89, w, kRegMap[insn.src_reg], kTmp2);
+
+      // Division by zero: dst = 0 for div, dst unchanged for mod
+      EmitRR(0x85, w, kTmp2, kTmp2);  // test
+      Emit(0x75);                      // jnz rel8
+      size_t jnz_pos = code_.size();
+      Emit(0);
+      if (op == kDiv) {
+        EmitRR(0x31, false, dst, dst);  // xor dst32, dst32
+      } else if (!w) {
+        EmitRR(0x89, false, dst, dst);  // zero-extend
+      }
+      Emit(0xeb);  // jmp rel8
+      size_t jmp_pos = code_.size();
+      Emit(0);
+      code_[jnz_pos] = code_.size() - (jnz_pos + 1);
+      EmitDivBody(op, w, dst);
+      code_[jmp_pos] = code_.size() - (jmp_pos + 1);
+      return;
+    }
+
+    EmitDivBody(op, w, dst);
+  }
+
+  void EmitDivBody(uint8_t op, bool w, int dst) {
+    Emit(0x50);                      // push rax
+    Emit(0x52);                      // push rdx
+    EmitRR(0x89, w, dst, RAX);       // mov rax, dst
+    EmitRR(0x31, false, RDX, RDX);   // xor edx, edx
+    EmitRex(w, 0, 0, kTmp2);         // div kTmp2
+    Emit(0xf7);
+    EmitModRM(3, 6, kTmp2);
+    EmitRR(0x89, w, (op == kDiv) ? RAX : RDX, kTmp2);
+    Emit(0x5a);                      // pop rdx
+    Emit(0x58);                      // pop rax
+    EmitRR(0x89, w, kTmp2, dst);
+  }
+
+  void EmitAlu(const EbpfInsn &insn) {
+    bool w = Class(insn.code) == kAlu64;
+    uint8_t op = Op(insn.code);
+    int dst = kRegMap[insn.dst_reg];
+    int src = kRegMap[insn.src_reg];
+    bool x = Src(insn.code) == kX;
+
+    switch (op) {
+      case kAdd:
+      case kSub:
+      case kOr:
+      case kAnd:
+      case kXor: {
+        static const uint8_t kOpcodes[] = {0x01, 0x29, 0, 0, 0x09, 0x21,
+                                           0, 0, 0, 0, 0x31};
+        static const int kExts[] = {0, 5, 0, 0, 1, 4, 0, 0, 0, 0, 6};
+        if (x) {
+          EmitRR(kOpcodes[op >> 4], w, src, dst);
+        } else {
+          EmitRI(kExts[op >> 4], w, dst, insn.imm);
+        }
+        break;
+      }
+
+      case kMov:
+        if (x) {
+          EmitRR(0x89, w, src, dst);
+        } else {
+          EmitMovImm(w, dst, insn.imm);
+        }
+        break;
+
+      case kMul:
+        if (x) {
+          EmitRex(w, dst, 0, src);
+          Emit(0x0f, 0xaf);
+          EmitModRM(3, dst, src);
+        } else {
+          EmitRex(w, dst, 0, dst);
+          Emit(0x69);
+          EmitModRM(3, dst, dst);
+          Emit32(insn.imm);
+        }
+        break;
+
+      case kDiv:
+      case kMod:
+        EmitDiv(op, w, dst, insn);
+        break;
+
+      case kLsh:
+      case kRsh:
+      case kArsh:
+        EmitShift(op, w, dst, insn);
+        break;
+
+      case kNeg:
+        EmitRex(w, 0, 0, dst);
+        Emit(0xf7);
+        EmitModRM(3, 3, dst);
+        break;
+
+      case kEnd:
+        if (x) {
+          if (insn.imm == 16) {
+            Emit(0x66);  // rol dst16, 8
+            EmitRex(false, 0, 0, dst);
+            Emit(0xc1);
+            EmitModRM(3, 0, dst);
+            Emit(8);
+          } else {
+            EmitRex(insn.imm == 64, 0, 0, dst);  // bswap
+            Emit(0x0f, 0xc8 + (dst & 7));
+            break;
+          }
+        }
+        if (insn.imm == 16) {
+          EmitRex(false, dst, 0, dst);  // movzx dst32, dst16
+          Emit(0x0f, 0xb7);
+          EmitModRM(3, dst, dst);
+        } else if (insn.imm == 32) {
+          EmitRR(0x89, false, dst, dst);
+        }
+        break;
+    }
+  }
+
+  void EmitLoad(int size, int dst, int base, int32_t off) {
+    switch (size) {
+      case 1:
+        EmitRex(false, dst, 0, base);
+        Emit(0x0f, 0xb6);  // movzx
+        break;
+      case 2:
+        EmitRex(false, dst, 0, base);
+        Emit(0x0f, 0xb7);  // movzx
+        break;
+      case 4:
+        EmitRex(false, dst, 0, base);
+        Emit(0x8b);
+        break;
+      case 8:
+        EmitRex(true, dst, 0, base);
+        Emit(0x8b);
+        break;
+    }
+    EmitMem(dst, base, off);
+  }
+
+  void EmitStore(int size, int src, int base, int32_t off) {
+    if (size == 2) {
+      Emit(0x66);
+    }
+    // With a REX prefix, byte registers 4-7 are spl/bpl/sil/dil
+    EmitRex(size == 8, src, 0, base, size == 1);
+    Emit(size == 1 ? 0x88 : 0x89);
+    EmitMem(src, base, off);
+  }
+
+  void EmitStoreImm(int size, int base, int32_t off, int32_t imm) {
+    if (size == 2) {
+      Emit(0x66);
+    }
+    EmitRex(size == 8, 0, 0, base);
+    Emit(size == 1 ? 0xc6 : 0xc7);
+    EmitMem(0, base, off);
+    switch (size) {
+      case 1:
+        Emit(imm);
+        break;
+      case 2:
+        Emit16(imm);
+        break;
+      default:
+        Emit32(imm);
+        break;
+    }
+  }
+
+  void EmitPacketLoad(const EbpfInsn &insn) {
+    int size = SizeBytes(insn.code);
+    int ctx = kRegMap[6];
+
+    // kTmp1 = 32-bit offset
+    if (Mode(insn.code) == kInd) {
+      EmitRR(0x89, false, kRegMap[insn.src_reg], kTmp1);
+      EmitRI(0, false, kTmp1, insn.imm);
+    } else {
+      EmitMovImm(false, kTmp1, insn.imm);
+    }
+
+    // if (offset > data_len - size) abort
+    EmitLoad(4, kTmp2, ctx, offsetof(EbpfContext, data_len));
+    EmitRI(5, true, kTmp2, size);
+    EmitRR(0x39, true, kTmp2, kTmp1);  // cmp kTmp1, kTmp2
+    EmitJump(0x8f, kToAbort, 0);       // jg
+
+    EmitLoad(8, kTmp2, ctx, offsetof(EbpfContext, data));
+
+    // R0 = [kTmp2 + kTmp1]
+    EmitRex(false, RAX, kTmp1, kTmp2);
+    switch (size) {
+      case 1:
+        Emit(0x0f, 0xb6);
+        break;
+      case 2:
+        Emit(0x0f, 0xb7);
+        break;
+      default:
+        Emit(0x8b);
+        break;
+    }
+    EmitModRM(0, RAX, RSP);                   // SIB follows
+    Emit(((kTmp1 & 7) << 3) | (kTmp2 & 7));  // scale 1
+
+    if (size == 2) {
+      Emit(0x66, 0xc1);  // rol ax, 8
+      Emit(0xc0, 8);
+    } else if (size == 4) {
+      Emit(0x0f, 0xc8);  // bswap eax
+    }
+  }
+
+  void EmitJmp(size_t pc, const EbpfInsn &insn) {
+    uint8_t op = Op(insn.code);
+    int dst = kRegMap[insn.dst_reg];
+    size_t target = pc + 1 + insn.off;
+
+    switch (op) {
+      case kJa:
+        EmitJump(0xe9, kToInsn, target);
+        return;
+      case kExit:
+        EmitJump(0xe9, kToExit, 0);
+        return;
+      case kCall:
+        EmitMovImm64(kTmp2, reinterpret_cast<uintptr_t>(GetHelper(insn.imm)));
+        EmitRex(false, 0, 0, kTmp2);  // call kTmp2
+        Emit(0xff);
+        EmitModRM(3, 2, kTmp2);
+        return;
+    }
+
+    if (op == kJset) {
+      if (Src(insn.code) == kX) {
+        EmitRR(0x85, true, kRegMap[insn.src_reg], dst);
+      } else {
+        EmitRex(true, 0, 0, dst);
+        Emit(0xf7);
+        EmitModRM(3, 0, dst);
+        Emit32(insn.imm);
+      }
+    } else if (Src(insn.code) == kX) {
+      EmitRR(0x39, true, kRegMap[insn.src_reg], dst);
+    } else {
+      EmitRI(7, true, dst, insn.imm);
+    }
+
+    uint8_t jcc;
+    switch (op) {
+      case kJeq:
+        jcc = 0x84;
+        break;
+      case kJgt:
+        jcc = 0x87;
+        break;
+      case kJge:
+        jcc = 0x83;
+        break;
+      case kJset:
+      case kJne:
+        jcc = 0x85;
+        break;
+      case kJsgt:
+        jcc = 0x8f;
+        break;
+      case kJsge:
+        jcc = 0x8d;
+        break;
+      case kJlt:
+        jcc = 0x82;
+        break;
+      case kJle:
+        jcc = 0x86;
+        break;
+      case kJslt:
+        jcc = 0x8c;
+        break;
+      default:  // kJsle
+        jcc = 0x8e;
+        break;
+    }
+    EmitJump(jcc, kToInsn, target);
+  }
+
+  void EmitInsn(size_t pc) {
+    const EbpfInsn &insn = insns_[pc];
+    int dst = kRegMap[insn.dst_reg];
+    int src = kRegMap[insn.src_reg];
+
+    switch (Class(insn.code)) {
+      case kAlu:
+      case kAlu64:
+        EmitAlu(insn);
+        break;
+
+      case kLdx:
+        EmitLoad(SizeBytes(insn.code), dst, src, insn.off);
+        break;
+
+      case kSt:
+        EmitStoreImm(SizeBytes(insn.code), dst, insn.off, insn.imm);
+        break;
+
+      case kStx:
+        if (Mode(insn.code) == kXadd) {
+          Emit(0xf0);  // lock add
+          EmitRex(Size(insn.code) == kDw, src, 0, dst);
+          Emit(0x01);
+          EmitMem(src, dst, insn.off);
+        } else {
+          EmitStore(SizeBytes(insn.code), src, dst, insn.off);
+        }
+        break;
+
+      case kLd:
+        if (IsLdImm64(insn)) {
+          EmitMovImm64(dst,
+                       static_cast<uint32_t>(insn.imm) |
+                           (static_cast<uint64_t>(insns_[pc + 1].imm) << 32));
+        } else {
+          EmitPacketLoad(insn);
+        }
+        break;
+
+      case kJmp:
+        EmitJmp(pc, insn);
+        break;
+    }
+  }
+
+  const std::vector<EbpfInsn> &insns_;
+  std::vector<uint8_t> code_;
+  std::vector<size_t> insn_offsets_;
+  std::vector<Fixup> fixups_;
+  size_t abort_offset_;
+  size_t exit_offset_;
+};
+
+}  // namespace
+
+bool EbpfProgram::Compile() {
+  std::vector<uint8_t> code = JitCompiler(insns_).Compile();
+
+  void *mem = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+
+  memcpy(mem, code.data(), code.size());
+  if (mprotect(mem, code.size(), PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, code.size());
+    return false;
+  }
+
+  jit_func_ = reinterpret_cast<JitFunc>(mem);
+  jit_size_ = code.size();
+  return true;
+}
+
+#else
+
+bool EbpfProgram::Compile() {
+  return false;
+}
+
+#endif  // __x86_64
+
+// ---------------------------------------------------------------------------
+// Loading
+// ---------------------------------------------------------------------------
+
+EbpfProgram::~EbpfProgram() {
+  Unload();
+}
+
+void EbpfProgram::Unload() {
+  if (jit_func_) {
+    munmap(reinterpret_cast<void *>(jit_func_), jit_size_);
+    jit_func_ = nullptr;
+    jit_size_ = 0;
+  }
+  insns_.clear();
+}
+
+bool EbpfProgram::Load(const std::vector<EbpfInsn> &insns,
+                       const Config &config, bool jit, std::string *err) {
+  Unload();
+  insns_ = insns;
+
+  if (!Verify(config, err)) {
+    insns_.clear();
+    return false;
+  }
+
+  // Resolve map indexes to pointers
+  for (size_t pc = 0; pc < insns_.size(); pc++) {
+    EbpfInsn &insn = insns_[pc];
+    if (IsLdImm64(insn) && insn.src_reg == kPseudoMapIdx) {
+      uint64_t ptr = reinterpret_cast<uintptr_t>(config.maps[insn.imm]);
+      insn.src_reg = 0;
+      insn.imm = static_cast<uint32_t>(ptr);
+      insns_[pc + 1].imm = static_cast<uint32_t>(ptr >> 32);
+    }
+  }
+
+  if (jit && !Compile()) {
+    *err = "JIT compilation failed";
+    insns_.clear();
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,274 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// An eBPF execution engine: verifier, interpreter and x86-64 JIT.
+//
+// Programs follow the Linux eBPF instruction set (64-bit registers R0-R10, a
+// 512-byte stack at R10, legacy LD_ABS/LD_IND packet loads) with a few
+// restrictions that keep the verifier simple: jumps must go forward (so every
+// program terminates), JMP32 instructions are not supported, and pointers
+// cannot be stored to memory or combined with non-constant scalars.
+
+#ifndef BESS_UTILS_EBPF_H_
+#define BESS_UTILS_EBPF_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "mcslock.h"
+
+namespace bess {
+namespace utils {
+
+struct EbpfInsn {
+  uint8_t code;
+  uint8_t dst_reg : 4;
+  uint8_t src_reg : 4;
+  int16_t off;
+  int32_t imm;
+};
+
+static_assert(sizeof(EbpfInsn) == 8, "struct EbpfInsn is incorrect");
+
+namespace ebpf {
+
+// Instruction classes
+const uint8_t kLd = 0x00;
+const uint8_t kLdx = 0x01;
+const uint8_t kSt = 0x02;
+const uint8_t kStx = 0x03;
+const uint8_t kAlu = 0x04;
+const uint8_t kJmp = 0x05;
+const uint8_t kJmp32 = 0x06;
+const uint8_t kAlu64 = 0x07;
+
+// Load/store sizes
+const uint8_t kW = 0x00;
+const uint8_t kH = 0x08;
+const uint8_t kB = 0x10;
+const uint8_t kDw = 0x18;
+
+// Load/store modes
+const uint8_t kImm = 0x00;
+const uint8_t kAbs = 0x20;
+const uint8_t kInd = 0x40;
+const uint8_t kMem = 0x60;
+const uint8_t kXadd = 0xc0;
+
+// ALU/jump operand source
+const uint8_t kK = 0x00;
+const uint8_t kX = 0x08;
+
+// ALU operations
+const uint8_t kAdd = 0x00;
+const uint8_t kSub = 0x10;
+const uint8_t kMul = 0x20;
+const uint8_t kDiv = 0x30;
+const uint8_t kOr = 0x40;
+const uint8_t kAnd = 0x50;
+const uint8_t kLsh = 0x60;
+const uint8_t kRsh = 0x70;
+const uint8_t kNeg = 0x80;
+const uint8_t kMod = 0x90;
+const uint8_t kXor = 0xa0;
+const uint8_t kMov = 0xb0;
+const uint8_t kArsh = 0xc0;
+const uint8_t kEnd = 0xd0;  // kK: to little endian, kX: to big endian
+
+// Jump operations
+const uint8_t kJa = 0x00;
+const uint8_t kJeq = 0x10;
+const uint8_t kJgt = 0x20;
+const uint8_t kJge = 0x30;
+const uint8_t kJset = 0x40;
+const uint8_t kJne = 0x50;
+const uint8_t kJsgt = 0x60;
+const uint8_t kJsge = 0x70;
+const uint8_t kCall = 0x80;
+const uint8_t kExit = 0x90;
+const uint8_t kJlt = 0xa0;
+const uint8_t kJle = 0xb0;
+const uint8_t kJslt = 0xc0;
+const uint8_t kJsle = 0xd0;
+
+inline uint8_t Class(uint8_t code) { return code & 0x07; }
+inline uint8_t Size(uint8_t code) { return code & 0x18; }
+inline uint8_t Mode(uint8_t code) { return code & 0xe0; }
+inline uint8_t Op(uint8_t code) { return code & 0xf0; }
+inline uint8_t Src(uint8_t code) { return code & 0x08; }
+
+// src_reg of a 64-bit immediate load (LD | IMM | DW) whose imm is the index
+// of a map in the list given to EbpfProgram::Load()
+const uint8_t kPseudoMapIdx = 1;
+
+// Helper functions (same numbering as Linux)
+const int32_t kHelperMapLookupElem = 1;  // (map, key) -> value or NULL
+const int32_t kHelperMapUpdateElem = 2;  // (map, key, value, flags) -> 0/-err
+const int32_t kHelperMapDeleteElem = 3;  // (map, key) -> 0/-err
+const int32_t kHelperGetPrandomU32 = 7;  // () -> random u32
+
+// Flags of kHelperMapUpdateElem and EbpfMap::Update()
+const uint64_t kAny = 0;      // create a new element or update an existing one
+const uint64_t kNoExist = 1;  // create a new element only
+const uint64_t kExist = 2;    // update an existing element only
+
+const int kNumRegs = 11;
+const int kStackSize = 512;
+const size_t kMaxInsns = 4096;
+
+// Maximum number of metadata attributes exposed to a program
+const int kMaxAttrs = 16;
+
+}  // namespace ebpf
+
+// The context that R1 points to when a program starts. Programs may read
+// pkt_len, data_len and attrs, and write the attrs marked as writable.
+struct EbpfContext {
+  uint32_t pkt_len;                  // total packet length
+  uint32_t data_len;                 // bytes accessible with LD_ABS/LD_IND
+  uint64_t attrs[ebpf::kMaxAttrs];   // metadata attributes, zero-extended
+
+  // Not accessible by programs
+  const uint8_t *data;
+};
+
+// An array or hash map, shared by programs and the control plane. Lookups
+// return pointers into preallocated storage that remain valid for the
+// lifetime of the map, so they stay safe to dereference even if the element
+// is deleted concurrently (as with Linux preallocated maps).
+class EbpfMap {
+ public:
+  enum Type {
+    kArray = 1,  // key is a uint32_t index, elements always exist
+    kHash = 2,
+  };
+
+  // Returns nullptr (and sets *err) if the parameters are invalid.
+  static EbpfMap *Create(Type type, uint32_t key_size, uint32_t value_size,
+                         uint32_t max_entries, std::string *err);
+
+  ~EbpfMap();
+
+  Type type() const { return type_; }
+  uint32_t key_size() const { return key_size_; }
+  uint32_t value_size() const { return value_size_; }
+  uint32_t max_entries() const { return max_entries_; }
+
+  // Returns a pointer to the value of key, or nullptr if none.
+  void *Lookup(const void *key);
+
+  // Returns 0 on success, or -errno.
+  int Update(const void *key, const void *value, uint64_t flags);
+  int Delete(const void *key);
+
+  // Calls f for every existing element. f must not modify the map.
+  void ForEach(const std::function<void(const void *key, const void *value)>
+                   &f);
+
+ private:
+  EbpfMap(Type type, uint32_t key_size, uint32_t value_size,
+          uint32_t max_entries);
+
+  // Hash map slot states
+  enum : uint8_t { kEmpty = 0, kUsed, kDeleted };
+
+  uint8_t *key_at(size_t slot) { return keys_ + slot * key_size_; }
+  uint8_t *value_at(size_t slot) { return values_ + slot * value_size_; }
+
+  // Returns the slot holding key, or -1. Hash maps only, with lock_ held.
+  ssize_t FindSlot(const void *key);
+
+  const Type type_;
+  const uint32_t key_size_;
+  const uint32_t value_size_;
+  const uint32_t max_entries_;
+
+  size_t num_slots_;  // a power of two for hash maps
+  size_t count_;
+  uint8_t *state_;    // per slot, hash maps only
+  uint8_t *keys_;     // hash maps only
+  uint8_t *values_;
+
+  mcslock_t lock_;  // serializes hash map operations
+};
+
+// A verified (and possibly JIT-compiled) program
+class EbpfProgram {
+ public:
+  struct Config {
+    int num_attrs;            // number of valid EbpfContext::attrs
+    uint32_t writable_attrs;  // bitmask of attrs the program may write
+    std::vector<EbpfMap *> maps;
+  };
+
+  EbpfProgram() : jit_func_(), jit_size_() {}
+  ~EbpfProgram();
+
+  EbpfProgram(const EbpfProgram &) = delete;
+  EbpfProgram &operator=(const EbpfProgram &) = delete;
+
+  // Verifies the program and prepares it for execution, JIT-compiling it if
+  // jit is true (x86-64 only). Returns false with *err set if the program is
+  // rejected.
+  bool Load(const std::vector<EbpfInsn> &insns, const Config &config,
+            bool jit, std::string *err);
+
+  // Runs the program and returns R0. A program aborts with 0 if a packet
+  // load (LD_ABS/LD_IND) goes beyond ctx->data_len.
+  uint64_t Run(EbpfContext *ctx) const {
+    return jit_func_ ? jit_func_(ctx) : Interpret(ctx);
+  }
+
+  uint64_t Interpret(EbpfContext *ctx) const;
+
+  bool jitted() const { return jit_func_ != nullptr; }
+  size_t num_insns() const { return insns_.size(); }
+
+ private:
+  using JitFunc = uint64_t (*)(EbpfContext *);
+
+  bool Verify(const Config &config, std::string *err) const;
+  bool Compile();
+
+  void Unload();
+
+  std::vector<EbpfInsn> insns_;  // with map indexes resolved to pointers
+  JitFunc jit_func_;
+  size_t jit_size_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_EBPF_H_
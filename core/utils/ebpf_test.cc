@@ -0,0 +1,366 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <vector>
+
+#include "random.h"
+
+using namespace bess::utils::ebpf;
+using bess::utils::EbpfContext;
+using bess::utils::EbpfInsn;
+using bess::utils::EbpfMap;
+using bess::utils::EbpfProgram;
+
+namespace {
+
+EbpfInsn Insn(uint8_t code, int dst, int src, int16_t off, int32_t imm) {
+  EbpfInsn insn;
+  insn.code = code;
+  insn.dst_reg = dst;
+  insn.src_reg = src;
+  insn.off = off;
+  insn.imm = imm;
+  return insn;
+}
+
+EbpfInsn MovImm(int dst, int32_t imm) {
+  return Insn(kAlu64 | kMov | kK, dst, 0, 0, imm);
+}
+
+EbpfInsn Exit() {
+  return Insn(kJmp | kExit, 0, 0, 0, 0);
+}
+
+// Both halves of a 64-bit immediate load of a map
+std::vector<EbpfInsn> LdMap(int dst, int map_idx) {
+  return {Insn(kLd | kImm | kDw, dst, kPseudoMapIdx, 0, map_idx),
+          Insn(0, 0, 0, 0, 0)};
+}
+
+EbpfProgram::Config DefaultConfig() {
+  EbpfProgram::Config config;
+  config.num_attrs = 2;
+  config.writable_attrs = 0x2;  // attrs[1] only
+  return config;
+}
+
+// Loads the program both interpreted and JIT-compiled, and checks that both
+// return the same value, which is returned.
+uint64_t RunBoth(const std::vector<EbpfInsn> &insns, EbpfContext *ctx,
+                 const EbpfProgram::Config &config = DefaultConfig()) {
+  EbpfProgram interp;
+  EbpfProgram jit;
+  std::string err;
+
+  EXPECT_TRUE(interp.Load(insns, config, false, &err)) << err;
+  EXPECT_TRUE(jit.Load(insns, config, true, &err)) << err;
+  EXPECT_FALSE(interp.jitted());
+  EXPECT_TRUE(jit.jitted());
+
+  EbpfContext ctx_copy = *ctx;
+  uint64_t ret = interp.Run(ctx);
+  EXPECT_EQ(ret, jit.Run(&ctx_copy));
+  EXPECT_EQ(0, memcmp(ctx->attrs, ctx_copy.attrs, sizeof(ctx->attrs)));
+  return ret;
+}
+
+std::string Reject(const std::vector<EbpfInsn> &insns,
+                   const EbpfProgram::Config &config = DefaultConfig()) {
+  EbpfProgram prog;
+  std::string err;
+  EXPECT_FALSE(prog.Load(insns, config, false, &err));
+  return err;
+}
+
+TEST(EbpfTest, Verifier) {
+  EXPECT_NE("", Reject({}));
+  EXPECT_NE("", Reject({MovImm(0, 1)}));  // falls off the end
+  EXPECT_NE("", Reject({Exit()}));        // R0 not initialized
+  EXPECT_NE("", Reject({MovImm(0, 1), Insn(kJmp | kJa, 0, 0, -2, 0), Exit()}));
+  EXPECT_NE("", Reject({MovImm(10, 1), MovImm(0, 0), Exit()}));
+  EXPECT_NE("", Reject({MovImm(0, 1), Insn(kAlu64 | kDiv | kK, 0, 0, 0, 0),
+                        Exit()}));
+
+  // Stack and context bounds
+  EXPECT_NE("", Reject({Insn(kLdx | kMem | kDw, 0, 10, 0, 0), Exit()}));
+  EXPECT_NE("", Reject({Insn(kLdx | kMem | kDw, 0, 10, -520, 0), Exit()}));
+  EXPECT_NE("", Reject({Insn(kLdx | kMem | kDw, 0, 1, 24, 0), Exit()}));
+  EXPECT_NE("", Reject({MovImm(0, 0), Insn(kSt | kMem | kW, 1, 0, 0, 1),
+                        Exit()}));  // pkt_len is read-only
+  EXPECT_NE("", Reject({MovImm(0, 0), Insn(kSt | kMem | kDw, 1, 0, 8, 1),
+                        Exit()}));  // attrs[0] is read-only
+
+  // Pointers
+  EXPECT_NE("", Reject({Insn(kAlu64 | kMov | kX, 0, 1, 0, 0), Exit()}));
+  EXPECT_NE("", Reject({Insn(kAlu64 | kMov | kX, 0, 10, 0, 0),
+                        Insn(kAlu64 | kMul | kK, 0, 0, 0, 2), Exit()}));
+  EXPECT_NE("", Reject({Insn(kStx | kMem | kDw, 10, 1, -8, 0), MovImm(0, 0),
+                        Exit()}));
+
+  // Map values must be NULL-checked
+  EbpfProgram::Config config = DefaultConfig();
+  std::string err;
+  std::unique_ptr<EbpfMap> map(
+      EbpfMap::Create(EbpfMap::kHash, 4, 8, 16, &err));
+  config.maps.push_back(map.get());
+
+  std::vector<EbpfInsn> prog = LdMap(1, 0);
+  std::vector<EbpfInsn> tail = {
+      Insn(kSt | kMem | kW, 10, 0, -4, 0),
+      Insn(kAlu64 | kMov | kX, 2, 10, 0, 0),
+      Insn(kAlu64 | kAdd | kK, 2, 0, 0, -4),
+      Insn(kJmp | kCall, 0, 0, 0, kHelperMapLookupElem),
+      Insn(kLdx | kMem | kDw, 0, 0, 0, 0),
+      Exit()};
+  prog.insert(prog.end(), tail.begin(), tail.end());
+  EXPECT_NE("", Reject(prog, config));
+  EXPECT_NE("", Reject(LdMap(1, 1), config));
+}
+
+TEST(EbpfTest, Alu) {
+  EbpfContext ctx = {};
+
+  EXPECT_EQ(42, RunBoth({MovImm(0, 40), Insn(kAlu64 | kAdd | kK, 0, 0, 0, 2),
+                         Exit()},
+                        &ctx));
+
+  // 32-bit operations zero-extend, 64-bit immediates are sign-extended
+  EXPECT_EQ(0xffffffffull,
+            RunBoth({MovImm(0, -1), Insn(kAlu | kMov | kX, 0, 0, 0, 0),
+                     Exit()},
+                    &ctx));
+  EXPECT_EQ(~0ull, RunBoth({MovImm(0, -1), Exit()}, &ctx));
+
+  // Division and modulo by zero
+  EXPECT_EQ(0, RunBoth({MovImm(0, 7), MovImm(1, 0),
+                        Insn(kAlu64 | kDiv | kX, 0, 1, 0, 0), Exit()},
+                       &ctx));
+  EXPECT_EQ(7, RunBoth({MovImm(0, 7), MovImm(1, 0),
+                        Insn(kAlu64 | kMod | kX, 0, 1, 0, 0), Exit()},
+                       &ctx));
+
+  // Byte swaps
+  EXPECT_EQ(0x3412, RunBoth({MovImm(0, 0x561234),
+                             Insn(kAlu | kEnd | kX, 0, 0, 0, 16), Exit()},
+                            &ctx));
+  EXPECT_EQ(0x1234, RunBoth({MovImm(0, 0x561234),
+                             Insn(kAlu | kEnd | kK, 0, 0, 0, 16), Exit()},
+                            &ctx));
+}
+
+// Random straight-line ALU programs must give the same result interpreted
+// and JIT-compiled. This exercises every register pairing, including the
+// ones that x86 shifts and divisions use implicitly (rcx, rax, rdx).
+TEST(EbpfTest, AluRandom) {
+  static const uint8_t kOps[] = {kAdd, kSub, kMul, kDiv, kOr,   kAnd, kLsh,
+                                 kRsh, kNeg, kMod, kXor, kMov, kArsh};
+  Random rng(7);
+  EbpfContext ctx = {};
+
+  for (int iter = 0; iter < 500; iter++) {
+    std::vector<EbpfInsn> prog;
+    for (int r = 0; r <= 9; r++) {
+      prog.push_back(Insn(kLd | kImm | kDw, r, 0, 0, rng.Get()));
+      prog.push_back(Insn(0, 0, 0, 0, rng.Get()));
+    }
+
+    for (int i = 0; i < 40; i++) {
+      uint8_t op = kOps[rng.GetRange(sizeof(kOps))];
+      uint8_t cls = rng.GetRange(2) ? kAlu64 : kAlu;
+      int dst = rng.GetRange(10);
+      int src = rng.GetRange(10);
+      int32_t imm = rng.Get();
+
+      if (op == kLsh || op == kRsh || op == kArsh) {
+        imm = rng.GetRange(cls == kAlu64 ? 64 : 32);
+      } else if ((op == kDiv || op == kMod) && imm == 0) {
+        imm = 3;
+      }
+
+      if (op == kNeg || rng.GetRange(2)) {
+        prog.push_back(Insn(cls | op | kK, dst, 0, 0, imm));
+      } else {
+        prog.push_back(Insn(cls | op | kX, dst, src, 0, 0));
+      }
+    }
+
+    // Fold all registers into R0
+    for (int r = 1; r <= 9; r++) {
+      prog.push_back(Insn(kAlu64 | kMul | kK, 0, 0, 0, 31));
+      prog.push_back(Insn(kAlu64 | kXor | kX, 0, r, 0, 0));
+    }
+    prog.push_back(Exit());
+
+    RunBoth(prog, &ctx);
+    if (HasFailure()) {
+      FAIL() << "iteration " << iter;
+    }
+  }
+}
+
+TEST(EbpfTest, Jumps) {
+  static const uint8_t kOps[] = {kJeq, kJgt, kJge, kJset, kJne, kJsgt,
+                                 kJsge, kJlt, kJle, kJslt, kJsle};
+  static const int64_t kValues[] = {0, 1, -1, 5, 0x7fffffff, -0x80000000LL};
+  EbpfContext ctx = {};
+
+  for (uint8_t op : kOps) {
+    for (int64_t a : kValues) {
+      for (int64_t b : kValues) {
+        std::vector<EbpfInsn> prog = {
+            MovImm(1, a), MovImm(2, b), MovImm(0, 0),
+            Insn(kJmp | op | kX, 1, 2, 1, 0),
+            Insn(kAlu64 | kOr | kK, 0, 0, 0, 1),
+            Insn(kJmp | op | kK, 1, 0, 1, b),
+            Insn(kAlu64 | kOr | kK, 0, 0, 0, 2),
+            Exit()};
+        RunBoth(prog, &ctx);
+      }
+    }
+  }
+}
+
+TEST(EbpfTest, ContextAndPacket) {
+  uint8_t pkt[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+  EbpfContext ctx = {};
+  ctx.pkt_len = 100;
+  ctx.data_len = sizeof(pkt);
+  ctx.data = pkt;
+  ctx.attrs[0] = 1000;
+
+  // attrs[1] = attrs[0] + pkt_len; R0 = attrs[1]
+  std::vector<EbpfInsn> prog = {
+      Insn(kLdx | kMem | kDw, 2, 1, offsetof(EbpfContext, attrs), 0),
+      Insn(kLdx | kMem | kW, 3, 1, offsetof(EbpfContext, pkt_len), 0),
+      Insn(kAlu64 | kAdd | kX, 2, 3, 0, 0),
+      Insn(kStx | kMem | kDw, 1, 2, offsetof(EbpfContext, attrs) + 8, 0),
+      Insn(kLdx | kMem | kDw, 0, 1, offsetof(EbpfContext, attrs) + 8, 0),
+      Exit()};
+  EXPECT_EQ(1100, RunBoth(prog, &ctx));
+  EXPECT_EQ(1100, ctx.attrs[1]);
+
+  // Packet loads are in network order, and abort with 0 when out of bounds
+  auto load = [](uint8_t size, int32_t off) {
+    return std::vector<EbpfInsn>{
+        Insn(kAlu64 | kMov | kX, 6, 1, 0, 0), MovImm(7, 1),
+        Insn(kLd | kInd | size, 0, 7, 0, off), Exit()};
+  };
+  EXPECT_EQ(0x02, RunBoth(load(kB, 0), &ctx));
+  EXPECT_EQ(0x0203, RunBoth(load(kH, 0), &ctx));
+  EXPECT_EQ(0x03040506, RunBoth(load(kW, 1), &ctx));
+  EXPECT_EQ(0, RunBoth(load(kW, 2), &ctx));
+  EXPECT_EQ(0, RunBoth(load(kB, -2), &ctx));
+}
+
+TEST(EbpfTest, Maps) {
+  std::string err;
+  std::unique_ptr<EbpfMap> array(
+      EbpfMap::Create(EbpfMap::kArray, 4, 8, 4, &err));
+  std::unique_ptr<EbpfMap> hash(
+      EbpfMap::Create(EbpfMap::kHash, 4, 8, 4, &err));
+  ASSERT_NE(nullptr, array);
+  ASSERT_NE(nullptr, hash);
+  EXPECT_EQ(nullptr, EbpfMap::Create(EbpfMap::kArray, 8, 8, 4, &err));
+
+  EbpfProgram::Config config = DefaultConfig();
+  config.maps = {array.get(), hash.get()};
+
+  // array[attrs[0]] += 1, then hash[attrs[0]] = array[attrs[0]]
+  std::vector<EbpfInsn> prog = {
+      Insn(kLdx | kMem | kDw, 6, 1, offsetof(EbpfContext, attrs), 0),
+      Insn(kStx | kMem | kW, 10, 6, -4, 0),
+      Insn(kAlu64 | kMov | kX, 2, 10, 0, 0),
+      Insn(kAlu64 | kAdd | kK, 2, 0, 0, -4)};
+  auto ld = LdMap(1, 0);
+  prog.insert(prog.end(), ld.begin(), ld.end());
+  std::vector<EbpfInsn> rest = {
+      Insn(kJmp | kCall, 0, 0, 0, kHelperMapLookupElem),
+      Insn(kJmp | kJne | kK, 0, 0, 1, 0),
+      Exit(),  // R0 == 0 (NULL)
+      MovImm(1, 1),
+      Insn(kStx | kXadd | kDw, 0, 1, 0, 0),
+      Insn(kLdx | kMem | kDw, 7, 0, 0, 0),
+      Insn(kStx | kMem | kDw, 10, 7, -16, 0),
+      Insn(kAlu64 | kMov | kX, 2, 10, 0, 0),
+      Insn(kAlu64 | kAdd | kK, 2, 0, 0, -4),
+      Insn(kAlu64 | kMov | kX, 3, 10, 0, 0),
+      Insn(kAlu64 | kAdd | kK, 3, 0, 0, -16),
+      MovImm(4, kAny)};
+  prog.insert(prog.end(), rest.begin(), rest.end());
+  ld = LdMap(1, 1);
+  prog.insert(prog.end(), ld.begin(), ld.end());
+  prog.push_back(Insn(kJmp | kCall, 0, 0, 0, kHelperMapUpdateElem));
+  prog.push_back(Exit());
+
+  EbpfProgram interp;
+  EbpfProgram jit;
+  ASSERT_TRUE(interp.Load(prog, config, false, &err)) << err;
+  ASSERT_TRUE(jit.Load(prog, config, true, &err)) << err;
+
+  EbpfContext ctx = {};
+  ctx.attrs[0] = 2;
+  EXPECT_EQ(0, interp.Run(&ctx));
+  EXPECT_EQ(0, jit.Run(&ctx));
+  ctx.attrs[0] = 9;  // out of range for the array
+  EXPECT_EQ(0, jit.Run(&ctx));
+
+  uint32_t key = 2;
+  uint64_t value = 0;
+  ASSERT_NE(nullptr, array->Lookup(&key));
+  memcpy(&value, array->Lookup(&key), sizeof(value));
+  EXPECT_EQ(2, value);
+  ASSERT_NE(nullptr, hash->Lookup(&key));
+  memcpy(&value, hash->Lookup(&key), sizeof(value));
+  EXPECT_EQ(2, value);
+
+  // Control-plane access
+  EXPECT_EQ(-EEXIST, hash->Update(&key, &value, kNoExist));
+  EXPECT_EQ(0, hash->Delete(&key));
+  EXPECT_EQ(nullptr, hash->Lookup(&key));
+  EXPECT_EQ(-ENOENT, hash->Delete(&key));
+  EXPECT_EQ(-EINVAL, array->Delete(&key));
+
+  for (uint32_t k = 0; k < 4; k++) {
+    EXPECT_EQ(0, hash->Update(&k, &value, kAny));
+  }
+  key = 4;
+  EXPECT_EQ(-E2BIG, hash->Update(&key, &value, kAny));
+
+  int count = 0;
+  hash->ForEach([&count](const void *, const void *) { count++; });
+  EXPECT_EQ(4, count);
+}
+
+}  // namespace
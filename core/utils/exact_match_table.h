@@ -221,6 +221,17 @@ class ExactMatchTable {
 
   size_t Size() const { return table_.Count(); }
 
+  // Make room for `n` rules in total, so that adding them in bulk does not
+  // rehash the table repeatedly.
+  void Reserve(size_t n) {
+    table_.Reserve(n, ExactMatchKeyHash(total_key_size_),
+                   ExactMatchKeyEq(total_key_size_));
+  }
+
+  // Migrate the table storage to NUMA node `socket_id`.
+  // Returns 0 on success, -errno on failure.
+  int MoveToSocket(int socket_id) { return table_.MoveToSocket(socket_id); }
+
   // Extract an ExactMatchKey from `buf` based on the fields that have been
   // added to this table.
   ExactMatchKey MakeKey(const void *buf) const {
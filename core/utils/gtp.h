@@ -12,6 +12,11 @@ namespace bess {
 
 #define EXT_TYPE_PDU_SESSION_CONTAINER 0x85
 
+/* Upper bound on the bytes GTP-U modules read from the head of a packet:
+ * Ethernet + outer IPv4/UDP + GTP-U with extensions + inner IPv4 + L4.
+ * Only this much is pulled up into the first segment of chained packets. */
+#define GTPU_MAX_HEADER_LEN 256
+
 		struct [[gnu::packed]] Gtpv1 {
 			uint8_t pdn : 1, /* N-PDU number */
 					seq : 1,     /* Sequence number */
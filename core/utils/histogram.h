@@ -178,6 +178,12 @@ class Histogram {
   size_t num_buckets() const { return buckets_.size(); }
   T bucket_width() const { return bucket_width_; }
 
+  // Returns the # of samples in bucket "i". The last bucket counts the samples
+  // above the histogram range.
+  uint64_t bucket(size_t i) const {
+    return buckets_[i].load(std::memory_order_relaxed);
+  }
+
   size_t max_num_buckets() const {
     // This constant is mainly to keep resets to a reasonable speed.
     const size_t max_buckets = 10'000'000;
@@ -56,6 +56,20 @@ TEST(HistogramTest, U32Quartiles) {
   EXPECT_EQ(1000, ret.percentile_values[3]);  // 100th percentile
 }
 
+TEST(HistogramTest, Buckets) {
+  Histogram<uint64_t> hist(4, 10);
+  for (uint64_t x : {0, 9, 10, 35, 40, 1000}) {
+    hist.Insert(x);
+  }
+
+  ASSERT_EQ(5, hist.num_buckets());
+  EXPECT_EQ(2, hist.bucket(0));
+  EXPECT_EQ(1, hist.bucket(1));
+  EXPECT_EQ(0, hist.bucket(2));
+  EXPECT_EQ(1, hist.bucket(3));
+  EXPECT_EQ(2, hist.bucket(4));  // above range
+}
+
 TEST(HistogramTest, DoubleQuartiles) {
   const std::vector<double> values = {1.0, 1.0, 2.0, 2.0, 4.0, 6.0};
 
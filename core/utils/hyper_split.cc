@@ -0,0 +1,275 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hyper_split.h"
+
+#include <algorithm>
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+// Clips `range` to `box`. The two are assumed to overlap.
+inline HyperSplit::Range Clip(const HyperSplit::Range &range,
+                              const HyperSplit::Range &box) {
+  return {std::max(range.lo, box.lo), std::min(range.hi, box.hi)};
+}
+
+}  // namespace
+
+HyperSplit::HyperSplit(size_t leaf_size)
+    : leaf_size_(std::max<size_t>(leaf_size, 1)), max_depth_() {
+  Build({});
+}
+
+HyperSplit::Range HyperSplit::FullRange(Field field) {
+  switch (field) {
+    case kSrcIp:
+    case kDstIp:
+      return {0, UINT32_MAX};
+    case kSrcPort:
+    case kDstPort:
+      return {0, UINT16_MAX};
+    case kProto:
+      return {0, UINT8_MAX};
+    default:
+      return {0, 0};
+  }
+}
+
+HyperSplit::Range HyperSplit::PrefixRange(uint32_t addr, int len) {
+  if (len <= 0) {
+    return {0, UINT32_MAX};
+  }
+  uint32_t mask = (len >= 32) ? UINT32_MAX : ~(UINT32_MAX >> len);
+  return {addr & mask, (addr & mask) | ~mask};
+}
+
+void HyperSplit::Build(const std::vector<Rule> &rules) {
+  rules_ = rules;
+  std::stable_sort(
+      rules_.begin(), rules_.end(),
+      [](const Rule &a, const Rule &b) { return a.priority > b.priority; });
+
+  nodes_.clear();
+  leaf_rules_.clear();
+  max_depth_ = 0;
+
+  std::vector<uint32_t> idx;
+  idx.reserve(rules_.size());
+  for (uint32_t i = 0; i < rules_.size(); i++) {
+    bool empty = false;
+    for (int f = 0; f < kNumFields; f++) {
+      const Range full = FullRange(static_cast<Field>(f));
+      Range &r = rules_[i].ranges[f];
+      r.hi = std::min(r.hi, full.hi);
+      empty |= r.lo > r.hi;
+    }
+    if (!empty) {
+      idx.push_back(i);
+    }
+  }
+
+  Range box[kNumFields];
+  for (int f = 0; f < kNumFields; f++) {
+    box[f] = FullRange(static_cast<Field>(f));
+  }
+
+  nodes_.emplace_back();
+  BuildNode(0, &idx, box, 0);
+
+  nodes_.shrink_to_fit();
+  leaf_rules_.shrink_to_fit();
+}
+
+void HyperSplit::MakeLeaf(uint32_t node_id, const std::vector<uint32_t> &idx) {
+  nodes_[node_id] = {static_cast<uint32_t>(leaf_rules_.size()),
+                     static_cast<uint32_t>(idx.size()), kLeaf};
+  for (uint32_t i : idx) {
+    leaf_rules_.push_back(rules_[i]);
+  }
+}
+
+// `idx` holds the rules overlapping `box`, in decreasing order of priority.
+// Both are consumed.
+void HyperSplit::BuildNode(uint32_t node_id, std::vector<uint32_t> *idx,
+                           Range *box, size_t depth) {
+  max_depth_ = std::max(max_depth_, depth);
+
+  // Rules below one that covers the whole box can never win here.
+  for (size_t i = 0; i < idx->size(); i++) {
+    const Rule &rule = rules_[(*idx)[i]];
+    bool covers = true;
+    for (int f = 0; f < kNumFields && covers; f++) {
+      covers = rule.ranges[f].lo <= box[f].lo && rule.ranges[f].hi >= box[f].hi;
+    }
+    if (covers) {
+      idx->resize(i + 1);
+      break;
+    }
+  }
+
+  const size_t n = idx->size();
+  if (n <= leaf_size_ || depth >= kMaxDepth) {
+    MakeLeaf(node_id, *idx);
+    return;
+  }
+
+  // Pick the cut (field, threshold) minimizing the larger of the two halves,
+  // then the total number of rule copies.
+  int best_field = -1;
+  uint32_t best_threshold = 0;
+  size_t best_max = n;
+  size_t best_sum = 2 * n + 1;
+
+  std::vector<uint32_t> los(n);
+  std::vector<uint32_t> his(n);
+  std::vector<uint32_t> candidates;
+  candidates.reserve(2 * n);
+
+  for (int f = 0; f < kNumFields; f++) {
+    if (box[f].lo == box[f].hi) {
+      continue;
+    }
+
+    candidates.clear();
+    for (size_t i = 0; i < n; i++) {
+      Range r = Clip(rules_[(*idx)[i]].ranges[f], box[f]);
+      los[i] = r.lo;
+      his[i] = r.hi;
+      if (r.lo > box[f].lo) {
+        candidates.push_back(r.lo - 1);
+      }
+      if (r.hi < box[f].hi) {
+        candidates.push_back(r.hi);
+      }
+    }
+
+    std::sort(los.begin(), los.end());
+    std::sort(his.begin(), his.end());
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+
+    for (uint32_t t : candidates) {
+      // Rules starting at or below t go left; ending above t go right.
+      size_t left = std::upper_bound(los.begin(), los.end(), t) - los.begin();
+      size_t right =
+          n - (std::upper_bound(his.begin(), his.end(), t) - his.begin());
+      size_t larger = std::max(left, right);
+      if (larger < best_max ||
+          (larger == best_max && left + right < best_sum)) {
+        best_field = f;
+        best_threshold = t;
+        best_max = larger;
+        best_sum = left + right;
+      }
+    }
+  }
+
+  // No cut leaves fewer rules on both sides: the rules all overlap. Cutting
+  // anyway would not bound the size of the tree.
+  if (best_field < 0 || best_max >= n) {
+    MakeLeaf(node_id, *idx);
+    return;
+  }
+
+  std::vector<uint32_t> left_idx;
+  std::vector<uint32_t> right_idx;
+  for (uint32_t i : *idx) {
+    const Range &r = rules_[i].ranges[best_field];
+    if (r.lo <= best_threshold) {
+      left_idx.push_back(i);
+    }
+    if (r.hi > best_threshold) {
+      right_idx.push_back(i);
+    }
+  }
+  idx->clear();
+  idx->shrink_to_fit();
+
+  uint32_t child = nodes_.size();
+  nodes_.resize(child + 2);
+  nodes_[node_id] = {best_threshold, child, static_cast<uint32_t>(best_field)};
+
+  Range saved = box[best_field];
+  box[best_field].hi = best_threshold;
+  BuildNode(child, &left_idx, box, depth + 1);
+  box[best_field] = saved;
+  box[best_field].lo = best_threshold + 1;
+  BuildNode(child + 1, &right_idx, box, depth + 1);
+  box[best_field] = saved;
+}
+
+const HyperSplit::Rule *HyperSplit::Match(const Key &key) const {
+  const Node *node = &nodes_[0];
+  while (node->field != kLeaf) {
+    node = &nodes_[node->child + (key.fields[node->field] > node->value)];
+  }
+  return ScanLeaf(*node, key);
+}
+
+void HyperSplit::MatchBatch(const Key *keys, size_t n,
+                            const Rule **results) const {
+  const size_t kChunk = 32;
+  uint32_t cur[kChunk];
+
+  for (size_t base = 0; base < n; base += kChunk) {
+    size_t cnt = std::min(kChunk, n - base);
+    const Key *k = keys + base;
+
+    std::fill(cur, cur + cnt, 0);
+
+    bool moved = true;
+    while (moved) {
+      moved = false;
+      for (size_t i = 0; i < cnt; i++) {
+        const Node &node = nodes_[cur[i]];
+        if (node.field != kLeaf) {
+          cur[i] = node.child + (k[i].fields[node.field] > node.value);
+          __builtin_prefetch(&nodes_[cur[i]]);
+          moved = true;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      __builtin_prefetch(leaf_rules_.data() + nodes_[cur[i]].value);
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      results[base + i] = ScanLeaf(nodes_[cur[i]], k[i]);
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
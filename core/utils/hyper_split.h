@@ -0,0 +1,151 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_HYPER_SPLIT_H_
+#define BESS_UTILS_HYPER_SPLIT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+// HyperSplit classifies packets by 5-tuple, with each field of a rule matched
+// against an arbitrary range of values (prefixes being a special case). Rules
+// are compiled into a binary decision tree: every internal node cuts the
+// remaining search space in two along one field, at the point that best
+// balances the rules on both sides, and every leaf holds a short list of
+// candidate rules in priority order.
+//
+// Build() is expensive and meant for the control path. Lookups do not modify
+// the object and are thread-safe.
+class HyperSplit {
+ public:
+  enum Field { kSrcIp = 0, kDstIp, kSrcPort, kDstPort, kProto, kNumFields };
+
+  // Inclusive range of field values, in host byte order
+  struct Range {
+    uint32_t lo;
+    uint32_t hi;
+  };
+
+  struct Rule {
+    Range ranges[kNumFields];
+    int priority;  // Among matching rules, the one with highest priority wins
+    uint32_t id;   // Opaque to HyperSplit
+  };
+
+  // Field values of a packet, in host byte order
+  struct Key {
+    uint32_t fields[kNumFields];
+  };
+
+  static const size_t kDefaultLeafSize = 8;
+  static const size_t kMaxDepth = 48;
+
+  explicit HyperSplit(size_t leaf_size = kDefaultLeafSize);
+
+  // Compiles `rules`, replacing the current ones. Among matching rules of
+  // equal priority, the one appearing first in `rules` wins.
+  void Build(const std::vector<Rule> &rules);
+
+  // Returns the highest-priority rule matching `key`, or nullptr.
+  const Rule *Match(const Key &key) const;
+
+  // Same as Match() for each of `keys[0..n)`. The tree is walked for all keys
+  // in lockstep, so that cache misses on nodes of different keys overlap.
+  void MatchBatch(const Key *keys, size_t n, const Rule **results) const;
+
+  size_t num_rules() const { return rules_.size(); }
+  size_t num_nodes() const { return nodes_.size(); }
+  size_t max_depth() const { return max_depth_; }
+
+  // Number of rule copies held by all leaves. Its ratio to num_rules() tells
+  // how much rules got replicated across leaves.
+  size_t num_leaf_entries() const { return leaf_rules_.size(); }
+
+  // The range covering all values of `field`
+  static Range FullRange(Field field);
+
+  // The range of IPv4 addresses in `addr`/`len` (host byte order)
+  static Range PrefixRange(uint32_t addr, int len);
+
+ private:
+  // Internal nodes go to nodes_[child] if the key field is <= `value`, and to
+  // nodes_[child + 1] otherwise. Leaves hold leaf_rules_[value, value + child).
+  struct Node {
+    uint32_t value;
+    uint32_t child;
+    uint32_t field;  // kLeaf for leaves
+  };
+
+  static const uint32_t kLeaf = kNumFields;
+
+  void BuildNode(uint32_t node_id, std::vector<uint32_t> *idx, Range *box,
+                 size_t depth);
+
+  void MakeLeaf(uint32_t node_id, const std::vector<uint32_t> &idx);
+
+  static bool Covers(const Rule &rule, const Key &key) {
+    for (int i = 0; i < kNumFields; i++) {
+      if (key.fields[i] < rule.ranges[i].lo ||
+          key.fields[i] > rule.ranges[i].hi) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  const Rule *ScanLeaf(const Node &leaf, const Key &key) const {
+    for (uint32_t i = leaf.value; i < leaf.value + leaf.child; i++) {
+      const Rule &rule = leaf_rules_[i];
+      if (Covers(rule, key)) {
+        return &rule;
+      }
+    }
+    return nullptr;
+  }
+
+  size_t leaf_size_;
+  size_t max_depth_;
+
+  std::vector<Rule> rules_;  // In decreasing order of priority
+  std::vector<Node> nodes_;  // nodes_[0] is the root
+
+  // Rules of each leaf, copied next to each other so that a leaf scan touches
+  // consecutive cache lines.
+  std::vector<Rule> leaf_rules_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_HYPER_SPLIT_H_
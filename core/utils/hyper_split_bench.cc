@@ -0,0 +1,126 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmarks for the HyperSplit decision-tree classifier, with a rule set
+// shaped like per-UE SDF filters (one UE address per rule, plus remote
+// prefixes, port ranges and protocols).
+
+#include "hyper_split.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+
+using bess::utils::HyperSplit;
+
+static const size_t kBatchSize = 32;
+static const size_t kNumKeys = 4096;
+
+class HyperSplitFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    Random rng(0);
+    std::vector<HyperSplit::Rule> rules;
+
+    for (int64_t i = 0; i < state.range(0); i++) {
+      HyperSplit::Rule r;
+      for (int f = 0; f < HyperSplit::kNumFields; f++) {
+        r.ranges[f] = HyperSplit::FullRange(static_cast<HyperSplit::Field>(f));
+      }
+      // UE addresses out of 10.0.0.0/8
+      uint32_t ue = 0x0a000000 + i;
+      r.ranges[HyperSplit::kDstIp] = {ue, ue};
+      r.ranges[HyperSplit::kSrcIp] =
+          HyperSplit::PrefixRange(rng.Get(), 8 + rng.GetRange(17));
+      if (rng.GetRange(2)) {
+        uint32_t lo = rng.GetRange(65536);
+        r.ranges[HyperSplit::kSrcPort] = {lo, lo + rng.GetRange(65536 - lo)};
+      }
+      if (rng.GetRange(2)) {
+        uint32_t proto = rng.GetRange(2) ? 6 : 17;
+        r.ranges[HyperSplit::kProto] = {proto, proto};
+      }
+      r.priority = rng.GetRange(256);
+      r.id = i;
+      rules.push_back(r);
+    }
+
+    hs_.Build(rules);
+
+    keys_.resize(kNumKeys);
+    for (HyperSplit::Key &key : keys_) {
+      const HyperSplit::Rule &r = rules[rng.GetRange(rules.size())];
+      for (int f = 0; f < HyperSplit::kNumFields; f++) {
+        uint32_t width = r.ranges[f].hi - r.ranges[f].lo;
+        key.fields[f] = r.ranges[f].lo + (width ? rng.Get() % width : 0);
+      }
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    hs_.Build({});
+    keys_.clear();
+  }
+
+ protected:
+  HyperSplit hs_;
+  std::vector<HyperSplit::Key> keys_;
+};
+
+BENCHMARK_DEFINE_F(HyperSplitFixture, Match)(benchmark::State &state) {
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(hs_.Match(keys_[i]));
+    i = (i + 1) % kNumKeys;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(HyperSplitFixture, MatchBatch)(benchmark::State &state) {
+  const HyperSplit::Rule *results[kBatchSize];
+  size_t i = 0;
+  for (auto _ : state) {
+    hs_.MatchBatch(&keys_[i], kBatchSize, results);
+    benchmark::DoNotOptimize(results);
+    i = (i + kBatchSize) % kNumKeys;
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(HyperSplitFixture, Match)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000);
+BENCHMARK_REGISTER_F(HyperSplitFixture, MatchBatch)
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,175 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "hyper_split.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "random.h"
+
+using bess::utils::HyperSplit;
+
+namespace {
+
+using Rule = HyperSplit::Rule;
+using Key = HyperSplit::Key;
+
+Rule AnyRule(int priority, uint32_t id) {
+  Rule r;
+  for (int f = 0; f < HyperSplit::kNumFields; f++) {
+    r.ranges[f] = HyperSplit::FullRange(static_cast<HyperSplit::Field>(f));
+  }
+  r.priority = priority;
+  r.id = id;
+  return r;
+}
+
+// Reference classifier: first rule of highest priority that matches.
+const Rule *LinearMatch(const std::vector<Rule> &rules, const Key &key) {
+  const Rule *best = nullptr;
+  for (const Rule &r : rules) {
+    bool match = true;
+    for (int f = 0; f < HyperSplit::kNumFields; f++) {
+      match &= key.fields[f] >= r.ranges[f].lo && key.fields[f] <= r.ranges[f].hi;
+    }
+    if (match && (!best || r.priority > best->priority)) {
+      best = &r;
+    }
+  }
+  return best;
+}
+
+TEST(HyperSplitTest, Empty) {
+  HyperSplit hs;
+  Key key = {{1, 2, 3, 4, 5}};
+  EXPECT_EQ(nullptr, hs.Match(key));
+  EXPECT_EQ(0, hs.num_rules());
+}
+
+TEST(HyperSplitTest, PrefixRange) {
+  HyperSplit::Range r = HyperSplit::PrefixRange(0x0a010203, 16);
+  EXPECT_EQ(0x0a010000, r.lo);
+  EXPECT_EQ(0x0a01ffff, r.hi);
+
+  r = HyperSplit::PrefixRange(0x0a010203, 32);
+  EXPECT_EQ(0x0a010203, r.lo);
+  EXPECT_EQ(0x0a010203, r.hi);
+
+  r = HyperSplit::PrefixRange(0x0a010203, 0);
+  EXPECT_EQ(0, r.lo);
+  EXPECT_EQ(UINT32_MAX, r.hi);
+}
+
+TEST(HyperSplitTest, PriorityAndRanges) {
+  std::vector<Rule> rules;
+
+  Rule web = AnyRule(10, 1);
+  web.ranges[HyperSplit::kDstIp] = HyperSplit::PrefixRange(0x0a000000, 8);
+  web.ranges[HyperSplit::kDstPort] = {80, 80};
+  web.ranges[HyperSplit::kProto] = {6, 6};
+  rules.push_back(web);
+
+  Rule high_ports = AnyRule(5, 2);
+  high_ports.ranges[HyperSplit::kDstPort] = {1024, 65535};
+  rules.push_back(high_ports);
+
+  rules.push_back(AnyRule(0, 3));
+
+  HyperSplit hs(1);
+  hs.Build(rules);
+
+  Key key = {{0xc0a80001, 0x0a000001, 5555, 80, 6}};
+  ASSERT_NE(nullptr, hs.Match(key));
+  EXPECT_EQ(1, hs.Match(key)->id);
+
+  key.fields[HyperSplit::kProto] = 17;
+  EXPECT_EQ(3, hs.Match(key)->id);
+
+  key.fields[HyperSplit::kDstPort] = 8080;
+  EXPECT_EQ(2, hs.Match(key)->id);
+}
+
+TEST(HyperSplitTest, MatchesLinearScan) {
+  Random rng(42);
+  std::vector<Rule> rules;
+
+  for (uint32_t i = 0; i < 2000; i++) {
+    Rule r = AnyRule(rng.GetRange(100), i);
+    r.ranges[HyperSplit::kSrcIp] =
+        HyperSplit::PrefixRange(rng.Get(), rng.GetRange(33));
+    r.ranges[HyperSplit::kDstIp] =
+        HyperSplit::PrefixRange(rng.Get(), 8 + rng.GetRange(25));
+    if (rng.GetRange(2)) {
+      uint32_t lo = rng.GetRange(65536);
+      r.ranges[HyperSplit::kDstPort] = {lo, lo + rng.GetRange(65536 - lo)};
+    }
+    if (rng.GetRange(2)) {
+      uint32_t proto = rng.GetRange(2) ? 6 : 17;
+      r.ranges[HyperSplit::kProto] = {proto, proto};
+    }
+    rules.push_back(r);
+  }
+
+  HyperSplit hs;
+  hs.Build(rules);
+
+  std::vector<Key> keys;
+  for (int i = 0; i < 5000; i++) {
+    const Rule &r = rules[rng.GetRange(rules.size())];
+    Key key;
+    for (int f = 0; f < HyperSplit::kNumFields; f++) {
+      uint32_t width = r.ranges[f].hi - r.ranges[f].lo;
+      // Half of the keys fall within a rule, the rest anywhere.
+      key.fields[f] = (i % 2)
+                          ? r.ranges[f].lo + (width ? rng.Get() % width : 0)
+                          : rng.Get() & HyperSplit::FullRange(
+                                            static_cast<HyperSplit::Field>(f))
+                                            .hi;
+    }
+    keys.push_back(key);
+  }
+
+  std::vector<const Rule *> results(keys.size());
+  hs.MatchBatch(keys.data(), keys.size(), results.data());
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    const Rule *expected = LinearMatch(rules, keys[i]);
+    const Rule *actual = hs.Match(keys[i]);
+    ASSERT_EQ(expected == nullptr, actual == nullptr) << i;
+    ASSERT_EQ(actual, results[i]) << i;
+    if (expected) {
+      EXPECT_EQ(expected->id, actual->id) << i;
+    }
+  }
+}
+
+}  // namespace
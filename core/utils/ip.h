@@ -43,6 +43,13 @@ bool ParseIpv4Address(const std::string &str, be32_t *addr);
 // be32 -> string
 std::string ToIpv4Address(be32_t addr);
 
+// return false if string -> 16-byte network order address conversion failed
+// (*addr is unmodified)
+bool ParseIpv6Address(const std::string &str, uint8_t (*addr)[16]);
+
+// 16-byte network order address -> string
+std::string ToIpv6Address(const uint8_t (&addr)[16]);
+
 // An IPv4 header definition loosely based on the BSD version.
 struct[[gnu::packed]] Ipv4 {
   enum Flag : uint16_t {
@@ -89,6 +96,19 @@ struct[[gnu::packed]] Ipv4 {
 static_assert(std::is_pod<Ipv4>::value, "not a POD type");
 static_assert(sizeof(Ipv4) == 20, "struct Ipv4 is incorrect");
 
+// An IPv6 fixed header (RFC 8200). Extension headers are not modeled.
+struct[[gnu::packed]] Ipv6 {
+  be32_t vtc_flow;         // Version, traffic class and flow label.
+  be16_t payload_length;   // Payload length.
+  uint8_t next_header;     // Next header, using the Ipv4::Proto values.
+  uint8_t hop_limit;       // Hop limit.
+  uint8_t src[16];         // Source address.
+  uint8_t dst[16];         // Destination address.
+};
+
+static_assert(std::is_pod<Ipv6>::value, "not a POD type");
+static_assert(sizeof(Ipv6) == 40, "struct Ipv6 is incorrect");
+
 struct Ipv4Prefix {
   // Implicit default constructor is not allowed
   Ipv4Prefix() = delete;
@@ -31,6 +31,8 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
+
 using bess::utils::be32_t;
 
 namespace {
@@ -53,6 +55,23 @@ TEST(IPTest, AddressInStr) {
   EXPECT_FALSE(ParseIpv4Address("1.1.256.1", &b));
 }
 
+TEST(IPTest, Ipv6AddressInStr) {
+  uint8_t a[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                   0,    0,    0,    0,    0, 0, 0, 1};
+
+  std::string str = bess::utils::ToIpv6Address(a);
+  EXPECT_EQ(str, "2001:db8::1");
+
+  uint8_t b[16] = {};
+  EXPECT_TRUE(bess::utils::ParseIpv6Address(str, &b));
+  EXPECT_EQ(0, memcmp(a, b, sizeof(a)));
+
+  EXPECT_FALSE(bess::utils::ParseIpv6Address("hello", &b));
+  EXPECT_FALSE(bess::utils::ParseIpv6Address("1.1.1.1", &b));
+  EXPECT_FALSE(bess::utils::ParseIpv6Address("2001:db8::1::2", &b));
+  EXPECT_EQ(0, memcmp(a, b, sizeof(a)));
+}
+
 // Check if Ipv4Prefix can be correctly constructed from strings
 TEST(IPTest, PrefixInStr) {
   Ipv4Prefix prefix_1("192.168.0.1/24");
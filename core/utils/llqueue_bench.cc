@@ -0,0 +1,186 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmarks for inter-worker rings: llring (used by Queue, Buffer, VPort,
+// QueueOut) versus MpmcRing. The *Burst benchmarks run 1-8 threads that each
+// enqueue and then dequeue a burst on the same ring. The *Producers ones
+// sweep 1/2/4/8 producer threads against a fixed set of kConsumers consumer
+// threads, as when several upstream workers feed one Queue. Both report CPU
+// cycles per packet.
+
+#include <benchmark/benchmark.h>
+
+#include "../kmod/llring.h"
+#include "mpmc_ring.h"
+#include "time.h"
+
+namespace {
+
+const unsigned kRingSize = 1024;
+const unsigned kBurst = 32;
+const int kConsumers = 2;
+
+struct llring *NewLlring() {
+  struct llring *ring = reinterpret_cast<struct llring *>(aligned_alloc(
+      alignof(llring), llring_bytes_with_slots(kRingSize)));
+  CHECK(ring);
+  CHECK_EQ(llring_init(ring, kRingSize, 0, 0), 0);
+  return ring;
+}
+
+template <typename EnqueueFn, typename DequeueFn>
+void RunBurst(benchmark::State &state, EnqueueFn enqueue, DequeueFn dequeue) {
+  void *objs[kBurst];
+  void *out[kBurst];
+  for (unsigned i = 0; i < kBurst; i++) {
+    objs[i] = reinterpret_cast<void *>(i + 1);
+  }
+
+  uint64_t cycles = 0;
+  uint64_t pkts = 0;
+  for (auto _ : state) {
+    uint64_t start = rdtsc();
+    unsigned enqueued = enqueue(objs, kBurst);
+    unsigned dequeued = dequeue(out, kBurst);
+    cycles += rdtsc() - start;
+    pkts += enqueued;
+    benchmark::DoNotOptimize(dequeued);
+  }
+
+  state.SetItemsProcessed(pkts);
+  state.counters["cycles/pkt"] = benchmark::Counter(
+      pkts ? static_cast<double>(cycles) / pkts : 0,
+      benchmark::Counter::kAvgThreads);
+}
+
+void BM_LlringBurst(benchmark::State &state) {
+  static struct llring *ring = NewLlring();
+  RunBurst(state,
+           [](void **objs, unsigned n) {
+             return llring_mp_enqueue_burst(ring, objs, n);
+           },
+           [](void **objs, unsigned n) {
+             return llring_mc_dequeue_burst(ring, objs, n);
+           });
+}
+
+void BM_MpmcRingBurst(benchmark::State &state) {
+  static bess::utils::MpmcRing *ring = new bess::utils::MpmcRing(kRingSize);
+  RunBurst(state,
+           [](void **objs, unsigned n) {
+             return static_cast<unsigned>(ring->EnqueueBurst(objs, n));
+           },
+           [](void **objs, unsigned n) {
+             return static_cast<unsigned>(ring->DequeueBurst(objs, n));
+           });
+}
+
+// The last kConsumers threads only dequeue and all the others only enqueue.
+// cycles/pkt is the producer cost per enqueued packet; full-ring retries
+// count toward it.
+template <typename EnqueueFn, typename DequeueFn>
+void RunProducers(benchmark::State &state, EnqueueFn enqueue,
+                  DequeueFn dequeue) {
+  void *objs[kBurst];
+  for (unsigned i = 0; i < kBurst; i++) {
+    objs[i] = reinterpret_cast<void *>(i + 1);
+  }
+
+  const int producers = state.threads() - kConsumers;
+  bool producer = state.thread_index() < producers;
+  if (state.thread_index() == 0) {
+    // Start from an empty ring; the previous run may have left packets.
+    while (dequeue(objs, kBurst)) {
+    }
+    for (unsigned i = 0; i < kBurst; i++) {
+      objs[i] = reinterpret_cast<void *>(i + 1);
+    }
+  }
+
+  uint64_t cycles = 0;
+  uint64_t pkts = 0;
+  for (auto _ : state) {
+    if (producer) {
+      uint64_t start = rdtsc();
+      pkts += enqueue(objs, kBurst);
+      cycles += rdtsc() - start;
+    } else {
+      benchmark::DoNotOptimize(dequeue(objs, kBurst));
+    }
+  }
+
+  // Counters are summed over threads, so each producer adds its share of the
+  // average.
+  if (producer) {
+    state.SetItemsProcessed(pkts);
+    state.counters["cycles/pkt"] =
+        pkts ? static_cast<double>(cycles) / pkts / producers : 0;
+  }
+  if (state.thread_index() == 0) {
+    state.counters["producers"] = producers;
+  }
+}
+
+void BM_LlringProducers(benchmark::State &state) {
+  static struct llring *ring = NewLlring();
+  RunProducers(state,
+               [](void **objs, unsigned n) {
+                 return llring_mp_enqueue_burst(ring, objs, n);
+               },
+               [](void **objs, unsigned n) {
+                 return llring_mc_dequeue_burst(ring, objs, n);
+               });
+}
+
+void BM_MpmcRingProducers(benchmark::State &state) {
+  static bess::utils::MpmcRing *ring = new bess::utils::MpmcRing(kRingSize);
+  RunProducers(state,
+               [](void **objs, unsigned n) {
+                 return static_cast<unsigned>(ring->EnqueueBurst(objs, n));
+               },
+               [](void **objs, unsigned n) {
+                 return static_cast<unsigned>(ring->DequeueBurst(objs, n));
+               });
+}
+
+void ProducerSweep(benchmark::internal::Benchmark *b) {
+  for (int producers : {1, 2, 4, 8}) {
+    b->Threads(producers + kConsumers);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_LlringBurst)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_MpmcRingBurst)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_LlringProducers)->Apply(ProducerSweep)->UseRealTime();
+BENCHMARK(BM_MpmcRingProducers)->Apply(ProducerSweep)->UseRealTime();
+
+BENCHMARK_MAIN();
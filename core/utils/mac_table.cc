@@ -0,0 +1,309 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "mac_table.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include "numa.h"
+
+namespace bess {
+namespace utils {
+
+// Bounds the breadth-first search for a cuckoo path in MakeRoom().
+static const int kMaxBfsNodes = 512;
+
+// FindBulk() hashes and prefetches this many addresses ahead of comparing.
+static const size_t kPrefetchBatch = 32;
+
+int MacTable::Init(size_t num_buckets, int slots_per_bucket) {
+  if (num_buckets == 0 || num_buckets > kMaxBuckets ||
+      (num_buckets & (num_buckets - 1))) {
+    return -EINVAL;
+  }
+  if (slots_per_bucket <= 0 || slots_per_bucket > kBucketSize ||
+      (slots_per_bucket & (slots_per_bucket - 1))) {
+    return -EINVAL;
+  }
+
+  DeInit();
+
+  // Zero-filled, and in mappings of their own for MoveToSocket().
+  num_buckets_ = num_buckets;
+  buckets_ = static_cast<Bucket *>(AllocPages(BucketsBytes()));
+  timestamps_ = static_cast<uint32_t *>(AllocPages(TimestampsBytes()));
+  if (!buckets_ || !timestamps_) {
+    DeInit();
+    return -ENOMEM;
+  }
+
+  bucket_mask_ = num_buckets - 1;
+  slots_per_bucket_ = slots_per_bucket;
+  count_ = 0;
+  return 0;
+}
+
+void MacTable::DeInit() {
+  FreePages(buckets_, BucketsBytes());
+  FreePages(timestamps_, TimestampsBytes());
+  buckets_ = nullptr;
+  timestamps_ = nullptr;
+  num_buckets_ = 0;
+  bucket_mask_ = 0;
+  count_ = 0;
+}
+
+int MacTable::MoveToSocket(int socket) {
+  int ret = MovePagesToNode(buckets_, BucketsBytes(), socket);
+  if (ret) {
+    return ret;
+  }
+  return MovePagesToNode(timestamps_, TimestampsBytes(), socket);
+}
+
+void MacTable::FindBulk(const uint64_t *addrs, size_t n, uint64_t *entries,
+                        uint32_t *slots) const {
+  uint32_t version = version_.load(std::memory_order_acquire);
+  bool missed = false;
+
+  for (size_t base = 0; base < n; base += kPrefetchBatch) {
+    size_t cnt = std::min(kPrefetchBatch, n - base);
+    uint32_t b1[kPrefetchBatch];
+    uint32_t b2[kPrefetchBatch];
+
+    for (size_t i = 0; i < cnt; i++) {
+      BucketsOf(addrs[base + i], &b1[i], &b2[i]);
+      __builtin_prefetch(&buckets_[b1[i]]);
+      __builtin_prefetch(&buckets_[b2[i]]);
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      uint64_t addr = addrs[base + i];
+      uint64_t *entry = &entries[base + i];
+      int s;
+
+      if ((s = SearchBucket(b1[i], addr, entry)) >= 0) {
+        slots[base + i] = b1[i] * kBucketSize + s;
+      } else if ((s = SearchBucket(b2[i], addr, entry)) >= 0) {
+        slots[base + i] = b2[i] * kBucketSize + s;
+      } else {
+        *entry = 0;
+        slots[base + i] = kInvalidSlot;
+        missed = true;
+      }
+    }
+  }
+
+  if (!missed) {
+    return;
+  }
+
+  // An entry may have been moved under us; look up misses again if so.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (version != version_.load(std::memory_order_relaxed)) {
+    for (size_t i = 0; i < n; i++) {
+      if (slots[i] == kInvalidSlot) {
+        slots[i] = Find(addrs[i], &entries[i]);
+      }
+    }
+  }
+}
+
+int MacTable::FreeSlotIn(uint32_t bucket) const {
+  for (int i = 0; i < slots_per_bucket_; i++) {
+    if (!(buckets_[bucket].slots[i] & kValid)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+uint32_t MacTable::MakeRoom(uint32_t b1, uint32_t b2) {
+  int s;
+  if ((s = FreeSlotIn(b1)) >= 0) {
+    return b1 * kBucketSize + s;
+  }
+  if ((s = FreeSlotIn(b2)) >= 0) {
+    return b2 * kBucketSize + s;
+  }
+
+  // Breadth-first search for the shortest chain of entries, each of which
+  // can move to its other bucket, ending at a bucket with a free slot.
+  struct Node {
+    uint32_t bucket;
+    int parent;  // index in `nodes`, or -1
+    int slot;    // slot in the parent bucket whose entry moves here
+  };
+  Node nodes[kMaxBfsNodes];
+  int num_nodes = 0;
+
+  nodes[num_nodes++] = {b1, -1, -1};
+  if (b2 != b1) {
+    nodes[num_nodes++] = {b2, -1, -1};
+  }
+
+  int found = -1;
+  int free_slot = -1;
+  for (int head = 0; head < num_nodes && found < 0; head++) {
+    uint32_t bucket = nodes[head].bucket;
+
+    for (int i = 0; i < slots_per_bucket_ && num_nodes < kMaxBfsNodes; i++) {
+      uint32_t alt1, alt2;
+      BucketsOf(buckets_[bucket].slots[i] & kAddrMask, &alt1, &alt2);
+      uint32_t alt = (alt1 == bucket) ? alt2 : alt1;
+
+      // A bucket may appear only once on a path.
+      bool on_path = false;
+      for (int n = head; n >= 0; n = nodes[n].parent) {
+        if (nodes[n].bucket == alt) {
+          on_path = true;
+          break;
+        }
+      }
+      if (on_path) {
+        continue;
+      }
+
+      nodes[num_nodes++] = {alt, head, i};
+      if ((free_slot = FreeSlotIn(alt)) >= 0) {
+        found = num_nodes - 1;
+        break;
+      }
+    }
+  }
+
+  if (found < 0) {
+    return kInvalidSlot;
+  }
+
+  // Move entries backwards along the path, so that every entry is always
+  // present in at least one of its buckets.
+  uint32_t dst = nodes[found].bucket * kBucketSize + free_slot;
+  for (int n = found; nodes[n].parent >= 0; n = nodes[n].parent) {
+    uint32_t src = nodes[nodes[n].parent].bucket * kBucketSize + nodes[n].slot;
+
+    timestamps_[dst] = timestamps_[src];
+    StoreSlot(dst, LoadSlot(src));
+    version_.fetch_add(1, std::memory_order_release);
+    StoreSlot(src, 0);
+    dst = src;
+  }
+
+  return dst;
+}
+
+int MacTable::Add(uint64_t addr, uint16_t gate, bool is_static, uint32_t now) {
+  uint64_t entry;
+  if (Find(addr, &entry) != kInvalidSlot) {
+    return -EEXIST;
+  }
+
+  uint32_t b1, b2;
+  BucketsOf(addr, &b1, &b2);
+  uint32_t slot = MakeRoom(b1, b2);
+  if (slot == kInvalidSlot) {
+    return -ENOSPC;
+  }
+
+  timestamps_[slot] = now;
+  StoreSlot(slot, kValid | (is_static ? kStatic : 0) |
+                      (static_cast<uint64_t>(gate & kGateMask) << kGateShift) |
+                      (addr & kAddrMask));
+  count_++;
+  return 0;
+}
+
+int MacTable::Learn(uint64_t addr, uint16_t gate, uint32_t now) {
+  uint64_t entry;
+  uint32_t slot = Find(addr, &entry);
+  if (slot == kInvalidSlot) {
+    return Add(addr, gate, false, now);
+  }
+
+  if (EntryIsStatic(entry)) {
+    return 0;
+  }
+
+  timestamps_[slot] = now;
+  if (EntryGate(entry) != gate) {
+    // The station has moved.
+    entry &= ~(kGateMask << kGateShift);
+    StoreSlot(slot, entry | (static_cast<uint64_t>(gate & kGateMask)
+                             << kGateShift));
+  }
+  return 0;
+}
+
+int MacTable::Delete(uint64_t addr) {
+  uint64_t entry;
+  uint32_t slot = Find(addr, &entry);
+  if (slot == kInvalidSlot) {
+    return -ENOENT;
+  }
+
+  StoreSlot(slot, 0);
+  count_--;
+  return 0;
+}
+
+size_t MacTable::Expire(size_t first, size_t n, uint32_t now,
+                        uint32_t max_age) {
+  size_t last = std::min(first + n, num_buckets_);
+  size_t removed = 0;
+
+  for (size_t b = first; b < last; b++) {
+    for (int i = 0; i < slots_per_bucket_; i++) {
+      uint32_t slot = b * kBucketSize + i;
+      uint64_t entry = LoadSlot(slot);
+
+      // Signed, since workers may have refreshed the entry with a timestamp
+      // later than `now` in the meantime. Such entries are not expired.
+      uint32_t ts = __atomic_load_n(&timestamps_[slot], __ATOMIC_RELAXED);
+      if ((entry & kValid) && !(entry & kStatic) &&
+          static_cast<int32_t>(now - ts) > static_cast<int32_t>(max_age)) {
+        StoreSlot(slot, 0);
+        removed++;
+      }
+    }
+  }
+
+  count_ -= removed;
+  return removed;
+}
+
+void MacTable::Clear() {
+  for (size_t slot = 0; slot < num_buckets_ * kBucketSize; slot++) {
+    StoreSlot(slot, 0);
+  }
+  count_ = 0;
+}
+
+}  // namespace utils
+}  // namespace bess
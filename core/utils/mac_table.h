@@ -0,0 +1,275 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Concurrent MAC address table for L2 forwarding and learning.
+//
+// The table is a two-choice cuckoo hash whose buckets are one cache line of
+// eight 64-bit slots, each packing {valid, static, gate, 48-bit address}. A
+// bucket is searched with one SIMD compare (AVX-512) or two (AVX2).
+//
+// Lookups and timestamp refreshes are lock-free and may run on any number of
+// threads. Structural updates (Add, Learn, Delete, Expire, Clear) must be
+// serialized by holding mutex(). When an insert displaces entries, each entry
+// is copied to its new slot before the old one is cleared, and a version
+// counter is bumped in between; lookups that miss while the version changes
+// retry, so a concurrent lookup never misses an entry that is being moved.
+
+#ifndef BESS_UTILS_MAC_TABLE_H_
+#define BESS_UTILS_MAC_TABLE_H_
+
+#include <x86intrin.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+class MacTable {
+ public:
+  static constexpr int kBucketSize = 8;
+
+  // The largest table has 2^26 buckets, i.e., 512M slots.
+  static constexpr size_t kMaxBuckets = 1ul << 26;
+
+  static constexpr uint32_t kInvalidSlot = UINT32_MAX;
+
+  // Slot layout. An all-zero slot is empty.
+  static constexpr uint64_t kAddrMask = 0x0000ffffffffffffull;
+  static constexpr int kGateShift = 48;
+  static constexpr uint64_t kGateMask = 0x3fff;
+  static constexpr uint64_t kStatic = 1ull << 62;
+  static constexpr uint64_t kValid = 1ull << 63;
+
+  static uint16_t EntryGate(uint64_t entry) {
+    return (entry >> kGateShift) & kGateMask;
+  }
+
+  static bool EntryIsStatic(uint64_t entry) { return entry & kStatic; }
+
+  MacTable()
+      : buckets_(),
+        timestamps_(),
+        num_buckets_(),
+        bucket_mask_(),
+        slots_per_bucket_(),
+        count_(),
+        version_() {}
+
+  ~MacTable() { DeInit(); }
+
+  // `num_buckets` must be a power of 2 up to kMaxBuckets. Only the first
+  // `slots_per_bucket` (a power of 2 up to kBucketSize) slots of each bucket
+  // are used. Returns 0 or -errno.
+  int Init(size_t num_buckets, int slots_per_bucket);
+  void DeInit();
+
+  // Migrates the table memory to NUMA node `socket`. Returns 0 or -errno.
+  int MoveToSocket(int socket);
+
+  // Lock-free lookup. Returns the slot holding `addr` and stores its entry
+  // in `*entry`, or returns kInvalidSlot (with `*entry` set to 0).
+  uint32_t Find(uint64_t addr, uint64_t *entry) const {
+    uint32_t b1, b2;
+    BucketsOf(addr, &b1, &b2);
+
+    uint32_t version;
+    do {
+      version = version_.load(std::memory_order_acquire);
+
+      int i = SearchBucket(b1, addr, entry);
+      if (i >= 0) {
+        return b1 * kBucketSize + i;
+      }
+      i = SearchBucket(b2, addr, entry);
+      if (i >= 0) {
+        return b2 * kBucketSize + i;
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while (version != version_.load(std::memory_order_relaxed));
+
+    *entry = 0;
+    return kInvalidSlot;
+  }
+
+  // Lock-free lookup of `n` addresses, prefetching all candidate buckets
+  // before comparing. Entries of missing addresses are set to 0.
+  void FindBulk(const uint64_t *addrs, size_t n, uint64_t *entries,
+                uint32_t *slots) const;
+
+  // Refreshes the last-seen time of the entry in `slot`, as returned by
+  // Find(). Lock-free; a refresh racing with a move of the entry may be lost.
+  void Touch(uint32_t slot, uint32_t now) {
+    if (timestamps_[slot] != now) {
+      __atomic_store_n(&timestamps_[slot], now, __ATOMIC_RELAXED);
+    }
+  }
+
+  // The following methods require mutex() to be held.
+
+  // Inserts a new entry. Returns 0, -EEXIST or -ENOSPC.
+  int Add(uint64_t addr, uint16_t gate, bool is_static, uint32_t now);
+
+  // Inserts or updates a dynamic entry for `addr` seen on `gate`. Static
+  // entries are left alone. Returns 0 or -ENOSPC.
+  int Learn(uint64_t addr, uint16_t gate, uint32_t now);
+
+  // Returns 0 or -ENOENT.
+  int Delete(uint64_t addr);
+
+  // Removes dynamic entries in buckets [first, first + n) not seen for more
+  // than `max_age` (at most INT32_MAX) before `now`. Entries seen after `now`
+  // are kept. Returns the number of removed entries.
+  size_t Expire(size_t first, size_t n, uint32_t now, uint32_t max_age);
+
+  void Clear();
+
+  std::mutex &mutex() { return mutex_; }
+
+  size_t num_buckets() const { return num_buckets_; }
+  size_t capacity() const { return num_buckets_ * slots_per_bucket_; }
+  size_t count() const { return count_.load(std::memory_order_relaxed); }
+
+ private:
+  struct alignas(64) Bucket {
+    uint64_t slots[kBucketSize];
+  };
+
+  static uint64_t Hash(uint64_t addr) {
+    // MurmurHash3 finalizer
+    addr ^= addr >> 33;
+    addr *= 0xff51afd7ed558ccdull;
+    addr ^= addr >> 33;
+    addr *= 0xc4ceb9fe1a85ec53ull;
+    addr ^= addr >> 33;
+    return addr;
+  }
+
+  void BucketsOf(uint64_t addr, uint32_t *b1, uint32_t *b2) const {
+    uint64_t h = Hash(addr);
+    *b1 = h & bucket_mask_;
+    *b2 = (h >> 32) & bucket_mask_;
+    if (*b2 == *b1) {
+      *b2 ^= 1;
+      *b2 &= bucket_mask_;
+    }
+  }
+
+  // Returns a bitmask of the slots of `bucket` holding `addr`.
+  int MatchBucket(uint32_t bucket, uint64_t addr) const {
+    const uint64_t *slots = buckets_[bucket].slots;
+    const uint64_t key = addr | kValid;
+    const uint64_t mask = kValid | kAddrMask;
+#if __AVX512F__
+    __m512i v = _mm512_and_si512(_mm512_load_si512(slots),
+                                 _mm512_set1_epi64(mask));
+    return _mm512_cmpeq_epi64_mask(v, _mm512_set1_epi64(key));
+#elif __AVX2__
+    const __m256i k = _mm256_set1_epi64x(key);
+    const __m256i m = _mm256_set1_epi64x(mask);
+    __m256i lo = _mm256_and_si256(
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(slots)), m);
+    __m256i hi = _mm256_and_si256(
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(slots + 4)), m);
+    int lo_bits = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, k)));
+    int hi_bits = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, k)));
+    return lo_bits | (hi_bits << 4);
+#else
+    int bits = 0;
+    for (int i = 0; i < kBucketSize; i++) {
+      bits |= ((__atomic_load_n(&slots[i], __ATOMIC_RELAXED) & mask) == key)
+              << i;
+    }
+    return bits;
+#endif
+  }
+
+  // Returns the slot index within `bucket` holding `addr` (with its entry in
+  // `*entry`), or -1.
+  int SearchBucket(uint32_t bucket, uint64_t addr, uint64_t *entry) const {
+    int bits = MatchBucket(bucket, addr);
+    if (!bits) {
+      return -1;
+    }
+    int i = __builtin_ctz(bits);
+    *entry = __atomic_load_n(&buckets_[bucket].slots[i], __ATOMIC_RELAXED);
+    // The slot may have been overwritten since the compare.
+    if ((*entry & (kValid | kAddrMask)) != (addr | kValid)) {
+      return -1;
+    }
+    return i;
+  }
+
+  // Locates an empty slot for an entry whose candidate buckets are `b1` and
+  // `b2`, displacing existing entries along a cuckoo path if needed.
+  // Returns the slot or kInvalidSlot if the table is too full.
+  uint32_t MakeRoom(uint32_t b1, uint32_t b2);
+
+  int FreeSlotIn(uint32_t bucket) const;
+
+  void StoreSlot(uint32_t slot, uint64_t entry) {
+    __atomic_store_n(&buckets_[slot / kBucketSize].slots[slot % kBucketSize],
+                     entry, __ATOMIC_RELEASE);
+  }
+
+  size_t BucketsBytes() const { return num_buckets_ * sizeof(Bucket); }
+
+  size_t TimestampsBytes() const {
+    return num_buckets_ * kBucketSize * sizeof(uint32_t);
+  }
+
+  uint64_t LoadSlot(uint32_t slot) const {
+    return buckets_[slot / kBucketSize].slots[slot % kBucketSize];
+  }
+
+  Bucket *buckets_;
+  uint32_t *timestamps_;  // per slot, kept apart so refreshes do not dirty
+                          // the cache lines read by lookups
+  size_t num_buckets_;
+  uint32_t bucket_mask_;
+  int slots_per_bucket_;
+  std::atomic<size_t> count_;
+
+  std::atomic<uint32_t> version_;
+  std::mutex mutex_;
+
+  DISALLOW_COPY_AND_ASSIGN(MacTable);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_MAC_TABLE_H_
@@ -0,0 +1,258 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "mac_table.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "random.h"
+
+namespace {
+
+using bess::utils::MacTable;
+
+static uint64_t RandomAddr(Random *rng) {
+  return ((static_cast<uint64_t>(rng->Get()) << 32) | rng->Get()) &
+         MacTable::kAddrMask;
+}
+
+TEST(MacTableTest, Init) {
+  MacTable t;
+
+  EXPECT_EQ(-EINVAL, t.Init(0, 0));
+  EXPECT_EQ(-EINVAL, t.Init(4, 0));
+  EXPECT_EQ(-EINVAL, t.Init(0, 2));
+  EXPECT_EQ(-EINVAL, t.Init(6, 4));
+  EXPECT_EQ(-EINVAL, t.Init(4, 3));
+  EXPECT_EQ(-EINVAL, t.Init(4, 16));
+  EXPECT_EQ(-EINVAL, t.Init(MacTable::kMaxBuckets * 2, 8));
+
+  EXPECT_EQ(0, t.Init(4, 2));
+  EXPECT_EQ(8, t.capacity());
+  EXPECT_EQ(0, t.Init(2 << 10, 8));
+  EXPECT_EQ(16384, t.capacity());
+  EXPECT_EQ(0, t.count());
+}
+
+TEST(MacTableTest, AddFindDelete) {
+  MacTable t;
+  uint64_t addr1 = 0x456701234567;
+  uint64_t addr2 = 0x543210987654;
+  uint64_t entry;
+
+  ASSERT_EQ(0, t.Init(4, 4));
+  std::lock_guard<std::mutex> lock(t.mutex());
+
+  EXPECT_EQ(0, t.Add(addr1, 0x123, true, 0));
+  EXPECT_EQ(-EEXIST, t.Add(addr1, 0x456, true, 0));
+  EXPECT_EQ(1, t.count());
+
+  ASSERT_NE(MacTable::kInvalidSlot, t.Find(addr1, &entry));
+  EXPECT_EQ(0x123, MacTable::EntryGate(entry));
+  EXPECT_TRUE(MacTable::EntryIsStatic(entry));
+  EXPECT_EQ(MacTable::kInvalidSlot, t.Find(addr2, &entry));
+
+  EXPECT_EQ(0, t.Delete(addr1));
+  EXPECT_EQ(-ENOENT, t.Delete(addr2));
+  EXPECT_EQ(MacTable::kInvalidSlot, t.Find(addr1, &entry));
+  EXPECT_EQ(0, t.count());
+
+  EXPECT_EQ(0, t.Add(addr1, 1, false, 0));
+  EXPECT_EQ(0, t.Add(addr2, 2, false, 0));
+  t.Clear();
+  EXPECT_EQ(MacTable::kInvalidSlot, t.Find(addr1, &entry));
+  EXPECT_EQ(MacTable::kInvalidSlot, t.Find(addr2, &entry));
+  EXPECT_EQ(0, t.count());
+}
+
+// Fills the table until it rejects an insert, and checks that every entry
+// added on the way (including displaced ones) can still be found.
+TEST(MacTableTest, HighLoad) {
+  MacTable t;
+  Random rng(0);
+  std::vector<uint64_t> addrs;
+
+  ASSERT_EQ(0, t.Init(1024, 8));
+  std::lock_guard<std::mutex> lock(t.mutex());
+
+  while (true) {
+    uint64_t addr = RandomAddr(&rng);
+    int ret = t.Add(addr, addrs.size() % 100, false, 0);
+    if (ret == -EEXIST) {
+      continue;
+    }
+    if (ret == -ENOSPC) {
+      break;
+    }
+    ASSERT_EQ(0, ret);
+    addrs.push_back(addr);
+  }
+
+  EXPECT_GT(addrs.size(), t.capacity() * 0.95);
+  EXPECT_EQ(addrs.size(), t.count());
+
+  for (size_t i = 0; i < addrs.size(); i++) {
+    uint64_t entry;
+    ASSERT_NE(MacTable::kInvalidSlot, t.Find(addrs[i], &entry));
+    EXPECT_EQ(i % 100, MacTable::EntryGate(entry));
+  }
+
+  std::vector<uint64_t> entries(addrs.size() + 1);
+  std::vector<uint32_t> slots(addrs.size() + 1);
+  addrs.push_back(0x1);  // missing
+  t.FindBulk(addrs.data(), addrs.size(), entries.data(), slots.data());
+  for (size_t i = 0; i + 1 < addrs.size(); i++) {
+    ASSERT_NE(MacTable::kInvalidSlot, slots[i]);
+    EXPECT_EQ(i % 100, MacTable::EntryGate(entries[i]));
+  }
+  EXPECT_EQ(MacTable::kInvalidSlot, slots.back());
+  EXPECT_EQ(0, entries.back());
+}
+
+TEST(MacTableTest, LearnAndExpire) {
+  MacTable t;
+  uint64_t entry;
+
+  ASSERT_EQ(0, t.Init(16, 8));
+  std::lock_guard<std::mutex> lock(t.mutex());
+
+  EXPECT_EQ(0, t.Add(0xa, 1, true, 0));
+  EXPECT_EQ(0, t.Learn(0xb, 2, 100));
+  EXPECT_EQ(0, t.Learn(0xc, 3, 100));
+
+  // Static entries are neither relearned nor aged out.
+  EXPECT_EQ(0, t.Learn(0xa, 5, 100));
+  t.Find(0xa, &entry);
+  EXPECT_EQ(1, MacTable::EntryGate(entry));
+
+  // A station moving to another gate is relearned.
+  EXPECT_EQ(0, t.Learn(0xb, 4, 105));
+  t.Find(0xb, &entry);
+  EXPECT_EQ(4, MacTable::EntryGate(entry));
+  EXPECT_FALSE(MacTable::EntryIsStatic(entry));
+
+  uint32_t slot = t.Find(0xc, &entry);
+  t.Touch(slot, 108);
+
+  EXPECT_EQ(0, t.Expire(0, t.num_buckets(), 110, 10));
+  EXPECT_EQ(1, t.Expire(0, t.num_buckets(), 116, 10));
+  EXPECT_EQ(MacTable::kInvalidSlot, t.Find(0xb, &entry));
+  EXPECT_NE(MacTable::kInvalidSlot, t.Find(0xc, &entry));
+  EXPECT_EQ(1, t.Expire(0, t.num_buckets(), 119, 10));
+  EXPECT_NE(MacTable::kInvalidSlot, t.Find(0xa, &entry));
+  EXPECT_EQ(1, t.count());
+}
+
+// An entry refreshed by a worker after the sweeper read the clock is newer
+// than `now`, and must not be expired.
+TEST(MacTableTest, ExpireRefreshedAfterNow) {
+  MacTable t;
+  uint64_t entry;
+
+  ASSERT_EQ(0, t.Init(16, 8));
+  std::lock_guard<std::mutex> lock(t.mutex());
+
+  EXPECT_EQ(0, t.Learn(0xb, 2, 101));
+  EXPECT_EQ(0, t.Expire(0, t.num_buckets(), 100, 10));
+  EXPECT_NE(MacTable::kInvalidSlot, t.Find(0xb, &entry));
+
+  // Across the wraparound of the timestamps.
+  EXPECT_EQ(0, t.Learn(0xc, 3, 0xffffffff));
+  EXPECT_EQ(0, t.Expire(0, t.num_buckets(), 0xfffffffe, 10));
+  EXPECT_EQ(0, t.Expire(0, t.num_buckets(), 5, 10));
+  EXPECT_NE(MacTable::kInvalidSlot, t.Find(0xc, &entry));
+  EXPECT_EQ(1, t.Expire(0, t.num_buckets(), 10, 10));
+  EXPECT_EQ(MacTable::kInvalidSlot, t.Find(0xc, &entry));
+  EXPECT_EQ(1, t.count());
+}
+
+// Lookups of resident entries must never miss while another thread keeps
+// inserting and deleting entries, which displaces the resident ones.
+TEST(MacTableTest, ConcurrentLookup) {
+  MacTable t;
+  Random rng(1);
+  std::vector<uint64_t> resident;
+
+  ASSERT_EQ(0, t.Init(256, 8));
+  {
+    std::lock_guard<std::mutex> lock(t.mutex());
+    while (resident.size() < t.capacity() / 2) {
+      uint64_t addr = RandomAddr(&rng);
+      if (t.Add(addr, 7, false, 0) == 0) {
+        resident.push_back(addr);
+      }
+    }
+  }
+
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> misses(0);
+  std::vector<std::thread> readers;
+
+  for (int r = 0; r < 2; r++) {
+    readers.emplace_back([&]() {
+      std::vector<uint64_t> entries(resident.size());
+      std::vector<uint32_t> slots(resident.size());
+      while (!stop) {
+        t.FindBulk(resident.data(), resident.size(), entries.data(),
+                   slots.data());
+        for (size_t i = 0; i < resident.size(); i++) {
+          misses += (slots[i] == MacTable::kInvalidSlot);
+        }
+      }
+    });
+  }
+
+  std::vector<uint64_t> churn;
+  for (int round = 0; round < 1000; round++) {
+    std::lock_guard<std::mutex> lock(t.mutex());
+    while (t.count() < t.capacity() * 0.95) {
+      uint64_t addr = RandomAddr(&rng);
+      if (t.Add(addr, 9, false, 0) == 0) {
+        churn.push_back(addr);
+      }
+    }
+    for (uint64_t addr : churn) {
+      EXPECT_EQ(0, t.Delete(addr));
+    }
+    churn.clear();
+  }
+
+  stop = true;
+  for (std::thread &th : readers) {
+    th.join();
+  }
+
+  EXPECT_EQ(0, misses);
+}
+
+}  // namespace (unnamed)
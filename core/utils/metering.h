@@ -162,8 +162,45 @@ class Metering {
     return hit_mask;
   }
 
+  // Calls `fn(key, val)` on every entry. Not safe against concurrent
+  // updates.
+  template <typename F>
+  void ForEach(F &&fn) const {
+    const void *key;
+    void *data;
+    uint32_t next = 0;
+    while (table_->Iterate(&key, &data, &next) >= 0) {
+      fn(*static_cast<const MeteringKey *>(key), *static_cast<const T *>(data));
+    }
+  }
+
   uint32_t Total_key_size() const { return total_key_size_; }
 
+  // Rebuild the table, and reallocate the meter state it points to, on NUMA
+  // node `socket_id`. Returns 0 on success, -errno on failure.
+  int MoveToSocket(int socket_id) {
+    std::ostringstream name;
+    name << "Metering" << &table_ << "s" << socket_id;
+    int ret = table_->MoveToSocket(socket_id, name.str());
+    if (ret) {
+      return ret;
+    }
+
+    // Small allocations may still be served from pages already owned by the
+    // heap arena; fresh pages come from `socket_id`.
+    ScopedNodePreference numa(socket_id);
+    const void *key;
+    void *data;
+    uint32_t next = 0;
+    while (table_->Iterate(&key, &data, &next) >= 0) {
+      T *old_val = static_cast<T *>(data);
+      T *new_val = new T(*old_val);
+      table_->insert_dpdk(key, new_val);
+      delete old_val;
+    }
+    return 0;
+  }
+
   void Init(int size, int entries) {
     std::ostringstream address;
     total_key_size_ = size;
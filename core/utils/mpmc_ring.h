@@ -0,0 +1,191 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_MPMC_RING_H_
+#define BESS_UTILS_MPMC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <glog/logging.h>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+// A bounded multi-producer/multi-consumer ring of pointers, optimized for
+// burst enqueue/dequeue.
+//
+// Unlike llring, where every producer (consumer) must wait for all earlier
+// producers (consumers) to finish before publishing its own objects, each
+// slot carries its own sequence number. A producer reserves a run of slots
+// with a single CAS on the head index, fills them, and publishes each slot
+// independently; consumers only take the prefix of slots that has been
+// published. Nobody ever spins on another thread's progress, which keeps the
+// cost per object flat as the number of producers grows.
+//
+// The head and tail indices live on separate cache lines. All slots are
+// usable, so a ring of N slots holds N objects (llring holds N - 1).
+class MpmcRing {
+ public:
+  // `slots` must be a power of two.
+  explicit MpmcRing(size_t slots) : mask_(slots - 1), slots_() {
+    CHECK(slots >= 2 && (slots & (slots - 1)) == 0);
+    slots_ = static_cast<Slot *>(
+        std::aligned_alloc(alignof(Slot), sizeof(Slot) * slots));
+    CHECK(slots_);
+    for (size_t i = 0; i < slots; i++) {
+      new (&slots_[i]) Slot();
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    head_.pos.store(0, std::memory_order_relaxed);
+    tail_.pos.store(0, std::memory_order_relaxed);
+  }
+
+  ~MpmcRing() { std::free(slots_); }
+
+  // Enqueues up to n objects. Returns the number of objects enqueued, which
+  // is less than n only if the ring is (nearly) full.
+  size_t EnqueueBurst(void *const *objs, size_t n) {
+    uint64_t pos = head_.pos.load(std::memory_order_relaxed);
+    size_t cnt;
+
+    while (true) {
+      cnt = 0;
+      while (cnt < n && SlotSeq(pos + cnt) == pos + cnt) {
+        cnt++;
+      }
+
+      if (unlikely(cnt == 0)) {
+        if (static_cast<int64_t>(SlotSeq(pos) - pos) < 0) {
+          return 0;  // full
+        }
+        pos = head_.pos.load(std::memory_order_relaxed);  // stale; retry
+        continue;
+      }
+
+      if (likely(head_.pos.compare_exchange_weak(pos, pos + cnt,
+                                                 std::memory_order_relaxed))) {
+        break;
+      }
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      Slot &slot = slots_[(pos + i) & mask_];
+      slot.obj = objs[i];
+      slot.seq.store(pos + i + 1, std::memory_order_release);
+    }
+
+    return cnt;
+  }
+
+  // Dequeues up to n objects. Returns the number of objects dequeued.
+  size_t DequeueBurst(void **objs, size_t n) {
+    uint64_t pos = tail_.pos.load(std::memory_order_relaxed);
+    size_t cnt;
+
+    while (true) {
+      cnt = 0;
+      while (cnt < n && SlotSeq(pos + cnt) == pos + cnt + 1) {
+        cnt++;
+      }
+
+      if (unlikely(cnt == 0)) {
+        if (static_cast<int64_t>(SlotSeq(pos) - (pos + 1)) < 0) {
+          return 0;  // empty
+        }
+        pos = tail_.pos.load(std::memory_order_relaxed);  // stale; retry
+        continue;
+      }
+
+      if (likely(tail_.pos.compare_exchange_weak(pos, pos + cnt,
+                                                 std::memory_order_relaxed))) {
+        break;
+      }
+    }
+
+    for (size_t i = 0; i < cnt; i++) {
+      Slot &slot = slots_[(pos + i) & mask_];
+      objs[i] = slot.obj;
+      slot.seq.store(pos + i + mask_ + 1, std::memory_order_release);
+    }
+
+    return cnt;
+  }
+
+  int Enqueue(void *obj) { return EnqueueBurst(&obj, 1) == 1 ? 0 : -1; }
+
+  int Dequeue(void **obj) { return DequeueBurst(obj, 1) == 1 ? 0 : -1; }
+
+  // Number of objects in the ring. Only approximate while other threads are
+  // enqueuing or dequeuing.
+  size_t Count() const {
+    uint64_t tail = tail_.pos.load(std::memory_order_relaxed);
+    uint64_t head = head_.pos.load(std::memory_order_relaxed);
+    return (head > tail) ? head - tail : 0;
+  }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  bool Empty() const { return Count() == 0; }
+
+  bool Full() const { return Count() == Capacity(); }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    void *obj;
+  };
+
+  struct alignas(64) Index {
+    std::atomic<uint64_t> pos;
+  };
+
+  uint64_t SlotSeq(uint64_t pos) const {
+    return slots_[pos & mask_].seq.load(std::memory_order_acquire);
+  }
+
+  const uint64_t mask_;
+  Slot *slots_;
+
+  Index head_;  // next position to enqueue at
+  Index tail_;  // next position to dequeue from
+
+  DISALLOW_COPY_AND_ASSIGN(MpmcRing);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_MPMC_RING_H_
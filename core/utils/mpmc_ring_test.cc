@@ -0,0 +1,150 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "mpmc_ring.h"
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::MpmcRing;
+
+void *ToPtr(uintptr_t v) {
+  return reinterpret_cast<void *>(v);
+}
+
+TEST(MpmcRingTest, SingleInputOutput) {
+  MpmcRing r(8);
+  EXPECT_TRUE(r.Empty());
+  ASSERT_EQ(0, r.Enqueue(ToPtr(42)));
+  EXPECT_EQ(1, r.Count());
+
+  void *obj = nullptr;
+  ASSERT_EQ(0, r.Dequeue(&obj));
+  EXPECT_EQ(ToPtr(42), obj);
+  EXPECT_TRUE(r.Empty());
+  EXPECT_NE(0, r.Dequeue(&obj));
+}
+
+// All slots are usable, and bursts are partially served when the ring fills.
+TEST(MpmcRingTest, BurstFullEmpty) {
+  MpmcRing r(8);
+  void *in[12];
+  void *out[12];
+  for (int i = 0; i < 12; i++) {
+    in[i] = ToPtr(i + 1);
+  }
+
+  ASSERT_EQ(5, r.EnqueueBurst(in, 5));
+  ASSERT_EQ(3, r.EnqueueBurst(in + 5, 7));
+  EXPECT_TRUE(r.Full());
+  EXPECT_EQ(0, r.EnqueueBurst(in + 8, 4));
+
+  ASSERT_EQ(8, r.DequeueBurst(out, 12));
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(in[i], out[i]);
+  }
+  EXPECT_EQ(0, r.DequeueBurst(out, 12));
+
+  // Wraps around.
+  ASSERT_EQ(4, r.EnqueueBurst(in + 8, 4));
+  ASSERT_EQ(4, r.DequeueBurst(out, 4));
+  for (int i = 0; i < 4; i++) {
+    EXPECT_EQ(in[8 + i], out[i]);
+  }
+}
+
+// Every object enqueued by concurrent producers is dequeued exactly once, and
+// objects from each producer come out in order.
+TEST(MpmcRingTest, ConcurrentProducersConsumers) {
+  const int kThreads = 4;
+  const uintptr_t kPerProducer = 50000;
+  const size_t kBurst = 32;
+
+  MpmcRing r(1024);
+  std::atomic<uint64_t> consumed(0);
+  std::vector<uint64_t> sums(kThreads);
+  std::vector<bool> in_order(kThreads, true);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&r, t, kPerProducer, kBurst]() {
+      void *objs[kBurst];
+      uintptr_t next = 0;
+      while (next < kPerProducer) {
+        size_t n = 0;
+        for (; n < kBurst && next + n < kPerProducer; n++) {
+          objs[n] = ToPtr(((next + n) << 8) | t);
+        }
+        next += r.EnqueueBurst(objs, n);
+      }
+    });
+  }
+
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t]() {
+      void *objs[kBurst];
+      std::vector<uintptr_t> last(kThreads, 0);
+      uint64_t sum = 0;
+      while (consumed.load() < kThreads * kPerProducer) {
+        size_t n = r.DequeueBurst(objs, kBurst);
+        for (size_t i = 0; i < n; i++) {
+          uintptr_t v = reinterpret_cast<uintptr_t>(objs[i]);
+          uintptr_t seq = (v >> 8) + 1;
+          int producer = v & 0xff;
+          if (seq <= last[producer]) {
+            in_order[t] = false;
+          }
+          last[producer] = seq;
+          sum += seq;
+        }
+        consumed += n;
+      }
+      sums[t] = sum;
+    });
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  uint64_t total = 0;
+  for (int t = 0; t < kThreads; t++) {
+    total += sums[t];
+    EXPECT_TRUE(in_order[t]);
+  }
+  EXPECT_EQ(kThreads * kPerProducer * (kPerProducer + 1) / 2, total);
+  EXPECT_TRUE(r.Empty());
+}
+
+}  // namespace
@@ -0,0 +1,173 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_NUMA_H_
+#define BESS_UTILS_NUMA_H_
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+// mbind()/set_mempolicy() without libnuma dependency. Node masks are limited
+// to 64 nodes, same as `placement_constraint`.
+static inline long LinuxMbind(void *addr, unsigned long len, int mode,
+                              const unsigned long *nmask,
+                              unsigned long maxnode, unsigned flags) {
+  return syscall(__NR_mbind, addr, len, mode, nmask, maxnode, flags);
+}
+
+static inline long LinuxSetMempolicy(int mode, const unsigned long *nmask,
+                                     unsigned long maxnode) {
+  return syscall(__NR_set_mempolicy, mode, nmask, maxnode);
+}
+
+static inline long LinuxGetMempolicy(int *mode, unsigned long *nmask,
+                                     unsigned long maxnode) {
+  return syscall(__NR_get_mempolicy, mode, nmask, maxnode, nullptr, 0);
+}
+
+// Allocates `len` zeroed bytes in an anonymous mapping of their own, so that
+// the pages can be moved with MovePagesToNode() without dragging any other
+// object along. Returns nullptr on failure.
+static inline void *AllocPages(size_t len) {
+  void *addr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return addr == MAP_FAILED ? nullptr : addr;
+}
+
+// Releases memory from AllocPages(). `len` must be the allocated length.
+static inline void FreePages(void *addr, size_t len) {
+  if (addr) {
+    munmap(addr, len);
+  }
+}
+
+// std::allocator replacement for containers whose storage is to be moved
+// with MovePagesToNode().
+template <typename T>
+struct PageAllocator {
+  typedef T value_type;
+
+  PageAllocator() = default;
+
+  template <typename U>
+  PageAllocator(const PageAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    void *addr = AllocPages(n * sizeof(T));
+    if (!addr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(addr);
+  }
+
+  void deallocate(T *p, size_t n) { FreePages(p, n * sizeof(T)); }
+};
+
+template <typename T, typename U>
+bool operator==(const PageAllocator<T> &, const PageAllocator<U> &) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PageAllocator<T> &, const PageAllocator<U> &) {
+  return false;
+}
+
+// Migrates the pages backing [addr, addr + len) to NUMA node `node`, and makes
+// later page faults in that range allocate from it. The range must come from
+// AllocPages() (or PageAllocator), so that no other object shares its pages.
+// Returns 0 on success, -errno otherwise.
+static inline int MovePagesToNode(const void *addr, size_t len, int node) {
+  if (node < 0 || node >= 64) {
+    return -EINVAL;
+  }
+  if (len == 0) {
+    return 0;
+  }
+
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+  if (start & (page_size - 1)) {
+    return -EINVAL;
+  }
+  uintptr_t end = (start + len + page_size - 1) & ~(page_size - 1);
+  unsigned long mask = 1ul << node;
+
+  if (LinuxMbind(reinterpret_cast<void *>(start), end - start, MPOL_PREFERRED,
+                 &mask, 64 + 1, MPOL_MF_MOVE) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+// While in scope, new pages faulted in by the calling thread are preferably
+// allocated from NUMA node `node`. A negative `node` leaves the policy alone.
+// The thread's previous policy is restored on destruction.
+class ScopedNodePreference {
+ public:
+  explicit ScopedNodePreference(int node)
+      : active_(false), old_mode_(MPOL_DEFAULT), old_mask_() {
+    if (node >= 0 && node < 64 &&
+        LinuxGetMempolicy(&old_mode_, &old_mask_, 64 + 1) == 0) {
+      unsigned long mask = 1ul << node;
+      active_ = LinuxSetMempolicy(MPOL_PREFERRED, &mask, 64 + 1) == 0;
+    }
+  }
+
+  ~ScopedNodePreference() {
+    if (active_) {
+      LinuxSetMempolicy(old_mode_, &old_mask_, 64 + 1);
+    }
+  }
+
+ private:
+  bool active_;
+  int old_mode_;
+  unsigned long old_mask_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedNodePreference);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_NUMA_H_
@@ -0,0 +1,155 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "openmetrics.h"
+
+#include <cmath>
+
+#include "format.h"
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+// Escapes a label value or help text, as required by the text format.
+std::string Escape(const std::string &s) {
+  std::string ret;
+  ret.reserve(s.size());
+  for (char c : s) {
+    switch (c) {
+      case '\\':
+        ret += "\\\\";
+        break;
+      case '"':
+        ret += "\\\"";
+        break;
+      case '\n':
+        ret += "\\n";
+        break;
+      default:
+        ret += c;
+    }
+  }
+  return ret;
+}
+
+std::string FormatDouble(double v) {
+  if (std::isnan(v)) {
+    return "NaN";
+  } else if (std::isinf(v)) {
+    return v > 0 ? "+Inf" : "-Inf";
+  }
+  return Format("%.12g", v);
+}
+
+// Appends "name{labels} value\n" to `out`. `extra` is an additional label
+// (e.g., "le") that comes last, if its name is not empty.
+void AppendSample(std::string *out, const std::string &name,
+                  const OpenMetricsWriter::Labels &labels,
+                  const std::pair<std::string, std::string> &extra,
+                  const std::string &value) {
+  *out += name;
+  if (!labels.empty() || !extra.first.empty()) {
+    char sep = '{';
+    for (const auto &label : labels) {
+      *out += sep;
+      *out += label.first + "=\"" + Escape(label.second) + "\"";
+      sep = ',';
+    }
+    if (!extra.first.empty()) {
+      *out += sep;
+      *out += extra.first + "=\"" + extra.second + "\"";
+    }
+    *out += '}';
+  }
+  *out += ' ';
+  *out += value;
+  *out += '\n';
+}
+
+}  // namespace
+
+OpenMetricsWriter::Family &OpenMetricsWriter::GetFamily(
+    const std::string &name, const char *type, const std::string &help) {
+  auto it = families_.find(name);
+  if (it == families_.end()) {
+    order_.push_back(name);
+    it = families_.emplace(name, Family{type, help, ""}).first;
+  }
+  return it->second;
+}
+
+void OpenMetricsWriter::Counter(const std::string &name,
+                                const std::string &help, const Labels &labels,
+                                uint64_t value) {
+  Family &f = GetFamily(name, "counter", help);
+  AppendSample(&f.samples, name + "_total", labels, {},
+               Format("%lu", static_cast<unsigned long>(value)));
+}
+
+void OpenMetricsWriter::Gauge(const std::string &name, const std::string &help,
+                              const Labels &labels, double value) {
+  Family &f = GetFamily(name, "gauge", help);
+  AppendSample(&f.samples, name, labels, {}, FormatDouble(value));
+}
+
+void OpenMetricsWriter::Histogram(const std::string &name,
+                                  const std::string &help,
+                                  const Labels &labels, const Buckets &buckets,
+                                  double sum, uint64_t count) {
+  Family &f = GetFamily(name, "histogram", help);
+  uint64_t cumulative = 0;
+  for (const auto &bucket : buckets) {
+    cumulative += bucket.second;
+    AppendSample(&f.samples, name + "_bucket", labels,
+                 {"le", FormatDouble(bucket.first)},
+                 Format("%lu", static_cast<unsigned long>(cumulative)));
+  }
+  AppendSample(&f.samples, name + "_bucket", labels, {"le", "+Inf"},
+               Format("%lu", static_cast<unsigned long>(count)));
+  AppendSample(&f.samples, name + "_count", labels, {},
+               Format("%lu", static_cast<unsigned long>(count)));
+  AppendSample(&f.samples, name + "_sum", labels, {}, FormatDouble(sum));
+}
+
+std::string OpenMetricsWriter::Render() const {
+  std::string ret;
+  for (const std::string &name : order_) {
+    const Family &f = families_.at(name);
+    ret += "# TYPE " + name + " " + f.type + "\n";
+    ret += "# HELP " + name + " " + Escape(f.help) + "\n";
+    ret += f.samples;
+  }
+  ret += "# EOF\n";
+  return ret;
+}
+
+}  // namespace utils
+}  // namespace bess
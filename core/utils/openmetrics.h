@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#ifndef BESS_UTILS_OPENMETRICS_H_
+#define BESS_UTILS_OPENMETRICS_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+// Builds a page of metrics in the OpenMetrics text format, as scraped by
+// Prometheus. Samples may be added in any order; they are grouped by metric
+// family, in the order families were first seen, when the page is rendered.
+// Names should follow the OpenMetrics conventions, e.g., "bess_port_bytes" for
+// a counter, which is exposed as "bess_port_bytes_total".
+class OpenMetricsWriter {
+ public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  // (upper bound, # of samples in the bucket) pairs, in ascending order. The
+  // counts are NOT cumulative.
+  using Buckets = std::vector<std::pair<double, uint64_t>>;
+
+  void Counter(const std::string &name, const std::string &help,
+               const Labels &labels, uint64_t value);
+
+  void Gauge(const std::string &name, const std::string &help,
+             const Labels &labels, double value);
+
+  // `count` is the total # of samples, including the ones above the highest
+  // bucket bound, and `sum` is their sum.
+  void Histogram(const std::string &name, const std::string &help,
+                 const Labels &labels, const Buckets &buckets, double sum,
+                 uint64_t count);
+
+  // Returns the page, terminated by "# EOF".
+  std::string Render() const;
+
+  bool empty() const { return families_.empty(); }
+
+ private:
+  struct Family {
+    std::string type;
+    std::string help;
+    std::string samples;
+  };
+
+  // Returns the family `name`, creating it if needed. A family keeps the type
+  // and help text it was created with.
+  Family &GetFamily(const std::string &name, const char *type,
+                    const std::string &help);
+
+  std::vector<std::string> order_;
+  std::map<std::string, Family> families_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_OPENMETRICS_H_
@@ -0,0 +1,100 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "openmetrics.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::OpenMetricsWriter;
+
+TEST(OpenMetricsTest, Empty) {
+  OpenMetricsWriter w;
+  EXPECT_TRUE(w.empty());
+  EXPECT_EQ("# EOF\n", w.Render());
+}
+
+TEST(OpenMetricsTest, GroupsByFamily) {
+  OpenMetricsWriter w;
+  w.Counter("bess_port_packets", "Packets", {{"port", "p0"}, {"dir", "inc"}},
+            10);
+  w.Gauge("bess_mempool_available_buffers", "Free buffers", {{"socket", "0"}},
+          0.5);
+  w.Counter("bess_port_packets", "ignored", {{"port", "p1"}, {"dir", "out"}},
+            20);
+  w.Gauge("bess_up", "Whether BESS is up", {}, 1);
+  EXPECT_FALSE(w.empty());
+
+  EXPECT_EQ(
+      "# TYPE bess_port_packets counter\n"
+      "# HELP bess_port_packets Packets\n"
+      "bess_port_packets_total{port=\"p0\",dir=\"inc\"} 10\n"
+      "bess_port_packets_total{port=\"p1\",dir=\"out\"} 20\n"
+      "# TYPE bess_mempool_available_buffers gauge\n"
+      "# HELP bess_mempool_available_buffers Free buffers\n"
+      "bess_mempool_available_buffers{socket=\"0\"} 0.5\n"
+      "# TYPE bess_up gauge\n"
+      "# HELP bess_up Whether BESS is up\n"
+      "bess_up 1\n"
+      "# EOF\n",
+      w.Render());
+}
+
+TEST(OpenMetricsTest, Histogram) {
+  OpenMetricsWriter w;
+  w.Histogram("lat_seconds", "Latency", {{"module", "m"}},
+              {{0.001, 3}, {0.002, 0}, {0.003, 2}}, 0.01, 6);
+
+  EXPECT_EQ(
+      "# TYPE lat_seconds histogram\n"
+      "# HELP lat_seconds Latency\n"
+      "lat_seconds_bucket{module=\"m\",le=\"0.001\"} 3\n"
+      "lat_seconds_bucket{module=\"m\",le=\"0.002\"} 3\n"
+      "lat_seconds_bucket{module=\"m\",le=\"0.003\"} 5\n"
+      "lat_seconds_bucket{module=\"m\",le=\"+Inf\"} 6\n"
+      "lat_seconds_count{module=\"m\"} 6\n"
+      "lat_seconds_sum{module=\"m\"} 0.01\n"
+      "# EOF\n",
+      w.Render());
+}
+
+TEST(OpenMetricsTest, Escape) {
+  OpenMetricsWriter w;
+  w.Gauge("g", "a \\ b\nc", {{"name", "x\"y\\z\n"}}, 2);
+
+  EXPECT_EQ(
+      "# TYPE g gauge\n"
+      "# HELP g a \\\\ b\\nc\n"
+      "g{name=\"x\\\"y\\\\z\\n\"} 2\n"
+      "# EOF\n",
+      w.Render());
+}
+
+}  // namespace
@@ -0,0 +1,308 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcap_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+const uint32_t kMagicMicro = PCAP_MAGIC_NUMBER;
+const uint32_t kMagicNano = 0xa1b23c4d;
+
+// Returns 0 on success, or -errno.
+int WriteAll(int fd, const uint8_t *data, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t ret = write(fd, data + done, len - done);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -errno;
+    }
+    done += ret;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int PcapFileReader::Open(const std::string &path) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -errno;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int err = errno;
+    close(fd);
+    return -err;
+  }
+
+  if (static_cast<size_t>(st.st_size) < sizeof(struct pcap_hdr)) {
+    close(fd);
+    return -EINVAL;
+  }
+
+  // MAP_POPULATE prefaults the whole file, so that replay does not take page
+  // faults on the datapath.
+  void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                   fd, 0);
+  int err = errno;
+  close(fd);
+  if (map == MAP_FAILED) {
+    return -err;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+  const uint8_t *base = static_cast<const uint8_t *>(map);
+  const uint8_t *end = base + st.st_size;
+
+  struct pcap_hdr hdr;
+  memcpy(&hdr, base, sizeof(hdr));
+
+  bool swapped;
+  bool nano;
+  if (hdr.magic_number == kMagicMicro || hdr.magic_number == kMagicNano) {
+    swapped = false;
+    nano = (hdr.magic_number == kMagicNano);
+  } else if (__builtin_bswap32(hdr.magic_number) == kMagicMicro ||
+             __builtin_bswap32(hdr.magic_number) == kMagicNano) {
+    swapped = true;
+    nano = (__builtin_bswap32(hdr.magic_number) == kMagicNano);
+  } else {
+    munmap(map, st.st_size);
+    return -EINVAL;
+  }
+
+  map_ = map;
+  map_len_ = st.st_size;
+
+  uint64_t first_ns = 0;
+  const uint8_t *p = base + sizeof(hdr);
+  while (p + sizeof(struct pcap_rec_hdr) <= end) {
+    struct pcap_rec_hdr rec;
+    memcpy(&rec, p, sizeof(rec));
+    if (swapped) {
+      rec.ts_sec = __builtin_bswap32(rec.ts_sec);
+      rec.ts_usec = __builtin_bswap32(rec.ts_usec);
+      rec.incl_len = __builtin_bswap32(rec.incl_len);
+    }
+
+    p += sizeof(rec);
+    if (rec.incl_len > static_cast<size_t>(end - p)) {
+      break;
+    }
+
+    uint64_t ts_ns = rec.ts_sec * 1000000000ull +
+                     (nano ? rec.ts_usec : rec.ts_usec * 1000ull);
+    if (records_.empty()) {
+      first_ns = ts_ns;
+    }
+
+    // Captures are not always in timestamp order; never go back in time.
+    uint64_t rel_ns = (ts_ns > first_ns) ? ts_ns - first_ns : 0;
+    if (!records_.empty()) {
+      rel_ns = std::max(rel_ns, records_.back().ts_ns);
+    }
+
+    records_.push_back({p, rec.incl_len, rel_ns});
+    p += rec.incl_len;
+  }
+
+  return 0;
+}
+
+void PcapFileReader::Close() {
+  if (map_) {
+    munmap(map_, map_len_);
+    map_ = nullptr;
+    map_len_ = 0;
+  }
+  records_.clear();
+}
+
+int PcapFileWriter::Open(const std::string &path, size_t buffer_size) {
+  Close();
+
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    return -errno;
+  }
+
+  buf_.resize(std::max(buffer_size,
+                       sizeof(struct pcap_rec_hdr) + PCAP_SNAPLEN));
+  used_ = 0;
+  spare_.resize(buf_.size());
+  pending_ = 0;
+
+  struct pcap_hdr hdr = {
+      .magic_number = PCAP_MAGIC_NUMBER,
+      .version_major = PCAP_VERSION_MAJOR,
+      .version_minor = PCAP_VERSION_MINOR,
+      .thiszone = PCAP_THISZONE,
+      .sigfigs = PCAP_SIGFIGS,
+      .snaplen = PCAP_SNAPLEN,
+      .network = PCAP_NETWORK,
+  };
+  memcpy(buf_.data(), &hdr, sizeof(hdr));
+  used_ = sizeof(hdr);
+
+  return 0;
+}
+
+void PcapFileWriter::Close() {
+  StopPeriodicFlush();
+
+  if (fd_ >= 0) {
+    Flush();
+    close(fd_);
+    fd_ = -1;
+  }
+  buf_.clear();
+  buf_.shrink_to_fit();
+  used_ = 0;
+  spare_.clear();
+  spare_.shrink_to_fit();
+  pending_ = 0;
+}
+
+uint8_t *PcapFileWriter::AppendRecord(uint32_t caplen, uint32_t orig_len,
+                                      uint32_t ts_sec, uint32_t ts_usec) {
+  DCHECK_LE(caplen, PCAP_SNAPLEN);
+
+  size_t needed = sizeof(struct pcap_rec_hdr) + caplen;
+  if (used_ + needed > buf_.size()) {
+    if (!flusher_.joinable()) {
+      if (Flush() < 0) {
+        return nullptr;
+      }
+    } else if (pending_ == 0) {
+      SwapBuffers();
+      cv_.notify_one();
+    } else {
+      return nullptr;
+    }
+  }
+
+  struct pcap_rec_hdr rec = {
+      .ts_sec = ts_sec,
+      .ts_usec = ts_usec,
+      .incl_len = caplen,
+      .orig_len = orig_len,
+  };
+  memcpy(buf_.data() + used_, &rec, sizeof(rec));
+
+  uint8_t *ret = buf_.data() + used_ + sizeof(rec);
+  used_ += needed;
+  return ret;
+}
+
+void PcapFileWriter::StartPeriodicFlush(uint32_t interval_ms) {
+  StopPeriodicFlush();
+
+  stop_ = false;
+  flusher_ = std::thread([this, interval_ms]() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lock, std::chrono::milliseconds(interval_ms),
+                   [this]() { return stop_ || pending_ > 0; });
+      if (pending_ == 0 && used_ > 0) {
+        SwapBuffers();
+      }
+      if (pending_ == 0) {
+        continue;
+      }
+
+      // AppendRecord() leaves the spare buffer alone while pending_ is set,
+      // so it can be written out without holding the lock.
+      size_t len = pending_;
+      lock.unlock();
+      int ret = WriteAll(fd_, spare_.data(), len);
+      if (ret < 0) {
+        LOG_EVERY_N(ERROR, 100) << "pcap write failed: " << strerror(-ret);
+      }
+      lock.lock();
+      pending_ = 0;
+    }
+  });
+}
+
+void PcapFileWriter::StopPeriodicFlush() {
+  if (!flusher_.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  flusher_.join();
+}
+
+void PcapFileWriter::SwapBuffers() {
+  DCHECK_EQ(pending_, 0);
+  buf_.swap(spare_);
+  pending_ = used_;
+  used_ = 0;
+}
+
+int PcapFileWriter::Flush() {
+  // Records in the spare buffer are older than those in the active one.
+  // Drop what we could not write rather than retrying forever.
+  int ret = WriteAll(fd_, spare_.data(), pending_);
+  pending_ = 0;
+  if (ret == 0) {
+    ret = WriteAll(fd_, buf_.data(), used_);
+  }
+  used_ = 0;
+  return ret;
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,176 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PCAP_FILE_H_
+#define BESS_UTILS_PCAP_FILE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+#include "pcap.h"
+
+namespace bess {
+namespace utils {
+
+// Read-only view of a (classic, non-pcapng) capture file. The whole file is
+// mapped into memory and every record header is indexed once in Open(), so
+// that the datapath can copy packets out of the mapping without any system
+// call or header parsing per packet.
+class PcapFileReader {
+ public:
+  struct Record {
+    const uint8_t *data;
+    uint32_t caplen;
+    uint64_t ts_ns;  // relative to the first record of the file
+  };
+
+  PcapFileReader() : map_(nullptr), map_len_(), records_() {}
+
+  ~PcapFileReader() { Close(); }
+
+  // Maps and indexes the file at `path`. Both microsecond and nanosecond
+  // resolution files are accepted, in either byte order. A truncated last
+  // record is silently ignored. Returns 0 on success, or -errno.
+  int Open(const std::string &path);
+
+  // Unmaps the file. Records previously returned become invalid.
+  void Close();
+
+  bool is_open() const { return map_ != nullptr; }
+
+  size_t size() const { return records_.size(); }
+
+  const Record &record(size_t i) const { return records_[i]; }
+
+  // Timestamp of the last record, relative to the first one.
+  uint64_t duration_ns() const {
+    return records_.empty() ? 0 : records_.back().ts_ns;
+  }
+
+ private:
+  void *map_;
+  size_t map_len_;
+  std::vector<Record> records_;
+
+  DISALLOW_COPY_AND_ASSIGN(PcapFileReader);
+};
+
+// Writes a classic capture file. Records are accumulated in a user-space
+// buffer and handed to the kernel with a single write() each time the buffer
+// fills up, instead of one system call per packet.
+//
+// Once StartPeriodicFlush() is called, the buffer is double-buffered: a full
+// buffer is swapped with a spare one and written out by the flush thread, so
+// that the datapath never blocks on write(). If the spare buffer is still
+// being written when the active one fills up, AppendRecord() fails and the
+// caller is expected to drop the record.
+class PcapFileWriter {
+ public:
+  static const size_t kDefaultBufferSize = 1 << 20;  // 1MB
+
+  PcapFileWriter()
+      : fd_(-1),
+        buf_(),
+        used_(),
+        spare_(),
+        pending_(),
+        mutex_(),
+        cv_(),
+        flusher_(),
+        stop_() {}
+
+  ~PcapFileWriter() { Close(); }
+
+  // Creates (or truncates) the file at `path` and writes the global header.
+  // `buffer_size` is rounded up so that at least one full-sized record fits.
+  // Returns 0 on success, or -errno.
+  int Open(const std::string &path, size_t buffer_size = kDefaultBufferSize);
+
+  // Flushes any buffered records and closes the file.
+  void Close();
+
+  bool is_open() const { return fd_ >= 0; }
+
+  // Starts a thread that writes out buffered records every `interval_ms`, so
+  // that records do not sit in the buffer indefinitely under low traffic, and
+  // whenever the buffer fills up. Once started, AppendRecord() and filling in
+  // the record must be done with mutex() held.
+  void StartPeriodicFlush(uint32_t interval_ms);
+
+  std::mutex &mutex() { return mutex_; }
+
+  // Appends a record header and returns a pointer to `caplen` bytes in the
+  // write buffer, which the caller must fill in before the next call.
+  // `caplen` must not exceed PCAP_SNAPLEN. Returns nullptr on I/O error, or
+  // if both buffers are full while the flush thread is running.
+  uint8_t *AppendRecord(uint32_t caplen, uint32_t orig_len, uint32_t ts_sec,
+                        uint32_t ts_usec);
+
+  // Writes out all buffered records. Must not be called while the flush
+  // thread is running. Returns 0 on success, or -errno.
+  int Flush();
+
+ private:
+  void StopPeriodicFlush();
+
+  // Hands the active buffer to the flush thread. Called with mutex_ held.
+  void SwapBuffers();
+
+  int fd_;
+
+  // Active buffer, filled in by AppendRecord().
+  std::vector<uint8_t> buf_;
+  size_t used_;
+
+  // Spare buffer, holding `pending_` bytes being written out by the flush
+  // thread. It is free to be swapped in when `pending_` is 0.
+  std::vector<uint8_t> spare_;
+  size_t pending_;
+
+  // Guards both buffers against the periodic flush thread, which only holds
+  // it to swap them, never across write().
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread flusher_;
+  bool stop_;
+
+  DISALLOW_COPY_AND_ASSIGN(PcapFileWriter);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PCAP_FILE_H_
@@ -0,0 +1,196 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcap_file.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <mutex>
+
+#include <gtest/gtest.h>
+#include <pcap/pcap.h>
+
+namespace bess {
+namespace utils {
+namespace {
+
+const char *kTraceFile = "testdata/test-pktcaptures/tcpflow-http-3.pcap";
+
+TEST(PcapFileReaderTest, BadFile) {
+  PcapFileReader r;
+  EXPECT_EQ(-ENOENT, r.Open("testdata/test-pktcaptures/nonexistent.pcap"));
+  EXPECT_FALSE(r.is_open());
+  EXPECT_EQ(0, r.size());
+}
+
+// Records indexed from the mapping must match what libpcap reads.
+TEST(PcapFileReaderTest, MatchesLibpcap) {
+  PcapFileReader r;
+  ASSERT_EQ(0, r.Open(kTraceFile));
+  ASSERT_TRUE(r.is_open());
+
+  char errbuf[PCAP_ERRBUF_SIZE];
+  pcap_t *handle = pcap_open_offline(kTraceFile, errbuf);
+  ASSERT_NE(nullptr, handle);
+
+  const u_char *pcap_pkt;
+  struct pcap_pkthdr pcap_hdr;
+  size_t i = 0;
+  uint64_t prev_ns = 0;
+  while ((pcap_pkt = pcap_next(handle, &pcap_hdr)) != nullptr) {
+    ASSERT_LT(i, r.size());
+    const PcapFileReader::Record &rec = r.record(i);
+    ASSERT_EQ(pcap_hdr.caplen, rec.caplen);
+    EXPECT_EQ(0, memcmp(pcap_pkt, rec.data, rec.caplen));
+    EXPECT_GE(rec.ts_ns, prev_ns);
+    prev_ns = rec.ts_ns;
+    i++;
+  }
+  pcap_close(handle);
+
+  EXPECT_EQ(i, r.size());
+  EXPECT_EQ(0, r.record(0).ts_ns);
+  EXPECT_EQ(prev_ns, r.duration_ns());
+}
+
+// Records written through the buffered writer can be read back, including
+// ones that force the buffer to be flushed in the middle.
+TEST(PcapFileWriterTest, RoundTrip) {
+  char path[] = "/tmp/testpcapfileXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  const int kRecords = 100;
+  {
+    PcapFileWriter w;
+    ASSERT_EQ(0, w.Open(path, 4096));
+    for (int i = 0; i < kRecords; i++) {
+      uint32_t len = 60 + i * 97;
+      uint8_t *data = w.AppendRecord(len, len + 1, 1000, i);
+      ASSERT_NE(nullptr, data);
+      memset(data, i, len);
+    }
+  }
+
+  PcapFileReader r;
+  ASSERT_EQ(0, r.Open(path));
+  ASSERT_EQ(kRecords, r.size());
+  for (int i = 0; i < kRecords; i++) {
+    const PcapFileReader::Record &rec = r.record(i);
+    ASSERT_EQ(60 + i * 97, rec.caplen);
+    EXPECT_EQ(i * 1000ull, rec.ts_ns);
+    EXPECT_EQ(i, rec.data[0]);
+    EXPECT_EQ(i, rec.data[rec.caplen - 1]);
+  }
+
+  r.Close();
+  unlink(path);
+}
+
+// With a periodic flush, a lone record reaches the file without waiting for the
+// buffer to fill up or the writer to be closed.
+TEST(PcapFileWriterTest, PeriodicFlush) {
+  char path[] = "/tmp/testpcapfileXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  PcapFileWriter w;
+  ASSERT_EQ(0, w.Open(path));
+  w.StartPeriodicFlush(10);
+  {
+    std::lock_guard<std::mutex> lock(w.mutex());
+    uint8_t *data = w.AppendRecord(64, 64, 1, 0);
+    ASSERT_NE(nullptr, data);
+    memset(data, 0xab, 64);
+  }
+
+  const off_t expected =
+      sizeof(struct pcap_hdr) + sizeof(struct pcap_rec_hdr) + 64;
+  struct stat st = {};
+  for (int i = 0; i < 100 && st.st_size < expected; i++) {
+    usleep(10000);
+    ASSERT_EQ(0, stat(path, &st));
+  }
+  ASSERT_EQ(expected, st.st_size);
+
+  PcapFileReader r;
+  ASSERT_EQ(0, r.Open(path));
+  ASSERT_EQ(1, r.size());
+  EXPECT_EQ(0xab, r.record(0).data[63]);
+
+  r.Close();
+  w.Close();
+  unlink(path);
+}
+
+// With the flush thread running, a full buffer is handed off rather than
+// written out in place. Records that find both buffers full are rejected, and
+// everything accepted makes it to the file in order.
+TEST(PcapFileWriterTest, DoubleBuffered) {
+  char path[] = "/tmp/testpcapfileXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  const int kRecords = 10000;
+  int accepted = 0;
+  {
+    PcapFileWriter w;
+    ASSERT_EQ(0, w.Open(path, 4096));
+    w.StartPeriodicFlush(1000);
+    for (int i = 0; i < kRecords; i++) {
+      std::lock_guard<std::mutex> lock(w.mutex());
+      uint8_t *data = w.AppendRecord(1000, 1000, 1, accepted);
+      if (data) {
+        memset(data, accepted & 0xff, 1000);
+        accepted++;
+      }
+    }
+  }
+  EXPECT_GT(accepted, 0);
+
+  PcapFileReader r;
+  ASSERT_EQ(0, r.Open(path));
+  ASSERT_EQ(accepted, r.size());
+  for (int i = 0; i < accepted; i++) {
+    ASSERT_EQ(i & 0xff, r.record(i).data[999]);
+  }
+
+  r.Close();
+  unlink(path);
+}
+
+}  // namespace
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,130 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "perf_counters.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+struct EventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+const EventConfig kEvents[NUM_PERF_EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+  for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+    fds_[i] = -1;
+    pages_[i] = nullptr;
+  }
+}
+
+int PerfCounters::Open() {
+  Close();
+
+  long page_size = sysconf(_SC_PAGESIZE);
+
+  for (int i = 0; i < NUM_PERF_EVENTS; i++) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = kEvents[i].type;
+    attr.config = kEvents[i].config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // The cycle counter leads the group.
+    int group_fd = fds_[PERF_EVENT_CYCLES];
+    int fd = syscall(__NR_perf_event_open, &attr, 0 /* this thread */,
+                     -1 /* any CPU */, group_fd, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) {
+      if (i == PERF_EVENT_CYCLES) {
+        return -errno;
+      }
+      continue;
+    }
+
+    void *page = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED) {
+      int ret = -errno;
+      close(fd);
+      if (i == PERF_EVENT_CYCLES) {
+        return ret;
+      }
+      continue;
+    }
+
+    fds_[i] = fd;
+    pages_[i] = static_cast<perf_event_mmap_page *>(page);
+  }
+
+  if (!pages_[PERF_EVENT_CYCLES]->cap_user_rdpmc) {
+    Close();
+    return -EPERM;
+  }
+
+  return 0;
+}
+
+void PerfCounters::Close() {
+  long page_size = sysconf(_SC_PAGESIZE);
+
+  // Members first, then the group leader.
+  for (int i = NUM_PERF_EVENTS - 1; i >= 0; i--) {
+    if (pages_[i]) {
+      munmap(pages_[i], page_size);
+      pages_[i] = nullptr;
+    }
+    if (fds_[i] >= 0) {
+      close(fds_[i]);
+      fds_[i] = -1;
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
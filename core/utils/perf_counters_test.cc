@@ -0,0 +1,76 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "perf_counters.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::PerfCounters;
+using bess::utils::perf_arr_t;
+
+// Hardware counters are often unavailable (VMs, containers), in which case
+// Open() must fail cleanly and Read() must not fault.
+TEST(PerfCountersTest, OpenOrFail) {
+  PerfCounters perf;
+  int ret = perf.Open();
+  if (ret < 0) {
+    EXPECT_FALSE(perf.is_open());
+    perf_arr_t values;
+    perf.Read(values);
+    for (uint64_t v : values) {
+      EXPECT_EQ(0, v);
+    }
+    return;
+  }
+
+  EXPECT_TRUE(perf.is_open());
+  EXPECT_TRUE(perf.has_event(bess::utils::PERF_EVENT_CYCLES));
+
+  perf_arr_t before, after;
+  perf.Read(before);
+  volatile uint64_t sum = 0;
+  for (int i = 0; i < 1000000; i++) {
+    sum = sum + i;
+  }
+  perf.Read(after);
+
+  EXPECT_LT(before[bess::utils::PERF_EVENT_CYCLES],
+            after[bess::utils::PERF_EVENT_CYCLES]);
+  if (perf.has_event(bess::utils::PERF_EVENT_INSTRUCTIONS)) {
+    EXPECT_LE(before[bess::utils::PERF_EVENT_INSTRUCTIONS] + 1000000,
+              after[bess::utils::PERF_EVENT_INSTRUCTIONS]);
+  }
+
+  perf.Close();
+  EXPECT_FALSE(perf.is_open());
+}
+
+}  // namespace
@@ -0,0 +1,208 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+// Hierarchical timer wheel with O(1) scheduling and cancellation.
+//
+// Time is divided into ticks of 2^tick_shift ns. The wheel has kLevels levels
+// of kSlots slots each; level L holds timers due in [kSlots^L, kSlots^(L+1))
+// ticks. Whenever the lower level wraps around, the next slot of the upper
+// level is redistributed ("cascaded") downwards, so every timer is touched at
+// most kLevels times before it fires. Timers are intrusive: the owner embeds
+// a TimerWheel::Timer and gets it back in the expiry callback.
+//
+// Not thread-safe. Typical use is one wheel per worker, advanced from the
+// datapath with the current time.
+
+#ifndef BESS_UTILS_TIMER_WHEEL_H_
+#define BESS_UTILS_TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+class TimerWheel {
+ public:
+  static constexpr int kLevelBits = 8;
+  static constexpr int kSlots = 1 << kLevelBits;
+  static constexpr int kLevels = 4;
+
+  struct Timer {
+    Timer() : next(), pprev(), expiry() {}
+
+    bool armed() const { return pprev != nullptr; }
+
+    Timer *next;
+    Timer **pprev;
+    uint64_t expiry;  // in ticks
+  };
+
+  explicit TimerWheel(int tick_shift = 24, uint64_t now_ns = 0)
+      : tick_shift_(tick_shift),
+        cur_tick_(now_ns >> tick_shift),
+        count_(),
+        slots_() {}
+
+  ~TimerWheel() { Clear(); }
+
+  // Arms `t` to fire at `expiry_ns`, or on the next tick if that is in the
+  // past. Re-arms it if it was already armed.
+  void Schedule(Timer *t, uint64_t expiry_ns) {
+    if (t->armed()) {
+      Cancel(t);
+    }
+
+    uint64_t tick = expiry_ns >> tick_shift_;
+    t->expiry = (tick > cur_tick_) ? tick : cur_tick_ + 1;
+    Place(t, cur_tick_);
+    count_++;
+  }
+
+  // Disarms `t` if armed.
+  void Cancel(Timer *t) {
+    if (!t->armed()) {
+      return;
+    }
+    Unlink(t);
+    count_--;
+  }
+
+  // Fires every timer due at or before `now_ns`, in tick order, calling
+  // `on_expire(Timer *)` with the timer already disarmed. The callback may
+  // schedule or cancel any timer, including the one being fired.
+  template <typename F>
+  void Advance(uint64_t now_ns, F &&on_expire) {
+    uint64_t target = now_ns >> tick_shift_;
+
+    while (cur_tick_ < target) {
+      uint64_t tick = cur_tick_ + 1;
+
+      // Cascade each level whose lower level wraps around at this tick.
+      for (int level = 1; level < kLevels; level++) {
+        if ((tick & ((1ull << (level * kLevelBits)) - 1)) != 0) {
+          break;
+        }
+        Cascade(level, tick);
+      }
+
+      cur_tick_ = tick;
+
+      // Everything in this slot is due now. Timers scheduled by the callback
+      // are due later, so they never land in this slot.
+      Timer **head = &slots_[0][tick & (kSlots - 1)];
+      while (Timer *t = *head) {
+        Unlink(t);
+        count_--;
+        on_expire(t);
+      }
+    }
+  }
+
+  // Disarms all timers.
+  void Clear() {
+    for (int level = 0; level < kLevels; level++) {
+      for (int i = 0; i < kSlots; i++) {
+        while (slots_[level][i]) {
+          Unlink(slots_[level][i]);
+        }
+      }
+    }
+    count_ = 0;
+  }
+
+  size_t count() const { return count_; }
+  uint64_t tick_ns() const { return 1ull << tick_shift_; }
+
+ private:
+  // Links `t` into the slot for `t->expiry`, relative to tick `base`.
+  void Place(Timer *t, uint64_t base) {
+    uint64_t delta = t->expiry - base;
+    int level = 0;
+
+    while (level < kLevels - 1 &&
+           delta >= (1ull << ((level + 1) * kLevelBits))) {
+      level++;
+    }
+
+    // Timers beyond the wheel's range park in the last slot of the top
+    // level and are cascaded (and re-parked) until they get in range.
+    uint64_t max_delta = (1ull << (kLevels * kLevelBits)) - 1;
+    uint64_t expiry = (delta > max_delta) ? base + max_delta : t->expiry;
+
+    Timer **head =
+        &slots_[level][(expiry >> (level * kLevelBits)) & (kSlots - 1)];
+    t->next = *head;
+    if (t->next) {
+      t->next->pprev = &t->next;
+    }
+    t->pprev = head;
+    *head = t;
+  }
+
+  void Unlink(Timer *t) {
+    *t->pprev = t->next;
+    if (t->next) {
+      t->next->pprev = t->pprev;
+    }
+    t->next = nullptr;
+    t->pprev = nullptr;
+  }
+
+  void Cascade(int level, uint64_t tick) {
+    Timer **head = &slots_[level][(tick >> (level * kLevelBits)) & (kSlots - 1)];
+    Timer *t = *head;
+    *head = nullptr;
+
+    while (t) {
+      Timer *next = t->next;
+      t->next = nullptr;
+      t->pprev = nullptr;
+      if (t->expiry < tick) {
+        t->expiry = tick;
+      }
+      Place(t, tick);
+      t = next;
+    }
+  }
+
+  const int tick_shift_;
+  uint64_t cur_tick_;  // last tick processed by Advance()
+  size_t count_;
+  Timer *slots_[kLevels][kSlots];
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_TIMER_WHEEL_H_
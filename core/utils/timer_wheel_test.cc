@@ -0,0 +1,164 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "timer_wheel.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "random.h"
+
+namespace {
+
+using bess::utils::TimerWheel;
+
+struct TestTimer {
+  TimerWheel::Timer timer;
+  uint64_t due;        // in ns
+  uint64_t fired_at;   // `now` of the Advance() that fired it, or 0
+  int fired;
+};
+
+static TestTimer *Owner(TimerWheel::Timer *t) {
+  return reinterpret_cast<TestTimer *>(t);
+}
+
+TEST(TimerWheelTest, Basic) {
+  TimerWheel wheel(0, 100);
+  TestTimer a = {}, b = {};
+  int fired = 0;
+  auto cb = [&](TimerWheel::Timer *t) {
+    fired++;
+    Owner(t)->fired++;
+  };
+
+  wheel.Schedule(&a.timer, 150);
+  wheel.Schedule(&b.timer, 90);  // in the past: fires on the next tick
+  EXPECT_EQ(2, wheel.count());
+  EXPECT_TRUE(a.timer.armed());
+
+  wheel.Advance(101, cb);
+  EXPECT_EQ(1, b.fired);
+  EXPECT_EQ(0, a.fired);
+  EXPECT_FALSE(b.timer.armed());
+
+  wheel.Advance(149, cb);
+  EXPECT_EQ(0, a.fired);
+  wheel.Advance(150, cb);
+  EXPECT_EQ(1, a.fired);
+
+  // Cancelled and rescheduled timers
+  wheel.Schedule(&a.timer, 200);
+  wheel.Schedule(&b.timer, 300);
+  wheel.Cancel(&a.timer);
+  wheel.Schedule(&b.timer, 250);
+  EXPECT_EQ(1, wheel.count());
+  wheel.Advance(1000, cb);
+  EXPECT_EQ(1, a.fired);
+  EXPECT_EQ(2, b.fired);
+  EXPECT_EQ(3, fired);
+  EXPECT_EQ(0, wheel.count());
+}
+
+// Timers spread over all levels must fire in the first Advance() that reaches
+// their due time, never earlier, and exactly once.
+TEST(TimerWheelTest, RandomAgainstReference) {
+  const int kNumTimers = 20000;
+  const int kTickShift = 2;
+  Random rng(0);
+  uint64_t now = 12345;
+  TimerWheel wheel(kTickShift, now);
+  std::vector<TestTimer> timers(kNumTimers);
+
+  for (TestTimer &t : timers) {
+    t = {};
+    // Delays up to 2^22 ticks, so that levels 0-2 are all used
+    int bits = rng.GetRange(23);
+    t.due = now + ((1ull << bits) + rng.GetRange(1 << bits)) * (1 << kTickShift);
+    wheel.Schedule(&t.timer, t.due);
+  }
+
+  uint64_t prev = now;
+  while (wheel.count() > 0) {
+    now += rng.GetRange(50000);
+    wheel.Advance(now, [&](TimerWheel::Timer *timer) {
+      TestTimer *t = Owner(timer);
+      t->fired++;
+      t->fired_at = now;
+    });
+
+    for (const TestTimer &t : timers) {
+      if (t.fired) {
+        continue;
+      }
+      ASSERT_GT(t.due >> kTickShift, now >> kTickShift);
+    }
+    for (const TestTimer &t : timers) {
+      if (t.fired_at == now) {
+        ASSERT_GT(t.due >> kTickShift, prev >> kTickShift);
+        ASSERT_LE(t.due >> kTickShift, now >> kTickShift);
+      }
+    }
+    prev = now;
+  }
+
+  for (const TestTimer &t : timers) {
+    EXPECT_EQ(1, t.fired);
+  }
+}
+
+// A callback may reschedule its own timer and cancel others.
+TEST(TimerWheelTest, ScheduleFromCallback) {
+  TimerWheel wheel(0, 0);
+  TestTimer timers[3] = {};
+
+  for (TestTimer &t : timers) {
+    wheel.Schedule(&t.timer, 10);
+  }
+
+  // Whichever timer fires first cancels the other two, and reschedules itself
+  // for "now", which means the next tick.
+  wheel.Advance(10, [&](TimerWheel::Timer *t) {
+    Owner(t)->fired++;
+    for (TestTimer &other : timers) {
+      wheel.Cancel(&other.timer);
+    }
+    wheel.Schedule(t, 10);
+  });
+
+  EXPECT_EQ(1, timers[0].fired + timers[1].fired + timers[2].fired);
+  EXPECT_EQ(1, wheel.count());
+
+  wheel.Advance(11, [&](TimerWheel::Timer *t) { Owner(t)->fired++; });
+  EXPECT_EQ(2, timers[0].fired + timers[1].fired + timers[2].fired);
+  EXPECT_EQ(0, wheel.count());
+}
+
+}  // namespace (unnamed)
@@ -0,0 +1,194 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "tls.h"
+
+#include <cstdint>
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+const uint8_t kRecordHandshake = 22;
+const uint8_t kHandshakeClientHello = 1;
+const uint16_t kExtensionServerName = 0;
+const uint8_t kNameTypeHostName = 0;
+
+// Bounds-checked big-endian reader.
+class Reader {
+ public:
+  Reader(const uint8_t *p, size_t len) : p_(p), end_(p + len), ok_(true) {}
+
+  bool ok() const { return ok_; }
+  size_t left() const { return end_ - p_; }
+  const uint8_t *pos() const { return p_; }
+
+  uint32_t Read(int bytes) {
+    uint32_t v = 0;
+    if (left() < static_cast<size_t>(bytes)) {
+      ok_ = false;
+      p_ = end_;
+      return 0;
+    }
+    for (int i = 0; i < bytes; i++) {
+      v = (v << 8) | *p_++;
+    }
+    return v;
+  }
+
+  void Skip(size_t bytes) {
+    if (left() < bytes) {
+      ok_ = false;
+      p_ = end_;
+      return;
+    }
+    p_ += bytes;
+  }
+
+ private:
+  const uint8_t *p_;
+  const uint8_t *end_;
+  bool ok_;
+};
+
+}  // namespace
+
+int ParseTlsSni(const char *buf, size_t len, const char **name,
+                size_t *name_len, std::string *scratch) {
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(buf);
+
+  // The handshake message, which is only copied to `scratch` if it spans
+  // more than one record.
+  const uint8_t *handshake = nullptr;
+  size_t handshake_len = 0;
+  size_t hello_len = 0;
+  size_t off = 0;
+
+  while (true) {
+    const uint8_t *p = data + off;
+    size_t left = len - off;
+
+    // Record header: type (1), legacy version (2), length (2)
+    if (left >= 1 && p[0] != kRecordHandshake) {
+      return -1;
+    }
+    if (left >= 2 && p[1] != 3) {
+      return -1;
+    }
+    if (left < 5) {
+      return -2;
+    }
+    size_t record_len = (p[3] << 8) | p[4];
+    if (record_len == 0) {
+      return -1;
+    }
+    if (left - 5 < record_len) {
+      return -2;
+    }
+
+    if (off == 0) {
+      handshake = p + 5;
+      handshake_len = record_len;
+    } else {
+      if (off == 5 + handshake_len) {
+        // Second record: start over from the first fragment.
+        scratch->assign(reinterpret_cast<const char *>(handshake),
+                        handshake_len);
+      }
+      scratch->append(reinterpret_cast<const char *>(p + 5), record_len);
+      handshake = reinterpret_cast<const uint8_t *>(scratch->data());
+      handshake_len = scratch->size();
+    }
+    off += 5 + record_len;
+
+    // Handshake header: type (1), length (3)
+    if (handshake_len >= 4) {
+      if (handshake[0] != kHandshakeClientHello) {
+        return -1;
+      }
+      hello_len = (handshake[1] << 16) | (handshake[2] << 8) | handshake[3];
+      if (hello_len > kMaxTlsClientHelloLen) {
+        return -3;
+      }
+      if (handshake_len - 4 >= hello_len) {
+        break;
+      }
+    }
+  }
+
+  Reader hello(handshake + 4, hello_len);
+  hello.Skip(2 + 32);          // legacy version, random
+  hello.Skip(hello.Read(1));   // legacy session id
+  hello.Skip(hello.Read(2));   // cipher suites
+  hello.Skip(hello.Read(1));   // legacy compression methods
+  size_t extensions_len = hello.Read(2);
+  if (!hello.ok() || extensions_len > hello.left()) {
+    return -1;
+  }
+
+  Reader extensions(hello.pos(), extensions_len);
+  while (extensions.left() >= 4) {
+    uint16_t type = extensions.Read(2);
+    size_t ext_len = extensions.Read(2);
+    if (ext_len > extensions.left()) {
+      return -1;
+    }
+    if (type != kExtensionServerName) {
+      extensions.Skip(ext_len);
+      continue;
+    }
+
+    Reader ext(extensions.pos(), ext_len);
+    size_t list_len = ext.Read(2);
+    if (!ext.ok() || list_len > ext.left()) {
+      return -1;
+    }
+    Reader list(ext.pos(), list_len);
+    while (list.left() >= 3) {
+      uint8_t name_type = list.Read(1);
+      size_t host_len = list.Read(2);
+      if (host_len > list.left()) {
+        return -1;
+      }
+      if (name_type == kNameTypeHostName && host_len > 0) {
+        *name = reinterpret_cast<const char *>(list.pos());
+        *name_len = host_len;
+        return 0;
+      }
+      list.Skip(host_len);
+    }
+    return -1;
+  }
+
+  return -1;
+}
+
+}  // namespace utils
+}  // namespace bess
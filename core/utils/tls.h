@@ -0,0 +1,57 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_TLS_H_
+#define BESS_UTILS_TLS_H_
+
+#include <cstddef>
+#include <string>
+
+namespace bess {
+namespace utils {
+
+// Largest ClientHello ParseTlsSni() inspects. Clients send much smaller ones
+// in practice, even with post-quantum key shares.
+static const size_t kMaxTlsClientHelloLen = 16384;
+
+// Extracts the server name (SNI, RFC 6066) from a TLS ClientHello at the
+// start of `buf`, i.e., the first bytes a TLS client sends on a connection.
+// Returns 0 and sets `name`/`name_len` on success, -2 if the ClientHello is
+// incomplete (more data is needed), -3 if it is larger than
+// kMaxTlsClientHelloLen, and -1 if `buf` is not a ClientHello or it has no
+// server name. A ClientHello split across several records is reassembled in
+// `scratch`; `name` points into `buf` or `scratch`.
+int ParseTlsSni(const char *buf, size_t len, const char **name,
+                size_t *name_len, std::string *scratch);
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_TLS_H_
@@ -0,0 +1,201 @@
+// Copyright (c) 2014-2016, The Regents of the University of California.
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+#include "tls.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using bess::utils::ParseTlsSni;
+
+void Put16(std::string *s, size_t v) {
+  s->push_back(v >> 8);
+  s->push_back(v & 0xff);
+}
+
+// Returns a TLS record with a ClientHello, with an SNI extension for `host`
+// (if not empty) between two other extensions.
+std::string MakeClientHello(const std::string &host) {
+  std::string ext;
+  Put16(&ext, 10);  // supported_groups
+  Put16(&ext, 4);
+  Put16(&ext, 2);
+  Put16(&ext, 29);  // x25519
+  if (!host.empty()) {
+    Put16(&ext, 0);  // server_name
+    Put16(&ext, host.size() + 5);
+    Put16(&ext, host.size() + 3);
+    ext.push_back(0);  // host_name
+    Put16(&ext, host.size());
+    ext += host;
+  }
+  Put16(&ext, 43);  // supported_versions
+  Put16(&ext, 3);
+  ext.push_back(2);
+  Put16(&ext, 0x0304);
+
+  std::string hello;
+  Put16(&hello, 0x0303);
+  hello += std::string(32, 'r');
+  hello.push_back(32);
+  hello += std::string(32, 's');  // session id
+  Put16(&hello, 4);
+  Put16(&hello, 0x1301);
+  Put16(&hello, 0x1302);
+  hello.push_back(1);
+  hello.push_back(0);  // null compression
+  Put16(&hello, ext.size());
+  hello += ext;
+
+  std::string handshake;
+  handshake.push_back(1);  // ClientHello
+  handshake.push_back(0);
+  Put16(&handshake, hello.size());
+  handshake += hello;
+
+  std::string record;
+  record.push_back(22);  // handshake
+  Put16(&record, 0x0301);
+  Put16(&record, handshake.size());
+  return record + handshake;
+}
+
+TEST(TlsTest, Sni) {
+  std::string hello = MakeClientHello("www.example.com");
+  const char *name;
+  size_t name_len;
+  std::string scratch;
+  ASSERT_EQ(0, ParseTlsSni(hello.data(), hello.size(), &name, &name_len,
+                           &scratch));
+  EXPECT_EQ("www.example.com", std::string(name, name_len));
+
+  // Trailing data (e.g., early data) is fine.
+  hello += "garbage";
+  ASSERT_EQ(0, ParseTlsSni(hello.data(), hello.size(), &name, &name_len,
+                           &scratch));
+  EXPECT_EQ("www.example.com", std::string(name, name_len));
+}
+
+// Splits the handshake message in the single record `hello` into records that
+// start at the given offsets into the message.
+std::string SplitRecords(const std::string &hello,
+                         const std::vector<size_t> &offsets) {
+  std::string handshake = hello.substr(5);
+  std::string ret;
+  for (size_t i = 0; i < offsets.size(); i++) {
+    size_t end = i + 1 < offsets.size() ? offsets[i + 1] : handshake.size();
+    ret.push_back(22);  // handshake
+    Put16(&ret, 0x0303);
+    Put16(&ret, end - offsets[i]);
+    ret += handshake.substr(offsets[i], end - offsets[i]);
+  }
+  return ret;
+}
+
+TEST(TlsTest, Incomplete) {
+  std::string hello = MakeClientHello("www.example.com");
+  const char *name;
+  size_t name_len;
+  std::string scratch;
+  for (size_t len = 0; len < hello.size(); len++) {
+    EXPECT_EQ(-2, ParseTlsSni(hello.data(), len, &name, &name_len, &scratch))
+        << len;
+  }
+}
+
+TEST(TlsTest, NoSni) {
+  const char *name;
+  size_t name_len;
+  std::string scratch;
+
+  std::string hello = MakeClientHello("");
+  EXPECT_EQ(-1, ParseTlsSni(hello.data(), hello.size(), &name, &name_len,
+                            &scratch));
+
+  std::string http = "GET / HTTP/1.1\r\nHost: www.example.com\r\n\r\n";
+  EXPECT_EQ(-1,
+            ParseTlsSni(http.data(), http.size(), &name, &name_len, &scratch));
+  EXPECT_EQ(-1, ParseTlsSni(http.data(), 1, &name, &name_len, &scratch));
+
+  // Lengths pointing past the record.
+  hello = MakeClientHello("www.example.com");
+  hello[5 + 4 + 2 + 32] = 100;  // session id length
+  EXPECT_EQ(-1, ParseTlsSni(hello.data(), hello.size(), &name, &name_len,
+                            &scratch));
+}
+
+TEST(TlsTest, SplitRecords) {
+  std::string hello = MakeClientHello("www.example.com");
+  const char *name;
+  size_t name_len;
+  std::string scratch;
+
+  // Including a handshake header split in the middle.
+  for (size_t split = 1; split < hello.size() - 5; split++) {
+    std::string split_hello = SplitRecords(hello, {0, split});
+    ASSERT_EQ(0, ParseTlsSni(split_hello.data(), split_hello.size(), &name,
+                             &name_len, &scratch))
+        << split;
+    EXPECT_EQ("www.example.com", std::string(name, name_len)) << split;
+  }
+
+  std::string split_hello = SplitRecords(hello, {0, 2, 3, 50, 100});
+  ASSERT_EQ(0, ParseTlsSni(split_hello.data(), split_hello.size(), &name,
+                           &name_len, &scratch));
+  EXPECT_EQ("www.example.com", std::string(name, name_len));
+  for (size_t len = 0; len < split_hello.size(); len++) {
+    EXPECT_EQ(-2, ParseTlsSni(split_hello.data(), len, &name, &name_len,
+                              &scratch))
+        << len;
+  }
+
+  // Anything but another handshake record before the ClientHello is complete.
+  split_hello = SplitRecords(hello, {0, 100});
+  split_hello[5 + 100] = 23;  // application data
+  EXPECT_EQ(-1, ParseTlsSni(split_hello.data(), split_hello.size(), &name,
+                            &name_len, &scratch));
+}
+
+TEST(TlsTest, TooLarge) {
+  std::string hello = MakeClientHello("www.example.com");
+  const char *name;
+  size_t name_len;
+  std::string scratch;
+
+  // A ClientHello header claiming more than we are willing to reassemble.
+  hello[5 + 1] = 1;  // length += 64KB
+  EXPECT_EQ(-3, ParseTlsSni(hello.data(), hello.size(), &name, &name_len,
+                            &scratch));
+}
+
+}  // namespace
@@ -40,6 +40,7 @@
 
 #include <cassert>
 #include <climits>
+#include <cstring>
 #include <list>
 #include <string>
 #include <utility>
@@ -48,6 +49,7 @@
 #include "module.h"
 #include "opts.h"
 #include "packet_pool.h"
+#include "packet_trace.h"
 #include "resume_hook.h"
 #include "resume_hooks/metadata.h"
 #include "scheduler.h"
@@ -229,6 +231,32 @@ bool is_any_worker_running() {
   return false;
 }
 
+void synchronize_workers() {
+  uint64_t rounds[Worker::kMaxWorkers];
+  bool busy[Worker::kMaxWorkers];
+
+  // Paused (or finished) workers are blocked outside of any task.
+  auto in_task = [](int wid) {
+    Worker *w = workers[wid];
+    return w && (w->status() == WORKER_RUNNING ||
+                 w->status() == WORKER_PAUSING);
+  };
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    busy[wid] = in_task(wid);
+    if (busy[wid]) {
+      rounds[wid] = workers[wid]->rounds();
+    }
+  }
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    while (busy[wid] && in_task(wid) &&
+           workers[wid]->rounds() == rounds[wid]) {
+      std::this_thread::yield();
+    }
+  }
+}
+
 void Worker::SetNonWorker() {
   // These TLS variables should not be accessed by non-worker threads.
   // Assign INT_MIN to the variables so that the program can crash
@@ -304,6 +332,18 @@ void *Worker::Run(void *_arg) {
 
   scheduler_ = arg->scheduler;
 
+  if (FLAGS_perf_counters) {
+    // Counters are per thread, so they must be opened here.
+    perf_counters_ = new bess::utils::PerfCounters();
+    int ret = perf_counters_->Open();
+    if (ret < 0) {
+      LOG(WARNING) << "Worker " << arg->wid
+                   << ": cannot use hardware counters: " << strerror(-ret);
+      delete perf_counters_;
+      perf_counters_ = nullptr;
+    }
+  }
+
   current_tsc_ = rdtsc();
 
   packet_pool_ = bess::PacketPool::GetDefaultPool(socket_);
@@ -328,6 +368,7 @@ void *Worker::Run(void *_arg) {
 
   delete scheduler_;
   delete rand_;
+  delete perf_counters_;
 
   return nullptr;
 }
@@ -348,6 +389,9 @@ void launch_worker(int wid, int core,
     CHECK(false) << "Scheduler " << scheduler << " is invalid.";
   }
 
+  // Before the thread starts, so that the ring is visible to it.
+  bess::trace::InitWorker(wid);
+
   worker_threads[wid] = std::thread(run_worker, &arg);
   worker_threads[wid].detach();
 
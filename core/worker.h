@@ -33,6 +33,7 @@
 
 #include <glog/logging.h>
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <thread>
@@ -41,6 +42,7 @@
 #include "gate.h"
 #include "traffic_class.h"
 #include "utils/common.h"
+#include "utils/perf_counters.h"
 #include "utils/random.h"
 
 #define MAX_GATES 8192
@@ -115,8 +117,21 @@ class Worker {
   uint64_t current_ns() const { return current_ns_; }
   void set_current_ns(uint64_t ns) { current_ns_ = ns; }
 
+  // Number of scheduling rounds completed. Read by other threads to detect
+  // that this worker has passed a quiescent point: the release/acquire pair
+  // orders everything the worker did in earlier rounds before the reader.
+  uint64_t rounds() const { return rounds_.load(std::memory_order_acquire); }
+  void incr_rounds() {
+    // Only the worker itself writes, so no read-modify-write is needed.
+    rounds_.store(rounds_.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+
   Random *rand() const { return rand_; }
 
+  // nullptr unless hardware counters are enabled (--perf_counters).
+  bess::utils::PerfCounters *perf_counters() const { return perf_counters_; }
+
  private:
   volatile worker_status_t status_;
 
@@ -134,7 +149,11 @@ class Worker {
   uint64_t current_tsc_;
   uint64_t current_ns_;
 
+  std::atomic<uint64_t> rounds_;
+
   Random *rand_;
+
+  bess::utils::PerfCounters *perf_counters_;
 };
 
 // NOTE: Do not use "thread_local" here. It requires a function call every time
@@ -175,6 +194,13 @@ void destroy_all_workers();
 
 bool is_any_worker_running();
 
+// Blocks until every worker that may be running a task has finished its
+// current scheduling round. After this returns, no worker can still hold a
+// pointer it loaded before the call, so datapath structures that were
+// replaced with an atomic pointer swap can be freed (a poor man's RCU).
+// Must not be called from a worker thread.
+void synchronize_workers();
+
 int is_cpu_present(unsigned int core_id);
 
 static inline int is_worker_active(int wid) {
@@ -600,10 +600,13 @@ class BESS(object):
         request.arg.Pack(arg)
         return self._request('ConfigureResumeHook', request)
 
-    def tcpdump_gate(self, enable, name, m, direction='out', gate=0, fifo=None):
+    def tcpdump_gate(self, enable, name, m, direction='out', gate=0, fifo=None,
+                     snaplen=0, sample=0):
         arg = bess_msg.TcpdumpArg()
         if fifo is not None:
             arg.fifo = fifo
+        arg.snaplen = snaplen
+        arg.sample = sample
         return self._configure_gate_hook('TcpDump', name, m, arg, enable,
                                          direction, gate)
 
@@ -614,10 +617,13 @@ class BESS(object):
         return self._configure_gate_hook('Track', name, m, arg, enable,
                                          direction, gate)
 
-    def pcapng_gate(self, enable, name, m, direction='out', gate=0, fifo=None):
+    def pcapng_gate(self, enable, name, m, direction='out', gate=0, fifo=None,
+                    snaplen=0, sample=0):
         arg = bess_msg.PcapngArg()
         if fifo is not None:
             arg.fifo = fifo
+        arg.snaplen = snaplen
+        arg.sample = sample
         return self._configure_gate_hook('PcapNg', name, m, arg, enable,
                                          direction, gate)
 
@@ -740,3 +746,46 @@ class BESS(object):
         request = bess_msg.DumpMempoolRequest()
         request.socket = socket
         return self._request('DumpMempool', request)
+
+    def dump_trace(self):
+        return self._request('DumpTrace')
+
+    def save_snapshot(self, path):
+        request = bess_msg.SnapshotRequest()
+        request.path = path
+        return self._request('SaveSnapshot', request)
+
+    def restore_snapshot(self, path):
+        request = bess_msg.SnapshotRequest()
+        request.path = path
+        return self._request('RestoreSnapshot', request)
+
+    def subscribe_stats(self, ports=[], modules=[], tcs=[], interval_ms=0):
+        """Yields StatsUpdate messages until the caller stops iterating.
+
+        Each list holds names of objects to report, or '*' for all of them.
+        """
+        if not self.is_connected():
+            raise self.APIError('BESS daemon not connected')
+
+        request = bess_msg.SubscribeStatsRequest()
+        request.ports.extend(ports)
+        request.modules.extend(modules)
+        request.tcs.extend(tcs)
+        request.interval_ms = interval_ms
+
+        stream = self.stub.SubscribeStats(request)
+        try:
+            for update in stream:
+                if update.error.code != 0:
+                    errmsg = update.error.errmsg or \
+                        '(error message is not given)'
+                    raise self.Error(update.error.code, errmsg,
+                                     query='SubscribeStats',
+                                     query_arg=pb_conv.protobuf_to_dict(
+                                         request))
+                yield update
+        except grpc._channel._Rendezvous as e:
+            raise self.RPCError(str(e))
+        finally:
+            stream.cancel()